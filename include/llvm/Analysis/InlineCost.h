@@ -14,13 +14,20 @@
 #ifndef LLVM_ANALYSIS_INLINECOST_H
 #define LLVM_ANALYSIS_INLINECOST_H
 
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Analysis/CallGraphSCCPass.h"
+#include "llvm/IR/ValueHandle.h"
 #include <cassert>
 #include <climits>
+#include <memory>
 
 namespace llvm {
 class AssumptionCacheTracker;
 class CallSite;
+class Constant;
 class DataLayout;
 class Function;
 class TargetTransformInfo;
@@ -98,6 +105,124 @@ public:
   int getCostDelta() const { return Threshold - getCost(); }
 };
 
+/// \brief A cache of callee summaries for the inline cost analysis.
+///
+/// Computing the cost of a call site walks the body of the callee, so a callee
+/// with many callers is otherwise analyzed once per call site. The summary of
+/// a callee holds the facts that only depend on its body (currently its
+/// ephemeral values) along with a small number of memoized walk results. Each
+/// result is keyed by exactly the call site facts the walk consumes: the
+/// threshold and cost at the start of the walk, and for every argument the
+/// callee actually uses, the simplifications the call site enables for it.
+/// Call sites presenting the same inputs to the callee then reuse the result
+/// instead of re-walking the body.
+///
+/// Clients must call invalidate() whenever the body or attributes of a function
+/// change. Summaries of deleted functions are dropped automatically.
+class InlineCostCache {
+public:
+  /// \brief The simplification opportunities a call site argument provides.
+  struct ArgKey {
+    /// The constant passed for the argument, if any.
+    Constant *C;
+    /// The index of the first used argument sharing this argument's base
+    /// pointer, or -1 if no constant-offset base pointer is known.
+    int BaseIdx;
+    /// The constant offset from the base pointer, valid if BaseIdx >= 0.
+    APInt Offset;
+    bool IsAllocaBase;
+    bool IsNonNull;
+
+    bool operator==(const ArgKey &RHS) const {
+      return C == RHS.C && BaseIdx == RHS.BaseIdx &&
+             IsAllocaBase == RHS.IsAllocaBase && IsNonNull == RHS.IsNonNull &&
+             (BaseIdx < 0 || Offset == RHS.Offset);
+    }
+  };
+
+  /// \brief All call site specific inputs of the walk over the callee body.
+  struct CallSiteKey {
+    int BaseThreshold;
+    int Threshold;
+    int Cost;
+    bool IsCallerRecursive;
+    bool OnlyOneCallAndLocalLinkage;
+    SmallVector<ArgKey, 4> Args;
+
+    bool operator==(const CallSiteKey &RHS) const {
+      return BaseThreshold == RHS.BaseThreshold &&
+             Threshold == RHS.Threshold && Cost == RHS.Cost &&
+             IsCallerRecursive == RHS.IsCallerRecursive &&
+             OnlyOneCallAndLocalLinkage == RHS.OnlyOneCallAndLocalLinkage &&
+             Args == RHS.Args;
+    }
+  };
+
+  /// \brief The outcome of a walk over the callee body.
+  struct AnalysisResult {
+    bool ShouldInline;
+    int Cost;
+    int Threshold;
+    unsigned NumInstructions;
+    unsigned NumVectorInstructions;
+    unsigned NumInstructionsSimplified;
+    unsigned NumConstantPtrCmps;
+    unsigned NumConstantPtrDiffs;
+    unsigned SROACostSavings;
+    unsigned SROACostSavingsLost;
+    bool ContainsNoDuplicateCall;
+  };
+
+  /// \brief The cached information about a single callee.
+  struct CalleeSummary {
+    CalleeSummary() : NextVictim(0) {}
+
+    /// The ephemeral values of the callee, which the cost walk skips.
+    SmallPtrSet<const Value *, 32> EphValues;
+
+    /// Memoized walk results, replaced round-robin once the cap is reached.
+    SmallVector<std::pair<CallSiteKey, AnalysisResult>, 4> Results;
+    unsigned NextVictim;
+
+    /// \brief Find the memoized result for \p Key, or null if there is none.
+    const AnalysisResult *lookup(const CallSiteKey &Key) const;
+
+    /// \brief Memoize \p Result for \p Key, evicting an older result if the
+    /// per-callee cap has been reached.
+    void insert(const CallSiteKey &Key, const AnalysisResult &Result);
+  };
+
+  /// \brief Get the summary for \p F, computing the body-only facts if the
+  /// function has not been summarized yet.
+  CalleeSummary &getSummary(Function &F, AssumptionCacheTracker *ACT);
+
+  /// \brief Drop the summary for \p F, if any.
+  void invalidate(Function *F);
+
+  /// \brief Drop all summaries.
+  void clear() { Summaries.clear(); }
+
+private:
+  /// A callback value handle applied to function objects, which we use to
+  /// drop the summary of a function when it is deleted.
+  class FunctionCallbackVH final : public CallbackVH {
+    InlineCostCache *Cache;
+    void deleted() override;
+
+  public:
+    typedef DenseMapInfo<Value *> DMI;
+
+    FunctionCallbackVH(Value *V, InlineCostCache *Cache = nullptr)
+        : CallbackVH(V), Cache(Cache) {}
+  };
+
+  friend FunctionCallbackVH;
+
+  typedef DenseMap<FunctionCallbackVH, std::unique_ptr<CalleeSummary>,
+                   FunctionCallbackVH::DMI> SummaryMapT;
+  SummaryMapT Summaries;
+};
+
 /// \brief Get an InlineCost object representing the cost of inlining this
 /// callsite.
 ///
@@ -108,10 +233,12 @@ public:
 /// sufficiently low to warrant inlining.
 ///
 /// Also note that calling this function *dynamically* computes the cost of
-/// inlining the callsite. It is an expensive, heavyweight call.
+/// inlining the callsite. It is an expensive, heavyweight call. Passing an
+/// \p Cache lets repeated queries against the same callee reuse its summary.
 InlineCost getInlineCost(CallSite CS, int DefaultThreshold,
                          TargetTransformInfo &CalleeTTI,
-                         AssumptionCacheTracker *ACT);
+                         AssumptionCacheTracker *ACT,
+                         InlineCostCache *Cache = nullptr);
 
 /// \brief Get an InlineCost with the callee explicitly specified.
 /// This allows you to calculate the cost of inlining a function via a
@@ -120,7 +247,8 @@ InlineCost getInlineCost(CallSite CS, int DefaultThreshold,
 //
 InlineCost getInlineCost(CallSite CS, Function *Callee, int DefaultThreshold,
                          TargetTransformInfo &CalleeTTI,
-                         AssumptionCacheTracker *ACT);
+                         AssumptionCacheTracker *ACT,
+                         InlineCostCache *Cache = nullptr);
 
 int computeThresholdFromOptLevels(unsigned OptLevel, unsigned SizeOptLevel);
 
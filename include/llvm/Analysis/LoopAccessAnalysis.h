@@ -698,6 +698,10 @@ public:
   /// the analysis.
   const LoopAccessInfo &getInfo(Loop *L, const ValueToValueMap &Strides);
 
+  /// \brief Drop the cached result for \p L, e.g. after the loop was
+  /// transformed in a way that changes the start of its accesses.
+  void forgetLoop(Loop *L) { LoopAccessInfoMap.erase(L); }
+
   void releaseMemory() override {
     // Invalidate the cache when the pass is freed.
     LoopAccessInfoMap.clear();
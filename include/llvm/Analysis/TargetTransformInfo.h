@@ -408,6 +408,12 @@ public:
   /// \brief Additional properties of an operand's values.
   enum OperandValueProperties { OP_None = 0, OP_PowerOf2 = 1 };
 
+  /// \brief The levels of the data cache hierarchy.
+  enum CacheLevel {
+    CL_L1D, ///< The level 1 data cache.
+    CL_L2D  ///< The level 2 data cache.
+  };
+
   /// \return The number of scalar or vector registers that the target has.
   /// If 'Vectors' is true, it returns the number of vector registers. If it is
   /// set to false, it returns the number of scalar registers.
@@ -419,6 +425,14 @@ public:
   /// \return The size of a cache line in bytes.
   unsigned getCacheLineSize() const;
 
+  /// \return The size in bytes of the given level of the data cache, or 0 if
+  /// it is not known.
+  unsigned getCacheSize(CacheLevel Level) const;
+
+  /// \return The number of ways of the given level of the data cache, or 0 if
+  /// it is not known.
+  unsigned getCacheAssociativity(CacheLevel Level) const;
+
   /// \return How much before a load we should place the prefetch instruction.
   /// This is currently measured in number of instructions.
   unsigned getPrefetchDistance() const;
@@ -627,6 +641,8 @@ public:
   virtual unsigned getNumberOfRegisters(bool Vector) = 0;
   virtual unsigned getRegisterBitWidth(bool Vector) = 0;
   virtual unsigned getCacheLineSize() = 0;
+  virtual unsigned getCacheSize(CacheLevel Level) = 0;
+  virtual unsigned getCacheAssociativity(CacheLevel Level) = 0;
   virtual unsigned getPrefetchDistance() = 0;
   virtual unsigned getMinPrefetchStride() = 0;
   virtual unsigned getMaxPrefetchIterationsAhead() = 0;
@@ -799,6 +815,12 @@ public:
   unsigned getCacheLineSize() override {
     return Impl.getCacheLineSize();
   }
+  unsigned getCacheSize(CacheLevel Level) override {
+    return Impl.getCacheSize(Level);
+  }
+  unsigned getCacheAssociativity(CacheLevel Level) override {
+    return Impl.getCacheAssociativity(Level);
+  }
   unsigned getPrefetchDistance() override { return Impl.getPrefetchDistance(); }
   unsigned getMinPrefetchStride() override {
     return Impl.getMinPrefetchStride();
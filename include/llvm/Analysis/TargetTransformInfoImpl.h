@@ -274,6 +274,10 @@ public:
 
   unsigned getCacheLineSize() { return 0; }
 
+  unsigned getCacheSize(TTI::CacheLevel Level) { return 0; }
+
+  unsigned getCacheAssociativity(TTI::CacheLevel Level) { return 0; }
+
   unsigned getPrefetchDistance() { return 0; }
 
   unsigned getMinPrefetchStride() { return 1; }
@@ -248,16 +248,14 @@ namespace llvm {
       assert(I != end());
       if (Pos >= endIndex())
         return end();
-      while (I->end <= Pos) ++I;
-      return I;
+      return gallopTo(I, end(), Pos);
     }
 
     const_iterator advanceTo(const_iterator I, SlotIndex Pos) const {
       assert(I != end());
       if (Pos >= endIndex())
         return end();
-      while (I->end <= Pos) ++I;
-      return I;
+      return gallopTo(I, end(), Pos);
     }
 
     /// find - Return an iterator pointing to the first segment that ends after
@@ -582,6 +580,46 @@ namespace llvm {
     void addSegmentToSet(Segment S);
     void markValNoForDeletion(VNInfo *V);
 
+    /// gallopTo - Return the first segment in [I, E) that ends after Pos,
+    /// which must exist.  Interference queries mostly advance by a segment or
+    /// two, so check the nearby segments first, but take exponentially growing
+    /// steps and then binary search when skipping ahead, which keeps skipping
+    /// over many segments of a huge live range logarithmic.
+    template <typename IterT>
+    static IterT gallopTo(IterT I, IterT E, SlotIndex Pos) {
+      if (Pos < I->end)
+        return I;
+      // Find Hi such that the answer is in (I, Hi).
+      IterT Hi;
+      size_t Step = 1;
+      for (;;) {
+        if (size_t(E - I) <= Step) {
+          Hi = E;
+          break;
+        }
+        IterT Next = I + Step;
+        if (Pos < Next->end) {
+          Hi = Next + 1;
+          break;
+        }
+        I = Next;
+        Step *= 2;
+      }
+      // This is std::upper_bound on the segment ends, as in find().
+      ++I;
+      size_t Len = Hi - I;
+      do {
+        size_t Mid = Len >> 1;
+        if (Pos < I[Mid].end) {
+          Len = Mid;
+        } else {
+          I += Mid + 1;
+          Len -= Mid + 1;
+        }
+      } while (Len);
+      return I;
+    }
+
   };
 
   inline raw_ostream &operator<<(raw_ostream &OS, const LiveRange &LR) {
@@ -246,8 +246,7 @@ extern cl::opt<bool> UseSegmentSetForPhysRegs;
 
     void InsertMachineInstrRangeInMaps(MachineBasicBlock::iterator B,
                                        MachineBasicBlock::iterator E) {
-      for (MachineBasicBlock::iterator I = B; I != E; ++I)
-        Indexes->insertMachineInstrInMaps(*I);
+      Indexes->insertMachineInstrRangeInMaps(B, E);
     }
 
     void RemoveMachineInstrFromMaps(MachineInstr &MI) {
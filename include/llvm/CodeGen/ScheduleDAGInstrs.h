@@ -180,6 +180,15 @@ namespace llvm {
     void reduceHugeMemNodeMaps(Value2SUsMap &stores,
                                Value2SUsMap &loads, unsigned N);
 
+    /// Return true if the stores and loads maps hold so many SUs, and cost so
+    /// many chain dependency checks, that they need to be reduced.
+    bool isHugeMemNodeMaps(const Value2SUsMap &stores,
+                           const Value2SUsMap &loads);
+
+    /// Return how many SUs to reduce huge stores and loads maps by.
+    unsigned getHugeMemNodeMapsReduction(const Value2SUsMap &stores,
+                                         const Value2SUsMap &loads);
+
     /// Add a chain edge between SUa and SUb, but only if both AliasAnalysis
     /// and Target fail to deny the dependency.
     void addChainDependency(SUnit *SUa, SUnit *SUb,
@@ -237,9 +237,12 @@ public:
     llvm_unreachable("Tblgen should generate this!");
   }
 
+  /// Run the matcher table state machine on NodeToMatch, starting at
+  /// MatcherIndex.  TableGen'erated selectors dispatch on the opcode of the
+  /// node to its case of a top-level OPC_SwitchOpcode before calling this.
   SDNode *SelectCodeCommon(SDNode *NodeToMatch,
                            const unsigned char *MatcherTable,
-                           unsigned TableSize);
+                           unsigned TableSize, unsigned MatcherIndex = 0);
 
   /// \brief Return true if complex patterns for this target can mutate the
   /// DAG.
@@ -291,10 +294,6 @@ private:
   ///
   ScheduleDAGSDNodes *CreateScheduler();
 
-  /// OpcodeOffset - This is a cache used to dispatch efficiently into isel
-  /// state machines that start with a OPC_SwitchOpcode node.
-  std::vector<unsigned> OpcodeOffset;
-
   void UpdateChainsAndGlue(SDNode *NodeToMatch, SDValue InputChain,
                            const SmallVectorImpl<SDNode*> &ChainNodesMatched,
                            SDValue InputGlue, const SmallVectorImpl<SDNode*> &F,
@@ -433,11 +433,21 @@ private:
   /// Source line information.
   DebugLoc debugLoc;
 
+  /// The hash of the CSE profile of this node, or 0 if it is not known. It is
+  /// only kept while the node is in the CSE map of the DAG, where it lets a
+  /// lookup skip the other nodes of a bucket without profiling them.
+  unsigned CSEHash;
+
+  /// The position of this node on the worklist of the DAG combiner, -1 if it
+  /// is not on the worklist, or -2 if it is not and has been combined.
+  int CombinerWorklistIndex;
+
   /// Return a pointer to the specified value type.
   static const EVT *getValueTypeList(EVT VT);
 
   friend class SelectionDAG;
   friend struct ilist_traits<SDNode>;
+  friend struct FoldingSetTrait<SDNode>;
   // TODO: unfriend HandleSDNode once we fix its operand handling.
   friend class HandleSDNode;
 
@@ -516,6 +526,12 @@ public:
   /// Set unique node id.
   void setNodeId(int Id) { NodeId = Id; }
 
+  /// Return the position of this node on the worklist of the DAG combiner.
+  int getCombinerWorklistIndex() const { return CombinerWorklistIndex; }
+
+  /// Set the position of this node on the worklist of the DAG combiner.
+  void setCombinerWorklistIndex(int Index) { CombinerWorklistIndex = Index; }
+
   /// Return the node ordering.
   unsigned getIROrder() const { return IROrder; }
 
@@ -800,7 +816,7 @@ protected:
       : NodeType(Opc), HasDebugValue(false), SubclassData(0), NodeId(-1),
         OperandList(nullptr), ValueList(VTs.VTs), UseList(nullptr),
         NumOperands(0), NumValues(VTs.NumVTs), IROrder(Order),
-        debugLoc(std::move(dl)) {
+        debugLoc(std::move(dl)), CSEHash(0), CombinerWorklistIndex(-1) {
     assert(debugLoc.hasTrivialDestructor() && "Expected trivial destructor");
     assert(NumValues == VTs.NumVTs &&
            "NumValues wasn't wide enough for its operands!");
@@ -810,6 +826,31 @@ protected:
   void DropOperands();
 };
 
+/// Specialize FoldingSetTrait for SDNode to cache the hash of each node in the
+/// CSE map, so that neither lookups nor rehashing profile the nodes whose hash
+/// does not match.
+template<> struct FoldingSetTrait<SDNode> : DefaultFoldingSetTrait<SDNode> {
+  static bool Equals(SDNode &X, const FoldingSetNodeID &ID, unsigned IDHash,
+                     FoldingSetNodeID &TempID) {
+    if (X.CSEHash && X.CSEHash != IDHash)
+      return false;
+    X.Profile(TempID);
+    if (TempID == ID) {
+      X.CSEHash = IDHash;
+      return true;
+    }
+    X.CSEHash = TempID.ComputeHash();
+    return false;
+  }
+  static unsigned ComputeHash(SDNode &X, FoldingSetNodeID &TempID) {
+    if (!X.CSEHash) {
+      X.Profile(TempID);
+      X.CSEHash = TempID.ComputeHash();
+    }
+    return X.CSEHash;
+  }
+};
+
 /// Wrapper class for IR location info (IR ordering and DebugLoc) to be passed
 /// into SDNode creation functions.
 /// When an SDNode is created from the DAGBuilder, the DebugLoc is extracted
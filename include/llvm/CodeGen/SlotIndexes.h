@@ -617,6 +617,13 @@ namespace llvm {
       return newIndex;
     }
 
+    /// Insert the machine instructions in [B, E), which must not have indexes
+    /// yet, into the mapping.  This orders them like inserting them one by
+    /// one, but spreads them evenly over the gap they go into, and renumbers
+    /// at most once if the gap is too small.
+    void insertMachineInstrRangeInMaps(MachineBasicBlock::iterator B,
+                                       MachineBasicBlock::iterator E);
+
     /// Remove the given machine instruction from the mapping.
     void removeMachineInstrFromMaps(MachineInstr &MI) {
       // remove index -> MachineInstr and
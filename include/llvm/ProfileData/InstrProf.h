@@ -81,6 +81,10 @@ inline StringRef getInstrProfDataVarPrefix() { return "__profd_"; }
 /// Return the name prefix of profile counter variables.
 inline StringRef getInstrProfCountersVarPrefix() { return "__profc_"; }
 
+/// Return the name prefix of the variables holding the per-thread shards of
+/// the profile counters.
+inline StringRef getInstrProfCounterShardsVarPrefix() { return "__profs_"; }
+
 /// Return the name prefix of the COMDAT group for instrumentation variables
 /// associated with a COMDAT function.
 inline StringRef getInstrProfComdatPrefix() { return "__profv_"; }
@@ -132,6 +136,31 @@ inline StringRef getInstrProfNamesRegFuncName() {
 /// has internal linkage and invoked at startup time via init_array.
 inline StringRef getInstrProfInitFuncName() { return "__llvm_profile_init"; }
 
+/// Return the name of the compiler generated function that adds the
+/// per-thread shards of the counters into the profile counters. It has
+/// internal linkage and runs at exit, before the profile is written.
+inline StringRef getInstrProfMergeShardsFuncName() {
+  return "__llvm_profile_merge_shards";
+}
+
+/// Return the name of the thread local variable whose address selects the
+/// counter shard used by a thread.
+inline StringRef getInstrProfShardKeyVarName() {
+  return "__llvm_profile_shard_key";
+}
+
+/// Return the name of the thread local countdown that selects the function
+/// invocations running the instrumented body in sampled PGO instrumentation.
+inline StringRef getPGOSampleCountdownVarName() {
+  return "__llvm_pgo_sample_countdown";
+}
+
+/// Return the name of the profile runtime interface that registers the
+/// profile writer to run at exit.
+inline StringRef getInstrProfRegisterWriteFileAtExitFuncName() {
+  return "__llvm_profile_register_write_file_atexit";
+}
+
 /// Return the name of the hook variable defined in profile runtime library.
 /// A reference to the variable causes the linker to link in the runtime
 /// initialization module (which defines the hook variable).
@@ -205,6 +205,12 @@ ModulePass *createMergeFunctionsPass();
 ///
 ModulePass *createPartialInliningPass();
 
+//===----------------------------------------------------------------------===//
+/// createHotColdSplittingPass - This pass outlines the cold regions of
+/// functions into separate functions that are marked cold.
+///
+ModulePass *createHotColdSplittingPass();
+
 //===----------------------------------------------------------------------===//
 // createMetaRenamerPass - Rename everything with metasyntatic names.
 //
@@ -18,12 +18,12 @@
 #define LLVM_TRANSFORMS_IPO_INLINERPASS_H
 
 #include "llvm/Analysis/CallGraphSCCPass.h"
+#include "llvm/Analysis/InlineCost.h"
 
 namespace llvm {
 class AssumptionCacheTracker;
 class CallSite;
 class DataLayout;
-class InlineCost;
 template <class PtrType, unsigned SmallSize> class SmallPtrSet;
 
 /// Inliner - This class contains all of the helper code which is used to
@@ -72,6 +72,12 @@ private:
 
 protected:
   AssumptionCacheTracker *ACT;
+
+  /// Callee summaries shared by the cost queries of this inliner. Functions
+  /// are invalidated as soon as the inliner changes them, and the functions of
+  /// an SCC when the inliner is done with it, since the passes scheduled after
+  /// the inliner may change them.
+  InlineCostCache CostCache;
 };
 
 } // End llvm namespace
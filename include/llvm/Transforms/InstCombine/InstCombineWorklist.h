@@ -14,6 +14,7 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Instruction.h"
+#include "llvm/IR/ValueHandle.h"
 #include "llvm/Support/Compiler.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
@@ -28,17 +29,30 @@ class InstCombineWorklist {
   SmallVector<Instruction*, 256> Worklist;
   DenseMap<Instruction*, unsigned> WorklistMap;
 
+  /// Instructions added to the worklist while tracking is enabled. These are
+  /// weak handles since the combiner may delete an instruction after it has
+  /// been processed without going through Remove.
+  SmallVector<WeakVH, 16> Touched;
+  /// The index of each instruction in Touched, to record it only once.
+  DenseMap<Instruction*, unsigned> TouchedMap;
+  bool TrackTouched;
+
   void operator=(const InstCombineWorklist&RHS) = delete;
   InstCombineWorklist(const InstCombineWorklist&) = delete;
 public:
-  InstCombineWorklist() {}
+  InstCombineWorklist() : TrackTouched(false) {}
 
   InstCombineWorklist(InstCombineWorklist &&Arg)
       : Worklist(std::move(Arg.Worklist)),
-        WorklistMap(std::move(Arg.WorklistMap)) {}
+        WorklistMap(std::move(Arg.WorklistMap)),
+        Touched(std::move(Arg.Touched)),
+        TouchedMap(std::move(Arg.TouchedMap)), TrackTouched(Arg.TrackTouched) {}
   InstCombineWorklist &operator=(InstCombineWorklist &&RHS) {
     Worklist = std::move(RHS.Worklist);
     WorklistMap = std::move(RHS.WorklistMap);
+    Touched = std::move(RHS.Touched);
+    TouchedMap = std::move(RHS.TouchedMap);
+    TrackTouched = RHS.TrackTouched;
     return *this;
   }
 
@@ -47,6 +61,9 @@ public:
   /// Add - Add the specified instruction to the worklist if it isn't already
   /// in it.
   void Add(Instruction *I) {
+    // Record I even if it is already queued: the next sparse iteration has to
+    // revisit it after the change that adds it again, like any other.
+    AddTouched(I);
     if (WorklistMap.insert(std::make_pair(I, Worklist.size())).second) {
       DEBUG(dbgs() << "IC: ADD: " << *I << '\n');
       Worklist.push_back(I);
@@ -100,6 +117,48 @@ public:
   }
 
 
+  /// setTrackTouched - Start or stop recording the instructions added to the
+  /// worklist. Every change the combiner makes adds the changed instructions
+  /// and their users, so the recorded set is everything a change may have
+  /// exposed new opportunities in.
+  void setTrackTouched(bool Track) {
+    TrackTouched = Track;
+    if (!Track) {
+      Touched.clear();
+      TouchedMap.clear();
+    }
+  }
+
+  bool isTrackingTouched() const { return TrackTouched; }
+
+  /// AddTouched - Record \p I for the next sparse iteration without adding it
+  /// to the worklist.
+  void AddTouched(Instruction *I) {
+    if (!TrackTouched)
+      return;
+    auto It = TouchedMap.insert(std::make_pair(I, Touched.size()));
+    // The recorded instruction may have been deleted, or replaced, since and
+    // its address reused.
+    if (!It.second) {
+      if (static_cast<Value *>(Touched[It.first->second]) == I)
+        return;
+      It.first->second = Touched.size();
+    }
+    Touched.push_back(I);
+  }
+
+  /// takeTouched - Move the instructions recorded since the last call into
+  /// \p Out. Instructions deleted in the meantime are dropped, and
+  /// instructions that were replaced are reported as their replacement if it
+  /// is still an instruction.
+  void takeTouched(SmallVectorImpl<Instruction *> &Out) {
+    for (WeakVH &V : Touched)
+      if (Instruction *I = dyn_cast_or_null<Instruction>(V))
+        Out.push_back(I);
+    Touched.clear();
+    TouchedMap.clear();
+  }
+
   /// Zap - check that the worklist is empty and nuke the backing store for
   /// the map if it is large.
   void Zap() {
@@ -86,11 +86,20 @@ createPGOInstrumentationUsePass(StringRef Filename = StringRef(""));
 
 /// Options for the frontend instrumentation based profiling pass.
 struct InstrProfOptions {
-  InstrProfOptions() : NoRedZone(false) {}
+  InstrProfOptions()
+      : NoRedZone(false), DoCounterPromotion(false), NumCounterShards(1) {}
 
   // Add the 'noredzone' attribute to added runtime library calls.
   bool NoRedZone;
 
+  // Accumulate the counts of the counters incremented in a loop in registers
+  // and add them to the counters on the loop exits.
+  bool DoCounterPromotion;
+
+  // Number of per-thread shards of the counters, which are merged into the
+  // counters when the profile is written. 1 disables sharding.
+  unsigned NumCounterShards;
+
   // Name of the profile file to use as output
   std::string InstrProfileOutput;
 };
@@ -147,6 +147,20 @@ Pass *createLICMPass();
 //
 Pass *createLoopInterchangePass();
 
+//===----------------------------------------------------------------------===//
+//
+// LoopFuse - This pass fuses adjacent loops with the same trip count, so that
+// the second one reuses the data the first one brings into the cache.
+//
+FunctionPass *createLoopFusePass();
+
+//===----------------------------------------------------------------------===//
+//
+// LoopTile - This pass tiles perfect loop nests so that the data of each tile
+// stays in the data cache.
+//
+FunctionPass *createLoopTilePass();
+
 //===----------------------------------------------------------------------===//
 //
 // LoopStrengthReduce - This pass is strength reduces GEP instructions that use
@@ -333,6 +347,12 @@ FunctionPass *createEarlyCSEPass();
 //
 FunctionPass *createMergedLoadStoreMotionPass();
 
+//===----------------------------------------------------------------------===//
+//
+// NewGVN - This pass performs optimistic global value numbering on MemorySSA.
+//
+FunctionPass *createNewGVNPass();
+
 //===----------------------------------------------------------------------===//
 //
 // MemCpyOpt - This pass performs optimizations related to eliminating memcpy
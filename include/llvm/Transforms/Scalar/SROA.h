@@ -81,7 +81,10 @@ class SROA : public PassInfoMixin<SROA> {
   SetVector<AllocaInst *, SmallVector<AllocaInst *, 16>> PostPromotionWorklist;
 
   /// \brief A collection of alloca instructions we can directly promote.
-  std::vector<AllocaInst *> PromotableAllocas;
+  ///
+  /// This is a set so that allocas which get deleted or need re-splitting can
+  /// be looked up without scanning every promotable alloca of the function.
+  SetVector<AllocaInst *, SmallVector<AllocaInst *, 16>> PromotableAllocas;
 
   /// \brief A worklist of PHIs to speculate prior to promoting allocas.
   ///
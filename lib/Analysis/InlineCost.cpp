@@ -38,6 +38,8 @@ using namespace llvm;
 #define DEBUG_TYPE "inline-cost"
 
 STATISTIC(NumCallsAnalyzed, "Number of call sites analyzed");
+STATISTIC(NumCallsMemoized,
+          "Number of call sites whose cost was reused from a callee summary");
 
 // Threshold to use when optsize is specified (and there is no
 // -inline-threshold).
@@ -65,6 +67,11 @@ static cl::opt<int> ColdThreshold(
     "inlinecold-threshold", cl::Hidden, cl::init(225),
     cl::desc("Threshold for inlining functions with cold attribute"));
 
+static cl::opt<unsigned> CostCacheSize(
+    "inline-cost-cache-size", cl::Hidden, cl::init(8),
+    cl::desc("Maximum number of call site cost results memoized per callee "
+             "(0 disables memoization)"));
+
 namespace {
 
 class CallAnalyzer : public InstVisitor<CallAnalyzer, bool> {
@@ -77,6 +84,9 @@ class CallAnalyzer : public InstVisitor<CallAnalyzer, bool> {
   /// The cache of @llvm.assume intrinsics.
   AssumptionCacheTracker *ACT;
 
+  /// The cache of callee summaries, if the client provided one.
+  InlineCostCache *Cache;
+
   // The called function.
   Function &F;
 
@@ -97,6 +107,11 @@ class CallAnalyzer : public InstVisitor<CallAnalyzer, bool> {
   bool HasIndirectBr;
   bool HasFrameEscape;
 
+  /// Whether the walk analyzed another function as the target of an indirect
+  /// call. Such results also depend on the body of that function, so they
+  /// are never memoized.
+  bool HasIndirectCallAnalysis;
+
   /// Number of bytes allocated statically by the callee.
   uint64_t AllocatedSize;
   unsigned NumInstructions, NumVectorInstructions;
@@ -156,6 +171,8 @@ class CallAnalyzer : public InstVisitor<CallAnalyzer, bool> {
 
   // Custom analysis routines.
   bool analyzeBlock(BasicBlock *BB, SmallPtrSetImpl<const Value *> &EphValues);
+  bool analyzeBody(SmallPtrSetImpl<const Value *> &EphValues,
+                   int SingleBBBonus, bool OnlyOneCallAndLocalLinkage);
 
   // Disable several entry points to the visitor so we don't accidentally use
   // them by declaring but not defining them here.
@@ -194,12 +211,14 @@ class CallAnalyzer : public InstVisitor<CallAnalyzer, bool> {
 
 public:
   CallAnalyzer(const TargetTransformInfo &TTI, AssumptionCacheTracker *ACT,
-               Function &Callee, int Threshold, CallSite CSArg)
-    : TTI(TTI), ACT(ACT), F(Callee), CandidateCS(CSArg), Threshold(Threshold),
-        Cost(0), IsCallerRecursive(false), IsRecursiveCall(false),
-        ExposesReturnsTwice(false), HasDynamicAlloca(false),
-        ContainsNoDuplicateCall(false), HasReturn(false), HasIndirectBr(false),
-        HasFrameEscape(false), AllocatedSize(0), NumInstructions(0),
+               Function &Callee, int Threshold, CallSite CSArg,
+               InlineCostCache *Cache = nullptr)
+    : TTI(TTI), ACT(ACT), Cache(Cache), F(Callee), CandidateCS(CSArg),
+        Threshold(Threshold), Cost(0), IsCallerRecursive(false),
+        IsRecursiveCall(false), ExposesReturnsTwice(false),
+        HasDynamicAlloca(false), ContainsNoDuplicateCall(false),
+        HasReturn(false), HasIndirectBr(false), HasFrameEscape(false),
+        HasIndirectCallAnalysis(false), AllocatedSize(0), NumInstructions(0),
         NumVectorInstructions(0), FiftyPercentVectorBonus(0),
         TenPercentVectorBonus(0), VectorBonus(0), NumConstantArgs(0),
         NumConstantOffsetPtrArgs(0), NumAllocaArgs(0), NumConstantPtrCmps(0),
@@ -912,6 +931,7 @@ bool CallAnalyzer::visitCallSite(CallSite CS) {
   // during devirtualization and so we want to give it a hefty bonus for
   // inlining, but cap that bonus in the event that inlining wouldn't pan
   // out. Pretend to inline the function, with a custom threshold.
+  HasIndirectCallAnalysis = true;
   CallAnalyzer CA(TTI, ACT, *F, InlineConstants::IndirectCallThreshold, CS);
   if (CA.analyzeCall(CS)) {
     // We were able to inline the indirect call! Subtract the cost from the
@@ -1163,15 +1183,14 @@ bool CallAnalyzer::analyzeCall(CallSite CS) {
 
   // Update the threshold based on callsite properties
   updateThreshold(CS, F);
+  int BaseThreshold = Threshold;
 
   FiftyPercentVectorBonus = 3 * Threshold / 2;
   TenPercentVectorBonus = 3 * Threshold / 4;
   const DataLayout &DL = F.getParent()->getDataLayout();
 
-  // Track whether the post-inlining function would have more than one basic
-  // block. A single basic block is often intended for inlining. Balloon the
-  // threshold by 50% until we pass the single-BB phase.
-  bool SingleBB = true;
+  // Bonus for the post-inlining function having a single basic block. It is
+  // taken back in analyzeBody once the walk finds a second live block.
   int SingleBBBonus = Threshold / 2;
 
   // Speculatively apply all possible bonuses to Threshold. If cost exceeds
@@ -1261,14 +1280,25 @@ bool CallAnalyzer::analyzeCall(CallSite CS) {
     }
   }
 
+  // Everything the walk over the callee body depends on, other than the body
+  // itself, is recorded in this key so that the result can be memoized.
+  InlineCostCache::CallSiteKey Key;
+  Key.BaseThreshold = BaseThreshold;
+  Key.Threshold = Threshold;
+  Key.Cost = Cost;
+  Key.IsCallerRecursive = IsCallerRecursive;
+  Key.OnlyOneCallAndLocalLinkage = OnlyOneCallAndLocalLinkage;
+
   // Populate our simplified values by mapping from function arguments to call
   // arguments with known important simplifications.
+  SmallVector<Value *, 4> ArgBases;
   CallSite::arg_iterator CAI = CS.arg_begin();
   for (Function::arg_iterator FAI = F.arg_begin(), FAE = F.arg_end();
        FAI != FAE; ++FAI, ++CAI) {
     assert(CAI != CS.arg_end());
+    InlineCostCache::ArgKey AK = {nullptr, -1, APInt(), false, false};
     if (Constant *C = dyn_cast<Constant>(CAI))
-      SimplifiedValues[&*FAI] = C;
+      SimplifiedValues[&*FAI] = AK.C = C;
 
     Value *PtrArg = *CAI;
     if (ConstantInt *C = stripAndComputeInBoundsConstantOffsets(PtrArg)) {
@@ -1279,17 +1309,78 @@ bool CallAnalyzer::analyzeCall(CallSite CS) {
         SROAArgValues[&*FAI] = PtrArg;
         SROAArgCosts[PtrArg] = 0;
       }
+
+      AK.BaseIdx = std::find(ArgBases.begin(), ArgBases.end(), PtrArg) -
+                   ArgBases.begin();
+      AK.Offset = C->getValue();
+      AK.IsAllocaBase = isa<AllocaInst>(PtrArg);
     }
+
+    // Arguments the callee never uses cannot influence the walk, so keep them
+    // out of the key to share results between more call sites.
+    if (FAI->use_empty()) {
+      AK = {nullptr, -1, APInt(), false, false};
+    } else {
+      AK.IsNonNull = paramHasAttr(&*FAI, Attribute::NonNull);
+      if (AK.BaseIdx == (int)ArgBases.size())
+        ArgBases.push_back(PtrArg);
+    }
+    Key.Args.push_back(AK);
   }
   NumConstantArgs = SimplifiedValues.size();
   NumConstantOffsetPtrArgs = ConstantOffsetPtrs.size();
   NumAllocaArgs = SROAArgValues.size();
 
-  // FIXME: If a caller has multiple calls to a callee, we end up recomputing
-  // the ephemeral values multiple times (and they're completely determined by
-  // the callee, so this is purely duplicate work).
-  SmallPtrSet<const Value *, 32> EphValues;
-  CodeMetrics::collectEphemeralValues(&F, &ACT->getAssumptionCache(F), EphValues);
+  if (!Cache) {
+    SmallPtrSet<const Value *, 32> EphValues;
+    CodeMetrics::collectEphemeralValues(&F, &ACT->getAssumptionCache(F),
+                                        EphValues);
+    return analyzeBody(EphValues, SingleBBBonus, OnlyOneCallAndLocalLinkage);
+  }
+
+  InlineCostCache::CalleeSummary &Summary = Cache->getSummary(F, ACT);
+  if (const InlineCostCache::AnalysisResult *R = Summary.lookup(Key)) {
+    ++NumCallsMemoized;
+    Cost = R->Cost;
+    Threshold = R->Threshold;
+    NumInstructions = R->NumInstructions;
+    NumVectorInstructions = R->NumVectorInstructions;
+    NumInstructionsSimplified = R->NumInstructionsSimplified;
+    NumConstantPtrCmps = R->NumConstantPtrCmps;
+    NumConstantPtrDiffs = R->NumConstantPtrDiffs;
+    SROACostSavings = R->SROACostSavings;
+    SROACostSavingsLost = R->SROACostSavingsLost;
+    ContainsNoDuplicateCall = R->ContainsNoDuplicateCall;
+    return R->ShouldInline;
+  }
+
+  bool ShouldInline =
+      analyzeBody(Summary.EphValues, SingleBBBonus, OnlyOneCallAndLocalLinkage);
+  if (!HasIndirectCallAnalysis) {
+    InlineCostCache::AnalysisResult R = {
+        ShouldInline,          Cost,
+        Threshold,             NumInstructions,
+        NumVectorInstructions, NumInstructionsSimplified,
+        NumConstantPtrCmps,    NumConstantPtrDiffs,
+        SROACostSavings,       SROACostSavingsLost,
+        ContainsNoDuplicateCall};
+    Summary.insert(Key, R);
+  }
+  return ShouldInline;
+}
+
+/// \brief Walk the live blocks of the callee and accumulate their cost.
+///
+/// This is the part of analyzeCall which scales with the size of the callee.
+/// Its result only depends on the callee body and on the state analyzeCall
+/// records in an InlineCostCache::CallSiteKey.
+bool CallAnalyzer::analyzeBody(SmallPtrSetImpl<const Value *> &EphValues,
+                               int SingleBBBonus,
+                               bool OnlyOneCallAndLocalLinkage) {
+  // Track whether the post-inlining function would have more than one basic
+  // block. A single basic block is often intended for inlining. Balloon the
+  // threshold by 50% until we pass the single-BB phase.
+  bool SingleBB = true;
 
   // The worklist of live basic blocks in the callee *after* inlining. We avoid
   // adding basic blocks of the callee which can be proven to be dead for this
@@ -1433,9 +1524,10 @@ static bool functionsHaveCompatibleAttributes(Function *Caller,
 
 InlineCost llvm::getInlineCost(CallSite CS, int DefaultThreshold,
                                TargetTransformInfo &CalleeTTI,
-                               AssumptionCacheTracker *ACT) {
+                               AssumptionCacheTracker *ACT,
+                               InlineCostCache *Cache) {
   return getInlineCost(CS, CS.getCalledFunction(), DefaultThreshold, CalleeTTI,
-                       ACT);
+                       ACT, Cache);
 }
 
 int llvm::computeThresholdFromOptLevels(unsigned OptLevel,
@@ -1454,7 +1546,8 @@ int llvm::getDefaultInlineThreshold() { return DefaultInlineThreshold; }
 InlineCost llvm::getInlineCost(CallSite CS, Function *Callee,
                                int DefaultThreshold,
                                TargetTransformInfo &CalleeTTI,
-                               AssumptionCacheTracker *ACT) {
+                               AssumptionCacheTracker *ACT,
+                               InlineCostCache *Cache) {
 
   // Cannot inline indirect calls.
   if (!Callee)
@@ -1487,7 +1580,7 @@ InlineCost llvm::getInlineCost(CallSite CS, Function *Callee,
   DEBUG(llvm::dbgs() << "      Analyzing call of " << Callee->getName()
         << "...\n");
 
-  CallAnalyzer CA(CalleeTTI, ACT, *Callee, DefaultThreshold, CS);
+  CallAnalyzer CA(CalleeTTI, ACT, *Callee, DefaultThreshold, CS, Cache);
   bool ShouldInline = CA.analyzeCall(CS);
 
   DEBUG(CA.dump());
@@ -1501,6 +1594,54 @@ InlineCost llvm::getInlineCost(CallSite CS, Function *Callee,
   return llvm::InlineCost::get(CA.getCost(), CA.getThreshold());
 }
 
+const InlineCostCache::AnalysisResult *
+InlineCostCache::CalleeSummary::lookup(const CallSiteKey &Key) const {
+  for (const auto &Entry : Results)
+    if (Entry.first == Key)
+      return &Entry.second;
+  return nullptr;
+}
+
+void InlineCostCache::CalleeSummary::insert(const CallSiteKey &Key,
+                                            const AnalysisResult &Result) {
+  if (CostCacheSize == 0)
+    return;
+  if (Results.size() < CostCacheSize) {
+    Results.push_back(std::make_pair(Key, Result));
+    return;
+  }
+  Results[NextVictim] = std::make_pair(Key, Result);
+  NextVictim = (NextVictim + 1) % Results.size();
+}
+
+void InlineCostCache::FunctionCallbackVH::deleted() {
+  Cache->invalidate(cast<Function>(getValPtr()));
+  // 'this' now dangles!
+}
+
+InlineCostCache::CalleeSummary &
+InlineCostCache::getSummary(Function &F, AssumptionCacheTracker *ACT) {
+  // We probe the function map twice to try and avoid creating a value handle
+  // around the function in common cases.
+  auto I = Summaries.find_as(&F);
+  if (I != Summaries.end())
+    return *I->second;
+
+  auto Summary = llvm::make_unique<CalleeSummary>();
+  CodeMetrics::collectEphemeralValues(&F, &ACT->getAssumptionCache(F),
+                                      Summary->EphValues);
+  auto IP = Summaries.insert(
+      std::make_pair(FunctionCallbackVH(&F, this), std::move(Summary)));
+  assert(IP.second && "Summarizing function already in the map?");
+  return *IP.first->second;
+}
+
+void InlineCostCache::invalidate(Function *F) {
+  auto I = Summaries.find_as(F);
+  if (I != Summaries.end())
+    Summaries.erase(I);
+}
+
 bool llvm::isInlineViable(Function &F) {
   bool ReturnsTwice = F.hasFnAttribute(Attribute::ReturnsTwice);
   for (Function::iterator BI = F.begin(), BE = F.end(); BI != BE; ++BI) {
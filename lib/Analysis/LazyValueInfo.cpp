@@ -14,6 +14,7 @@
 
 #include "llvm/Analysis/LazyValueInfo.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/FoldingSet.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/Analysis/AssumptionCache.h"
 #include "llvm/Analysis/ConstantFolding.h"
@@ -29,9 +30,11 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/PatternMatch.h"
 #include "llvm/IR/ValueHandle.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
-#include <map>
+#include <algorithm>
 #include <stack>
 using namespace llvm;
 using namespace PatternMatch;
@@ -367,7 +370,7 @@ namespace {
   struct LVIValueHandle final : public CallbackVH {
     LazyValueInfoCache *Parent;
 
-    LVIValueHandle(Value *V, LazyValueInfoCache *P)
+    LVIValueHandle(Value *V, LazyValueInfoCache *P = nullptr)
       : CallbackVH(V), Parent(P) { }
 
     void deleted() override;
@@ -377,31 +380,113 @@ namespace {
   };
 }
 
+namespace {
+  /// A lattice value as stored in the cache. Over-defined values are not
+  /// stored this way at all, and constant ranges are interned, so an entry is
+  /// two words instead of a full LVILatticeVal with its inline ConstantRange.
+  class CachedLatticeVal {
+    enum KindTy : unsigned char { undefined, constant, notconstant, range };
+    KindTy Kind;
+    union {
+      Constant *C;
+      const ConstantRange *CR;
+    };
+
+  public:
+    CachedLatticeVal() : Kind(undefined), C(nullptr) {}
+    CachedLatticeVal(KindTy Kind, Constant *C) : Kind(Kind), C(C) {}
+    CachedLatticeVal(const ConstantRange *CR) : Kind(range), CR(CR) {}
+
+    /// Compress \p LV, which must not be over-defined. Ranges are interned
+    /// through \p Intern.
+    template <typename InternFnTy>
+    static CachedLatticeVal get(const LVILatticeVal &LV, InternFnTy Intern) {
+      assert(!LV.isOverdefined() && "Over-defined values are kept separately");
+      if (LV.isConstant())
+        return CachedLatticeVal(constant, LV.getConstant());
+      if (LV.isNotConstant())
+        return CachedLatticeVal(notconstant, LV.getNotConstant());
+      if (LV.isConstantRange())
+        return CachedLatticeVal(Intern(LV.getConstantRange()));
+      return CachedLatticeVal();
+    }
+
+    LVILatticeVal get() const {
+      switch (Kind) {
+      case undefined:
+        return LVILatticeVal();
+      case constant:
+        return LVILatticeVal::get(C);
+      case notconstant:
+        return LVILatticeVal::getNot(C);
+      case range:
+        return LVILatticeVal::getRange(*CR);
+      }
+      llvm_unreachable("Unknown cached lattice value kind!");
+    }
+
+    bool isRange() const { return Kind == range; }
+    const ConstantRange &getRange() const { return *CR; }
+  };
+
+  /// A constant range owned by the interning pool of the cache.
+  struct InternedRange : public FoldingSetNode {
+    ConstantRange CR;
+
+    InternedRange(const ConstantRange &CR) : CR(CR) {}
+
+    static void Profile(FoldingSetNodeID &ID, const ConstantRange &CR) {
+      CR.getLower().Profile(ID);
+      CR.getUpper().Profile(ID);
+    }
+    void Profile(FoldingSetNodeID &ID) const { Profile(ID, CR); }
+  };
+}
+
+static cl::opt<unsigned> MaxCacheEntries(
+    "lvi-cache-max-entries", cl::Hidden, cl::init(1u << 20),
+    cl::desc("Maximum number of (value, block) results LazyValueInfo keeps "
+             "between queries before it evicts the least recently used "
+             "blocks (0 = unbounded)"));
+
 namespace {
   /// This is the cache kept by LazyValueInfo which
   /// maintains information about queries across the clients' queries.
   class LazyValueInfoCache {
-    /// This is all of the cached block information for exactly one Value*.
-    /// The entries are sorted by the BasicBlock* of the
-    /// entries, allowing us to do a lookup with a binary search.
-    /// Over-defined lattice values are recorded in OverDefinedCache to reduce
-    /// memory overhead.
-    typedef SmallDenseMap<AssertingVH<BasicBlock>, LVILatticeVal, 4>
-        ValueCacheEntryTy;
-
-    /// This is all of the cached information for all values,
-    /// mapped from Value* to key information.
-    std::map<LVIValueHandle, ValueCacheEntryTy> ValueCache;
-
-    /// This tracks, on a per-block basis, the set of values that are
-    /// over-defined at the end of that block.
-    typedef DenseMap<AssertingVH<BasicBlock>, SmallPtrSet<Value *, 4>>
-        OverDefinedCacheTy;
-    OverDefinedCacheTy OverDefinedCache;
-
-    /// Keep track of all blocks that we have ever seen, so we
-    /// don't spend time removing unused blocks from our caches.
-    DenseSet<AssertingVH<BasicBlock> > SeenBlocks;
+    /// This is all of the cached information for exactly one BasicBlock: the
+    /// lattice values at the end of the block, keyed by Value*. Over-defined
+    /// lattice values are recorded in the OverDefined set to reduce memory
+    /// overhead.
+    struct BlockCacheEntry {
+      SmallDenseMap<Value *, CachedLatticeVal, 4> LatticeElements;
+      SmallPtrSet<Value *, 4> OverDefined;
+      /// The query counter value when this block was last used.
+      unsigned LastUse;
+
+      BlockCacheEntry() : LastUse(0) {}
+      unsigned size() const {
+        return LatticeElements.size() + OverDefined.size();
+      }
+    };
+
+    /// The cached information for every block we have ever seen.
+    typedef DenseMap<AssertingVH<BasicBlock>, std::unique_ptr<BlockCacheEntry>>
+        BlockCacheTy;
+    BlockCacheTy BlockCache;
+
+    /// One handle for every value with cached information, so we can purge
+    /// the value from the cache when it is deleted or replaced.
+    DenseSet<LVIValueHandle, DenseMapInfo<Value *>> ValueHandles;
+
+    /// The interned constant ranges referenced by the cache entries.
+    FoldingSet<InternedRange> RangePool;
+    SpecificBumpPtrAllocator<InternedRange> RangeAllocator;
+
+    /// The number of (value, block) results in BlockCache.
+    unsigned NumEntries;
+
+    /// Counts the top level queries, and serves as the LRU clock.
+    unsigned QueryCounter;
 
     /// This stack holds the state of the value solver during a query.
     /// It basically emulates the callstack of the naive
@@ -429,15 +514,56 @@ namespace {
 
     friend struct LVIValueHandle;
 
+    const ConstantRange *internRange(const ConstantRange &CR) {
+      FoldingSetNodeID ID;
+      InternedRange::Profile(ID, CR);
+      void *InsertPos;
+      if (InternedRange *IR = RangePool.FindNodeOrInsertPos(ID, InsertPos))
+        return &IR->CR;
+      InternedRange *IR = new (RangeAllocator.Allocate()) InternedRange(CR);
+      RangePool.InsertNode(IR, InsertPos);
+      return &IR->CR;
+    }
+
+    BlockCacheEntry &getOrCreateEntry(BasicBlock *BB) {
+      std::unique_ptr<BlockCacheEntry> &Entry = BlockCache[BB];
+      if (!Entry)
+        Entry = llvm::make_unique<BlockCacheEntry>();
+      Entry->LastUse = QueryCounter;
+      return *Entry;
+    }
+
+    BlockCacheEntry *getEntry(BasicBlock *BB) {
+      auto I = BlockCache.find(BB);
+      if (I == BlockCache.end())
+        return nullptr;
+      I->second->LastUse = QueryCounter;
+      return I->second.get();
+    }
+
     void insertResult(Value *Val, BasicBlock *BB, const LVILatticeVal &Result) {
-      SeenBlocks.insert(BB);
+      BlockCacheEntry &Entry = getOrCreateEntry(BB);
+      ValueHandles.insert(LVIValueHandle(Val, this));
 
-      // Insert over-defined values into their own cache to reduce memory
+      // Insert over-defined values into their own set to reduce memory
       // overhead.
-      if (Result.isOverdefined())
-        OverDefinedCache[BB].insert(Val);
-      else
-        lookup(Val)[BB] = Result;
+      bool Inserted;
+      if (Result.isOverdefined()) {
+        if (Entry.LatticeElements.erase(Val))
+          --NumEntries;
+        Inserted = Entry.OverDefined.insert(Val).second;
+      } else {
+        if (Entry.OverDefined.erase(Val))
+          --NumEntries;
+        auto Compressed = CachedLatticeVal::get(
+            Result, [&](const ConstantRange &CR) { return internRange(CR); });
+        auto IP = Entry.LatticeElements.insert(std::make_pair(Val, Compressed));
+        if (!IP.second)
+          IP.first->second = Compressed;
+        Inserted = IP.second;
+      }
+      if (Inserted)
+        ++NumEntries;
     }
 
     LVILatticeVal getBlockValue(Value *Val, BasicBlock *BB);
@@ -463,36 +589,45 @@ namespace {
 
     void solve();
 
-    ValueCacheEntryTy &lookup(Value *V) {
-      return ValueCache[LVIValueHandle(V, this)];
+    /// Start a top level query.
+    void beginQuery() {
+      assert(BlockValueStack.empty() && BlockValueSet.empty());
+      ++QueryCounter;
     }
 
-    bool isOverdefined(Value *V, BasicBlock *BB) const {
-      auto ODI = OverDefinedCache.find(BB);
+    /// Finish a top level query, evicting blocks if the cache grew too large.
+    /// This must not happen during a query, since the solver relies on the
+    /// results it has pushed and solved staying in the cache.
+    void endQuery() {
+      if (MaxCacheEntries && NumEntries > MaxCacheEntries)
+        evictLeastRecentlyUsed();
+    }
 
-      if (ODI == OverDefinedCache.end())
-        return false;
+    void evictLeastRecentlyUsed();
 
-      return ODI->second.count(V);
+    bool isOverdefined(Value *V, BasicBlock *BB) {
+      BlockCacheEntry *Entry = getEntry(BB);
+      return Entry && Entry->OverDefined.count(V);
     }
 
     bool hasCachedValueInfo(Value *V, BasicBlock *BB) {
-      if (isOverdefined(V, BB))
-        return true;
-
-      LVIValueHandle ValHandle(V, this);
-      auto I = ValueCache.find(ValHandle);
-      if (I == ValueCache.end())
+      BlockCacheEntry *Entry = getEntry(BB);
+      if (!Entry)
         return false;
-
-      return I->second.count(BB);
+      return Entry->OverDefined.count(V) || Entry->LatticeElements.count(V);
     }
 
     LVILatticeVal getCachedValueInfo(Value *V, BasicBlock *BB) {
-      if (isOverdefined(V, BB))
+      BlockCacheEntry *Entry = getEntry(BB);
+      if (!Entry)
+        return LVILatticeVal();
+      if (Entry->OverDefined.count(V))
         return LVILatticeVal::getOverdefined();
 
-      return lookup(V)[BB];
+      auto I = Entry->LatticeElements.find(V);
+      if (I == Entry->LatticeElements.end())
+        return LVILatticeVal();
+      return I->second.get();
     }
     
   public:
@@ -521,47 +656,93 @@ namespace {
 
     /// clear - Empty the cache.
     void clear() {
-      SeenBlocks.clear();
-      ValueCache.clear();
-      OverDefinedCache.clear();
+      BlockCache.clear();
+      ValueHandles.clear();
+      RangePool.clear();
+      RangeAllocator.DestroyAll();
+      NumEntries = 0;
     }
 
     LazyValueInfoCache(AssumptionCache *AC, const DataLayout &DL,
                        DominatorTree *DT = nullptr)
-        : AC(AC), DL(DL), DT(DT) {}
+        : NumEntries(0), QueryCounter(0), AC(AC), DL(DL), DT(DT) {}
   };
 } // end anonymous namespace
 
 void LVIValueHandle::deleted() {
+  Value *V = getValPtr();
   SmallVector<AssertingVH<BasicBlock>, 4> ToErase;
-  for (auto &I : Parent->OverDefinedCache) {
-    SmallPtrSetImpl<Value *> &ValueSet = I.second;
-    if (ValueSet.count(getValPtr()))
-      ValueSet.erase(getValPtr());
-    if (ValueSet.empty())
+  for (auto &I : Parent->BlockCache) {
+    LazyValueInfoCache::BlockCacheEntry &Entry = *I.second;
+    if (Entry.OverDefined.erase(V) || Entry.LatticeElements.erase(V))
+      --Parent->NumEntries;
+    if (Entry.size() == 0)
       ToErase.push_back(I.first);
   }
   for (auto &BB : ToErase)
-    Parent->OverDefinedCache.erase(BB);
+    Parent->BlockCache.erase(BB);
 
   // This erasure deallocates *this, so it MUST happen after we're done
   // using any and all members of *this.
-  Parent->ValueCache.erase(*this);
+  Parent->ValueHandles.erase(*this);
 }
 
 void LazyValueInfoCache::eraseBlock(BasicBlock *BB) {
-  // Shortcut if we have never seen this block.
-  DenseSet<AssertingVH<BasicBlock> >::iterator I = SeenBlocks.find(BB);
-  if (I == SeenBlocks.end())
+  auto I = BlockCache.find(BB);
+  if (I == BlockCache.end())
     return;
-  SeenBlocks.erase(I);
 
-  auto ODI = OverDefinedCache.find(BB);
-  if (ODI != OverDefinedCache.end())
-    OverDefinedCache.erase(ODI);
+  NumEntries -= I->second->size();
+  BlockCache.erase(I);
+}
+
+void LazyValueInfoCache::evictLeastRecentlyUsed() {
+  // Evict the least recently used blocks until the cache is down to half of
+  // its budget, so that the cost of a sweep is amortized over many queries.
+  std::vector<std::pair<unsigned, BasicBlock *>> Blocks;
+  Blocks.reserve(BlockCache.size());
+  for (auto &I : BlockCache)
+    Blocks.push_back(std::make_pair(I.second->LastUse, I.first));
+  std::sort(Blocks.begin(), Blocks.end());
+
+  unsigned Target = MaxCacheEntries / 2;
+  for (auto &B : Blocks) {
+    if (NumEntries <= Target)
+      break;
+    eraseBlock(B.second);
+  }
 
-  for (auto I = ValueCache.begin(), E = ValueCache.end(); I != E; ++I)
-    I->second.erase(BB);
+  // Drop the handles of the values that have no entries left, and rebuild
+  // the range pool from the surviving entries.
+  DenseSet<Value *> LiveValues;
+  std::vector<ConstantRange> Ranges;
+  for (auto &I : BlockCache) {
+    for (Value *V : I.second->OverDefined)
+      LiveValues.insert(V);
+    for (auto &LE : I.second->LatticeElements) {
+      LiveValues.insert(LE.first);
+      if (LE.second.isRange())
+        Ranges.push_back(LE.second.getRange());
+    }
+  }
+  for (auto I = ValueHandles.begin(), E = ValueHandles.end(); I != E;) {
+    auto Cur = I;
+    ++I;
+    if (!LiveValues.count(*Cur))
+      ValueHandles.erase(Cur);
+  }
+
+  RangePool.clear();
+  RangeAllocator.DestroyAll();
+  auto NextRange = Ranges.begin();
+  for (auto &I : BlockCache)
+    for (auto &LE : I.second->LatticeElements)
+      if (LE.second.isRange())
+        LE.second = CachedLatticeVal(internRange(*NextRange++));
+
+  DEBUG(dbgs() << "LVI: evicted down to " << NumEntries << " entries in "
+               << BlockCache.size() << " blocks for " << ValueHandles.size()
+               << " values\n");
 }
 
 void LazyValueInfoCache::solve() {
@@ -600,7 +781,6 @@ LVILatticeVal LazyValueInfoCache::getBlockValue(Value *Val, BasicBlock *BB) {
   if (Constant *VC = dyn_cast<Constant>(Val))
     return LVILatticeVal::get(VC);
 
-  SeenBlocks.insert(BB);
   return getCachedValueInfo(Val, BB);
 }
 
@@ -630,7 +810,7 @@ bool LazyValueInfoCache::solveBlockValue(Value *Val, BasicBlock *BB) {
                  << "' val=" << getCachedValueInfo(Val, BB) << '\n');
 
     // Since we're reusing a cached value, we don't need to update the
-    // OverDefinedCache. The cache will have been properly updated whenever the
+    // over-defined sets. The cache will have been properly updated whenever the
     // cached value was inserted.
     return true;
   }
@@ -1229,13 +1409,14 @@ LVILatticeVal LazyValueInfoCache::getValueInBlock(Value *V, BasicBlock *BB,
   DEBUG(dbgs() << "LVI Getting block end value " << *V << " at '"
         << BB->getName() << "'\n");
 
-  assert(BlockValueStack.empty() && BlockValueSet.empty());
+  beginQuery();
   if (!hasBlockValue(V, BB)) {
     pushBlockValue(std::make_pair(BB, V)); 
     solve();
   }
   LVILatticeVal Result = getBlockValue(V, BB);
   intersectAssumeBlockValueConstantRange(V, Result, CxtI);
+  endQuery();
 
   DEBUG(dbgs() << "  Result = " << Result << "\n");
   return Result;
@@ -1263,6 +1444,7 @@ getValueOnEdge(Value *V, BasicBlock *FromBB, BasicBlock *ToBB,
   DEBUG(dbgs() << "LVI Getting edge value " << *V << " from '"
         << FromBB->getName() << "' to '" << ToBB->getName() << "'\n");
 
+  beginQuery();
   LVILatticeVal Result;
   if (!getEdgeValue(V, FromBB, ToBB, Result, CxtI)) {
     solve();
@@ -1270,6 +1452,7 @@ getValueOnEdge(Value *V, BasicBlock *FromBB, BasicBlock *ToBB,
     (void)WasFastQuery;
     assert(WasFastQuery && "More work to do after problem solved?");
   }
+  endQuery();
 
   DEBUG(dbgs() << "  Result = " << Result << "\n");
   return Result;
@@ -1290,10 +1473,11 @@ void LazyValueInfoCache::threadEdge(BasicBlock *PredBB, BasicBlock *OldSucc,
   std::vector<BasicBlock*> worklist;
   worklist.push_back(OldSucc);
 
-  auto I = OverDefinedCache.find(OldSucc);
-  if (I == OverDefinedCache.end())
+  BlockCacheEntry *OldEntry = getEntry(OldSucc);
+  if (!OldEntry || OldEntry->OverDefined.empty())
     return; // Nothing to process here.
-  SmallVector<Value *, 4> ValsToClear(I->second.begin(), I->second.end());
+  SmallVector<Value *, 4> ValsToClear(OldEntry->OverDefined.begin(),
+                                      OldEntry->OverDefined.end());
 
   // Use a worklist to perform a depth-first search of OldSucc's successors.
   // NOTE: We do not need a visited list since any blocks we have already
@@ -1307,18 +1491,12 @@ void LazyValueInfoCache::threadEdge(BasicBlock *PredBB, BasicBlock *OldSucc,
     if (ToUpdate == NewSucc) continue;
 
     bool changed = false;
+    BlockCacheEntry *Entry = getEntry(ToUpdate);
     for (Value *V : ValsToClear) {
       // If a value was marked overdefined in OldSucc, and is here too...
-      auto OI = OverDefinedCache.find(ToUpdate);
-      if (OI == OverDefinedCache.end())
+      if (!Entry || !Entry->OverDefined.erase(V))
         continue;
-      SmallPtrSetImpl<Value *> &ValueSet = OI->second;
-      if (!ValueSet.count(V))
-        continue;
-
-      ValueSet.erase(V);
-      if (ValueSet.empty())
-        OverDefinedCache.erase(OI);
+      --NumEntries;
 
       // If we removed anything, then we potentially need to update
       // blocks successors too.
@@ -219,6 +219,14 @@ unsigned TargetTransformInfo::getCacheLineSize() const {
   return TTIImpl->getCacheLineSize();
 }
 
+unsigned TargetTransformInfo::getCacheSize(CacheLevel Level) const {
+  return TTIImpl->getCacheSize(Level);
+}
+
+unsigned TargetTransformInfo::getCacheAssociativity(CacheLevel Level) const {
+  return TTIImpl->getCacheAssociativity(Level);
+}
+
 unsigned TargetTransformInfo::getPrefetchDistance() const {
   return TTIImpl->getPrefetchDistance();
 }
@@ -54,6 +54,8 @@ using namespace llvm;
 STATISTIC(NumGlobalSplits, "Number of split global live ranges");
 STATISTIC(NumLocalSplits,  "Number of split local live ranges");
 STATISTIC(NumEvicted,      "Number of interferences evicted");
+STATISTIC(NumGrowRegionAborted,
+          "Number of split regions abandoned for exceeding the budget");
 
 static cl::opt<SplitEditor::ComplementSpillMode>
 SplitSpillMode("split-spill-mode", cl::Hidden,
@@ -94,6 +96,13 @@ static cl::opt<bool> EnableDeferredSpilling(
              "variable because of other evicted variables."),
     cl::init(false));
 
+static cl::opt<unsigned> GrowRegionComplexityBudget(
+    "grow-region-complexity-budget", cl::Hidden,
+    cl::desc("Maximum number of block visits when growing a split region "
+             "for one candidate register, to bound compile time on huge "
+             "functions"),
+    cl::init(10000));
+
 // FIXME: Find a good default for this flag and remove the flag.
 static cl::opt<unsigned>
 CSRFirstTimeCost("regalloc-csr-first-time-cost",
@@ -347,7 +356,7 @@ private:
   BlockFrequency calcSpillCost();
   bool addSplitConstraints(InterferenceCache::Cursor, BlockFrequency&);
   void addThroughConstraints(InterferenceCache::Cursor, ArrayRef<unsigned>);
-  void growRegion(GlobalSplitCandidate &Cand);
+  bool growRegion(GlobalSplitCandidate &Cand);
   BlockFrequency calcGlobalSplitCost(GlobalSplitCandidate&);
   bool calcCompactRegion(GlobalSplitCandidate&);
   void splitAroundRegion(LiveRangeEdit&, ArrayRef<unsigned>);
@@ -1039,11 +1048,17 @@ void RAGreedy::addThroughConstraints(InterferenceCache::Cursor Intf,
   SpillPlacer->addLinks(makeArrayRef(TBS, T));
 }
 
-void RAGreedy::growRegion(GlobalSplitCandidate &Cand) {
+/// growRegion - Grow the region of Cand through the live-through blocks next
+/// to its positive bundles until it no longer changes.  Each step looks at
+/// every block of a bundle, which doesn't scale to huge functions with long
+/// live ranges, so give up and return false once GrowRegionComplexityBudget
+/// block visits have been spent.
+bool RAGreedy::growRegion(GlobalSplitCandidate &Cand) {
   // Keep track of through blocks that have not been added to SpillPlacer.
   BitVector Todo = SA->getThroughBlocks();
   SmallVectorImpl<unsigned> &ActiveBlocks = Cand.ActiveBlocks;
   unsigned AddedTo = 0;
+  unsigned Budget = GrowRegionComplexityBudget;
 #ifndef NDEBUG
   unsigned Visited = 0;
 #endif
@@ -1055,6 +1070,12 @@ void RAGreedy::growRegion(GlobalSplitCandidate &Cand) {
       unsigned Bundle = NewBundles[i];
       // Look at all blocks connected to Bundle in the full graph.
       ArrayRef<unsigned> Blocks = Bundles->getBlocks(Bundle);
+      if (Blocks.size() >= Budget) {
+        DEBUG(dbgs() << ", out of budget");
+        ++NumGrowRegionAborted;
+        return false;
+      }
+      Budget -= Blocks.size();
       for (ArrayRef<unsigned>::iterator I = Blocks.begin(), E = Blocks.end();
            I != E; ++I) {
         unsigned Block = *I;
@@ -1087,6 +1108,7 @@ void RAGreedy::growRegion(GlobalSplitCandidate &Cand) {
     SpillPlacer->iterate();
   }
   DEBUG(dbgs() << ", v=" << Visited);
+  return true;
 }
 
 /// calcCompactRegion - Compute the set of edge bundles that should be live
@@ -1117,7 +1139,10 @@ bool RAGreedy::calcCompactRegion(GlobalSplitCandidate &Cand) {
     return false;
   }
 
-  growRegion(Cand);
+  if (!growRegion(Cand)) {
+    DEBUG(dbgs() << ", none.\n");
+    return false;
+  }
   SpillPlacer->finish();
 
   if (!Cand.LiveBundles.any()) {
@@ -1432,7 +1457,10 @@ unsigned RAGreedy::calculateRegionSplitCost(LiveInterval &VirtReg,
       });
       continue;
     }
-    growRegion(Cand);
+    if (!growRegion(Cand)) {
+      DEBUG(dbgs() << '\n');
+      continue;
+    }
 
     SpillPlacer->finish();
 
@@ -56,7 +56,9 @@ static cl::opt<bool> UseTBAA("use-tbaa-in-sched-mi", cl::Hidden,
 // reached means best-effort, but may be slow.
 
 // When Stores and Loads maps (or NonAliasStores and NonAliasLoads)
-// together hold this many SUs, a reduction of maps will be done.
+// together hold this many SUs, and adding chain dependencies against
+// them has cost HugeRegion * ReductionSize checks since they were last
+// reduced, a reduction of maps will be done.
 static cl::opt<unsigned> HugeRegion("dag-maps-huge-region", cl::Hidden,
     cl::init(1000), cl::desc("The limit to use while constructing the DAG "
                              "prior to scheduling, at which point a trade-off "
@@ -724,9 +726,16 @@ class ScheduleDAGInstrs::Value2SUsMap : public MapVector<ValueType, SUList> {
 
   /// 1 for loads, 0 for stores. (see comment in SUList)
   unsigned TrueMemOrderLatency;
+
+  /// Number of SUs that new SUs have been checked against for chain
+  /// dependencies since the map was last reduced. SUs are only checked
+  /// against the SUs mapped to the same Value, unless their memory
+  /// location is unknown, so this can stay small even if the map is huge.
+  unsigned NumChecks;
 public:
 
-  Value2SUsMap(unsigned lat = 0) : NumNodes(0), TrueMemOrderLatency(lat) {}
+  Value2SUsMap(unsigned lat = 0)
+      : NumNodes(0), TrueMemOrderLatency(lat), NumChecks(0) {}
 
   /// To keep NumNodes up to date, insert() is used instead of
   /// this operator w/ push_back().
@@ -755,6 +764,7 @@ public:
   void clear() {
     MapVector<ValueType, SUList>::clear();
     NumNodes = 0;
+    NumChecks = 0;
   }
 
   unsigned inline size() const { return NumNodes; }
@@ -770,11 +780,16 @@ public:
     return TrueMemOrderLatency;
   }
 
+  void inline addChecks(unsigned N) { NumChecks += N; }
+  unsigned inline getNumChecks() const { return NumChecks; }
+  void inline resetNumChecks() { NumChecks = 0; }
+
   void dump();
 };
 
 void ScheduleDAGInstrs::addChainDependencies(SUnit *SU,
                                              Value2SUsMap &Val2SUsMap) {
+  Val2SUsMap.addChecks(Val2SUsMap.size());
   for (auto &I : Val2SUsMap)
     addChainDependencies(SU, I.second,
                          Val2SUsMap.getTrueMemOrderLatency());
@@ -784,9 +799,11 @@ void ScheduleDAGInstrs::addChainDependencies(SUnit *SU,
                                              Value2SUsMap &Val2SUsMap,
                                              ValueType V) {
   Value2SUsMap::iterator Itr = Val2SUsMap.find(V);
-  if (Itr != Val2SUsMap.end())
+  if (Itr != Val2SUsMap.end()) {
+    Val2SUsMap.addChecks(Itr->second.size());
     addChainDependencies(SU, Itr->second,
                          Val2SUsMap.getTrueMemOrderLatency());
+  }
 }
 
 void ScheduleDAGInstrs::addBarrierChain(Value2SUsMap &map) {
@@ -1073,14 +1090,19 @@ void ScheduleDAGInstrs::buildSchedGraph(AliasAnalysis *AA,
       addChainDependencies(SU, Stores, UnknownValue);
     }
 
-    // Reduce maps if they grow huge.
-    if (Stores.size() + Loads.size() >= HugeRegion) {
+    // Reduce maps if they grow huge and checking new SUs against them
+    // gets expensive. Accesses to many different Values don't make the
+    // DAG construction quadratic, and are better left precise.
+    if (isHugeMemNodeMaps(Stores, Loads)) {
       DEBUG(dbgs() << "Reducing Stores and Loads maps.\n";);
-      reduceHugeMemNodeMaps(Stores, Loads, ReductionSize);
+      reduceHugeMemNodeMaps(Stores, Loads,
+                            getHugeMemNodeMapsReduction(Stores, Loads));
     }
-    if (NonAliasStores.size() + NonAliasLoads.size() >= HugeRegion) {
+    if (isHugeMemNodeMaps(NonAliasStores, NonAliasLoads)) {
       DEBUG(dbgs() << "Reducing NonAliasStores and NonAliasLoads maps.\n";);
-      reduceHugeMemNodeMaps(NonAliasStores, NonAliasLoads, ReductionSize);
+      reduceHugeMemNodeMaps(NonAliasStores, NonAliasLoads,
+                            getHugeMemNodeMapsReduction(NonAliasStores,
+                                                        NonAliasLoads));
     }
   }
 
@@ -1117,6 +1139,22 @@ void ScheduleDAGInstrs::Value2SUsMap::dump() {
   }
 }
 
+bool ScheduleDAGInstrs::isHugeMemNodeMaps(const Value2SUsMap &stores,
+                                          const Value2SUsMap &loads) {
+  return stores.size() + loads.size() >= HugeRegion &&
+         stores.getNumChecks() + loads.getNumChecks() >=
+             HugeRegion * ReductionSize;
+}
+
+/// The maps may have grown well beyond HugeRegion while the checks against
+/// them were cheap. Reduce them to the size a reduction at HugeRegion
+/// leaves, so that the next expensive checks are bounded again.
+unsigned ScheduleDAGInstrs::getHugeMemNodeMapsReduction(
+    const Value2SUsMap &stores, const Value2SUsMap &loads) {
+  unsigned Size = stores.size() + loads.size();
+  return std::min(Size, Size - HugeRegion + ReductionSize);
+}
+
 /// Reduce maps in FIFO order, by N SUs. This is better than turning
 /// every Nth memory SU into BarrierChain in buildSchedGraph(), since
 /// it avoids unnecessary edges between seen SUs above the new
@@ -1164,6 +1202,8 @@ void ScheduleDAGInstrs::reduceHugeMemNodeMaps(Value2SUsMap &stores,
 
   insertBarrierChain(stores);
   insertBarrierChain(loads);
+  stores.resetNumChecks();
+  loads.resetNumChecks();
 
   DEBUG(dbgs() << "After reduction:\nStoring SUnits:\n";
         stores.dump();
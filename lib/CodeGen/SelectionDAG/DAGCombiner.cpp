@@ -99,20 +99,15 @@ namespace {
     ///
     /// The worklist will not contain duplicates but may contain null entries
     /// due to nodes being deleted from the underlying DAG.
-    SmallVector<SDNode *, 64> Worklist;
-
-    /// \brief Mapping from an SDNode to its position on the worklist.
-    ///
-    /// This is used to find and remove nodes from the worklist (by nulling
-    /// them) when they are deleted from the underlying DAG. It relies on
-    /// stable indices of nodes within the worklist.
-    DenseMap<SDNode *, unsigned> WorklistMap;
-
-    /// \brief Set of nodes which have been combined (at least once).
     ///
-    /// This is used to allow us to reliably add any operands of a DAG node
-    /// which have not yet been combined to the worklist.
-    SmallPtrSet<SDNode *, 32> CombinedNodes;
+    /// Each node keeps its position on the worklist, which is used to find and
+    /// remove it (by nulling the entry) when it is deleted from the underlying
+    /// DAG, or -1 if it is not on the worklist. Nodes which have been combined
+    /// (at least once) and are not on the worklist are marked with -2, so that
+    /// we can reliably add the operands of a DAG node which have not yet been
+    /// combined to the worklist. This saves a hash table lookup on every
+    /// addition and removal.
+    SmallVector<SDNode *, 64> Worklist;
 
     // AA - Used for DAG load/store alias analysis.
     AliasAnalysis &AA;
@@ -136,21 +131,36 @@ namespace {
       if (N->getOpcode() == ISD::HANDLENODE)
         return;
 
-      if (WorklistMap.insert(std::make_pair(N, Worklist.size())).second)
-        Worklist.push_back(N);
+      if (N->getCombinerWorklistIndex() >= 0)
+        return; // Already in the worklist.
+
+      N->setCombinerWorklistIndex(Worklist.size());
+      Worklist.push_back(N);
     }
 
     /// Remove all instances of N from the worklist.
     void removeFromWorklist(SDNode *N) {
-      CombinedNodes.erase(N);
-
-      auto It = WorklistMap.find(N);
-      if (It == WorklistMap.end())
+      int Index = N->getCombinerWorklistIndex();
+      N->setCombinerWorklistIndex(-1);
+      if (Index < 0)
         return; // Not in the worklist.
 
       // Null out the entry rather than erasing it to avoid a linear operation.
-      Worklist[It->second] = nullptr;
-      WorklistMap.erase(It);
+      Worklist[Index] = nullptr;
+    }
+
+    /// Pop the next node off the worklist, skipping the null entries of
+    /// deleted nodes, or return null if the worklist is empty.
+    SDNode *getNextWorklistEntry() {
+      SDNode *N = nullptr;
+      while (!N && !Worklist.empty())
+        N = Worklist.pop_back_val();
+      if (N) {
+        assert(N->getCombinerWorklistIndex() == (int)Worklist.size() &&
+               "Found a worklist entry with a stale index!");
+        N->setCombinerWorklistIndex(-1);
+      }
+      return N;
     }
 
     void deleteAndRecombine(SDNode *N);
@@ -1255,18 +1265,7 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
 
   // while the worklist isn't empty, find a node and
   // try and combine it.
-  while (!WorklistMap.empty()) {
-    SDNode *N;
-    // The Worklist holds the SDNodes in order, but it may contain null entries.
-    do {
-      N = Worklist.pop_back_val();
-    } while (!N);
-
-    bool GoodWorklistEntry = WorklistMap.erase(N);
-    (void)GoodWorklistEntry;
-    assert(GoodWorklistEntry &&
-           "Found a worklist entry without a corresponding map entry!");
-
+  while (SDNode *N = getNextWorklistEntry()) {
     // If N has no uses, it is dead.  Make sure to revisit all N's operands once
     // N is deleted from the DAG, since they too may now be dead or may have a
     // reduced number of uses, allowing other xforms.
@@ -1294,9 +1293,9 @@ void DAGCombiner::Run(CombineLevel AtLevel) {
     // Add any operands of the new node which have not yet been combined to the
     // worklist as well. Because the worklist uniques things already, this
     // won't repeatedly process the same operand.
-    CombinedNodes.insert(N);
+    N->setCombinerWorklistIndex(-2);
     for (const SDValue &ChildN : N->op_values())
-      if (!CombinedNodes.count(ChildN.getNode()))
+      if (ChildN.getNode()->getCombinerWorklistIndex() != -2)
         AddToWorklist(ChildN.getNode());
 
     SDValue RV = combine(N);
@@ -2605,7 +2605,7 @@ public:
 
 SDNode *SelectionDAGISel::
 SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
-                 unsigned TableSize) {
+                 unsigned TableSize, unsigned MatcherIndex) {
   // FIXME: Should these even be selected?  Handle these cases in the caller?
   switch (NodeToMatch->getOpcode()) {
   default:
@@ -2681,43 +2681,10 @@ SelectCodeCommon(SDNode *NodeToMatch, const unsigned char *MatcherTable,
         NodeToMatch->dump(CurDAG);
         dbgs() << '\n');
 
-  // Determine where to start the interpreter.  Normally we start at opcode #0,
-  // but if the state machine starts with an OPC_SwitchOpcode, then we
-  // accelerate the first lookup (which is guaranteed to be hot) with the
-  // OpcodeOffset table.
-  unsigned MatcherIndex = 0;
-
-  if (!OpcodeOffset.empty()) {
-    // Already computed the OpcodeOffset table, just index into it.
-    if (N.getOpcode() < OpcodeOffset.size())
-      MatcherIndex = OpcodeOffset[N.getOpcode()];
-    DEBUG(dbgs() << "  Initial Opcode index to " << MatcherIndex << "\n");
-
-  } else if (MatcherTable[0] == OPC_SwitchOpcode) {
-    // Otherwise, the table isn't computed, but the state machine does start
-    // with an OPC_SwitchOpcode instruction.  Populate the table now, since this
-    // is the first time we're selecting an instruction.
-    unsigned Idx = 1;
-    while (1) {
-      // Get the size of this case.
-      unsigned CaseSize = MatcherTable[Idx++];
-      if (CaseSize & 128)
-        CaseSize = GetVBR(CaseSize, MatcherTable, Idx);
-      if (CaseSize == 0) break;
-
-      // Get the opcode, add the index to the table.
-      uint16_t Opc = MatcherTable[Idx++];
-      Opc |= (unsigned short)MatcherTable[Idx++] << 8;
-      if (Opc >= OpcodeOffset.size())
-        OpcodeOffset.resize((Opc+1)*2);
-      OpcodeOffset[Opc] = Idx;
-      Idx += CaseSize;
-    }
-
-    // Okay, do the lookup for the first opcode.
-    if (N.getOpcode() < OpcodeOffset.size())
-      MatcherIndex = OpcodeOffset[N.getOpcode()];
-  }
+  // The caller has already dispatched on the opcode of the node if the state
+  // machine starts with an OPC_SwitchOpcode, which is guaranteed to be hot.
+  // Otherwise we start at opcode #0.
+  DEBUG(dbgs() << "  Initial Opcode index to " << MatcherIndex << "\n");
 
   while (1) {
     assert(MatcherIndex < TableSize && "Invalid index");
@@ -24,6 +24,7 @@ INITIALIZE_PASS(SlotIndexes, "slotindexes",
 
 STATISTIC(NumLocalRenum,  "Number of local renumberings");
 STATISTIC(NumGlobalRenum, "Number of global renumberings");
+STATISTIC(NumBulkInserts, "Number of instruction ranges inserted at once");
 
 void SlotIndexes::getAnalysisUsage(AnalysisUsage &au) const {
   au.setPreservesAll();
@@ -142,6 +143,44 @@ void SlotIndexes::renumberIndexes(IndexList::iterator curItr) {
   ++NumLocalRenum;
 }
 
+void SlotIndexes::insertMachineInstrRangeInMaps(MachineBasicBlock::iterator B,
+                                                MachineBasicBlock::iterator E) {
+  if (B == E)
+    return;
+
+  // All the new entries go right after the entry of the last indexed
+  // instruction before B, like they would when inserted one at a time.
+  IndexList::iterator prevItr = getIndexBefore(*B).listEntry()->getIterator();
+  IndexList::iterator nextItr = std::next(prevItr);
+
+  unsigned NumInstrs = std::distance(B, E);
+  ++NumBulkInserts;
+
+  // Space the new indexes evenly over the gap, or give up on the gap and
+  // renumber locally once all of them are in if there isn't enough room.
+  unsigned Space =
+      ((nextItr->getIndex() - prevItr->getIndex()) / (NumInstrs + 1)) & ~3u;
+  unsigned index = prevItr->getIndex();
+  IndexList::iterator firstItr = nextItr;
+  for (MachineBasicBlock::iterator I = B; I != E; ++I) {
+    MachineInstr &MI = *I;
+    assert(!MI.isInsideBundle() &&
+           "Instructions inside bundles should use bundle start's slot.");
+    assert(mi2iMap.find(&MI) == mi2iMap.end() && "Instr already indexed.");
+    assert(!MI.isDebugValue() && "Cannot number DBG_VALUE instructions.");
+
+    IndexList::iterator newItr =
+        indexList.insert(nextItr, createEntry(&MI, index += Space));
+    if (I == B)
+      firstItr = newItr;
+    mi2iMap.insert(std::make_pair(&MI, SlotIndex(&*newItr,
+                                                 SlotIndex::Slot_Block)));
+  }
+
+  if (Space == 0)
+    renumberIndexes(firstItr);
+}
+
 // Repair indexes after adding and removing instructions.
 void SlotIndexes::repairIndexesInRange(MachineBasicBlock *MBB,
                                        MachineBasicBlock::iterator Begin,
@@ -503,6 +503,10 @@ StringRef sys::getHostCPUName() {
         if (!HasAVX) // If the OS doesn't support AVX provide a sane fallback.
           return "btver1";
         return "btver2";
+      case 23:
+        if (!HasAVX) // If the OS doesn't support AVX provide a sane fallback.
+          return "btver1";
+        return "znver1";
     default:
       return "generic";
     }
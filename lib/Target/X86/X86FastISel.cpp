@@ -131,6 +131,10 @@ private:
   bool X86SelectFPExt(const Instruction *I);
   bool X86SelectFPTrunc(const Instruction *I);
   bool X86SelectSIToFP(const Instruction *I);
+  bool X86SelectUIToFP(const Instruction *I);
+  bool X86SelectFPToUI(const Instruction *I);
+
+  unsigned X86EmitZExtToI64(MVT SrcVT, unsigned SrcReg);
 
   const X86InstrInfo *getInstrInfo() const {
     return Subtarget->getInstrInfo();
@@ -1352,24 +1356,7 @@ bool X86FastISel::X86SelectZExt(const Instruction *I) {
   }
 
   if (DstVT == MVT::i64) {
-    // Handle extension to 64-bits via sub-register shenanigans.
-    unsigned MovInst;
-
-    switch (SrcVT.SimpleTy) {
-    case MVT::i8:  MovInst = X86::MOVZX32rr8;  break;
-    case MVT::i16: MovInst = X86::MOVZX32rr16; break;
-    case MVT::i32: MovInst = X86::MOV32rr;     break;
-    default: llvm_unreachable("Unexpected zext to i64 source type");
-    }
-
-    unsigned Result32 = createResultReg(&X86::GR32RegClass);
-    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(MovInst), Result32)
-      .addReg(ResultReg);
-
-    ResultReg = createResultReg(&X86::GR64RegClass);
-    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(TargetOpcode::SUBREG_TO_REG),
-            ResultReg)
-      .addImm(0).addReg(Result32).addImm(X86::sub_32bit);
+    ResultReg = X86EmitZExtToI64(SrcVT, ResultReg);
   } else if (DstVT != MVT::i8) {
     ResultReg = fastEmit_r(MVT::i8, DstVT.getSimpleVT(), ISD::ZERO_EXTEND,
                            ResultReg, /*Kill=*/true);
@@ -1381,6 +1368,30 @@ bool X86FastISel::X86SelectZExt(const Instruction *I) {
   return true;
 }
 
+/// X86EmitZExtToI64 - Zero extend the i8, i16 or i32 value in SrcReg to 64 bits
+/// and return the register holding the result.
+unsigned X86FastISel::X86EmitZExtToI64(MVT SrcVT, unsigned SrcReg) {
+  // Handle extension to 64-bits via sub-register shenanigans.
+  unsigned MovInst;
+
+  switch (SrcVT.SimpleTy) {
+  case MVT::i8:  MovInst = X86::MOVZX32rr8;  break;
+  case MVT::i16: MovInst = X86::MOVZX32rr16; break;
+  case MVT::i32: MovInst = X86::MOV32rr;     break;
+  default: llvm_unreachable("Unexpected zext to i64 source type");
+  }
+
+  unsigned Result32 = createResultReg(&X86::GR32RegClass);
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(MovInst), Result32)
+    .addReg(SrcReg);
+
+  unsigned ResultReg = createResultReg(&X86::GR64RegClass);
+  BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc, TII.get(TargetOpcode::SUBREG_TO_REG),
+          ResultReg)
+    .addImm(0).addReg(Result32).addImm(X86::sub_32bit);
+  return ResultReg;
+}
+
 bool X86FastISel::X86SelectBranch(const Instruction *I) {
   // Unconditional branches are selected by tablegen-generated code.
   // Handle a conditional branch.
@@ -2134,6 +2145,91 @@ bool X86FastISel::X86SelectSIToFP(const Instruction *I) {
   return true;
 }
 
+bool X86FastISel::X86SelectUIToFP(const Instruction *I) {
+  // On x86-64, an unsigned integer of up to 32 bits is converted by zero
+  // extending it to 64 bits and doing a signed 64-bit conversion, just like
+  // the SelectionDAG promotes the UINT_TO_FP.
+  if (!Subtarget->is64Bit())
+    return false;
+
+  MVT SrcVT, DstVT;
+  if (!isTypeLegal(I->getOperand(0)->getType(), SrcVT) ||
+      !isTypeLegal(I->getType(), DstVT))
+    return false;
+  if (SrcVT != MVT::i8 && SrcVT != MVT::i16 && SrcVT != MVT::i32)
+    return false;
+  if (!isScalarFPTypeInSSEReg(DstVT))
+    return false;
+
+  unsigned OpReg = getRegForValue(I->getOperand(0));
+  if (OpReg == 0)
+    return false;
+  unsigned Op64Reg = X86EmitZExtToI64(SrcVT, OpReg);
+
+  unsigned ResultReg;
+  if (Subtarget->hasAVX()) {
+    // The AVX conversions merge the result into an undefined register, see
+    // X86SelectSIToFP.
+    const TargetRegisterClass *RC = TLI.getRegClassFor(DstVT);
+    unsigned Opcode =
+        DstVT == MVT::f64 ? X86::VCVTSI2SD64rr : X86::VCVTSI2SS64rr;
+    unsigned ImplicitDefReg = createResultReg(RC);
+    BuildMI(*FuncInfo.MBB, FuncInfo.InsertPt, DbgLoc,
+            TII.get(TargetOpcode::IMPLICIT_DEF), ImplicitDefReg);
+    ResultReg =
+        fastEmitInst_rr(Opcode, RC, ImplicitDefReg, true, Op64Reg, true);
+  } else {
+    ResultReg = fastEmit_r(MVT::i64, DstVT, ISD::SINT_TO_FP, Op64Reg,
+                           /*Kill=*/true);
+  }
+  if (ResultReg == 0)
+    return false;
+
+  updateValueMap(I, ResultReg);
+  return true;
+}
+
+bool X86FastISel::X86SelectFPToUI(const Instruction *I) {
+  // On x86-64, a conversion to an unsigned integer of up to 32 bits is done
+  // by a signed conversion to 64 bits, whose low bits hold the result for
+  // every value that is in range.
+  if (!Subtarget->is64Bit())
+    return false;
+
+  MVT SrcVT, DstVT;
+  if (!isTypeLegal(I->getOperand(0)->getType(), SrcVT) ||
+      !isTypeLegal(I->getType(), DstVT))
+    return false;
+  if (!isScalarFPTypeInSSEReg(SrcVT))
+    return false;
+
+  unsigned SubIdx;
+  switch (DstVT.SimpleTy) {
+  default: return false;
+  case MVT::i8:  SubIdx = X86::sub_8bit;  break;
+  case MVT::i16: SubIdx = X86::sub_16bit; break;
+  case MVT::i32: SubIdx = X86::sub_32bit; break;
+  }
+
+  unsigned OpReg = getRegForValue(I->getOperand(0));
+  if (OpReg == 0)
+    return false;
+  bool OpRegIsKill = hasTrivialKill(I->getOperand(0));
+
+  unsigned Result64 = fastEmit_r(SrcVT, MVT::i64, ISD::FP_TO_SINT, OpReg,
+                                 OpRegIsKill);
+  if (Result64 == 0)
+    return false;
+
+  unsigned ResultReg =
+      fastEmitInst_extractsubreg(DstVT, Result64, /*Kill=*/true, SubIdx);
+  if (ResultReg == 0)
+    return false;
+
+  updateValueMap(I, ResultReg);
+  return true;
+}
+
 // Helper method used by X86SelectFPExt and X86SelectFPTrunc.
 bool X86FastISel::X86SelectFPExtOrFPTrunc(const Instruction *I,
                                           unsigned TargetOpc,
@@ -3256,6 +3352,10 @@ X86FastISel::fastSelectInstruction(const Instruction *I)  {
     return X86SelectFPTrunc(I);
   case Instruction::SIToFP:
     return X86SelectSIToFP(I);
+  case Instruction::UIToFP:
+    return X86SelectUIToFP(I);
+  case Instruction::FPToUI:
+    return X86SelectFPToUI(I);
   case Instruction::IntToPtr: // Deliberate fall-through.
   case Instruction::PtrToInt: {
     EVT SrcVT = TLI.getValueType(DL, I->getOperand(0)->getType());
@@ -18,6 +18,7 @@
 #include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/CodeGen/BasicTTIImpl.h"
 #include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Target/CostTable.h"
 #include "llvm/Target/TargetLowering.h"
@@ -26,6 +27,19 @@ using namespace llvm;
 
 #define DEBUG_TYPE "x86tti"
 
+// The loop data prefetch pass only runs on X86 with -x86-loop-data-prefetch.
+static cl::opt<unsigned> X86PrefetchDistance(
+    "x86-prefetch-distance",
+    cl::desc("Number of instructions to prefetch ahead on X86"),
+    cl::init(300), cl::Hidden);
+
+// The hardware prefetchers handle strided accesses within a page, so leave
+// those alone and only prefetch indirect and pointer chasing accesses.
+static cl::opt<unsigned> X86MinPrefetchStride(
+    "x86-min-prefetch-stride",
+    cl::desc("Min stride to add prefetches for on X86"),
+    cl::init(4096), cl::Hidden);
+
 //===----------------------------------------------------------------------===//
 //
 // X86 cost model.
@@ -41,6 +55,39 @@ X86TTIImpl::getPopcntSupport(unsigned TyWidth) {
   return ST->hasPOPCNT() ? TTI::PSK_FastHardware : TTI::PSK_Software;
 }
 
+unsigned X86TTIImpl::getCacheLineSize() { return 64; }
+
+unsigned X86TTIImpl::getCacheSize(TTI::CacheLevel Level) {
+  // The caches of the x86 cores since Nehalem and Bulldozer have at least
+  // this size, e.g.:
+  //   Skylake client:  32K L1D, 256K L2
+  //   Skylake server:  32K L1D, 1M L2
+  //   Zen:             32K L1D, 512K L2
+  // so tiling for these sizes keeps the data in the cache on all of them.
+  switch (Level) {
+  case TTI::CL_L1D:
+    return 32 * 1024;
+  case TTI::CL_L2D:
+    return 256 * 1024;
+  }
+  llvm_unreachable("Unknown TargetTransformInfo::CacheLevel");
+}
+
+unsigned X86TTIImpl::getCacheAssociativity(TTI::CacheLevel Level) {
+  // Both levels are 8-way set associative on the cores above, except for the
+  // 16-way L2 of Skylake server.
+  switch (Level) {
+  case TTI::CL_L1D:
+  case TTI::CL_L2D:
+    return 8;
+  }
+  llvm_unreachable("Unknown TargetTransformInfo::CacheLevel");
+}
+
+unsigned X86TTIImpl::getPrefetchDistance() { return X86PrefetchDistance; }
+
+unsigned X86TTIImpl::getMinPrefetchStride() { return X86MinPrefetchStride; }
+
 unsigned X86TTIImpl::getNumberOfRegisters(bool Vector) {
   if (Vector && !ST->hasSSE1())
     return 0;
@@ -1433,6 +1480,33 @@ int X86TTIImpl::getGatherScatterOpCost(unsigned Opcode, Type *SrcVTy,
   return getGSVectorCost(Opcode, SrcVTy, Ptr, Alignment, AddressSpace);
 }
 
+/// Calculate the cost of an interleaved load / store group.
+///
+/// The generic model prices the (de)interleaving shuffles as one extract and
+/// one insert per element. With AVX2 and AVX-512 each member is instead
+/// assembled from (or spread into) every legal register of the wide vector
+/// with one cross-lane permute, plus one blend per additional register. That
+/// only holds for 32- and 64-bit elements: there are no cross-lane permutes
+/// of bytes and words, and those shuffles are mostly scalarized.
+int X86TTIImpl::getInterleavedMemoryOpCost(unsigned Opcode, Type *VecTy,
+                                           unsigned Factor,
+                                           ArrayRef<unsigned> Indices,
+                                           unsigned Alignment,
+                                           unsigned AddressSpace) {
+  VectorType *VT = cast<VectorType>(VecTy);
+  std::pair<int, MVT> LT = TLI->getTypeLegalizationCost(DL, VecTy);
+  EVT EltVT = TLI->getValueType(DL, VT->getElementType());
+  if (!ST->hasAVX2() || !isPowerOf2_32(Factor) || !LT.second.isVector() ||
+      EltVT != LT.second.getVectorElementType() || EltVT.getSizeInBits() < 32)
+    return BaseT::getInterleavedMemoryOpCost(Opcode, VecTy, Factor, Indices,
+                                             Alignment, AddressSpace);
+
+  int MemOpCost = getMemoryOpCost(Opcode, VecTy, Alignment, AddressSpace);
+  int ShufflesPerMember = 2 * LT.first - 1;
+  unsigned NumMembers = Opcode == Instruction::Load ? Indices.size() : Factor;
+  return MemOpCost + NumMembers * ShufflesPerMember;
+}
+
 bool X86TTIImpl::isLegalMaskedLoad(Type *DataTy) {
   Type *ScalarTy = DataTy->getScalarType();
   int DataWidth = isa<PointerType>(ScalarTy) ?
@@ -53,6 +53,11 @@ public:
   /// \name Scalar TTI Implementations
   /// @{
   TTI::PopcntSupportKind getPopcntSupport(unsigned TyWidth);
+  unsigned getCacheLineSize();
+  unsigned getCacheSize(TTI::CacheLevel Level);
+  unsigned getCacheAssociativity(TTI::CacheLevel Level);
+  unsigned getPrefetchDistance();
+  unsigned getMinPrefetchStride();
 
   /// @}
 
@@ -78,6 +83,9 @@ public:
                             unsigned AddressSpace);
   int getGatherScatterOpCost(unsigned Opcode, Type *DataTy, Value *Ptr,
                              bool VariableMask, unsigned Alignment);
+  int getInterleavedMemoryOpCost(unsigned Opcode, Type *VecTy, unsigned Factor,
+                                 ArrayRef<unsigned> Indices, unsigned Alignment,
+                                 unsigned AddressSpace);
   int getAddressComputationCost(Type *PtrTy, bool IsComplex);
 
   int getReductionCost(unsigned Opcode, Type *Ty, bool IsPairwiseForm);
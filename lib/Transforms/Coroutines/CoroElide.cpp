@@ -19,9 +19,12 @@
 #include "llvm/Analysis/CallGraphSCCPass.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 
-#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/IntrinsicInst.h"
@@ -45,8 +48,21 @@ struct CoroHeapElide : FunctionPass, CoroutineCommon {
 
   // This function walks up from an operand to @llvm.coro.resume or
   // @llvm.coro.destroy to see if it hits a @llvm.coro.init
-  // somewhere in the definition change
-  static IntrinsicInst *FindDefiningCoroInit(Value *op) {
+  // somewhere in the definition change. Offset is set to the byte offset
+  // of the operand from the start of the frame. Once a coroutine that has
+  // frames of its own callees elided into its frame is inlined, the stores
+  // and calls that refer to those nested frames are reached from the same
+  // @llvm.coro.init, but at a nonzero offset.
+  static IntrinsicInst *FindDefiningCoroInit(Value *op, const DataLayout &DL,
+                                             int64_t &Offset) {
+    SmallPtrSet<Value *, 8> Visited;
+    Offset = 0;
+    return FindDefiningCoroInit(op, DL, Offset, Visited);
+  }
+
+  static IntrinsicInst *FindDefiningCoroInit(Value *op, const DataLayout &DL,
+                                             int64_t &Offset,
+                                             SmallPtrSetImpl<Value *> &Visited) {
     for (;;) {
       if (IntrinsicInst *intrin = dyn_cast<IntrinsicInst>(op)) {
         if (intrin->getIntrinsicID() == Intrinsic::experimental_coro_init)
@@ -59,8 +75,12 @@ struct CoroHeapElide : FunctionPass, CoroutineCommon {
         return nullptr;
 
       if (auto gep = dyn_cast<GetElementPtrInst>(op)) {
+        APInt GEPOffset(DL.getPointerSizeInBits(gep->getPointerAddressSpace()),
+                        0);
+        if (!gep->accumulateConstantOffset(DL, GEPOffset))
+          return nullptr;
+        Offset += GEPOffset.getSExtValue();
         op = gep->getPointerOperand();
-        // TODO: sanity testing
         continue;
       }
       if (auto bitcast = dyn_cast<BitCastInst>(op)) {
@@ -68,6 +88,26 @@ struct CoroHeapElide : FunctionPass, CoroutineCommon {
         // TODO: sanity testing
         continue;
       }
+      // Once the resume function of an outer coroutine is inlined, the frame
+      // of a coroutine it awaits on may reach @llvm.coro.resume through the
+      // phis of the awaiting loop. Look through the phi if all of its inputs
+      // other than the loop back edges are the same @llvm.coro.init.
+      if (auto phi = dyn_cast<PHINode>(op)) {
+        Visited.insert(phi);
+        IntrinsicInst *common = nullptr;
+        for (Value *incoming : phi->incoming_values()) {
+          if (Visited.count(incoming))
+            continue;
+          int64_t IncomingOffset = 0;
+          IntrinsicInst *coroInit =
+              FindDefiningCoroInit(incoming, DL, IncomingOffset, Visited);
+          if (!coroInit || IncomingOffset != 0 ||
+              (common && coroInit != common))
+            return nullptr;
+          common = coroInit;
+        }
+        return common;
+      }
       return nullptr;
     }
   }
@@ -136,11 +176,18 @@ struct CoroHeapElide : FunctionPass, CoroutineCommon {
       // scan the function for a store that sets a destroy function
       // if we elided allocation, we need to replace that store
       // with a store of an address of a cleanup function instead
+      // The resume and destroy functions are stored in the first two
+      // pointers of the frame; the resume, destroy and store of anything
+      // further in belong to a frame nested in this one.
+      const DataLayout &DL = F.getParent()->getDataLayout();
+      int64_t Offset;
       for (Instruction &I : instructions(F)) {
         if (StoreInst *S = dyn_cast<StoreInst>(&I)) {
           if (Function *func = dyn_cast<Function>(S->getOperand(0))) {
-            IntrinsicInst *coroInit = FindDefiningCoroInit(S->getOperand(1));
-            if (coroInit == nullptr)
+            IntrinsicInst *coroInit =
+                FindDefiningCoroInit(S->getOperand(1), DL, Offset);
+            if (coroInit == nullptr || Offset < 0 ||
+                Offset > DL.getPointerSize())
               continue;
 
             AddStore(coroInit, func);
@@ -152,8 +199,8 @@ struct CoroHeapElide : FunctionPass, CoroutineCommon {
           case Intrinsic::experimental_coro_destroy:
           case Intrinsic::experimental_coro_resume: {
             IntrinsicInst *coroInit =
-                FindDefiningCoroInit(intrin->getOperand(0));
-            if (coroInit == nullptr)
+                FindDefiningCoroInit(intrin->getOperand(0), DL, Offset);
+            if (coroInit == nullptr || Offset != 0)
               continue;
             AddResumeOrDestroy(coroInit, intrin);
             break;
@@ -260,12 +307,24 @@ struct CoroHeapElide : FunctionPass, CoroutineCommon {
 
       // FIXME: check for escapes, moves,
       if (CoroElide && !noDestroys && rampName != F.getName()) {
-        auto InsertPt = inst_begin(F);
         auto allocaFrame =
-            new AllocaInst(item.getFrameType(), "elided.frame", &*InsertPt);
-
-        auto vAllocaFrame = new BitCastInst(allocaFrame, bytePtrTy,
-                                            "elided.vFrame", &*InsertPt);
+            new AllocaInst(item.getFrameType(), "elided.frame", &*inst_begin(F));
+
+        // The frame is live from where it would have been allocated on the
+        // heap to where it is destroyed. If F is a coroutine itself, CoroSplit
+        // moves the frames that live across its suspends into its own frame,
+        // which only exists from its @llvm.coro.init on, and lets frames that
+        // are never live together share a field from these markers.
+        IRBuilder<> Builder(CoroElide);
+        Value *vAllocaFrame =
+            Builder.CreateBitCast(allocaFrame, bytePtrTy, "elided.vFrame");
+        auto FrameSize = Builder.getInt64(
+            M->getDataLayout().getTypeAllocSize(item.getFrameType()));
+        Builder.CreateLifetimeStart(vAllocaFrame, FrameSize);
+        for (IntrinsicInst *Destroy : item.Destroys) {
+          Builder.SetInsertPoint(Destroy->getNextNode());
+          Builder.CreateLifetimeEnd(allocaFrame, FrameSize);
+        }
 
         replaceAllCoroDeletes(item.CoroInit);
 
@@ -15,6 +15,7 @@
 #include "CoroSplit.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SmallBitVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Transforms/Coroutines.h"
 #include "llvm/Analysis/AssumptionCache.h"
 #include "llvm/Analysis/CallGraphSCCPass.h"
@@ -24,6 +25,7 @@
 #include "llvm/IR/InstIterator.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Dominators.h"
@@ -34,6 +36,14 @@ using namespace llvm::coro;
 
 #define DEBUG_TYPE "coro-inline"
 
+STATISTIC(NumNestedElideRounds,
+          "Number of elision rounds over inlined nested coroutines");
+
+static cl::opt<unsigned> CoroElideMaxDepth(
+    "coro-elide-max-depth", cl::init(4), cl::Hidden,
+    cl::desc("Maximum number of levels of nested coroutines whose resume "
+             "and cleanup functions are inlined into a caller for elision"));
+
 namespace {
   /// PrintCallGraphPass - Print a Module corresponding to a call graph.
   ///
@@ -62,7 +72,7 @@ namespace {
 
     bool HasCoroInit;
 
-    void inlineResumeCleanup(Function& F) {
+    bool inlineResumeCleanup(Function& F) {
       SmallVector<CallSite, 8> CoroCalls;
       for (auto &I : instructions(F))
         if (CallSite CS = CallSite(&I))
@@ -72,15 +82,17 @@ namespace {
                 Callee->getName().endswith(".destroy"))
               CoroCalls.push_back(CS);
 
+      bool Inlined = false;
       for (auto& CS : CoroCalls) {
         // TODO: get proper inline threshold Inliner::getInlineThreshold(CS))
         Function *Callee = CS.getCalledFunction();
         TargetTransformInfo &TTI = TTIWP->getTTI(*Callee);
         if (getInlineCost(CS, 100, TTI, ACT)) {
           InlineFunctionInfo IFI;
-          InlineFunction(CS, IFI);
+          Inlined |= InlineFunction(CS, IFI);
         }
       }
+      return Inlined;
     }
 
     bool tryCoroElide(CallGraphSCC &SCC) {
@@ -89,9 +101,9 @@ namespace {
         Function *F = Node->getFunction();
         if (F) {
           auto CI = FindIntrinsic(*F, Intrinsic::experimental_coro_init);
-          if (!CI) return false;
+          if (!CI) continue;
           auto CD = FindIntrinsic(*F, Intrinsic::experimental_coro_destroy);
-          if (!CD) return false;
+          if (!CD) continue;
 
           legacy::FunctionPassManager FPM(F->getParent());
           FPM.add(createSROAPass());
@@ -119,9 +131,18 @@ namespace {
           //FPM.add(createCorrelatedValuePropagationPass());
 #endif
           FPM.doInitialization();
-          FPM.run(*F);
+          // Inlining the resume and cleanup functions of the coroutines
+          // awaited on here exposes the coroutines that they await on in
+          // turn. Clean up and elide again to follow a chain of nested
+          // awaits down to the innermost coroutine.
+          for (unsigned Depth = 0; Depth != CoroElideMaxDepth; ++Depth) {
+            FPM.run(*F);
+            if (!inlineResumeCleanup(*F))
+              break;
+            if (Depth != 0)
+              ++NumNestedElideRounds;
+          }
           FPM.doFinalization();
-          inlineResumeCleanup(*F);
           RefreshCallGraph(SCC, *CurrentCG, false);
           changed = true;
         }
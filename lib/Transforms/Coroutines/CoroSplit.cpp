@@ -13,12 +13,16 @@
 
 #include "CoroutineCommon.h"
 #include "CoroSplit.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/SmallBitVector.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/InlineCost.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/Function.h"
@@ -29,6 +33,7 @@
 #include "llvm/IR/Type.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Coroutines.h"
 #include "llvm/Transforms/IPO/InlinerPass.h"
@@ -40,6 +45,14 @@ using namespace llvm;
 
 #define DEBUG_TYPE "coro-split4"
 
+STATISTIC(NumSharedFrameFields,
+          "Number of allocas sharing a coroutine frame field with another");
+
+static cl::opt<bool> ShareFrameFields(
+    "coro-share-frame-fields", cl::init(true), cl::Hidden,
+    cl::desc("Let allocas with disjoint lifetimes share a field of the "
+             "coroutine frame"));
+
 #if 0
 namespace {
 /// The CoroutineFrame class bla bla
@@ -99,16 +112,18 @@ struct CoroSplit4 : CoroutineCommon {
         assert(SaveInst->getIntrinsicID() == Intrinsic::experimental_coro_save);
       }
 
-      // FIXME: This looks fragile
-      SuspendBr = cast<BranchInst>(SuspendInst->getNextNode());
-
-      if (isFinalSuspend()) {
-        assert(SuspendBr->getNumSuccessors() == 1);
-      }
-      else {
-        assert(SuspendBr->getNumSuccessors() == 2);
-        assert(SuspendBr->getOperand(0) == SuspendInst);
-      }
+      // The suspend is canonical if it is followed by a branch on its result,
+      // or by an unconditional one for the final suspend. Code hoisted out of
+      // the resume and cleanup paths, e.g. after the resume function of an
+      // awaited coroutine is inlined, gets in between; canonicalize() splits
+      // it off.
+      SuspendBr = dyn_cast<BranchInst>(SuspendInst->getNextNode());
+      if (!SuspendBr)
+        return;
+      if (isFinalSuspend() ? SuspendBr->isConditional()
+                           : SuspendBr->isUnconditional() ||
+                                 SuspendBr->getCondition() != SuspendInst)
+        SuspendBr = nullptr;
     }
 
     bool isCanonical() const { return SuspendBr; }
@@ -150,6 +165,15 @@ struct CoroSplit4 : CoroutineCommon {
       BasicBlock* BB = SuspendInst->getParent();
       Function* F = BB->getParent();
       Module* M = F->getParent();
+
+      // The final suspend only continues to the cleanup.
+      if (isFinalSuspend()) {
+        BB->splitBasicBlock(SuspendInst->getNextNode(),
+                            BB->getName() + ".cleanup");
+        SuspendBr = cast<BranchInst>(BB->getTerminator());
+        return true;
+      }
+
       BasicBlock* ResumeBB =
         BB->splitBasicBlock(SuspendInst->getNextNode(), BB->getName() + ".resume");
 
@@ -281,8 +305,10 @@ struct CoroSplit4 : CoroutineCommon {
       bool changed = false;
       SuspendPoints.clear();
       HasFinalSuspend = false;
-      for (auto BI = F.begin(), BE = F.end(); BI != BE;) {
-        auto& BB = *BI++;
+      // Canonicalizing a suspend splits its block, so that the new block
+      // right after it is visited next.
+      for (auto BI = F.begin(); BI != F.end(); ++BI) {
+        auto& BB = *BI;
         for (auto &I : BB)
           if (SuspendPoint SI{ I }) {
             changed |= SI.canonicalize();
@@ -446,6 +472,17 @@ struct CoroSplit4 : CoroutineCommon {
   struct CoroutineInfo {
     SmallVector<AllocaInst*, 4> ResumeAllocas;
     SmallVector<AllocaInst*, 8> SharedAllocas;
+    AllocaInst* PromiseAlloca = nullptr;
+
+    // Allocas covered by lifetime markers are numbered here, and
+    // Interference[N] holds the numbers of the marked allocas that may be
+    // live at the same time as alloca N. Allocas without markers are assumed
+    // to be live everywhere.
+    DenseMap<AllocaInst*, unsigned> MarkedAllocas;
+    SmallVector<BitVector, 8> Interference;
+
+    // Frame struct field storing each of the SharedAllocas.
+    DenseMap<AllocaInst*, unsigned> FrameFields;
     SmallPtrSet<BasicBlock*, 16> PostStartBlocks;
     SmallPtrSet<BasicBlock*, 16> StartBlocks;
     BasicBlock* ReturnBlock;
@@ -513,7 +550,7 @@ struct CoroSplit4 : CoroutineCommon {
       assert(CoroInit && "missing @llvm.coro.init");
       CoroInit->addAttribute(AttributeSet::ReturnIndex, Attribute::NonNull);
 
-      const auto PromiseAlloca = getPromiseAlloca(CoroInit, CC);
+      PromiseAlloca = getPromiseAlloca(CoroInit, CC);
 
       ResumeAllocas.clear();
       SharedAllocas.clear();
@@ -537,8 +574,8 @@ struct CoroSplit4 : CoroutineCommon {
           if (AI == PromiseAlloca) {
             // promise must be always in the shared state at a known 
             // offset relative to the beginning of the frame.
-            // At the moment, we just make it a first alloca
-            // TODO: handle alignment, better packing
+            // At the moment, we just make it a first alloca;
+            // createFrameStruct packs the rest after it.
             SharedAllocas.push_back(AI);
             if (SharedAllocas.size() > 1)
               std::swap(SharedAllocas.front(), SharedAllocas.back());
@@ -546,13 +583,24 @@ struct CoroSplit4 : CoroutineCommon {
           }
           bool seenInStart = false;
           bool seenInResume = false;
-          for (User* U : AI->users()) {
-            Instruction *UI = cast<Instruction>(U);
-            bool inResume = PostStartBlocks.count(UI->getParent());
-            bool inStart = StartBlocks.count(UI->getParent());
-            //            seenInStart |= !inResume; // bug here
-            seenInStart |= inStart; // bug here
-            seenInResume |= inResume;
+          // Look through the casts and geps of the alloca: one that is
+          // computed before a suspend and used after it makes the alloca
+          // live across the suspend as well.
+          SmallVector<Instruction *, 8> Users;
+          SmallPtrSet<Instruction *, 8> Visited;
+          Users.push_back(AI);
+          while (!Users.empty()) {
+            for (User *U : Users.pop_back_val()->users()) {
+              Instruction *UI = cast<Instruction>(U);
+              if ((isa<BitCastInst>(UI) || isa<GetElementPtrInst>(UI)) &&
+                  Visited.insert(UI).second)
+                Users.push_back(UI);
+              bool inResume = PostStartBlocks.count(UI->getParent());
+              bool inStart = StartBlocks.count(UI->getParent());
+              //            seenInStart |= !inResume; // bug here
+              seenInStart |= inStart; // bug here
+              seenInResume |= inResume;
+            }
           }
           if (seenInResume)
             if (seenInStart)
@@ -565,6 +613,123 @@ struct CoroSplit4 : CoroutineCommon {
         }
       }
     }
+
+    // Returns the number of the alloca whose lifetime starts or ends at I,
+    // or -1 if I is not a lifetime marker of an alloca in MarkedAllocas.
+    int getMarkedAlloca(Instruction &I, bool &IsStart) const {
+      auto II = dyn_cast<IntrinsicInst>(&I);
+      if (!II)
+        return -1;
+      switch (II->getIntrinsicID()) {
+      default:
+        return -1;
+      case Intrinsic::lifetime_start:
+        IsStart = true;
+        break;
+      case Intrinsic::lifetime_end:
+        IsStart = false;
+        break;
+      }
+      auto AI = dyn_cast<AllocaInst>(II->getArgOperand(1)->stripPointerCasts());
+      if (!AI)
+        return -1;
+      auto It = MarkedAllocas.find(AI);
+      return It == MarkedAllocas.end() ? -1 : (int)It->second;
+    }
+
+    // Computes which allocas may be live at the same time from their
+    // lifetime markers, so that allocas that are never live together can
+    // share a frame field. This has to run before the markers are removed.
+    // Liveness is propagated forward from lifetime.start to lifetime.end
+    // over the CFG; allocas live on entry to the same block or live where
+    // another one starts interfere.
+    void computeInterference(Function &F) {
+      MarkedAllocas.clear();
+      Interference.clear();
+
+      const DataLayout &DL = F.getParent()->getDataLayout();
+      SmallPtrSet<AllocaInst*, 8> PartiallyMarked;
+      for (auto &I : instructions(F))
+        if (auto II = dyn_cast<IntrinsicInst>(&I)) {
+          if (II->getIntrinsicID() != Intrinsic::lifetime_start &&
+              II->getIntrinsicID() != Intrinsic::lifetime_end)
+            continue;
+          auto AI =
+              dyn_cast<AllocaInst>(II->getArgOperand(1)->stripPointerCasts());
+          if (!AI || !isa<ConstantInt>(AI->getArraySize()))
+            continue;
+          // A marker that covers only a part of the alloca does not tell
+          // when the rest of it is live.
+          auto Size = cast<ConstantInt>(II->getArgOperand(0))->getSExtValue();
+          auto AllocSize =
+              DL.getTypeAllocSize(AI->getAllocatedType()) *
+              cast<ConstantInt>(AI->getArraySize())->getZExtValue();
+          if (Size != -1 && (uint64_t)Size < AllocSize)
+            PartiallyMarked.insert(AI);
+          unsigned Num = MarkedAllocas.size();
+          MarkedAllocas.insert(std::make_pair(AI, Num));
+        }
+      for (AllocaInst *AI : PartiallyMarked)
+        MarkedAllocas.erase(AI);
+      // Renumber densely after dropping partially marked allocas.
+      unsigned Num = 0;
+      for (auto &Entry : MarkedAllocas)
+        Entry.second = Num++;
+
+      const unsigned N = MarkedAllocas.size();
+      Interference.assign(N, BitVector(N));
+      if (N < 2)
+        return;
+
+      ReversePostOrderTraversal<Function*> RPOT(&F);
+      DenseMap<BasicBlock*, BitVector> LiveOut;
+      bool Changed = true;
+      while (Changed) {
+        Changed = false;
+        for (BasicBlock *BB : RPOT) {
+          BitVector Live(N);
+          for (BasicBlock *Pred : predecessors(BB)) {
+            auto It = LiveOut.find(Pred);
+            if (It != LiveOut.end())
+              Live |= It->second;
+          }
+          for (int Idx = Live.find_first(); Idx != -1;
+               Idx = Live.find_next(Idx))
+            Interference[Idx] |= Live;
+
+          for (Instruction &I : *BB) {
+            bool IsStart = false;
+            int Idx = getMarkedAlloca(I, IsStart);
+            if (Idx == -1)
+              continue;
+            if (!IsStart) {
+              Live.reset(Idx);
+              continue;
+            }
+            Live.set(Idx);
+            Interference[Idx] |= Live;
+            for (int Other = Live.find_first(); Other != -1;
+                 Other = Live.find_next(Other))
+              Interference[Other].set(Idx);
+          }
+
+          BitVector &Out = LiveOut[BB];
+          if (Out.size() != N || Out != Live) {
+            Out = Live;
+            Changed = true;
+          }
+        }
+      }
+    }
+
+    // Returns true if the lifetimes of A and B are known to be disjoint.
+    bool areDisjoint(AllocaInst *A, AllocaInst *B) const {
+      auto ItA = MarkedAllocas.find(A);
+      auto ItB = MarkedAllocas.find(B);
+      if (ItA == MarkedAllocas.end() || ItB == MarkedAllocas.end())
+        return false;
+      return !Interference[ItA->second].test(ItB->second);
+    }
   };
 
 #if 0
@@ -608,22 +773,95 @@ struct CoroSplit4 : CoroutineCommon {
     cleanupFn = CreateAuxillaryFunction(".cleanup", frameInCleanup);
   }
 #endif
-  void createFrameStruct(SmallVectorImpl<AllocaInst *>& SharedAllocas) {
-    SmallVector<Type *, 8> typeArray;
+  // A field of the coroutine frame and the shared allocas stored in it.
+  struct FrameField {
+    Type *Ty;
+    uint64_t Size;
+    unsigned Align;
+    SmallVector<AllocaInst *, 2> Allocas;
+  };
 
+  static Type *getAllocaStorageType(AllocaInst *AI) {
+    Type *Ty = AI->getAllocatedType();
+    auto Count = cast<ConstantInt>(AI->getArraySize())->getZExtValue();
+    return Count == 1 ? Ty : ArrayType::get(Ty, Count);
+  }
+
+  // Lays out the frame: the resume and destroy function pointers and the
+  // suspend index come first, followed by the promise (it has to be at a
+  // known offset) and then by the remaining shared allocas sorted by
+  // decreasing alignment and size to keep the padding down. An alloca whose
+  // lifetime is disjoint from the lifetimes of all allocas already in a field
+  // that is large and aligned enough reuses that field instead of getting a
+  // new one.
+  void createFrameStruct(CoroutineInfo &Info) {
     const DataLayout &DL = M->getDataLayout();
 
-    typeArray.clear();
+    auto getAlign = [&](AllocaInst *AI, Type *Ty) {
+      return std::max(AI->getAlignment(), DL.getABITypeAlignment(Ty));
+    };
+
+    SmallVector<AllocaInst *, 8> Allocas;
+    for (AllocaInst *AI : Info.SharedAllocas)
+      if (AI != Info.PromiseAlloca)
+        Allocas.push_back(AI);
+    std::stable_sort(Allocas.begin(), Allocas.end(),
+                     [&](AllocaInst *A, AllocaInst *B) {
+      Type *TyA = getAllocaStorageType(A);
+      Type *TyB = getAllocaStorageType(B);
+      unsigned AlignA = getAlign(A, TyA), AlignB = getAlign(B, TyB);
+      if (AlignA != AlignB)
+        return AlignA > AlignB;
+      return DL.getTypeAllocSize(TyA) > DL.getTypeAllocSize(TyB);
+    });
+
+    SmallVector<FrameField, 8> Fields;
+    auto addField = [&](AllocaInst *AI) {
+      Type *Ty = getAllocaStorageType(AI);
+      Fields.push_back({Ty, DL.getTypeAllocSize(Ty), getAlign(AI, Ty), {AI}});
+    };
+    auto canShare = [&](FrameField const &Field, AllocaInst *AI) {
+      Type *Ty = getAllocaStorageType(AI);
+      if (DL.getTypeAllocSize(Ty) > Field.Size ||
+          getAlign(AI, Ty) > Field.Align)
+        return false;
+      for (AllocaInst *Other : Field.Allocas)
+        if (!Info.areDisjoint(AI, Other))
+          return false;
+      return true;
+    };
+
+    if (Info.PromiseAlloca)
+      addField(Info.PromiseAlloca);
+    const unsigned FirstSharable = Fields.size();
+
+    for (AllocaInst *AI : Allocas) {
+      bool Shared = false;
+      if (ShareFrameFields)
+        for (unsigned I = FirstSharable, E = Fields.size(); I != E; ++I)
+          if (canShare(Fields[I], AI)) {
+            Fields[I].Allocas.push_back(AI);
+            ++NumSharedFrameFields;
+            Shared = true;
+            break;
+          }
+      if (!Shared)
+        addField(AI);
+    }
+
+    SmallVector<Type *, 8> typeArray;
     typeArray.push_back(CD->ResumeFnPtrTy); // 0 res-type
     typeArray.push_back(CD->ResumeFnPtrTy); // 1 dtor-type
     typeArray.push_back(int32Ty);       // 2 index
-#if 0
-    typeArray.push_back(int32Ty);       // 3 padding // TODO: make it conditional on arch?
-#endif
-    // TODO: optimize storage layout
 
-    for (AllocaInst *AI : SharedAllocas) {
-      typeArray.push_back(AI->getType()->getElementType());
+    Info.FrameFields.clear();
+    for (FrameField &Field : Fields) {
+      for (AllocaInst *AI : Field.Allocas) {
+        Info.FrameFields[AI] = typeArray.size();
+        DEBUG(dbgs() << "Frame field " << typeArray.size() << ": " << *AI
+                     << "\n");
+      }
+      typeArray.push_back(Field.Ty);
     }
     CD->FrameTy->setBody(typeArray);
 
@@ -636,22 +874,22 @@ struct CoroSplit4 : CoroutineCommon {
 
   // replace all uses of allocas with gep from frame struct
   void ReplaceSharedUses(CoroutineInfo const& Info) {
-    enum { kStartingField = 2 };
-    APInt fieldNo(32, kStartingField); // Fields start with after 2
-
     for (AllocaInst *AI : Info.SharedAllocas) {
       auto& Name = Scratch;
       Name = AI->getName();
       AI->setName(""); // FIXME: use TakeName
-      auto index = ConstantInt::get(M->getContext(), ++fieldNo);
+      auto index = ConstantInt::get(int32Ty, Info.FrameFields.lookup(AI));
 
       while (!AI->use_empty()) {
         Use &U = *AI->use_begin();
-        User *user = U.getUser();
+        auto InsertPt = cast<Instruction>(U.getUser());
         Value *frame = CD->Ramp.Frame;
-        auto gep =
+        Value *gep =
           GetElementPtrInst::Create(CD->FrameTy, frame, { zeroConstant, index },
-            Name, cast<Instruction>(user));
+            Name, InsertPt);
+        // the field may be shared with an alloca of a different type
+        if (gep->getType() != AI->getType())
+          gep = new BitCastInst(gep, AI->getType(), Name + ".cast", InsertPt);
         U.set(gep);
       }
       AI->eraseFromParent();
@@ -680,7 +918,7 @@ struct CoroSplit4 : CoroutineCommon {
   }
 
   void prepareFrame(CoroutineInfo& CoroInfo) {
-    createFrameStruct(CoroInfo.SharedAllocas);
+    createFrameStruct(CoroInfo);
     auto InsertPt = CoroInfo.CoroInit->getNextNode();
 
     CD->Ramp.vFrame = CoroInfo.CoroInit;
@@ -737,11 +975,12 @@ struct CoroSplit4 : CoroutineCommon {
   bool runOnCoroutine(Function& F) {
     DEBUG(dbgs() << "CoroSplit function: " << F.getName() << "\n");
 
-    removeLifetimeIntrinsics(F);
-
     SuspendInfo Suspends;
     CoroutineInfo CoroInfo;
 
+    CoroInfo.computeInterference(F);
+    removeLifetimeIntrinsics(F);
+
 #if 0
     init(F);
     CreateAuxillaryFunctions();
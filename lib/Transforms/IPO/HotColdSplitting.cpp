@@ -0,0 +1,230 @@
+//===- HotColdSplitting.cpp - Outline the cold regions of functions -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass outlines the cold regions of functions into new functions that are
+// marked cold.  The code generator optimizes those for size and, with
+// -group-functions-by-hotness, places them in .text.unlikely, away from the
+// hot code, so that the rarely executed code no longer takes up instruction
+// cache lines and TLB entries next to the code that runs.
+//
+// With a profile, a block is cold if it never executed.  Without one, a block
+// is cold if every path from it ends in unreachable or in a call to a cold
+// function, like the error handling paths that end in abort().  A cold region
+// is the dominator subtree of a block that is cold all the way down; the
+// outermost such regions that are large enough are extracted with the
+// CodeExtractor.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/IPO.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/CodeExtractor.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "hotcoldsplit"
+
+STATISTIC(NumColdRegionsOutlined, "Number of cold regions outlined");
+
+static cl::opt<unsigned> MinColdRegionSize(
+    "hotcoldsplit-threshold", cl::init(8), cl::Hidden,
+    cl::desc("Minimum number of instructions in a cold region for it to be "
+             "outlined"));
+
+namespace {
+  struct HotColdSplitting : public ModulePass {
+    static char ID; // Pass identification, replacement for typeid
+    HotColdSplitting() : ModulePass(ID) {
+      initializeHotColdSplittingPass(*PassRegistry::getPassRegistry());
+    }
+
+    void getAnalysisUsage(AnalysisUsage &AU) const override {
+      AU.addRequired<BlockFrequencyInfoWrapperPass>();
+    }
+
+    bool runOnModule(Module &M) override;
+
+  private:
+    void findColdBlocks(Function &F, SmallPtrSetImpl<BasicBlock *> &Cold);
+    bool splitFunction(Function &F);
+  };
+}
+
+char HotColdSplitting::ID = 0;
+INITIALIZE_PASS_BEGIN(HotColdSplitting, "hotcoldsplit",
+                      "Hot Cold Splitting", false, false)
+INITIALIZE_PASS_DEPENDENCY(BlockFrequencyInfoWrapperPass)
+INITIALIZE_PASS_END(HotColdSplitting, "hotcoldsplit",
+                    "Hot Cold Splitting", false, false)
+
+ModulePass *llvm::createHotColdSplittingPass() {
+  return new HotColdSplitting();
+}
+
+/// Return true if BB ends in unreachable or calls a cold function, which
+/// without a profile is the best hint that it rarely executes.
+static bool isColdBlock(const BasicBlock &BB) {
+  if (isa<UnreachableInst>(BB.getTerminator()))
+    return true;
+  for (const Instruction &I : BB)
+    if (const CallInst *CI = dyn_cast<CallInst>(&I))
+      if (CI->hasFnAttr(Attribute::Cold))
+        return true;
+  return false;
+}
+
+void HotColdSplitting::findColdBlocks(Function &F,
+                                      SmallPtrSetImpl<BasicBlock *> &Cold) {
+  if (F.getEntryCount()) {
+    BlockFrequencyInfo &BFI =
+        getAnalysis<BlockFrequencyInfoWrapperPass>(F).getBFI();
+    for (BasicBlock &BB : F) {
+      Optional<uint64_t> Count = BFI.getBlockProfileCount(&BB);
+      if (Count && *Count == 0)
+        Cold.insert(&BB);
+    }
+    return;
+  }
+
+  // Without a profile, a block is also cold if all of its successors are.
+  // Visit the blocks in post-order, so that most successors are decided
+  // before their predecessors, and iterate for the loops.
+  for (BasicBlock &BB : F)
+    if (isColdBlock(BB))
+      Cold.insert(&BB);
+  bool Changed;
+  do {
+    Changed = false;
+    for (BasicBlock *BB : post_order(&F)) {
+      if (Cold.count(BB) || succ_begin(BB) == succ_end(BB))
+        continue;
+      if (all_of(successors(BB),
+                 [&](BasicBlock *Succ) { return Cold.count(Succ); })) {
+        Cold.insert(BB);
+        Changed = true;
+      }
+    }
+  } while (Changed);
+}
+
+/// Return the number of instructions in Region, not counting debug info.
+static unsigned getRegionSize(ArrayRef<BasicBlock *> Region) {
+  unsigned Size = 0;
+  for (BasicBlock *BB : Region)
+    for (Instruction &I : *BB)
+      if (!isa<DbgInfoIntrinsic>(I))
+        ++Size;
+  return Size;
+}
+
+bool HotColdSplitting::splitFunction(Function &F) {
+  SmallPtrSet<BasicBlock *, 32> Cold;
+  findColdBlocks(F, Cold);
+  // A function that is cold from its entry is better placed as a whole.
+  if (Cold.empty() || Cold.count(&F.getEntryBlock()))
+    return false;
+
+  // A block heads a region if its whole dominator subtree is cold.  Decide
+  // that bottom-up over the dominator tree.
+  DominatorTree DT(F);
+  SmallPtrSet<BasicBlock *, 32> ColdSubtree;
+  for (DomTreeNode *N : post_order(DT.getRootNode())) {
+    if (!Cold.count(N->getBlock()))
+      continue;
+    if (all_of(N->getChildren(), [&](DomTreeNode *Child) {
+          return ColdSubtree.count(Child->getBlock());
+        }))
+      ColdSubtree.insert(N->getBlock());
+  }
+
+  // Collect the outermost cold regions top-down.  A region is only
+  // extractable if it is entered through its header alone; blocks that are
+  // unreachable from the entry may still branch into the middle of it.
+  SmallVector<SmallVector<BasicBlock *, 8>, 4> Regions;
+  for (auto I = df_begin(DT.getRootNode()), E = df_end(DT.getRootNode());
+       I != E;) {
+    BasicBlock *Header = I->getBlock();
+    if (Header == &F.getEntryBlock() || !ColdSubtree.count(Header)) {
+      ++I;
+      continue;
+    }
+    SmallVector<BasicBlock *, 8> Region;
+    for (DomTreeNode *N : depth_first(*I))
+      Region.push_back(N->getBlock());
+
+    // If this region can't be extracted, one nested in it still may.
+    SmallPtrSet<BasicBlock *, 8> InRegion(Region.begin(), Region.end());
+    bool SingleEntry = all_of(Region, [&](BasicBlock *BB) {
+      return BB == Header || all_of(predecessors(BB), [&](BasicBlock *Pred) {
+               return InRegion.count(Pred);
+             });
+    });
+    if (!SingleEntry || getRegionSize(Region) < MinColdRegionSize) {
+      ++I;
+      continue;
+    }
+    Regions.push_back(std::move(Region));
+    I.skipChildren();
+  }
+
+  bool Changed = false;
+  for (ArrayRef<BasicBlock *> Region : Regions) {
+    // Each extraction changes the CFG, so recompute the dominators for the
+    // next one.
+    DominatorTree RegionDT(F);
+    CodeExtractor CE(Region, &RegionDT);
+    if (!CE.isEligible())
+      continue;
+    Function *Outlined = CE.extractCodeRegion();
+    if (!Outlined)
+      continue;
+
+    DEBUG(dbgs() << "Outlined cold region at " << Region.front()->getName()
+                 << " of " << F.getName() << " into " << Outlined->getName()
+                 << "\n");
+    Outlined->addFnAttr(Attribute::Cold);
+    Outlined->addFnAttr(Attribute::MinSize);
+    Outlined->addFnAttr(Attribute::NoInline);
+    for (User *U : Outlined->users())
+      if (CallInst *CI = dyn_cast<CallInst>(U))
+        CI->setIsNoInline();
+    ++NumColdRegionsOutlined;
+    Changed = true;
+  }
+  return Changed;
+}
+
+bool HotColdSplitting::runOnModule(Module &M) {
+  // Collect the functions first, the extracted ones are added to the module.
+  SmallVector<Function *, 16> Worklist;
+  for (Function &F : M) {
+    if (F.isDeclaration() || F.hasFnAttribute(Attribute::OptimizeNone) ||
+        F.hasFnAttribute(Attribute::Naked) ||
+        F.hasFnAttribute(Attribute::Cold))
+      continue;
+    Worklist.push_back(&F);
+  }
+
+  bool Changed = false;
+  for (Function *F : Worklist)
+    Changed |= splitFunction(*F);
+  return Changed;
+}
@@ -446,6 +446,7 @@ bool Inliner::runOnSCC(CallGraphSCC &SCC) {
         // Update the call graph by deleting the edge from Callee to Caller.
         CG[Caller]->removeCallEdgeFor(CS);
         CS.getInstruction()->eraseFromParent();
+        CostCache.invalidate(Caller);
         ++NumCallsDeleted;
       } else {
         // We can only inline direct calls to non-declarations.
@@ -485,6 +486,7 @@ bool Inliner::runOnSCC(CallGraphSCC &SCC) {
                                              Caller->getName()));
           continue;
         }
+        CostCache.invalidate(Caller);
         ++NumInlined;
 
         // Report the inline decision.
@@ -544,12 +546,18 @@ bool Inliner::runOnSCC(CallGraphSCC &SCC) {
     }
   } while (LocalChange);
 
+  // The function passes scheduled after the inliner are free to change the
+  // functions of this SCC, so their summaries must not outlive this visit.
+  for (Function *F : SCCFunctions)
+    CostCache.invalidate(F);
+
   return Changed;
 }
 
 /// Remove now-dead linkonce functions at the end of
 /// processing to avoid breaking the SCC traversal.
 bool Inliner::doFinalization(CallGraph &CG) {
+  CostCache.clear();
   return removeDeadFunctions(CG);
 }
 
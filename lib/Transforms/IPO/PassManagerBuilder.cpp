@@ -58,6 +58,10 @@ UseGVNAfterVectorization("use-gvn-after-vectorization",
   cl::init(false), cl::Hidden,
   cl::desc("Run GVN instead of Early CSE after vectorization passes"));
 
+static cl::opt<bool> EnableNewGVN(
+    "enable-newgvn", cl::init(false), cl::Hidden,
+    cl::desc("Run the optimistic NewGVN pass instead of GVN"));
+
 static cl::opt<bool> ExtraVectorizerPasses(
     "extra-vectorizer-passes", cl::init(false), cl::Hidden,
     cl::desc("Run cleanup optimization passes after vectorization."));
@@ -96,6 +100,18 @@ static cl::opt<bool> EnableLoopInterchange(
     "enable-loopinterchange", cl::init(false), cl::Hidden,
     cl::desc("Enable the new, experimental LoopInterchange Pass"));
 
+static cl::opt<bool> EnableLoopFusion(
+    "enable-loop-fusion", cl::init(false), cl::Hidden,
+    cl::desc("Enable the experimental LoopFuse Pass"));
+
+static cl::opt<bool> EnableLoopTiling(
+    "enable-loop-tiling", cl::init(false), cl::Hidden,
+    cl::desc("Enable the experimental LoopTile Pass"));
+
+static cl::opt<bool> EnableHotColdSplit(
+    "hot-cold-split", cl::init(false), cl::Hidden,
+    cl::desc("Enable the experimental HotColdSplitting Pass"));
+
 static cl::opt<bool> EnableLoopDistribute(
     "enable-loop-distribute", cl::init(false), cl::Hidden,
     cl::desc("Enable the new, experimental LoopDistribution Pass"));
@@ -260,10 +276,14 @@ void PassManagerBuilder::addFunctionSimplificationPasses(
   MPM.add(createIndVarSimplifyPass());        // Canonicalize indvars
   MPM.add(createLoopIdiomPass());             // Recognize idioms like memset.
   MPM.add(createLoopDeletionPass());          // Delete dead loops
+  if (EnableLoopFusion)
+    MPM.add(createLoopFusePass()); // Fuse adjacent loops
   if (EnableLoopInterchange) {
     MPM.add(createLoopInterchangePass()); // Interchange loops
     MPM.add(createCFGSimplificationPass());
   }
+  if (EnableLoopTiling)
+    MPM.add(createLoopTilePass()); // Tile loop nests
   if (!DisableUnrollLoops)
     MPM.add(createSimpleLoopUnrollPass());    // Unroll small loops
   addExtensionsToPM(EP_LoopOptimizerEnd, MPM);
@@ -271,7 +291,10 @@ void PassManagerBuilder::addFunctionSimplificationPasses(
   if (OptLevel > 1) {
     if (EnableMLSM)
       MPM.add(createMergedLoadStoreMotionPass()); // Merge ld/st in diamonds
-    MPM.add(createGVNPass(DisableGVNLoadPRE));  // Remove redundancies
+    if (EnableNewGVN)
+      MPM.add(createNewGVNPass());              // Remove redundancies
+    else
+      MPM.add(createGVNPass(DisableGVNLoadPRE)); // Remove redundancies
   }
   MPM.add(createMemCpyOptPass());             // Remove memcpy / form memset
   MPM.add(createSCCPPass());                  // Constant prop with SCCP
@@ -569,6 +592,11 @@ void PassManagerBuilder::populateModulePassManager(
   if (MergeFunctions)
     MPM.add(createMergeFunctionsPass());
 
+  // Outline the cold code last, once the inliner and the loop passes no
+  // longer need to see it in place.
+  if (EnableHotColdSplit)
+    MPM.add(createHotColdSplittingPass());
+
   addExtensionsToPM(EP_OptimizerLast, MPM);
   MPM.add(createCoroCleanupPass());
 }
@@ -648,7 +676,10 @@ void PassManagerBuilder::addLTOOptimizationPasses(legacy::PassManagerBase &PM) {
   PM.add(createLICMPass());                 // Hoist loop invariants.
   if (EnableMLSM)
     PM.add(createMergedLoadStoreMotionPass()); // Merge ld/st in diamonds.
-  PM.add(createGVNPass(DisableGVNLoadPRE)); // Remove redundancies.
+  if (EnableNewGVN)
+    PM.add(createNewGVNPass());               // Remove redundancies.
+  else
+    PM.add(createGVNPass(DisableGVNLoadPRE)); // Remove redundancies.
   PM.add(createMemCpyOptPass());            // Remove dead memcpys.
 
   // Nuke dead stores.
@@ -2057,6 +2057,11 @@ Instruction *InstCombiner::tryOptimizeCall(CallInst *CI) {
   LibCallSimplifier Simplifier(DL, TLI, InstCombineRAUW);
   if (Value *With = Simplifier.optimizeCall(CI)) {
     ++NumSimplified;
+    // The simplifier builds the new code with its own builder, so only the
+    // full walk of the next iteration would visit it.  The sparse mode has no
+    // such walk, so record the result for it.
+    if (Instruction *WithI = dyn_cast<Instruction>(With))
+      Worklist.AddTouched(WithI);
     return CI->use_empty() ? CI : replaceInstUsesWith(*CI, With);
   }
 
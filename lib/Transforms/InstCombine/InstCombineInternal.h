@@ -466,6 +466,11 @@ public:
       for (Use &Operand : I.operands())
         if (auto *Inst = dyn_cast<Instruction>(Operand))
           Worklist.Add(Inst);
+    } else if (Worklist.isTrackingTouched()) {
+      // Too many to revisit now, but the next sparse iteration has to.
+      for (Use &Operand : I.operands())
+        if (auto *Inst = dyn_cast<Instruction>(Operand))
+          Worklist.AddTouched(Inst);
     }
     Worklist.Remove(&I);
     I.eraseFromParent();
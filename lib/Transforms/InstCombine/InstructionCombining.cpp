@@ -77,11 +77,18 @@ STATISTIC(NumSunkInst , "Number of instructions sunk");
 STATISTIC(NumExpand,    "Number of expansions");
 STATISTIC(NumFactor   , "Number of factorizations");
 STATISTIC(NumReassoc  , "Number of reassociations");
+STATISTIC(NumSeeded   , "Number of insts seeded into the worklist");
+STATISTIC(NumVisited  , "Number of insts visited by the combiner");
 
 static cl::opt<bool>
 EnableExpensiveCombines("expensive-combines",
                         cl::desc("Enable expensive instruction combines"));
 
+static cl::opt<bool>
+SparseIterations("instcombine-sparse-iterations", cl::Hidden,
+                 cl::desc("Seed the iterations after the first one only with "
+                          "the instructions changed by the previous one"));
+
 Value *InstCombiner::EmitGEPOffset(User *GEP) {
   return llvm::EmitGEPOffset(Builder, DL, GEP);
 }
@@ -2750,6 +2757,7 @@ bool InstCombiner::run() {
   while (!Worklist.isEmpty()) {
     Instruction *I = Worklist.RemoveOne();
     if (I == nullptr) continue;  // skip null values.
+    ++NumVisited;
 
     // Check to see if we can DCE the instruction.
     if (isInstructionTriviallyDead(I, TLI)) {
@@ -2845,6 +2853,16 @@ bool InstCombiner::run() {
     DEBUG(raw_string_ostream SS(OrigI); I->print(SS); OrigI = SS.str(););
     DEBUG(dbgs() << "IC: Visiting: " << OrigI << '\n');
 
+    // A change in place drops uses of the old operands without adding them
+    // to the worklist.  The full walk of the next iteration gets to them
+    // anyway, but the sparse mode only revisits what was touched, so record
+    // them for it.
+    SmallVector<WeakVH, 4> OrigOps;
+    if (Worklist.isTrackingTouched())
+      for (Use &U : I->operands())
+        if (isa<Instruction>(U.get()))
+          OrigOps.push_back(U.get());
+
     if (Instruction *Result = visit(*I)) {
       ++NumCombined;
       // Should we replace the old instruction with a new one?
@@ -2882,6 +2900,10 @@ bool InstCombiner::run() {
                      << "    New = " << *I << '\n');
 #endif
 
+        for (WeakVH &Op : OrigOps)
+          if (Instruction *OpI = dyn_cast_or_null<Instruction>(Op))
+            Worklist.AddTouched(OpI);
+
         // If the instruction was modified, it's possible that it is now dead.
         // if so, remove it.
         if (isInstructionTriviallyDead(I, TLI)) {
@@ -2892,6 +2914,13 @@ bool InstCombiner::run() {
         }
       }
       MadeIRChange = true;
+    } else {
+      // A few folds change an instruction in place without reporting it, so
+      // at least revisit the operands they left dead.
+      for (WeakVH &Op : OrigOps)
+        if (Instruction *OpI = dyn_cast_or_null<Instruction>(Op))
+          if (OpI->use_empty())
+            Worklist.AddTouched(OpI);
     }
   }
 
@@ -2899,6 +2928,32 @@ bool InstCombiner::run() {
   return MadeIRChange;
 }
 
+/// Constant fold the constant expression operands of \p Inst, caching the
+/// results in \p FoldedConstants. Returns true if any operand changed.
+static bool foldConstantExprOperands(
+    Instruction *Inst, const DataLayout &DL, const TargetLibraryInfo *TLI,
+    DenseMap<ConstantExpr *, Constant *> &FoldedConstants) {
+  bool MadeIRChange = false;
+  for (User::op_iterator i = Inst->op_begin(), e = Inst->op_end(); i != e;
+       ++i) {
+    ConstantExpr *CE = dyn_cast<ConstantExpr>(i);
+    if (CE == nullptr)
+      continue;
+
+    Constant *&FoldRes = FoldedConstants[CE];
+    if (!FoldRes)
+      FoldRes = ConstantFoldConstantExpression(CE, DL, TLI);
+    if (!FoldRes)
+      FoldRes = CE;
+
+    if (FoldRes != CE) {
+      *i = FoldRes;
+      MadeIRChange = true;
+    }
+  }
+  return MadeIRChange;
+}
+
 /// Walk the function in depth-first order, adding all reachable code to the
 /// worklist.
 ///
@@ -2950,23 +3005,7 @@ static bool AddReachableCodeToWorklist(BasicBlock *BB, const DataLayout &DL,
         }
 
       // See if we can constant fold its operands.
-      for (User::op_iterator i = Inst->op_begin(), e = Inst->op_end(); i != e;
-           ++i) {
-        ConstantExpr *CE = dyn_cast<ConstantExpr>(i);
-        if (CE == nullptr)
-          continue;
-
-        Constant *&FoldRes = FoldedConstants[CE];
-        if (!FoldRes)
-          FoldRes = ConstantFoldConstantExpression(CE, DL, TLI);
-        if (!FoldRes)
-          FoldRes = CE;
-
-        if (FoldRes != CE) {
-          *i = FoldRes;
-          MadeIRChange = true;
-        }
-      }
+      MadeIRChange |= foldConstantExprOperands(Inst, DL, TLI, FoldedConstants);
 
       InstrsForInstCombineWorklist.push_back(Inst);
     }
@@ -3008,6 +3047,7 @@ static bool AddReachableCodeToWorklist(BasicBlock *BB, const DataLayout &DL,
   // of instructions to the worklist after doing a transformation, thus avoiding
   // some N^2 behavior in pathological cases.
   ICWorklist.AddInitialGroup(InstrsForInstCombineWorklist);
+  NumSeeded += InstrsForInstCombineWorklist.size();
 
   return MadeIRChange;
 }
@@ -3044,6 +3084,67 @@ static bool prepareICWorklistFromFunction(Function &F, const DataLayout &DL,
   return MadeIRChange;
 }
 
+/// \brief Populate the IC worklist with just the instructions touched by the
+/// previous iteration, along with their instruction operands.
+///
+/// Every change the combiner makes puts the changed instructions and their
+/// users on the worklist, so these are the only places a further iteration
+/// can find something new. Operands are included because a change can drop
+/// uses of them, which enables the one-use folds on them. Like the full walk,
+/// this folds the constant expression operands of the seeded instructions and
+/// sets \p MadeIRChange if any changed. Returns false if the touched
+/// instructions include a terminator: a folded branch condition makes blocks
+/// unreachable, which only the full walk over the function prunes.
+static bool prepareICWorklistFromTouched(ArrayRef<Instruction *> Touched,
+                                         const DataLayout &DL,
+                                         TargetLibraryInfo *TLI,
+                                         DominatorTree &DT,
+                                         InstCombineWorklist &ICWorklist,
+                                         bool &MadeIRChange) {
+  if (any_of(Touched, [](Instruction *I) { return isa<TerminatorInst>(I); }))
+    return false;
+
+  SmallPtrSet<Instruction *, 32> Seeds;
+  SmallVector<BasicBlock *, 16> Blocks;
+  SmallPtrSet<BasicBlock *, 16> SeenBlocks;
+  auto AddSeed = [&](Instruction *I) {
+    if (I->getParent() && Seeds.insert(I).second &&
+        SeenBlocks.insert(I->getParent()).second)
+      Blocks.push_back(I->getParent());
+  };
+  for (Instruction *I : Touched) {
+    AddSeed(I);
+    for (Use &U : I->operands())
+      if (Instruction *OpI = dyn_cast<Instruction>(U.get()))
+        AddSeed(OpI);
+  }
+
+  // Which of several fixed points the combiner reaches depends on the order
+  // of its folds, so visit the seeds in about the order of the full walk:
+  // the blocks in dominator tree order, and top-down in each block. Scanning
+  // a block is much cheaper than combining its instructions again. Leave
+  // unreachable blocks to the full walk.
+  if (any_of(Blocks, [&](BasicBlock *BB) { return !DT.getNode(BB); }))
+    return false;
+  DT.updateDFSNumbers();
+  std::sort(Blocks.begin(), Blocks.end(), [&](BasicBlock *A, BasicBlock *B) {
+    return DT.getNode(A)->getDFSNumIn() < DT.getNode(B)->getDFSNumIn();
+  });
+
+  SmallVector<Instruction *, 128> InstrsForInstCombineWorklist;
+  DenseMap<ConstantExpr *, Constant *> FoldedConstants;
+  for (BasicBlock *BB : Blocks)
+    for (Instruction &I : *BB)
+      if (Seeds.count(&I)) {
+        MadeIRChange |= foldConstantExprOperands(&I, DL, TLI, FoldedConstants);
+        InstrsForInstCombineWorklist.push_back(&I);
+      }
+
+  ICWorklist.AddInitialGroup(InstrsForInstCombineWorklist);
+  NumSeeded += InstrsForInstCombineWorklist.size();
+  return true;
+}
+
 static bool
 combineInstructionsOverFunction(Function &F, InstCombineWorklist &Worklist,
                                 AliasAnalysis *AA, AssumptionCache &AC,
@@ -3062,6 +3163,11 @@ combineInstructionsOverFunction(Function &F, InstCombineWorklist &Worklist,
   // by instcombiner.
   bool DbgDeclaresChanged = LowerDbgDeclare(F);
 
+  // In the sparse mode, record what each iteration touches so that the next
+  // one only needs to revisit that.
+  Worklist.setTrackTouched(SparseIterations);
+  SmallVector<Instruction *, 128> Touched;
+
   // Iterate while there is work to do.
   int Iteration = 0;
   for (;;) {
@@ -3069,15 +3175,31 @@ combineInstructionsOverFunction(Function &F, InstCombineWorklist &Worklist,
     DEBUG(dbgs() << "\n\nINSTCOMBINE ITERATION #" << Iteration << " on "
                  << F.getName() << "\n");
 
-    bool Changed = prepareICWorklistFromFunction(F, DL, &TLI, Worklist);
+    bool Changed = false;
+    bool Sparse = false;
+    if (SparseIterations && !Touched.empty())
+      Sparse = prepareICWorklistFromTouched(Touched, DL, &TLI, DT, Worklist,
+                                            Changed);
+    if (!Sparse)
+      Changed = prepareICWorklistFromFunction(F, DL, &TLI, Worklist);
+    Touched.clear();
 
     InstCombiner IC(Worklist, &Builder, F.optForMinSize(), ExpensiveCombines,
                     AA, &AC, &TLI, &DT, DL, LI);
     Changed |= IC.run();
-
-    if (!Changed)
-      break;
+    Worklist.takeTouched(Touched);
+
+    // Not every fold queues what it makes dead or foldable elsewhere in the
+    // function, so a sparse iteration that changes nothing is not a fixed
+    // point yet.  Confirm it with a full walk, which an empty Touched list
+    // asks for.
+    if (!Changed) {
+      if (!Sparse)
+        break;
+      Touched.clear();
+    }
   }
+  Worklist.setTrackTouched(false);
 
   return DbgDeclaresChanged || Iteration > 1;
 }
@@ -14,12 +14,14 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
 #include "llvm/ProfileData/InstrProf.h"
 #include "llvm/Transforms/Instrumentation.h"
 #include "llvm/Transforms/Utils/ModuleUtils.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
 
 using namespace llvm;
 
@@ -31,6 +33,21 @@ cl::opt<bool> DoNameCompression("enable-name-compression",
                                 cl::desc("Enable name string compression"),
                                 cl::init(true));
 
+cl::opt<bool> DoCounterPromotion(
+    "do-counter-promotion", cl::ZeroOrMore, cl::init(false),
+    cl::desc("Accumulate the counts of the counters incremented in a loop in "
+             "registers and add them to the counters on the loop exits"));
+
+cl::opt<unsigned> NumCounterShards(
+    "instrprof-counter-shards", cl::ZeroOrMore, cl::init(1),
+    cl::desc("Number of per-thread shards of the profile counters, rounded up "
+             "to a power of two; 1 disables sharding"));
+
+/// Counters in a cache line. Counter shards are padded to whole lines so
+/// that threads using different shards never write to the same line.
+const unsigned CountersPerCacheLine = 8;
+const unsigned MaxCounterShards = 64;
+
 class InstrProfiling : public ModulePass {
 public:
   static char ID;
@@ -48,6 +65,8 @@ public:
 
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.setPreservesCFG();
+    if (isCounterPromotionEnabled())
+      AU.addRequired<LoopInfoWrapperPass>();
   }
 
 private:
@@ -56,8 +75,10 @@ private:
   typedef struct PerFunctionProfileData {
     uint32_t NumValueSites[IPVK_Last+1];
     GlobalVariable* RegionCounters;
+    GlobalVariable* CounterShards;
     GlobalVariable* DataVar;
-    PerFunctionProfileData() : RegionCounters(nullptr), DataVar(nullptr) {
+    PerFunctionProfileData()
+        : RegionCounters(nullptr), CounterShards(nullptr), DataVar(nullptr) {
       memset(NumValueSites, 0, sizeof(uint32_t) * (IPVK_Last+1));
     }
   } PerFunctionProfileData;
@@ -66,6 +87,23 @@ private:
   std::vector<GlobalVariable *> ReferencedNames;
   GlobalVariable *NamesVar;
   size_t NamesSize;
+  /// The shard index computed in the entry block of each function.
+  DenseMap<Function *, Value *> ShardIndices;
+  GlobalVariable *ShardKey;
+  Function *MergeShardsF;
+
+  bool isCounterPromotionEnabled() const {
+    return Options.DoCounterPromotion || DoCounterPromotion;
+  }
+
+  /// Number of counter shards, a power of two.
+  unsigned getNumCounterShards() const {
+    unsigned NumShards =
+        std::max(Options.NumCounterShards, (unsigned)NumCounterShards);
+    if (NumShards <= 1)
+      return 1;
+    return std::min((unsigned)NextPowerOf2(NumShards - 1), MaxCounterShards);
+  }
 
   bool isMachO() const {
     return Triple(M->getTargetTriple()).isOSBinFormatMachO();
@@ -98,7 +136,18 @@ private:
   void lowerValueProfileInst(InstrProfValueProfileInst *Ins);
 
   /// Replace instrprof_increment with an increment of the appropriate value.
-  void lowerIncrement(InstrProfIncrementInst *Inc);
+  void lowerIncrement(InstrProfIncrementInst *Inc, LoopInfo *LI);
+
+  /// Get the address of the counter of an increment, in the shard of the
+  /// current thread when the counters are sharded.
+  Value *getCounterAddress(InstrProfIncrementInst *Inc, IRBuilder<> &Builder);
+
+  /// Get the shard index of the current thread in the function of \p Inc.
+  Value *getShardIndex(InstrProfIncrementInst *Inc);
+
+  /// Count the increments of \p Inc in a register through the loop \p L and
+  /// add the count to the counter on the exits of \p L.
+  void promoteIncrement(InstrProfIncrementInst *Inc, Loop *L);
 
   /// Force emitting of name vars for unused functions.
   void lowerCoverageData(GlobalVariable *CoverageNamesVar);
@@ -112,6 +161,9 @@ private:
   /// Emit the section with compressed function names.
   void emitNameData();
 
+  /// Emit the function that adds the counter shards into the counters.
+  void emitShardMerge();
+
   /// Emit runtime registration functions for each profile data variable.
   void emitRegistration();
 
@@ -129,9 +181,13 @@ private:
 } // anonymous namespace
 
 char InstrProfiling::ID = 0;
-INITIALIZE_PASS(InstrProfiling, "instrprof",
-                "Frontend instrumentation-based coverage lowering.", false,
-                false)
+INITIALIZE_PASS_BEGIN(InstrProfiling, "instrprof",
+                      "Frontend instrumentation-based coverage lowering.",
+                      false, false)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_END(InstrProfiling, "instrprof",
+                    "Frontend instrumentation-based coverage lowering.", false,
+                    false)
 
 ModulePass *llvm::createInstrProfilingPass(const InstrProfOptions &Options) {
   return new InstrProfiling(Options);
@@ -145,6 +201,9 @@ bool InstrProfiling::runOnModule(Module &M) {
   NamesSize = 0;
   ProfileDataMap.clear();
   UsedVars.clear();
+  ShardIndices.clear();
+  ShardKey = nullptr;
+  MergeShardsF = nullptr;
 
   // We did not know how many value sites there would be inside
   // the instrumented function. This is counting the number of instrumented
@@ -164,18 +223,22 @@ bool InstrProfiling::runOnModule(Module &M) {
       static_cast<void>(getOrCreateRegionCounters(FirstProfIncInst));
   }
 
-  for (Function &F : M)
+  for (Function &F : M) {
+    LoopInfo *LI = nullptr;
     for (BasicBlock &BB : F)
       for (auto I = BB.begin(), E = BB.end(); I != E;) {
         auto Instr = I++;
         if (auto *Inc = dyn_cast<InstrProfIncrementInst>(Instr)) {
-          lowerIncrement(Inc);
+          if (!LI && isCounterPromotionEnabled())
+            LI = &getAnalysis<LoopInfoWrapperPass>(F).getLoopInfo();
+          lowerIncrement(Inc, LI);
           MadeChange = true;
         } else if (auto *Ind = dyn_cast<InstrProfValueProfileInst>(Instr)) {
           lowerValueProfileInst(Ind);
           MadeChange = true;
         }
       }
+  }
 
   if (GlobalVariable *CoverageNamesVar =
           M.getNamedGlobal(getCoverageUnusedNamesVarName())) {
@@ -187,6 +250,7 @@ bool InstrProfiling::runOnModule(Module &M) {
     return false;
 
   emitNameData();
+  emitShardMerge();
   emitRegistration();
   emitRuntimeHook();
   emitUses();
@@ -243,12 +307,111 @@ void InstrProfiling::lowerValueProfileInst(InstrProfValueProfileInst *Ind) {
   Ind->eraseFromParent();
 }
 
-void InstrProfiling::lowerIncrement(InstrProfIncrementInst *Inc) {
+Value *InstrProfiling::getShardIndex(InstrProfIncrementInst *Inc) {
+  Function *F = Inc->getParent()->getParent();
+  auto It = ShardIndices.find(F);
+  if (It != ShardIndices.end())
+    return It->second;
+
+  LLVMContext &Ctx = M->getContext();
+  auto *Int8Ty = Type::getInt8Ty(Ctx);
+  if (!ShardKey) {
+    ShardKey = new GlobalVariable(
+        *M, Int8Ty, false, GlobalValue::LinkOnceODRLinkage,
+        Constant::getNullValue(Int8Ty), getInstrProfShardKeyVarName(),
+        nullptr, GlobalVariable::InitialExecTLSModel);
+    ShardKey->setVisibility(GlobalValue::HiddenVisibility);
+    if (!isMachO())
+      ShardKey->setComdat(M->getOrInsertComdat(ShardKey->getName()));
+  }
+
+  // Every thread has its own copy of the key, and the copies of different
+  // threads are far apart. Hash the address of the copy of this thread into
+  // the shard index, multiplicatively so that the high bits that differ
+  // between threads reach the index.
+  IRBuilder<> Builder(&*F->getEntryBlock().getFirstInsertionPt());
+  // Keep the address of the thread local key in an instruction, instead of
+  // letting the builder fold the hash into a constant expression.
+  Value *Key = Builder.Insert(
+      CastInst::Create(Instruction::PtrToInt, ShardKey, Builder.getInt64Ty()),
+      "pgoshardkey");
+  Value *Hash = Builder.CreateMul(Builder.CreateLShr(Key, 12),
+                                  Builder.getInt64(0x9E3779B97F4A7C15ULL));
+  Value *Shard = Builder.CreateLShr(
+      Hash, 64 - Log2_32(getNumCounterShards()), "pgoshard");
+  ShardIndices[F] = Shard;
+  return Shard;
+}
+
+Value *InstrProfiling::getCounterAddress(InstrProfIncrementInst *Inc,
+                                         IRBuilder<> &Builder) {
   GlobalVariable *Counters = getOrCreateRegionCounters(Inc);
+  uint64_t Index = Inc->getIndex()->getZExtValue();
+  if (getNumCounterShards() == 1)
+    return Builder.CreateConstInBoundsGEP2_64(Counters, 0, Index);
+
+  GlobalVariable *Shards = ProfileDataMap[Inc->getName()].CounterShards;
+  Value *Indices[] = {Builder.getInt64(0), getShardIndex(Inc),
+                      Builder.getInt64(Index)};
+  return Builder.CreateInBoundsGEP(Shards, Indices);
+}
+
+/// Returns the outermost loop around \p BB whose counter increments can be
+/// counted in a register: it needs a preheader to start the count in and
+/// dedicated exits, all of which can take the code adding the count to the
+/// counter.
+static Loop *getPromotionLoop(LoopInfo &LI, BasicBlock *BB) {
+  Loop *Promotable = nullptr;
+  for (Loop *L = LI.getLoopFor(BB); L; L = L->getParentLoop()) {
+    if (!L->getLoopPreheader() || !L->hasDedicatedExits())
+      continue;
+    SmallVector<BasicBlock *, 8> ExitBlocks;
+    L->getUniqueExitBlocks(ExitBlocks);
+    if (std::all_of(ExitBlocks.begin(), ExitBlocks.end(), [](BasicBlock *E) {
+          return E->getFirstInsertionPt() != E->end();
+        }))
+      Promotable = L;
+  }
+  return Promotable;
+}
+
+void InstrProfiling::promoteIncrement(InstrProfIncrementInst *Inc, Loop *L) {
+  auto *Int64Ty = Type::getInt64Ty(M->getContext());
+  SSAUpdater SSA;
+  SSA.Initialize(Int64Ty, "pgocount.promoted");
+  SSA.AddAvailableValue(L->getLoopPreheader(), ConstantInt::get(Int64Ty, 0));
+
+  BasicBlock *BB = Inc->getParent();
+  auto *Next = BinaryOperator::CreateAdd(UndefValue::get(Int64Ty),
+                                         ConstantInt::get(Int64Ty, 1),
+                                         "pgocount.next", Inc);
+  SSA.AddAvailableValue(BB, Next);
+  Next->setOperand(0, SSA.GetValueInMiddleOfBlock(BB));
+
+  // Iterations that leave the loop through a call that does not return lose
+  // their counts, as the counts are only added on the exit blocks.
+  SmallVector<BasicBlock *, 8> ExitBlocks;
+  L->getUniqueExitBlocks(ExitBlocks);
+  for (BasicBlock *Exit : ExitBlocks) {
+    Value *LoopCount = SSA.GetValueInMiddleOfBlock(Exit);
+    IRBuilder<> Builder(&*Exit->getFirstInsertionPt());
+    Value *Addr = getCounterAddress(Inc, Builder);
+    Value *Count = Builder.CreateLoad(Addr, "pgocount");
+    Builder.CreateStore(Builder.CreateAdd(Count, LoopCount), Addr);
+  }
+  Inc->eraseFromParent();
+}
+
+void InstrProfiling::lowerIncrement(InstrProfIncrementInst *Inc,
+                                    LoopInfo *LI) {
+  if (LI)
+    if (Loop *L = getPromotionLoop(*LI, Inc->getParent())) {
+      promoteIncrement(Inc, L);
+      return;
+    }
 
   IRBuilder<> Builder(Inc);
-  uint64_t Index = Inc->getIndex()->getZExtValue();
-  Value *Addr = Builder.CreateConstInBoundsGEP2_64(Counters, 0, Index);
+  Value *Addr = getCounterAddress(Inc, Builder);
   Value *Count = Builder.CreateLoad(Addr, "pgocount");
   Count = Builder.CreateAdd(Count, Builder.getInt64(1));
   Inc->replaceAllUsesWith(Builder.CreateStore(Count, Addr));
@@ -391,6 +554,23 @@ InstrProfiling::getOrCreateRegionCounters(InstrProfIncrementInst *Inc) {
   Data->setAlignment(INSTR_PROF_DATA_ALIGNMENT);
   Data->setComdat(ProfileVarsComdat);
 
+  unsigned NumShards = getNumCounterShards();
+  if (NumShards > 1) {
+    // The shards stay out of the counters section: they are added into the
+    // counters by the merge function before the profile is written.
+    uint64_t Stride = alignTo(NumCounters, CountersPerCacheLine);
+    auto *ShardsTy = ArrayType::get(
+        ArrayType::get(Type::getInt64Ty(Ctx), Stride), NumShards);
+    auto *Shards = new GlobalVariable(
+        *M, ShardsTy, false, NamePtr->getLinkage(),
+        Constant::getNullValue(ShardsTy),
+        getVarName(Inc, getInstrProfCounterShardsVarPrefix()));
+    Shards->setVisibility(NamePtr->getVisibility());
+    Shards->setAlignment(CountersPerCacheLine * 8);
+    Shards->setComdat(ProfileVarsComdat);
+    PD.CounterShards = Shards;
+  }
+
   PD.RegionCounters = CounterPtr;
   PD.DataVar = Data;
   ProfileDataMap[NamePtr] = PD;
@@ -428,6 +608,59 @@ void InstrProfiling::emitNameData() {
   UsedVars.push_back(NamesVar);
 }
 
+void InstrProfiling::emitShardMerge() {
+  unsigned NumShards = getNumCounterShards();
+  if (NumShards == 1)
+    return;
+
+  auto &Ctx = M->getContext();
+  auto *VoidTy = Type::getVoidTy(Ctx);
+  MergeShardsF = Function::Create(FunctionType::get(VoidTy, false),
+                                  GlobalValue::InternalLinkage,
+                                  getInstrProfMergeShardsFuncName(), M);
+  MergeShardsF->setUnnamedAddr(true);
+  MergeShardsF->addFnAttr(Attribute::NoInline);
+  if (Options.NoRedZone) MergeShardsF->addFnAttr(Attribute::NoRedZone);
+
+  // For every function, add each counter of all shards into the counter and
+  // clear the shards, so that merging again adds nothing.
+  IRBuilder<> IRB(BasicBlock::Create(Ctx, "", MergeShardsF));
+  for (GlobalVariable *Name : ReferencedNames) {
+    auto It = ProfileDataMap.find(Name);
+    if (It == ProfileDataMap.end() || !It->second.CounterShards)
+      continue;
+    GlobalVariable *Counters = It->second.RegionCounters;
+    GlobalVariable *Shards = It->second.CounterShards;
+    uint64_t NumCounters =
+        cast<ArrayType>(Counters->getType()->getElementType())
+            ->getNumElements();
+
+    BasicBlock *Preheader = IRB.GetInsertBlock();
+    BasicBlock *Loop = BasicBlock::Create(Ctx, "merge", MergeShardsF);
+    BasicBlock *Exit = BasicBlock::Create(Ctx, "merge.end", MergeShardsF);
+    IRB.CreateBr(Loop);
+
+    IRB.SetInsertPoint(Loop);
+    PHINode *Index = IRB.CreatePHI(IRB.getInt64Ty(), 2, "idx");
+    Index->addIncoming(IRB.getInt64(0), Preheader);
+    Value *Addr = IRB.CreateInBoundsGEP(Counters, {IRB.getInt64(0), Index});
+    Value *Sum = IRB.CreateLoad(Addr, "pgocount");
+    for (unsigned Shard = 0; Shard != NumShards; ++Shard) {
+      Value *ShardAddr = IRB.CreateInBoundsGEP(
+          Shards, {IRB.getInt64(0), IRB.getInt64(Shard), Index});
+      Sum = IRB.CreateAdd(Sum, IRB.CreateLoad(ShardAddr, "pgoshardcount"));
+      IRB.CreateStore(IRB.getInt64(0), ShardAddr);
+    }
+    IRB.CreateStore(Sum, Addr);
+    Value *Next = IRB.CreateAdd(Index, IRB.getInt64(1), "idx.next");
+    Index->addIncoming(Next, Loop);
+    IRB.CreateCondBr(IRB.CreateICmpEQ(Next, IRB.getInt64(NumCounters)), Exit,
+                     Loop);
+    IRB.SetInsertPoint(Exit);
+  }
+  IRB.CreateRetVoid();
+}
+
 void InstrProfiling::emitRegistration() {
   // Don't do this for Darwin.  compiler-rt uses linker magic.
   if (Triple(M->getTargetTriple()).isOSDarwin())
@@ -537,7 +770,7 @@ void InstrProfiling::emitInitialization() {
   std::string InstrProfileOutput = Options.InstrProfileOutput;
 
   Constant *RegisterF = M->getFunction(getInstrProfRegFuncsName());
-  if (!RegisterF && InstrProfileOutput.empty()) return;
+  if (!RegisterF && !MergeShardsF && InstrProfileOutput.empty()) return;
 
   // Create the initialization function.
   auto *VoidTy = Type::getVoidTy(M->getContext());
@@ -552,6 +785,19 @@ void InstrProfiling::emitInitialization() {
   IRBuilder<> IRB(BasicBlock::Create(M->getContext(), "", F));
   if (RegisterF)
     IRB.CreateCall(RegisterF, {});
+  if (MergeShardsF) {
+    // The runtime writes the profile from an atexit handler. Register it now
+    // if it isn't yet, so that the merge function registered after it runs
+    // before it.
+    auto *Int32Ty = Type::getInt32Ty(M->getContext());
+    Constant *RegisterWriteF = M->getOrInsertFunction(
+        getInstrProfRegisterWriteFileAtExitFuncName(),
+        FunctionType::get(Int32Ty, false));
+    IRB.CreateCall(RegisterWriteF, {});
+    Constant *AtExitF = M->getOrInsertFunction(
+        "atexit", FunctionType::get(Int32Ty, MergeShardsF->getType(), false));
+    IRB.CreateCall(AtExitF, MergeShardsF);
+  }
   if (!InstrProfileOutput.empty()) {
     auto *Int8PtrTy = Type::getInt8PtrTy(M->getContext());
     auto *SetNameTy = FunctionType::get(VoidTy, Int8PtrTy, false);
@@ -72,6 +72,7 @@
 #include "llvm/Support/JamCRC.h"
 #include "llvm/Transforms/Instrumentation.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 #include <string>
 #include <utility>
 #include <vector>
@@ -88,6 +89,7 @@ STATISTIC(NumOfPGOFunc, "Number of functions having valid profile counts.");
 STATISTIC(NumOfPGOMismatch, "Number of functions having mismatch profile.");
 STATISTIC(NumOfPGOMissing, "Number of functions without profile.");
 STATISTIC(NumOfPGOICall, "Number of indirect call value instrumentations.");
+STATISTIC(NumOfPGOSampled, "Number of functions with sampled instrumentation.");
 
 // Command line option to specify the file to read profile from. This is
 // mainly used for testing.
@@ -111,6 +113,22 @@ static cl::opt<unsigned>
                      cl::desc("Max number of annotations for a single indirect "
                               "call callsite"));
 
+// Command line option to enable sampled instrumentation: the functions run
+// an uninstrumented copy of their body, except for one invocation in every
+// PGOInstrSamplingPeriod in each thread, which runs the instrumented body.
+static cl::opt<bool>
+    PGOInstrSampling("pgo-instr-sampling", cl::init(false), cl::Hidden,
+                     cl::desc("Only run the instrumented body of functions "
+                              "for a sample of their invocations"));
+
+// Command line option to set the number of function invocations between two
+// sampled ones. The default is a prime so that the sampled invocations don't
+// follow a regular pattern of calls.
+static cl::opt<unsigned> PGOInstrSamplingPeriod(
+    "pgo-instr-sampling-period", cl::init(1009), cl::Hidden,
+    cl::desc("Number of function invocations per sampled invocation in "
+             "sampled PGO instrumentation"));
+
 namespace {
 class PGOInstrumentationGen : public ModulePass {
 public:
@@ -394,6 +412,95 @@ static void instrumentOneFunc(Function &F, Module *M,
   NumOfPGOICall += NumIndirectCallSites;
 }
 
+// Give F an uninstrumented copy of its body and a new entry block that
+// branches to the instrumented body once every PGOInstrSamplingPeriod
+// invocations, counted down by a thread local variable shared by all the
+// functions. A sampled invocation runs in the instrumented body from the entry
+// to the exit, so the counters still obey flow conservation: the profile is
+// only scaled down by the sampling period, which llvm-profdata merge can
+// compensate for with -weighted-input.
+static void sampleOneFunc(Function &F, Module *M) {
+  // The copy of a block whose address is taken could only be reached by an
+  // indirectbr in the instrumented body. llvm.localescape has to stay in the
+  // entry block, and must not be called twice.
+  for (auto &BB : F) {
+    if (BB.hasAddressTaken())
+      return;
+    for (auto &I : BB)
+      if (auto *II = dyn_cast<IntrinsicInst>(&I))
+        if (II->getIntrinsicID() == Intrinsic::localescape)
+          return;
+  }
+
+  LLVMContext &Ctx = M->getContext();
+  Type *Int32Ty = Type::getInt32Ty(Ctx);
+  GlobalVariable *Countdown = M->getNamedGlobal(getPGOSampleCountdownVarName());
+  if (!Countdown) {
+    // The countdown starts at zero, so that the first invocation in each
+    // thread is sampled.
+    Countdown = new GlobalVariable(
+        *M, Int32Ty, false, GlobalValue::LinkOnceODRLinkage,
+        Constant::getNullValue(Int32Ty), getPGOSampleCountdownVarName(),
+        nullptr, GlobalVariable::InitialExecTLSModel);
+    Countdown->setVisibility(GlobalValue::HiddenVisibility);
+    if (!Triple(M->getTargetTriple()).isOSBinFormatMachO())
+      Countdown->setComdat(M->getOrInsertComdat(Countdown->getName()));
+  }
+
+  // Both bodies share the static allocas, which move to the new entry.
+  BasicBlock *Entry = &F.getEntryBlock();
+  SmallVector<AllocaInst *, 8> StaticAllocas;
+  for (auto &I : *Entry)
+    if (auto *AI = dyn_cast<AllocaInst>(&I))
+      if (AI->isStaticAlloca())
+        StaticAllocas.push_back(AI);
+
+  SmallVector<BasicBlock *, 16> Blocks;
+  for (auto &BB : F)
+    Blocks.push_back(&BB);
+
+  BasicBlock *SampleBB = BasicBlock::Create(Ctx, "pgo.sample", &F, Entry);
+  for (AllocaInst *AI : StaticAllocas) {
+    AI->removeFromParent();
+    SampleBB->getInstList().push_back(AI);
+  }
+
+  ValueToValueMapTy VMap;
+  SmallVector<BasicBlock *, 16> Clones;
+  for (BasicBlock *BB : Blocks) {
+    BasicBlock *Clone = CloneBasicBlock(BB, VMap, ".nosample", &F);
+    VMap[BB] = Clone;
+    Clones.push_back(Clone);
+  }
+  SmallVector<IntrinsicInst *, 16> Instrumentation;
+  for (BasicBlock *Clone : Clones)
+    for (auto &I : *Clone) {
+      RemapInstruction(&I, VMap,
+                       RF_NoModuleLevelChanges | RF_IgnoreMissingEntries);
+      if (auto *II = dyn_cast<IntrinsicInst>(&I))
+        if (II->getIntrinsicID() == Intrinsic::instrprof_increment ||
+            II->getIntrinsicID() == Intrinsic::instrprof_value_profile)
+          Instrumentation.push_back(II);
+    }
+  for (IntrinsicInst *II : Instrumentation)
+    II->eraseFromParent();
+
+  IRBuilder<> Builder(SampleBB);
+  Value *Count = Builder.CreateLoad(Countdown, "pgo.countdown");
+  Value *Next = Builder.CreateSub(Count, Builder.getInt32(1));
+  Value *Sampled = Builder.CreateICmpSLE(Next, Builder.getInt32(0),
+                                         "pgo.sampled");
+  Builder.CreateStore(
+      Builder.CreateSelect(Sampled, Builder.getInt32(PGOInstrSamplingPeriod),
+                           Next),
+      Countdown);
+  MDBuilder MDB(Ctx);
+  Builder.CreateCondBr(
+      Sampled, Entry, cast<BasicBlock>(VMap[Entry]),
+      MDB.createBranchWeights(1, std::max(1U, PGOInstrSamplingPeriod - 1)));
+  NumOfPGOSampled++;
+}
+
 // This class represents a CFG edge in profile use compilation.
 struct PGOUseEdge : public PGOEdge {
   bool CountValid;
@@ -790,6 +897,8 @@ bool PGOInstrumentationGen::runOnModule(Module &M) {
     BlockFrequencyInfo *BFI =
         &(getAnalysis<BlockFrequencyInfoWrapperPass>(F).getBFI());
     instrumentOneFunc(F, &M, BPI, BFI);
+    if (PGOInstrSampling)
+      sampleOneFunc(F, &M);
   }
   return true;
 }
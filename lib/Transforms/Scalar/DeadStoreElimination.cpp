@@ -24,6 +24,7 @@
 #include "llvm/Analysis/GlobalsModRef.h"
 #include "llvm/Analysis/MemoryBuiltins.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
+#include "llvm/Analysis/PostDominators.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/Constants.h"
@@ -34,9 +35,11 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/MemorySSA.h"
 using namespace llvm;
 
 #define DEBUG_TYPE "dse"
@@ -44,16 +47,39 @@ using namespace llvm;
 STATISTIC(NumRedundantStores, "Number of redundant stores deleted");
 STATISTIC(NumFastStores, "Number of stores deleted");
 STATISTIC(NumFastOther , "Number of other instrs removed");
+STATISTIC(NumMemorySSAStores, "Number of stores deleted across blocks");
+STATISTIC(NumMemorySSALimited,
+          "Number of stores kept because a MemorySSA walk hit its limit");
+
+static cl::opt<bool>
+EnableMemorySSA("enable-dse-memoryssa", cl::init(false), cl::Hidden,
+                cl::desc("Use MemorySSA to delete stores that are dead "
+                         "across basic blocks"));
+
+static cl::opt<unsigned>
+MemorySSAScanLimit("dse-memoryssa-scanlimit", cl::init(150), cl::Hidden,
+                   cl::desc("The number of memory accesses to visit from one "
+                            "store before giving up on it"));
+
+static cl::opt<unsigned>
+MemorySSABudget("dse-memoryssa-budget", cl::init(100), cl::Hidden,
+                cl::desc("The average number of memory accesses to visit per "
+                         "store in one function before giving up on the "
+                         "function"));
 
 namespace {
   struct DSE : public FunctionPass {
     AliasAnalysis *AA;
     MemoryDependenceResults *MD;
     DominatorTree *DT;
+    PostDominatorTree *PDT;
+    MemorySSA *MSSA;
     const TargetLibraryInfo *TLI;
 
     static char ID; // Pass identification, replacement for typeid
-    DSE() : FunctionPass(ID), AA(nullptr), MD(nullptr), DT(nullptr) {
+    DSE()
+        : FunctionPass(ID), AA(nullptr), MD(nullptr), DT(nullptr),
+          PDT(nullptr), MSSA(nullptr) {
       initializeDSEPass(*PassRegistry::getPassRegistry());
     }
 
@@ -73,6 +99,10 @@ namespace {
         if (DT->isReachableFromEntry(&I))
           Changed |= runOnBasicBlock(I);
 
+      // Stores killed in other blocks are only found by walking MemorySSA.
+      if (EnableMemorySSA)
+        Changed |= eliminateDeadStoresAcrossBlocks(F);
+
       AA = nullptr; MD = nullptr; DT = nullptr;
       return Changed;
     }
@@ -84,6 +114,9 @@ namespace {
     void RemoveAccessedObjects(const MemoryLocation &LoadedLoc,
                                SmallSetVector<Value *, 16> &DeadStackObjects,
                                const DataLayout &DL);
+    bool eliminateDeadStoresAcrossBlocks(Function &F);
+    bool isDeadAcrossBlocks(Instruction *Inst, const MemoryLocation &Loc,
+                            bool ToLocalObject, unsigned &Budget);
 
     void getAnalysisUsage(AnalysisUsage &AU) const override {
       AU.setPreservesCFG();
@@ -91,6 +124,8 @@ namespace {
       AU.addRequired<AAResultsWrapperPass>();
       AU.addRequired<MemoryDependenceWrapperPass>();
       AU.addRequired<TargetLibraryInfoWrapperPass>();
+      if (EnableMemorySSA)
+        AU.addRequired<PostDominatorTreeWrapperPass>();
       AU.addPreserved<DominatorTreeWrapperPass>();
       AU.addPreserved<GlobalsAAWrapperPass>();
       AU.addPreserved<MemoryDependenceWrapperPass>();
@@ -104,6 +139,7 @@ INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(AAResultsWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(GlobalsAAWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(MemoryDependenceWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(PostDominatorTreeWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(TargetLibraryInfoWrapperPass)
 INITIALIZE_PASS_END(DSE, "dse", "Dead Store Elimination", false, false)
 
@@ -118,11 +154,14 @@ FunctionPass *llvm::createDeadStoreEliminationPass() { return new DSE(); }
 /// dead, delete them and the computation tree that feeds them.
 ///
 /// If ValueSet is non-null, remove any deleted instructions from it as well.
+/// If MSSA is non-null, remove the memory accesses of the deleted instructions
+/// from it.
 ///
 static void DeleteDeadInstruction(Instruction *I,
                                MemoryDependenceResults &MD,
                                const TargetLibraryInfo &TLI,
-                               SmallSetVector<Value*, 16> *ValueSet = nullptr) {
+                               SmallSetVector<Value*, 16> *ValueSet = nullptr,
+                               MemorySSA *MSSA = nullptr) {
   SmallVector<Instruction*, 32> NowDeadInsts;
 
   NowDeadInsts.push_back(I);
@@ -137,6 +176,9 @@ static void DeleteDeadInstruction(Instruction *I,
     // MemDep, which needs to know the operands and needs it to be in the
     // function.
     MD.removeInstruction(DeadInst);
+    if (MSSA)
+      if (MemoryAccess *MA = MSSA->getMemoryAccess(DeadInst))
+        MSSA->removeMemoryAccess(MA);
 
     for (unsigned op = 0, e = DeadInst->getNumOperands(); op != e; ++op) {
       Value *Op = DeadInst->getOperand(op);
@@ -959,3 +1001,156 @@ void DSE::RemoveAccessedObjects(const MemoryLocation &LoadedLoc,
     return !AA->isNoAlias(StackLoc, LoadedLoc);
   });
 }
+
+/// isGuaranteedLoopInvariant - Return true if the pointer Ptr refers to the
+/// same memory every time it is evaluated, i.e. if neither its base nor its
+/// underlying object can be redefined on a cycle of the CFG.  A write to such
+/// a pointer in one iteration of a loop can't be killed by a write to it in
+/// another one.
+static bool isGuaranteedLoopInvariant(const Value *Ptr, const DataLayout &DL) {
+  auto IsInvariant = [](const Value *V) {
+    const Instruction *I = dyn_cast<Instruction>(V);
+    return !I || I->getParent() == &I->getFunction()->getEntryBlock();
+  };
+  int64_t Offset;
+  return IsInvariant(GetPointerBaseWithConstantOffset(Ptr, Offset, DL)) &&
+         IsInvariant(GetUnderlyingObject(Ptr, DL));
+}
+
+/// isDeadAcrossBlocks - Walk the MemorySSA def-use chains forward from the
+/// write Inst to the location Loc, and return true if nothing may read Loc
+/// before it is completely overwritten in a block that post-dominates Inst,
+/// or, if ToLocalObject is set, before the function returns.  Budget is the
+/// number of memory accesses the walks may still visit in this function.
+bool DSE::isDeadAcrossBlocks(Instruction *Inst, const MemoryLocation &Loc,
+                             bool ToLocalObject, unsigned &Budget) {
+  const DataLayout &DL = Inst->getModule()->getDataLayout();
+  MemoryAccess *Def = MSSA->getMemoryAccess(Inst);
+  if (!Def)
+    return false;
+
+  // Overwrites only kill Inst if they write the very memory it wrote.
+  bool CanBeKilled = isGuaranteedLoopInvariant(Loc.Ptr, DL);
+
+  SmallVector<MemoryAccess *, 16> WorkList;
+  SmallPtrSet<MemoryAccess *, 16> Visited;
+  auto PushUsers = [&](MemoryAccess *MA) {
+    for (User *U : MA->users()) {
+      MemoryAccess *UseAccess = cast<MemoryAccess>(U);
+      if (Visited.insert(UseAccess).second)
+        WorkList.push_back(UseAccess);
+    }
+  };
+  PushUsers(Def);
+
+  bool Killed = false;
+  unsigned Steps = 0;
+  while (!WorkList.empty()) {
+    if (++Steps > MemorySSAScanLimit || Budget == 0) {
+      ++NumMemorySSALimited;
+      return false;
+    }
+    --Budget;
+
+    MemoryAccess *MA = WorkList.pop_back_val();
+    if (isa<MemoryPhi>(MA)) {
+      PushUsers(MA);
+      continue;
+    }
+
+    // Coming back around a loop to Inst itself: its own users are already on
+    // the worklist.
+    Instruction *UseInst = cast<MemoryUseOrDef>(MA)->getMemoryInst();
+    if (UseInst == Inst)
+      continue;
+
+    // Anything that may read the location keeps the store alive.
+    if (AA->getModRefInfo(UseInst, Loc) & MRI_Ref)
+      return false;
+    if (isa<MemoryUse>(MA))
+      continue;
+
+    // Once we unwind out of the function, the caller can see the location,
+    // unless it is dead along with the frame.
+    if (!ToLocalObject && UseInst->mayThrow())
+      return false;
+
+    if (CanBeKilled && hasMemoryWrite(UseInst, *TLI)) {
+      MemoryLocation KillLoc = getLocForWrite(UseInst, *AA);
+      int64_t InstWriteOffset, KillWriteOffset;
+      if (KillLoc.Ptr && isGuaranteedLoopInvariant(KillLoc.Ptr, DL) &&
+          isOverwrite(KillLoc, Loc, DL, *TLI, InstWriteOffset,
+                      KillWriteOffset) == OverwriteComplete) {
+        // Nothing past the overwrite can see Inst on this path.  The store is
+        // only dead if every path to the exit goes through such an overwrite.
+        BasicBlock *BB = Inst->getParent(), *KillBB = UseInst->getParent();
+        if (KillBB == BB ? DT->dominates(Inst, UseInst)
+                         : PDT->dominates(KillBB, BB))
+          Killed = true;
+        continue;
+      }
+    }
+
+    PushUsers(MA);
+  }
+
+  return Killed || ToLocalObject;
+}
+
+/// eliminateDeadStoresAcrossBlocks - Remove the stores that are dead because
+/// they are overwritten, or their stack object dies, in another block.  The
+/// per-block pass above only looks at the memory dependencies of each store
+/// within its own block, while this walks MemorySSA over the whole function
+/// with a bound on the work done for each store and for the function.
+bool DSE::eliminateDeadStoresAcrossBlocks(Function &F) {
+  const DataLayout &DL = F.getParent()->getDataLayout();
+  PDT = &getAnalysis<PostDominatorTreeWrapperPass>().getPostDomTree();
+  MemorySSA MSSAImpl(F);
+  std::unique_ptr<MemorySSAWalker> Walker(MSSAImpl.buildMemorySSA(AA, DT));
+  MSSA = &MSSAImpl;
+
+  SmallVector<Instruction *, 32> Candidates;
+  for (BasicBlock &BB : F)
+    if (DT->isReachableFromEntry(&BB))
+      for (Instruction &I : BB)
+        if (hasMemoryWrite(&I, *TLI) && isRemovable(&I))
+          Candidates.push_back(&I);
+
+  bool MadeChange = false;
+  // Keep the walks linear in the number of stores of the function.
+  unsigned Budget = MemorySSABudget * Candidates.size();
+  for (Instruction *Inst : Candidates) {
+    if (Budget == 0)
+      break;
+
+    MemoryLocation Loc = getLocForWrite(Inst, *AA);
+    if (!Loc.Ptr || Loc.Size == MemoryLocation::UnknownSize)
+      continue;
+
+    // Stores to allocas and byval or inalloca arguments are dead at the end of
+    // the function, as in handleEndBlock.
+    SmallVector<Value *, 4> Pointers;
+    GetUnderlyingObjects(getStoredPointerOperand(Inst), Pointers, DL);
+    bool ToLocalObject = std::all_of(Pointers.begin(), Pointers.end(),
+                                     [](Value *V) {
+      if (Argument *A = dyn_cast<Argument>(V))
+        return A->hasByValOrInAllocaAttr();
+      return isa<AllocaInst>(V);
+    });
+
+    if (!isDeadAcrossBlocks(Inst, Loc, ToLocalObject, Budget))
+      continue;
+
+    DEBUG(dbgs() << "DSE: Remove Dead Store Across Blocks:\n  DEAD: " << *Inst
+                 << '\n');
+    DeleteDeadInstruction(Inst, *MD, *TLI, nullptr, MSSA);
+    ++NumFastStores;
+    ++NumMemorySSAStores;
+    MadeChange = true;
+  }
+
+  Walker.reset();
+  MSSA = nullptr;
+  PDT = nullptr;
+  return MadeChange;
+}
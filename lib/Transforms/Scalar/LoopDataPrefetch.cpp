@@ -16,6 +16,7 @@
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
 #include "llvm/Analysis/CodeMetrics.h"
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/LoopInfo.h"
@@ -43,7 +44,20 @@ static cl::opt<bool>
 PrefetchWrites("loop-prefetch-writes", cl::Hidden, cl::init(false),
                cl::desc("Prefetch write addresses"));
 
+static cl::opt<bool>
+PrefetchIndirect("loop-prefetch-indirect", cl::Hidden, cl::init(true),
+                 cl::desc("Prefetch indirect accesses like a[b[i]]"));
+
+static cl::opt<bool>
+PrefetchPointerChase("loop-prefetch-pointer-chase", cl::Hidden,
+                     cl::init(true),
+                     cl::desc("Prefetch the next node of linked data "
+                              "structures traversed by a loop"));
+
 STATISTIC(NumPrefetches, "Number of prefetches inserted");
+STATISTIC(NumIndirectPrefetches, "Number of indirect prefetches inserted");
+STATISTIC(NumPointerChasePrefetches,
+          "Number of pointer chasing prefetches inserted");
 
 namespace llvm {
   void initializeLoopDataPrefetchPass(PassRegistry&);
@@ -60,6 +74,8 @@ namespace {
 
     void getAnalysisUsage(AnalysisUsage &AU) const override {
       AU.addRequired<AssumptionCacheTracker>();
+      AU.addRequired<BlockFrequencyInfoWrapperPass>();
+      AU.addRequired<DominatorTreeWrapperPass>();
       AU.addPreserved<DominatorTreeWrapperPass>();
       AU.addRequired<LoopInfoWrapperPass>();
       AU.addPreserved<LoopInfoWrapperPass>();
@@ -77,8 +93,23 @@ namespace {
     /// warrant a prefetch.
     bool isStrideLargeEnough(const SCEVAddRecExpr *AR);
 
+    /// \brief Prefetch the address \p PtrSCEV of the indirect access \p MemI
+    /// \p ItersAhead iterations ahead.
+    bool prefetchIndirect(Loop *L, Instruction *MemI, const SCEV *PtrSCEV,
+                          unsigned ItersAhead);
+
+    /// \brief Prefetch the next node of a linked data structure that \p L
+    /// walks through.
+    bool prefetchPointerChase(Loop *L);
+
+    /// \returns the average number of iterations per entry of \p L according
+    /// to the profile, or None if there is no profile.
+    Optional<uint64_t> getProfileTripCount(Loop *L);
+
   private:
     AssumptionCache *AC;
+    BlockFrequencyInfo *BFI;
+    DominatorTree *DT;
     LoopInfo *LI;
     ScalarEvolution *SE;
     const TargetTransformInfo *TTI;
@@ -90,6 +121,8 @@ char LoopDataPrefetch::ID = 0;
 INITIALIZE_PASS_BEGIN(LoopDataPrefetch, "loop-data-prefetch",
                       "Loop Data Prefetch", false, false)
 INITIALIZE_PASS_DEPENDENCY(AssumptionCacheTracker)
+INITIALIZE_PASS_DEPENDENCY(BlockFrequencyInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(TargetTransformInfoWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(ScalarEvolutionWrapperPass)
@@ -114,11 +147,205 @@ bool LoopDataPrefetch::isStrideLargeEnough(const SCEVAddRecExpr *AR) {
   return TargetMinStride <= AbsStride;
 }
 
+/// \brief Insert a call to llvm.prefetch of \p PrefPtrValue before \p InsertPt.
+static void insertPrefetch(Value *PrefPtrValue, bool IsWrite,
+                           Instruction *InsertPt) {
+  IRBuilder<> Builder(InsertPt);
+  Module *M = InsertPt->getModule();
+  Type *I32 = Builder.getInt32Ty();
+  Value *PrefetchFunc = Intrinsic::getDeclaration(M, Intrinsic::prefetch);
+  Builder.CreateCall(PrefetchFunc,
+                     {PrefPtrValue, ConstantInt::get(I32, IsWrite),
+                      ConstantInt::get(I32, 3), ConstantInt::get(I32, 1)});
+  ++NumPrefetches;
+}
+
+namespace {
+/// Finds the load that the address of an indirect access like a[b[i]] is
+/// computed from, i.e. the only value of the loop that the address depends
+/// on.
+struct FindIndexLoad {
+  const Loop *L;
+  LoadInst *IndexLoad;
+  bool Invalid;
+
+  FindIndexLoad(const Loop *L) : L(L), IndexLoad(nullptr), Invalid(false) {}
+
+  bool follow(const SCEV *S) {
+    if (const auto *AR = dyn_cast<SCEVAddRecExpr>(S))
+      if (AR->getLoop() == L)
+        Invalid = true;
+    if (const auto *U = dyn_cast<SCEVUnknown>(S)) {
+      auto *I = dyn_cast<Instruction>(U->getValue());
+      if (I && L->contains(I)) {
+        auto *Load = dyn_cast<LoadInst>(I);
+        if (!Load || (IndexLoad && IndexLoad != Load))
+          Invalid = true;
+        IndexLoad = Load;
+      }
+    }
+    return !Invalid;
+  }
+  bool isDone() const { return Invalid; }
+};
+}
+
+bool LoopDataPrefetch::prefetchIndirect(Loop *L, Instruction *MemI,
+                                        const SCEV *PtrSCEV,
+                                        unsigned ItersAhead) {
+  FindIndexLoad Finder(L);
+  visitAll(PtrSCEV, Finder);
+  LoadInst *IndexLoad = Finder.IndexLoad;
+  if (Finder.Invalid || !IndexLoad || !IndexLoad->isSimple())
+    return false;
+
+  // The index must be loaded from an affine address.
+  const auto *IndexAR =
+      dyn_cast<SCEVAddRecExpr>(SE->getSCEV(IndexLoad->getPointerOperand()));
+  if (!IndexAR || IndexAR->getLoop() != L || !IndexAR->isAffine())
+    return false;
+
+  // Unlike a prefetch, the load of the index ahead of time may fault. Clamp
+  // it to the last iteration of the loop, which is only safe if the loop
+  // loads the index in every iteration that it starts.
+  SmallVector<BasicBlock *, 4> ExitingBlocks;
+  L->getExitingBlocks(ExitingBlocks);
+  for (BasicBlock *Exiting : ExitingBlocks)
+    if (!DT->dominates(IndexLoad->getParent(), Exiting))
+      return false;
+  const SCEV *BackedgeTakenCount = SE->getBackedgeTakenCount(L);
+  if (isa<SCEVCouldNotCompute>(BackedgeTakenCount))
+    return false;
+
+  const SCEV *Step = IndexAR->getStepRecurrence(*SE);
+  Type *IterTy = Step->getType();
+  if (SE->getTypeSizeInBits(BackedgeTakenCount->getType()) >
+      SE->getTypeSizeInBits(IterTy))
+    return false;
+  const SCEV *AheadIter = SE->getUMinExpr(
+      SE->getAddRecExpr(SE->getConstant(IterTy, ItersAhead),
+                        SE->getConstant(IterTy, 1), L, SCEV::FlagAnyWrap),
+      SE->getNoopOrZeroExtend(BackedgeTakenCount, IterTy));
+  const SCEV *AheadIndexPtr =
+      SE->getAddExpr(IndexAR->getStart(), SE->getMulExpr(AheadIter, Step));
+  if (!isSafeToExpand(AheadIndexPtr, *SE) || !isSafeToExpand(PtrSCEV, *SE))
+    return false;
+
+  SCEVExpander SCEVE(*SE, *DL, "prefaddr");
+  Value *AheadIndexPtrValue = SCEVE.expandCodeFor(
+      AheadIndexPtr, IndexLoad->getPointerOperand()->getType(), MemI);
+  LoadInst *AheadIndex =
+      new LoadInst(AheadIndexPtrValue, "prefidx", false,
+                   IndexLoad->getAlignment(), MemI);
+
+  // Compute the address of the access from the index loaded ahead.
+  ValueToValueMap Map;
+  Map[IndexLoad] = AheadIndex;
+  const SCEV *NextPtrSCEV = SCEVParameterRewriter::rewrite(PtrSCEV, *SE, Map);
+  Type *I8Ptr = Type::getInt8PtrTy(MemI->getContext());
+  Value *PrefPtrValue = SCEVE.expandCodeFor(NextPtrSCEV, I8Ptr, MemI);
+  insertPrefetch(PrefPtrValue, !MemI->mayReadFromMemory(), MemI);
+  ++NumIndirectPrefetches;
+  DEBUG(dbgs() << "  Indirect access: " << *MemI << ", index: " << *IndexLoad
+               << "\n");
+  return true;
+}
+
+bool LoopDataPrefetch::prefetchPointerChase(Loop *L) {
+  BasicBlock *Latch = L->getLoopLatch();
+  if (!Latch)
+    return false;
+
+  bool MadeChange = false;
+  unsigned LineSize = TTI->getCacheLineSize();
+  Type *I8Ptr = Type::getInt8PtrTy(L->getHeader()->getContext());
+  for (BasicBlock::iterator I = L->getHeader()->begin(); isa<PHINode>(I);
+       ++I) {
+    PHINode *Phi = cast<PHINode>(I);
+    if (!Phi->getType()->isPointerTy() ||
+        Phi->getType()->getPointerAddressSpace())
+      continue;
+
+    // The loop has to advance to a node loaded from the current one, as in
+    // "p = p->next".
+    LoadInst *Next = dyn_cast<LoadInst>(Phi->getIncomingValueForBlock(Latch));
+    if (!Next || !L->contains(Next))
+      continue;
+
+    // Collect the cache lines of a node that the loop accesses, as offsets
+    // from the node pointer.
+    const SCEV *PhiSCEV = SE->getSCEV(Phi);
+    SmallVector<std::pair<int64_t, bool>, 4> Lines;
+    bool NextFromNode = false;
+    for (BasicBlock *BB : L->blocks())
+      for (Instruction &MemI : *BB) {
+        Value *PtrValue;
+        if (LoadInst *LMemI = dyn_cast<LoadInst>(&MemI))
+          PtrValue = LMemI->getPointerOperand();
+        else if (StoreInst *SMemI = dyn_cast<StoreInst>(&MemI)) {
+          if (!PrefetchWrites)
+            continue;
+          PtrValue = SMemI->getPointerOperand();
+        } else
+          continue;
+
+        const auto *Offset = dyn_cast<SCEVConstant>(
+            SE->getMinusSCEV(SE->getSCEV(PtrValue), PhiSCEV));
+        if (!Offset)
+          continue;
+        if (&MemI == Next)
+          NextFromNode = true;
+
+        int64_t Off = Offset->getAPInt().getSExtValue();
+        bool DupPref = false;
+        for (auto &Line : Lines)
+          if (std::abs(Line.first - Off) < (int64_t)LineSize) {
+            // Prefetch for reading if any access of the line reads.
+            Line.second &= !MemI.mayReadFromMemory();
+            DupPref = true;
+            break;
+          }
+        if (!DupPref)
+          Lines.push_back(std::make_pair(Off, !MemI.mayReadFromMemory()));
+      }
+    if (!NextFromNode)
+      continue;
+
+    // Only the next node is known, so prefetch it as soon as its address has
+    // been loaded.
+    IRBuilder<> Builder(Next->getNextNode());
+    Value *NextNode = Builder.CreateBitCast(Next, I8Ptr);
+    for (auto &Line : Lines) {
+      Value *PrefPtrValue =
+          Builder.CreateConstGEP1_64(NextNode, Line.first, "prefaddr");
+      insertPrefetch(PrefPtrValue, Line.second, &*Builder.GetInsertPoint());
+      ++NumPointerChasePrefetches;
+    }
+    DEBUG(dbgs() << "  Pointer chase: " << *Next << ", " << Lines.size()
+                 << " lines\n");
+    MadeChange = true;
+  }
+  return MadeChange;
+}
+
+Optional<uint64_t> LoopDataPrefetch::getProfileTripCount(Loop *L) {
+  BasicBlock *Preheader = L->getLoopPreheader();
+  if (!Preheader || !L->getHeader()->getParent()->getEntryCount())
+    return None;
+
+  uint64_t PreheaderFreq = BFI->getBlockFreq(Preheader).getFrequency();
+  if (!PreheaderFreq)
+    return None;
+  return BFI->getBlockFreq(L->getHeader()).getFrequency() / PreheaderFreq;
+}
+
 bool LoopDataPrefetch::runOnFunction(Function &F) {
   LI = &getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
   SE = &getAnalysis<ScalarEvolutionWrapperPass>().getSE();
   DL = &F.getParent()->getDataLayout();
   AC = &getAnalysis<AssumptionCacheTracker>().getAssumptionCache(F);
+  BFI = &getAnalysis<BlockFrequencyInfoWrapperPass>().getBFI();
+  DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
   TTI = &getAnalysis<TargetTransformInfoWrapperPass>().getTTI(F);
 
   // If PrefetchDistance is not set, don't run the pass.  This gives an
@@ -167,6 +394,13 @@ bool LoopDataPrefetch::runOnLoop(Loop *L) {
   if (!LoopSize)
     LoopSize = 1;
 
+  // With a profile, don't bother with loops that usually end before the
+  // prefetched data would be used.
+  Optional<uint64_t> TripCount = getProfileTripCount(L);
+
+  if (PrefetchPointerChase && (!TripCount || *TripCount > 1))
+    MadeChange |= prefetchPointerChase(L);
+
   unsigned ItersAhead = TTI->getPrefetchDistance() / LoopSize;
   if (!ItersAhead)
     ItersAhead = 1;
@@ -174,11 +408,18 @@ bool LoopDataPrefetch::runOnLoop(Loop *L) {
   if (ItersAhead > TTI->getMaxPrefetchIterationsAhead())
     return MadeChange;
 
+  if (TripCount && *TripCount <= ItersAhead) {
+    DEBUG(dbgs() << "Not prefetching " << ItersAhead
+                 << " iterations ahead in a loop with a profile trip count of "
+                 << *TripCount << "\n");
+    return MadeChange;
+  }
+
   DEBUG(dbgs() << "Prefetching " << ItersAhead
                << " iterations ahead (loop size: " << LoopSize << ") in "
                << L->getHeader()->getParent()->getName() << ": " << *L);
 
-  SmallVector<std::pair<Instruction *, const SCEVAddRecExpr *>, 16> PrefLoads;
+  SmallVector<std::pair<Instruction *, const SCEV *>, 16> PrefLoads;
   for (Loop::block_iterator I = L->block_begin(), IE = L->block_end();
        I != IE; ++I) {
     for (BasicBlock::iterator J = (*I)->begin(), JE = (*I)->end();
@@ -204,8 +445,26 @@ bool LoopDataPrefetch::runOnLoop(Loop *L) {
 
       const SCEV *LSCEV = SE->getSCEV(PtrValue);
       const SCEVAddRecExpr *LSCEVAddRec = dyn_cast<SCEVAddRecExpr>(LSCEV);
-      if (!LSCEVAddRec)
+      if (!LSCEVAddRec) {
+        // Try to prefetch an indirect access instead, unless the same cache
+        // line is prefetched already.
+        if (!PrefetchIndirect)
+          continue;
+        bool DupPref = false;
+        for (const auto &PrefLoad : PrefLoads)
+          if (const SCEVConstant *ConstPtrDiff = dyn_cast<SCEVConstant>(
+                  SE->getMinusSCEV(LSCEV, PrefLoad.second)))
+            if (std::abs(ConstPtrDiff->getValue()->getSExtValue()) <
+                (int64_t)TTI->getCacheLineSize()) {
+              DupPref = true;
+              break;
+            }
+        if (!DupPref && prefetchIndirect(L, MemI, LSCEV, ItersAhead)) {
+          PrefLoads.push_back(std::make_pair(MemI, LSCEV));
+          MadeChange = true;
+        }
         continue;
+      }
 
       // Check if the the stride of the accesses is large enough to warrant a
       // prefetch.
@@ -216,7 +475,7 @@ bool LoopDataPrefetch::runOnLoop(Loop *L) {
       // is known to be within one cache line of some other load that has
       // already been prefetched, then don't prefetch this one as well.
       bool DupPref = false;
-      for (SmallVector<std::pair<Instruction *, const SCEVAddRecExpr *>,
+      for (SmallVector<std::pair<Instruction *, const SCEV *>,
              16>::iterator K = PrefLoads.begin(), KE = PrefLoads.end();
            K != KE; ++K) {
         const SCEV *PtrDiff = SE->getMinusSCEV(LSCEVAddRec, K->second);
@@ -244,16 +503,7 @@ bool LoopDataPrefetch::runOnLoop(Loop *L) {
       SCEVExpander SCEVE(*SE, J->getModule()->getDataLayout(), "prefaddr");
       Value *PrefPtrValue = SCEVE.expandCodeFor(NextLSCEV, I8Ptr, MemI);
 
-      IRBuilder<> Builder(MemI);
-      Module *M = (*I)->getParent()->getParent();
-      Type *I32 = Type::getInt32Ty((*I)->getContext());
-      Value *PrefetchFunc = Intrinsic::getDeclaration(M, Intrinsic::prefetch);
-      Builder.CreateCall(
-          PrefetchFunc,
-          {PrefPtrValue,
-           ConstantInt::get(I32, MemI->mayReadFromMemory() ? 0 : 1),
-           ConstantInt::get(I32, 3), ConstantInt::get(I32, 1)});
-      ++NumPrefetches;
+      insertPrefetch(PrefPtrValue, !MemI->mayReadFromMemory(), MemI);
       DEBUG(dbgs() << "  Access: " << *PtrValue << ", SCEV: " << *LSCEV
                    << "\n");
 
@@ -0,0 +1,455 @@
+//===- LoopFuse.cpp - Loop fusion pass ------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass fuses adjacent loops that run the same number of iterations into
+// a single loop, so that the data the first loop brings into the cache is
+// reused by the second one before it is evicted, instead of being streamed
+// from memory twice.
+//
+// Two innermost sibling loops L1 and L2 are fused when:
+//
+//  - they are adjacent: the single exit block of L1 is the preheader of L2,
+//    and it holds nothing but a branch.  Every execution of L1 is then
+//    followed by one of L2, i.e. the loops are control flow equivalent.
+//  - they are rotated, with the latch being the only exiting block, and
+//    ScalarEvolution proves that their backedge-taken counts are the same.
+//  - running iteration i of L2 right after iteration i of L1 keeps every
+//    memory dependence between them.  DependenceAnalysis rules out most
+//    pairs of accesses, and the remaining ones must be affine with the same
+//    stride and a constant distance which does not make an access of L2
+//    reach memory that L1 only writes or reads in a later iteration.
+//  - the cost model finds that the fused loop reuses data between the two
+//    bodies within a few cache lines, that the data touched by L1 would not
+//    stay in the cache until L2 runs, and that the fused loop does not run
+//    more memory streams than the hardware prefetchers can follow.
+//
+// The fused loop is the header and body of L1, followed by the header and
+// body of L2, with the latch of L2 as its only latch and exiting block.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/Local.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "loop-fusion"
+
+STATISTIC(NumFused, "Number of loops fused");
+STATISTIC(NumNotLegal, "Number of adjacent loops that cannot be fused");
+STATISTIC(NumNotProfitable,
+          "Number of adjacent loops not worth fusing");
+
+static cl::opt<unsigned> ReuseLines(
+    "loop-fusion-reuse-lines", cl::init(4), cl::Hidden,
+    cl::desc("The distance in cache lines within which an access of the "
+             "second loop reuses the data of an access of the first one"));
+
+static cl::opt<unsigned> CacheBytes(
+    "loop-fusion-cache-bytes", cl::init(256 * 1024), cl::Hidden,
+    cl::desc("The number of bytes the first loop may touch and still find "
+             "them in the cache in the second loop, so that fusing the "
+             "loops gains nothing"));
+
+static cl::opt<unsigned> MaxStreams(
+    "loop-fusion-max-streams", cl::init(16), cl::Hidden,
+    cl::desc("The maximum number of distinct objects accessed by a fused "
+             "loop"));
+
+// Maximum number of memory accesses in a loop, to bound the number of
+// dependence queries.
+static const unsigned MaxMemAccesses = 64;
+
+namespace {
+
+/// A load or store in a loop, with its address as an affine function of the
+/// iteration number when ScalarEvolution can express it so.
+struct MemAccess {
+  Instruction *Inst;
+  const Value *Object;
+  const SCEV *Start; // null if the address is not affine.
+  int64_t Stride;
+  uint64_t Size;
+  bool IsWrite;
+};
+
+typedef SmallVector<MemAccess, 16> MemAccessList;
+
+struct LoopFuse : public FunctionPass {
+  static char ID;
+  ScalarEvolution *SE;
+  LoopInfo *LI;
+  DependenceAnalysis *DA;
+  DominatorTree *DT;
+  const TargetTransformInfo *TTI;
+
+  LoopFuse()
+      : FunctionPass(ID), SE(nullptr), LI(nullptr), DA(nullptr), DT(nullptr),
+        TTI(nullptr) {
+    initializeLoopFusePass(*PassRegistry::getPassRegistry());
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<ScalarEvolutionWrapperPass>();
+    AU.addRequired<AAResultsWrapperPass>();
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.addRequired<DependenceAnalysis>();
+    AU.addRequired<TargetTransformInfoWrapperPass>();
+    AU.addRequiredID(LoopSimplifyID);
+    AU.addRequiredID(LCSSAID);
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  bool fuseSiblings(Loop *Parent);
+  Loop *findAdjacentLoop(Loop *L1, const std::vector<Loop *> &Siblings);
+  bool isCandidate(Loop *L);
+  bool collectAccesses(Loop *L, MemAccessList &Accesses);
+  bool isLegal(Loop *L1, Loop *L2, const MemAccessList &Accesses1,
+               const MemAccessList &Accesses2);
+  bool isProfitable(Loop *L1, const MemAccessList &Accesses1,
+                    const MemAccessList &Accesses2);
+  void fuse(Function &F, Loop *L1, Loop *L2);
+};
+
+} // end anonymous namespace
+
+/// isCandidate - Return true if L has the shape the fusion relies on: an
+/// innermost loop in simplified form whose latch is its only exiting block.
+bool LoopFuse::isCandidate(Loop *L) {
+  if (!L->empty() || !L->getLoopPreheader() || !L->getExitBlock())
+    return false;
+  BasicBlock *Latch = L->getLoopLatch();
+  if (!Latch || L->getExitingBlock() != Latch)
+    return false;
+  BranchInst *BI = dyn_cast<BranchInst>(Latch->getTerminator());
+  if (!BI || !BI->isConditional())
+    return false;
+  return !isa<SCEVCouldNotCompute>(SE->getBackedgeTakenCount(L));
+}
+
+/// findAdjacentLoop - Return the sibling of L1 which directly follows it, if
+/// there is nothing but a branch between them.
+Loop *LoopFuse::findAdjacentLoop(Loop *L1,
+                                 const std::vector<Loop *> &Siblings) {
+  BasicBlock *Exit = L1->getExitBlock();
+  if (!Exit || &Exit->front() != Exit->getTerminator())
+    return nullptr;
+  for (Loop *L2 : Siblings)
+    if (L2 != L1 && L2->getLoopPreheader() == Exit)
+      return L2;
+  return nullptr;
+}
+
+/// collectAccesses - Collect the loads and stores of L, with their addresses
+/// as a start and a stride per iteration when they are affine.  Return false
+/// if L has other instructions that touch memory or has too many accesses.
+bool LoopFuse::collectAccesses(Loop *L, MemAccessList &Accesses) {
+  const DataLayout &DL = L->getHeader()->getModule()->getDataLayout();
+  for (BasicBlock *BB : L->blocks()) {
+    for (Instruction &I : *BB) {
+      if (!I.mayReadFromMemory() && !I.mayHaveSideEffects())
+        continue;
+
+      Value *Ptr;
+      Type *AccessTy;
+      if (LoadInst *LdI = dyn_cast<LoadInst>(&I)) {
+        if (!LdI->isSimple())
+          return false;
+        Ptr = LdI->getPointerOperand();
+        AccessTy = LdI->getType();
+      } else if (StoreInst *StI = dyn_cast<StoreInst>(&I)) {
+        if (!StI->isSimple())
+          return false;
+        Ptr = StI->getPointerOperand();
+        AccessTy = StI->getValueOperand()->getType();
+      } else {
+        DEBUG(dbgs() << "LoopFuse: Cannot fuse around " << I << "\n");
+        return false;
+      }
+
+      if (Accesses.size() == MaxMemAccesses)
+        return false;
+
+      MemAccess Access = {&I, GetUnderlyingObject(Ptr, DL), nullptr, 0,
+                          DL.getTypeStoreSize(AccessTy), isa<StoreInst>(I)};
+      const SCEV *PtrSCEV = SE->getSCEV(Ptr);
+      if (SE->isLoopInvariant(PtrSCEV, L)) {
+        Access.Start = PtrSCEV;
+      } else if (auto *AR = dyn_cast<SCEVAddRecExpr>(PtrSCEV)) {
+        auto *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+        if (AR->isAffine() && AR->getLoop() == L && Step) {
+          Access.Start = AR->getStart();
+          Access.Stride = Step->getAPInt().getSExtValue();
+        }
+      }
+      Accesses.push_back(Access);
+    }
+  }
+  return true;
+}
+
+/// isLegal - Return true if running the iterations of L2 interleaved with the
+/// ones of L1 keeps all the memory dependences between them.
+bool LoopFuse::isLegal(Loop *L1, Loop *L2, const MemAccessList &Accesses1,
+                       const MemAccessList &Accesses2) {
+  // The loops must run the same iterations, so that the addresses of both
+  // in iteration i of the fused loop are the ones of their iteration i.
+  if (SE->getBackedgeTakenCount(L1) != SE->getBackedgeTakenCount(L2)) {
+    DEBUG(dbgs() << "LoopFuse: Trip counts differ\n");
+    return false;
+  }
+
+  for (const MemAccess &A1 : Accesses1) {
+    for (const MemAccess &A2 : Accesses2) {
+      if (!A1.IsWrite && !A2.IsWrite)
+        continue;
+      if (!DA->depends(A1.Inst, A2.Inst, true))
+        continue;
+
+      // In the fused loop iteration i of L2 runs before iteration j > i of
+      // L1, so A2 in iteration i must not touch what A1 touches in any later
+      // iteration.  With the same stride, A1 moves away from A2 one stride
+      // per iteration, so it is enough to check the next iteration.
+      if (!A1.Start || !A2.Start || A1.Stride != A2.Stride) {
+        DEBUG(dbgs() << "LoopFuse: Unknown dependence between " << *A1.Inst
+                     << " and " << *A2.Inst << "\n");
+        return false;
+      }
+      auto *Dist =
+          dyn_cast<SCEVConstant>(SE->getMinusSCEV(A1.Start, A2.Start));
+      if (!Dist) {
+        DEBUG(dbgs() << "LoopFuse: Unknown distance between " << *A1.Inst
+                     << " and " << *A2.Inst << "\n");
+        return false;
+      }
+      int64_t D = Dist->getAPInt().getSExtValue();
+      int64_t Stride = A1.Stride;
+      int64_t Size1 = A1.Size, Size2 = A2.Size;
+      bool AheadOfA2 = Stride >= 0 && D + Stride >= Size2;
+      bool BehindA2 = Stride <= 0 && D + Stride + Size1 <= 0;
+      if (!AheadOfA2 && !BehindA2) {
+        DEBUG(dbgs() << "LoopFuse: Fusion would reverse the dependence "
+                     << "between " << *A1.Inst << " and " << *A2.Inst
+                     << "\n");
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// isProfitable - Return true if fusing the loops lets the second one reuse,
+/// from the cache, data the first one brought from memory.
+bool LoopFuse::isProfitable(Loop *L1, const MemAccessList &Accesses1,
+                            const MemAccessList &Accesses2) {
+  unsigned LineSize = TTI->getCacheLineSize();
+  if (!LineSize)
+    LineSize = 64;
+  int64_t ReuseDistance = (int64_t)ReuseLines * LineSize;
+
+  // Count the accesses of the second loop that touch data near what the first
+  // loop touches in the same iteration.
+  unsigned Reused = 0;
+  for (const MemAccess &A2 : Accesses2) {
+    for (const MemAccess &A1 : Accesses1) {
+      if (A1.Object != A2.Object || !A1.Start || !A2.Start ||
+          A1.Stride != A2.Stride)
+        continue;
+      auto *Dist =
+          dyn_cast<SCEVConstant>(SE->getMinusSCEV(A1.Start, A2.Start));
+      if (Dist && std::abs(Dist->getAPInt().getSExtValue()) <= ReuseDistance) {
+        ++Reused;
+        break;
+      }
+    }
+  }
+  if (!Reused) {
+    DEBUG(dbgs() << "LoopFuse: No reuse between the loops\n");
+    return false;
+  }
+
+  // If everything the first loop touches fits in the cache, the second loop
+  // finds it there anyway.
+  if (auto *BTC = dyn_cast<SCEVConstant>(SE->getBackedgeTakenCount(L1))) {
+    uint64_t TripCount = BTC->getAPInt().getZExtValue() + 1;
+    uint64_t Footprint = 0;
+    for (const MemAccess &A1 : Accesses1)
+      Footprint += TripCount * std::abs(A1.Stride) + A1.Size;
+    if (Footprint <= CacheBytes) {
+      DEBUG(dbgs() << "LoopFuse: The first loop touches " << Footprint
+                   << " bytes, which stay in the cache\n");
+      return false;
+    }
+  }
+
+  // Too many streams defeat the hardware prefetchers and thrash the cache.
+  SmallPtrSet<const Value *, 16> Streams;
+  for (const MemAccess &A : Accesses1)
+    Streams.insert(A.Object);
+  for (const MemAccess &A : Accesses2)
+    Streams.insert(A.Object);
+  if (Streams.size() > MaxStreams) {
+    DEBUG(dbgs() << "LoopFuse: The fused loop would access " << Streams.size()
+                 << " objects\n");
+    return false;
+  }
+
+  DEBUG(dbgs() << "LoopFuse: " << Reused << " accesses reuse data\n");
+  return true;
+}
+
+/// fuse - Make the body of L2 part of the body of L1, right after it, and
+/// remove L2.
+void LoopFuse::fuse(Function &F, Loop *L1, Loop *L2) {
+  BasicBlock *Preheader1 = L1->getLoopPreheader();
+  BasicBlock *Header1 = L1->getHeader();
+  BasicBlock *Latch1 = L1->getLoopLatch();
+  BasicBlock *Between = L1->getExitBlock();
+  BasicBlock *Header2 = L2->getHeader();
+  BasicBlock *Latch2 = L2->getLoopLatch();
+
+  SE->forgetLoop(L1);
+  SE->forgetLoop(L2);
+
+  // The phis of both headers merge in the header of the fused loop, which is
+  // entered from the preheader of L1 and continued from the latch of L2.
+  // Their incoming values from before the loops dominate the preheader of L1,
+  // since the block in between holds nothing.
+  for (BasicBlock::iterator I = Header1->begin(); isa<PHINode>(I); ++I) {
+    PHINode *PN = cast<PHINode>(I);
+    PN->setIncomingBlock(PN->getBasicBlockIndex(Latch1), Latch2);
+  }
+  while (PHINode *PN = dyn_cast<PHINode>(&Header2->front())) {
+    PN->setIncomingBlock(PN->getBasicBlockIndex(Between), Preheader1);
+    PN->moveBefore(Header1->getFirstNonPHI());
+  }
+
+  // The latch of L1 falls through to the body of L2, and the latch of L2
+  // takes over the exit test, which is the same for both loops.
+  BranchInst *Branch1 = cast<BranchInst>(Latch1->getTerminator());
+  Value *Cond1 = Branch1->getCondition();
+  BranchInst::Create(Header2, Branch1);
+  Branch1->eraseFromParent();
+  RecursivelyDeleteTriviallyDeadInstructions(Cond1);
+
+  BranchInst *Branch2 = cast<BranchInst>(Latch2->getTerminator());
+  for (unsigned i = 0, e = Branch2->getNumSuccessors(); i != e; ++i)
+    if (Branch2->getSuccessor(i) == Header2)
+      Branch2->setSuccessor(i, Header1);
+
+  // Nothing branches to the block in between anymore.
+  Between->getTerminator()->eraseFromParent();
+  LI->removeBlock(Between);
+  Between->eraseFromParent();
+
+  // Move the blocks of L2 into L1, and drop L2.
+  for (BasicBlock *BB : L2->blocks()) {
+    L1->addBlockEntry(BB);
+    LI->changeLoopFor(BB, L1);
+  }
+  if (Loop *Parent = L2->getParentLoop())
+    Parent->removeChildLoop(std::find(Parent->begin(), Parent->end(), L2));
+  else
+    LI->removeLoop(std::find(LI->begin(), LI->end(), L2));
+  delete L2;
+
+  MergeBlockIntoPredecessor(Header2, nullptr, LI);
+  DT->recalculate(F);
+}
+
+bool LoopFuse::fuseSiblings(Loop *Parent) {
+  bool Changed = false;
+  bool Fused;
+  do {
+    Fused = false;
+    std::vector<Loop *> Siblings =
+        Parent ? Parent->getSubLoops() : std::vector<Loop *>(LI->begin(),
+                                                             LI->end());
+    for (Loop *L1 : Siblings) {
+      Loop *L2 = findAdjacentLoop(L1, Siblings);
+      if (!L2 || !isCandidate(L1) || !isCandidate(L2))
+        continue;
+
+      DEBUG(dbgs() << "LoopFuse: Trying to fuse " << *L1 << "  with " << *L2);
+      MemAccessList Accesses1, Accesses2;
+      if (!collectAccesses(L1, Accesses1) || !collectAccesses(L2, Accesses2) ||
+          !isLegal(L1, L2, Accesses1, Accesses2)) {
+        ++NumNotLegal;
+        continue;
+      }
+      if (!isProfitable(L1, Accesses1, Accesses2)) {
+        ++NumNotProfitable;
+        continue;
+      }
+
+      fuse(*L1->getHeader()->getParent(), L1, L2);
+      ++NumFused;
+      Fused = Changed = true;
+      break;
+    }
+  } while (Fused);
+
+  // Look for siblings deeper in the loop nest.
+  std::vector<Loop *> Children =
+      Parent ? Parent->getSubLoops() : std::vector<Loop *>(LI->begin(),
+                                                           LI->end());
+  for (Loop *L : Children)
+    Changed |= fuseSiblings(L);
+  return Changed;
+}
+
+bool LoopFuse::runOnFunction(Function &F) {
+  if (skipOptnoneFunction(F))
+    return false;
+
+  SE = &getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+  LI = &getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  DA = &getAnalysis<DependenceAnalysis>();
+  DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  TTI = &getAnalysis<TargetTransformInfoWrapperPass>().getTTI(F);
+
+  return fuseSiblings(nullptr);
+}
+
+char LoopFuse::ID = 0;
+INITIALIZE_PASS_BEGIN(LoopFuse, "loop-fusion", "Fuse adjacent loops", false,
+                      false)
+INITIALIZE_PASS_DEPENDENCY(AAResultsWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(DependenceAnalysis)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolutionWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(LoopSimplify)
+INITIALIZE_PASS_DEPENDENCY(LCSSA)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(TargetTransformInfoWrapperPass)
+INITIALIZE_PASS_END(LoopFuse, "loop-fusion", "Fuse adjacent loops", false,
+                    false)
+
+FunctionPass *llvm::createLoopFusePass() { return new LoopFuse(); }
@@ -0,0 +1,558 @@
+//===- LoopTile.cpp - Loop tiling pass ------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass tiles perfectly nested loops for the data cache.  A band of
+// nested loops L1 ... Ld, each of which runs an induction variable i from a
+// start S to a bound N by steps of 1, becomes:
+//
+//   for (ii1 = S1; ii1 < N1; ii1 += T1)      // tile loops
+//     ...
+//       for (iid = Sd; iid < Nd; iid += Td)
+//         for (i1 = ii1; i1 < min(ii1 + T1, N1); i1++)   // the original loops
+//           ...
+//             for (id = iid; id < min(iid + Td, Nd); id++)
+//               body;
+//
+// so that the body runs over one block of the iteration space at a time, and
+// the data it touches in a block stays in the cache while it is reused.
+//
+// The tile sizes come from the llvm.loop.tile.size metadata of the loops, or
+// from a cache model: the largest square tile such that one tile of every
+// array accessed in the band fits in the data cache, as described by the
+// TargetTransformInfo cache size and associativity.
+//
+// Tiling runs the iterations of the band in a different order, which is only
+// legal when it keeps all dependences: DependenceAnalysis must show that in
+// the band, the direction of every dependence is either "<=" or ">=" at every
+// level, so that it stays lexicographically positive in any interleaving of
+// the levels.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/DependenceAnalysis.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include "llvm/Transforms/Utils/UnrollLoop.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "loop-tile"
+
+STATISTIC(NumTiledBands, "Number of loop bands tiled");
+STATISTIC(NumTiledLoops, "Number of loops tiled");
+STATISTIC(NumNotLegal, "Number of loop bands that cannot be tiled");
+
+static cl::opt<unsigned> TileSize(
+    "loop-tile-size", cl::init(0), cl::Hidden,
+    cl::desc("Use this tile size for every loop, instead of the one of the "
+             "cache model"));
+
+static cl::opt<unsigned> TileCacheLevel(
+    "loop-tile-cache-level", cl::init(1), cl::Hidden,
+    cl::desc("The level of the data cache, 1 or 2, the tiles should fit in"));
+
+// Maximum number of loops tiled together.
+static const unsigned MaxBandDepth = 4;
+
+// Maximum number of memory accesses in a band, to bound the number of
+// dependence queries.
+static const unsigned MaxMemAccesses = 64;
+
+namespace {
+
+/// A loop of a band, with the induction variable it runs from Start to Bound.
+struct BandLoop {
+  Loop *L;
+  PHINode *IndVar;
+  Value *Start;
+  Value *Bound;
+  ICmpInst *ExitCmp;
+  unsigned BoundIdx; // The operand of ExitCmp that is the bound.
+  unsigned TileSize;
+};
+
+typedef SmallVector<BandLoop, 4> LoopBand;
+
+struct LoopTile : public FunctionPass {
+  static char ID;
+  ScalarEvolution *SE;
+  LoopInfo *LI;
+  DependenceAnalysis *DA;
+  DominatorTree *DT;
+  const TargetTransformInfo *TTI;
+
+  LoopTile()
+      : FunctionPass(ID), SE(nullptr), LI(nullptr), DA(nullptr), DT(nullptr),
+        TTI(nullptr) {
+    initializeLoopTilePass(*PassRegistry::getPassRegistry());
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<ScalarEvolutionWrapperPass>();
+    AU.addRequired<AAResultsWrapperPass>();
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.addRequired<DependenceAnalysis>();
+    AU.addRequired<TargetTransformInfoWrapperPass>();
+    AU.addRequiredID(LoopSimplifyID);
+    AU.addRequiredID(LCSSAID);
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  bool processLoop(Loop *L);
+  bool analyzeLoop(Loop *L, Loop *Outermost, BandLoop &BL);
+  void findBand(Loop *L, LoopBand &Band);
+  bool isLegal(LoopBand &Band, SmallVectorImpl<Instruction *> &MemInsts);
+  unsigned chooseTileSize(LoopBand &Band,
+                          SmallVectorImpl<Instruction *> &MemInsts);
+  void tile(LoopBand &Band);
+};
+
+} // end anonymous namespace
+
+/// getLoopTileMetadata - Return the value of the llvm.loop.tile metadata Name
+/// of L, or Default if it has none.
+static unsigned getLoopTileMetadata(Loop *L, StringRef Name, unsigned Default) {
+  MDNode *LoopID = L->getLoopID();
+  if (!LoopID)
+    return Default;
+  MDNode *MD = GetUnrollMetadata(LoopID, Name);
+  if (!MD)
+    return Default;
+  if (MD->getNumOperands() < 2)
+    return 1;
+  ConstantInt *Count = mdconst::extract_or_null<ConstantInt>(MD->getOperand(1));
+  return Count ? Count->getZExtValue() : Default;
+}
+
+/// analyzeLoop - Check that L is a loop in simplified and rotated form which
+/// steps its only header phi by 1 up to a bound that, like its start, is
+/// invariant in the outermost loop of the band, and fill in BL.
+bool LoopTile::analyzeLoop(Loop *L, Loop *Outermost, BandLoop &BL) {
+  BasicBlock *Header = L->getHeader();
+  BasicBlock *Preheader = L->getLoopPreheader();
+  BasicBlock *Latch = L->getLoopLatch();
+  if (!Preheader || !Latch || L->getExitingBlock() != Latch ||
+      !L->getExitBlock())
+    return false;
+
+  // The induction variable must be the only phi: other header phis carry
+  // values across iterations that tiling would run in another order.
+  PHINode *IndVar = dyn_cast<PHINode>(&Header->front());
+  if (!IndVar || !IndVar->getType()->isIntegerTy() ||
+      isa<PHINode>(IndVar->getNextNode()))
+    return false;
+
+  Value *Start = IndVar->getIncomingValueForBlock(Preheader);
+  auto *Inc = dyn_cast<BinaryOperator>(IndVar->getIncomingValueForBlock(Latch));
+  if (!Outermost->isLoopInvariant(Start) || !Inc ||
+      Inc->getOpcode() != Instruction::Add || Inc->getOperand(0) != IndVar)
+    return false;
+  auto *Step = dyn_cast<ConstantInt>(Inc->getOperand(1));
+  if (!Step || !Step->isOne())
+    return false;
+
+  // The latch must compare the incremented variable against the bound with a
+  // predicate that only changes once the bound is reached.
+  BranchInst *BI = dyn_cast<BranchInst>(Latch->getTerminator());
+  if (!BI || !BI->isConditional())
+    return false;
+  ICmpInst *Cmp = dyn_cast<ICmpInst>(BI->getCondition());
+  if (!Cmp || !Cmp->hasOneUse())
+    return false;
+  unsigned BoundIdx = Cmp->getOperand(0) == Inc ? 1 : 0;
+  Value *Bound = Cmp->getOperand(BoundIdx);
+  if (Cmp->getOperand(1 - BoundIdx) != Inc ||
+      !Outermost->isLoopInvariant(Bound))
+    return false;
+  ICmpInst::Predicate Pred = BoundIdx ? Cmp->getPredicate()
+                                      : Cmp->getSwappedPredicate();
+  switch (Pred) {
+  case ICmpInst::ICMP_EQ:
+  case ICmpInst::ICMP_NE:
+    break;
+  case ICmpInst::ICMP_SLT:
+  case ICmpInst::ICMP_ULT:
+    // A rotated loop runs once even when the start is past the bound, which
+    // a tile loop would not reproduce.
+    if (!SE->isKnownPredicate(Pred, SE->getSCEV(Start), SE->getSCEV(Bound)))
+      return false;
+    break;
+  default:
+    return false;
+  }
+  bool ContinuesOnTrue = Pred != ICmpInst::ICMP_EQ;
+  if ((BI->getSuccessor(0) == Header) != ContinuesOnTrue)
+    return false;
+
+  BL.L = L;
+  BL.IndVar = IndVar;
+  BL.Start = Start;
+  BL.Bound = Bound;
+  BL.ExitCmp = Cmp;
+  BL.BoundIdx = BoundIdx;
+  BL.TileSize = getLoopTileMetadata(L, "llvm.loop.tile.size", 0);
+  return true;
+}
+
+/// findBand - Collect in Band the perfectly nested loops starting at L that
+/// can be tiled together.  All the loops but the innermost one hold nothing
+/// but their only subloop and code without side effects.
+void LoopTile::findBand(Loop *L, LoopBand &Band) {
+  Loop *Outermost = L;
+  while (Band.size() < MaxBandDepth) {
+    if (getLoopTileMetadata(L, "llvm.loop.tile.disable", 0))
+      return;
+    BandLoop BL;
+    if (!analyzeLoop(L, Outermost, BL))
+      return;
+    // A tile size of 1 keeps the loop, and the loops inside it, untiled.
+    if (BL.TileSize == 1)
+      return;
+    Band.push_back(BL);
+
+    if (L->getSubLoops().size() != 1)
+      return;
+    Loop *Inner = L->getSubLoops()[0];
+    for (BasicBlock *BB : L->blocks()) {
+      if (Inner->contains(BB))
+        continue;
+      for (Instruction &I : *BB)
+        if ((isa<PHINode>(I) && &I != BL.IndVar) || I.mayReadFromMemory() ||
+            I.mayHaveSideEffects())
+          return;
+    }
+    L = Inner;
+  }
+}
+
+/// isLegal - Return true if tiling Band keeps the memory dependences of the
+/// loops, and collect their memory accesses in MemInsts.
+bool LoopTile::isLegal(LoopBand &Band,
+                       SmallVectorImpl<Instruction *> &MemInsts) {
+  Loop *Outermost = Band.front().L;
+  for (BasicBlock *BB : Outermost->blocks())
+    for (Instruction &I : *BB) {
+      if (!I.mayReadFromMemory() && !I.mayHaveSideEffects())
+        continue;
+      if (!isa<LoadInst>(I) && !isa<StoreInst>(I)) {
+        DEBUG(dbgs() << "LoopTile: Cannot tile around " << I << "\n");
+        return false;
+      }
+      if (MemInsts.size() == MaxMemAccesses)
+        return false;
+      MemInsts.push_back(&I);
+    }
+
+  // Values computed in the band must not be used after it: the last
+  // iteration of the loops is not the last one to run anymore.
+  BasicBlock *Exit = Outermost->getExitBlock();
+  if (isa<PHINode>(Exit->front()))
+    return false;
+
+  unsigned FirstLevel = Outermost->getLoopDepth();
+  unsigned LastLevel = FirstLevel + Band.size() - 1;
+  for (unsigned i = 0, e = MemInsts.size(); i != e; ++i) {
+    for (unsigned j = i; j != e; ++j) {
+      Instruction *Src = MemInsts[i], *Dst = MemInsts[j];
+      if (!isa<StoreInst>(Src) && !isa<StoreInst>(Dst))
+        continue;
+      auto D = DA->depends(Src, Dst, true);
+      if (!D)
+        continue;
+      if (D->isConfused() || D->getLevels() < LastLevel) {
+        DEBUG(dbgs() << "LoopTile: Unknown dependence between " << *Src
+                     << " and " << *Dst << "\n");
+        return false;
+      }
+      // Tiling keeps a dependence whose distance is non-negative in all the
+      // loops of the band, or non-positive in all of them.  The directions
+      // are a set per loop, e.g. * for a loop that doesn't index the access,
+      // so it only breaks one if a loop may go forward while another one
+      // goes backward.
+      unsigned LTMask = 0, GTMask = 0;
+      for (unsigned Level = FirstLevel; Level <= LastLevel; ++Level) {
+        unsigned Dir = D->getDirection(Level);
+        if (Dir & Dependence::DVEntry::LT)
+          LTMask |= 1U << (Level - FirstLevel);
+        if (Dir & Dependence::DVEntry::GT)
+          GTMask |= 1U << (Level - FirstLevel);
+      }
+      if (LTMask && GTMask &&
+          !(LTMask == GTMask && isPowerOf2_32(LTMask))) {
+        DEBUG(dbgs() << "LoopTile: Tiling would reverse the dependence "
+                     << "between " << *Src << " and " << *Dst << "\n");
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// chooseTileSize - Return the largest power of two T such that a T x T tile
+/// of every object accessed in the band fits in the data cache, or 0 if the
+/// band needs no tiling.
+unsigned LoopTile::chooseTileSize(LoopBand &Band,
+                                  SmallVectorImpl<Instruction *> &MemInsts) {
+  if (TileSize)
+    return TileSize;
+
+  TargetTransformInfo::CacheLevel Level = TileCacheLevel == 2
+                                              ? TargetTransformInfo::CL_L2D
+                                              : TargetTransformInfo::CL_L1D;
+  uint64_t CacheSize = TTI->getCacheSize(Level);
+  unsigned Assoc = TTI->getCacheAssociativity(Level);
+  unsigned LineSize = TTI->getCacheLineSize();
+  if (!CacheSize)
+    return 0;
+
+  // Leave one way for the other data of the loops and for the conflicts
+  // between the tiles.
+  uint64_t Usable = Assoc > 1 ? CacheSize / Assoc * (Assoc - 1) : CacheSize / 2;
+
+  const DataLayout &DL = Band.front().L->getHeader()->getModule()
+                             ->getDataLayout();
+  SmallPtrSet<const Value *, 8> Objects;
+  uint64_t ElemSize = 1;
+  for (Instruction *I : MemInsts) {
+    Value *Ptr = isa<LoadInst>(I) ? cast<LoadInst>(I)->getPointerOperand()
+                                  : cast<StoreInst>(I)->getPointerOperand();
+    Type *Ty = cast<PointerType>(Ptr->getType())->getElementType();
+    ElemSize = std::max<uint64_t>(ElemSize, DL.getTypeStoreSize(Ty));
+    Objects.insert(GetUnderlyingObject(Ptr, DL));
+  }
+  uint64_t TileBytes = Objects.size() * ElemSize;
+
+  // Nothing to gain if all the data of the band already fits, assuming the
+  // objects span the iterations of the two innermost loops of the band.
+  uint64_t Footprint = TileBytes;
+  for (unsigned i = Band.size() - 2, e = Band.size(); i != e; ++i) {
+    const SCEV *BTC = SE->getBackedgeTakenCount(Band[i].L);
+    auto *C = dyn_cast<SCEVConstant>(BTC);
+    if (!C || C->getAPInt().getActiveBits() > 32) {
+      Footprint = UINT64_MAX;
+      break;
+    }
+    Footprint *= C->getAPInt().getZExtValue() + 1;
+  }
+  if (Footprint <= Usable) {
+    DEBUG(dbgs() << "LoopTile: The band touches " << Footprint
+                 << " bytes, which fit in the cache\n");
+    return 0;
+  }
+
+  uint64_t T = 1;
+  while (TileBytes * (2 * T) * (2 * T) <= Usable)
+    T *= 2;
+  // Tiles narrower than a cache line waste the lines they bring in.
+  if (LineSize && T * ElemSize < LineSize)
+    return 0;
+  return T;
+}
+
+/// tile - Wrap the loops of Band into tile loops, and make them run over one
+/// tile of their iteration space each time they are entered.
+void LoopTile::tile(LoopBand &Band) {
+  Loop *Outermost = Band.front().L;
+  Loop *Parent = Outermost->getParentLoop();
+  BasicBlock *Preheader = Outermost->getLoopPreheader();
+  BasicBlock *Header = Outermost->getHeader();
+  BasicBlock *Latch = Outermost->getLoopLatch();
+  BasicBlock *Exit = Outermost->getExitBlock();
+  Function *F = Header->getParent();
+  LLVMContext &Ctx = F->getContext();
+  unsigned Depth = Band.size();
+
+  SE->forgetLoop(Outermost);
+
+  // The tile headers branch to the band, so find the preheaders of its loops
+  // before they are created.
+  SmallVector<BasicBlock *, 4> LoopPreheaders;
+  for (BandLoop &BL : Band)
+    LoopPreheaders.push_back(BL.L->getLoopPreheader());
+
+  // Create the blocks of the tile loops:
+  //   Headers[k]:
+  //     %tile = phi [ start, preheader ], [ %tile.next, Latches[k] ]
+  //     %tile.rem = sub bound, %tile
+  //     %tile.full = icmp ugt %tile.rem, T
+  //     %tile.len = select %tile.full, T, %tile.rem
+  //     %tile.end = add %tile, %tile.len
+  //     br Headers[k + 1]
+  //   Latches[k]:
+  //     %tile.next = add %tile, T
+  //     br %tile.full, Headers[k], Latches[k - 1]
+  // Computing the tile bounds from the remaining iterations keeps them from
+  // overflowing.
+  SmallVector<BasicBlock *, 4> Headers, Latches;
+  for (unsigned k = 0; k != Depth; ++k) {
+    StringRef Name = Band[k].L->getHeader()->getName();
+    Headers.push_back(BasicBlock::Create(Ctx, Name + ".tile", F, Header));
+    Latches.push_back(BasicBlock::Create(Ctx, Name + ".tile.latch", F,
+                                         k ? Latches[k - 1] : Exit));
+  }
+
+  SmallVector<Value *, 4> TileStarts, TileEnds;
+  for (unsigned k = 0; k != Depth; ++k) {
+    BandLoop &BL = Band[k];
+    Type *Ty = BL.IndVar->getType();
+    // A tile larger than the range of the variable covers all of it.
+    unsigned Bits = Ty->getIntegerBitWidth();
+    Constant *T = Bits > 32 || BL.TileSize < (1U << (Bits - 1))
+                      ? ConstantInt::get(Ty, BL.TileSize)
+                      : Constant::getAllOnesValue(Ty);
+    StringRef Name = BL.IndVar->getName();
+
+    IRBuilder<> B(Headers[k]);
+    PHINode *Tile = B.CreatePHI(Ty, 2, Name + ".tile");
+    Value *Rem = B.CreateSub(BL.Bound, Tile, Name + ".tile.rem");
+    Value *Full = B.CreateICmpUGT(Rem, T, Name + ".tile.full");
+    Value *Len = B.CreateSelect(Full, T, Rem, Name + ".tile.len");
+    Value *End = B.CreateAdd(Tile, Len, Name + ".tile.end");
+    B.CreateBr(k + 1 == Depth ? Header : Headers[k + 1]);
+
+    B.SetInsertPoint(Latches[k]);
+    Value *Next = B.CreateAdd(Tile, T, Name + ".tile.next");
+    B.CreateCondBr(Full, Headers[k], k == 0 ? Exit : Latches[k - 1]);
+
+    Tile->addIncoming(BL.Start, k == 0 ? Preheader : Headers[k - 1]);
+    Tile->addIncoming(Next, Latches[k]);
+    TileStarts.push_back(Tile);
+    TileEnds.push_back(End);
+  }
+
+  // Enter the tile loops instead of the band, and leave the band to the
+  // latch of the innermost tile loop.
+  Preheader->getTerminator()->replaceUsesOfWith(Header, Headers.front());
+  Latch->getTerminator()->replaceUsesOfWith(Exit, Latches.back());
+  for (unsigned k = 0; k != Depth; ++k) {
+    BandLoop &BL = Band[k];
+    unsigned Idx = BL.IndVar->getBasicBlockIndex(LoopPreheaders[k]);
+    BL.IndVar->setIncomingValue(Idx, TileStarts[k]);
+    BL.ExitCmp->setOperand(BL.BoundIdx, TileEnds[k]);
+  }
+  unsigned Idx = Band.front().IndVar->getBasicBlockIndex(Preheader);
+  Band.front().IndVar->setIncomingBlock(Idx, Headers.back());
+
+  // Build the tile loops around the band.
+  SmallVector<Loop *, 4> TileLoops;
+  for (unsigned k = 0; k != Depth; ++k) {
+    Loop *TileLoop = new Loop();
+    if (k)
+      TileLoops.back()->addChildLoop(TileLoop);
+    else if (Parent)
+      Parent->replaceChildLoopWith(Outermost, TileLoop);
+    else
+      LI->changeTopLevelLoop(Outermost, TileLoop);
+    TileLoops.push_back(TileLoop);
+  }
+  TileLoops.back()->addChildLoop(Outermost);
+  for (unsigned k = 0; k != Depth; ++k) {
+    TileLoops[k]->addBasicBlockToLoop(Headers[k], *LI);
+    TileLoops[k]->addBasicBlockToLoop(Latches[k], *LI);
+  }
+  for (Loop *TileLoop : TileLoops)
+    for (BasicBlock *BB : Outermost->blocks())
+      TileLoop->addBlockEntry(BB);
+
+  // Don't tile the band again.
+  for (BandLoop &BL : Band)
+    addStringMetadataToLoop(BL.L, "llvm.loop.tile.disable", 1);
+
+  DT->recalculate(*F);
+}
+
+bool LoopTile::processLoop(Loop *L) {
+  LoopBand Band;
+  findBand(L, Band);
+  if (Band.size() >= 2) {
+    DEBUG(dbgs() << "LoopTile: Found a band of " << Band.size()
+                 << " loops at " << *L);
+    SmallVector<Instruction *, 16> MemInsts;
+    if (!isLegal(Band, MemInsts)) {
+      ++NumNotLegal;
+    } else {
+      unsigned Size = chooseTileSize(Band, MemInsts);
+      bool Tiled = false;
+      for (BandLoop &BL : Band) {
+        if (!BL.TileSize)
+          BL.TileSize = Size;
+        Tiled |= BL.TileSize > 1;
+      }
+      if (Tiled) {
+        // Loops left untiled get a single tile.
+        for (BandLoop &BL : Band)
+          if (BL.TileSize < 2)
+            BL.TileSize = UINT_MAX;
+        tile(Band);
+        ++NumTiledBands;
+        NumTiledLoops += Band.size();
+        return true;
+      }
+    }
+  }
+
+  bool Changed = false;
+  std::vector<Loop *> SubLoops(L->begin(), L->end());
+  for (Loop *SubLoop : SubLoops)
+    Changed |= processLoop(SubLoop);
+  return Changed;
+}
+
+bool LoopTile::runOnFunction(Function &F) {
+  if (skipOptnoneFunction(F))
+    return false;
+
+  SE = &getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+  LI = &getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  DA = &getAnalysis<DependenceAnalysis>();
+  DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  TTI = &getAnalysis<TargetTransformInfoWrapperPass>().getTTI(F);
+
+  bool Changed = false;
+  std::vector<Loop *> Loops(LI->begin(), LI->end());
+  for (Loop *L : Loops)
+    Changed |= processLoop(L);
+  return Changed;
+}
+
+char LoopTile::ID = 0;
+INITIALIZE_PASS_BEGIN(LoopTile, "loop-tile", "Tile loop nests", false, false)
+INITIALIZE_PASS_DEPENDENCY(AAResultsWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(DependenceAnalysis)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolutionWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(LoopSimplify)
+INITIALIZE_PASS_DEPENDENCY(LCSSA)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(TargetTransformInfoWrapperPass)
+INITIALIZE_PASS_END(LoopTile, "loop-tile", "Tile loop nests", false, false)
+
+FunctionPass *llvm::createLoopTilePass() { return new LoopTile(); }
@@ -0,0 +1,751 @@
+//===- NewGVN.cpp - Optimistic global value numbering on MemorySSA --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This pass performs global value numbering with an optimistic, partition
+// based congruence finding algorithm, in the spirit of Simpson's RPO and SCC
+// value numbering and of Click's sparse congruence finding:
+//
+//   - every instruction starts out in a single optimistic class (TOP) and all
+//     the blocks but the entry start out unreachable,
+//   - touched instructions are value numbered in reverse post order: their
+//     expression is built from the leaders of the classes of their operands,
+//     simplified, and looked up in a hash table of expressions to find the
+//     class they move to,
+//   - a change of class touches the users of the instruction only, and a
+//     branch whose condition becomes constant only makes one edge reachable,
+//     so the iteration is sparse and stops at the maximal fixed point.
+//
+// Memory is value numbered through MemorySSA: a load is numbered by its
+// pointer and by the state of memory it reads, which is its clobbering access
+// with MemoryPhis whose reachable incoming accesses are all congruent folded
+// away.  A load whose clobber is a store to the same pointer gets the stored
+// value.  Unlike MemoryDependenceAnalysis queries, none of this needs scan
+// limits, so the cost of the pass grows about linearly with the function.
+//
+// Once the classes are stable, the members of each class are replaced by its
+// constant or argument leader, or by a dominating member of the class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/Scalar.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/Analysis/GlobalsModRef.h"
+#include "llvm/Analysis/InstructionSimplify.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/MemorySSA.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+using namespace llvm;
+
+#define DEBUG_TYPE "newgvn"
+
+STATISTIC(NumNewGVNInstrDeleted, "Number of instructions deleted");
+STATISTIC(NumNewGVNLoadsDeleted, "Number of loads deleted");
+STATISTIC(NumNewGVNConstants, "Number of instructions replaced by constants");
+STATISTIC(NumNewGVNUnreachable, "Number of blocks proven unreachable");
+STATISTIC(NumNewGVNMaxIterations,
+          "Number of functions that did not reach a fixed point");
+
+static cl::opt<unsigned> MaxIterations(
+    "newgvn-max-iterations", cl::init(100), cl::Hidden,
+    cl::desc("Maximum number of sweeps over the touched instructions before "
+             "NewGVN gives up on a function"));
+
+namespace {
+/// The value computed by an instruction, in terms of the leaders of the
+/// classes of its operands.  PHI expressions also record their block, and
+/// loads and calls that read memory record the state of memory they read.
+struct Expression {
+  uint32_t Opcode;
+  Type *Ty;
+  BasicBlock *BB;
+  MemoryAccess *Memory;
+  SmallVector<Value *, 4> Args;
+
+  Expression(uint32_t O = ~2U)
+      : Opcode(O), Ty(nullptr), BB(nullptr), Memory(nullptr) {}
+
+  bool operator==(const Expression &Other) const {
+    if (Opcode != Other.Opcode)
+      return false;
+    if (Opcode == ~0U || Opcode == ~1U)
+      return true;
+    return Ty == Other.Ty && BB == Other.BB && Memory == Other.Memory &&
+           Args == Other.Args;
+  }
+
+  friend hash_code hash_value(const Expression &E) {
+    return hash_combine(E.Opcode, E.Ty, E.BB, E.Memory,
+                        hash_combine_range(E.Args.begin(), E.Args.end()));
+  }
+};
+} // end anonymous namespace
+
+namespace llvm {
+template <> struct DenseMapInfo<Expression> {
+  static inline Expression getEmptyKey() { return ~0U; }
+  static inline Expression getTombstoneKey() { return ~1U; }
+
+  static unsigned getHashValue(const Expression &E) {
+    return static_cast<unsigned>(hash_value(E));
+  }
+  static bool isEqual(const Expression &LHS, const Expression &RHS) {
+    return LHS == RHS;
+  }
+};
+} // end namespace llvm
+
+namespace {
+/// A set of values proven to compute the same value.  The leader is the
+/// constant or argument of the class if it has one, and otherwise the member
+/// that comes first in reverse post order.
+struct CongruenceClass {
+  Value *Leader;
+  SmallPtrSet<Instruction *, 4> Members;
+
+  explicit CongruenceClass(Value *Leader) : Leader(Leader) {}
+};
+
+class NewGVN : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  NewGVN() : FunctionPass(ID) {
+    initializeNewGVNPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnFunction(Function &F) override;
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<AssumptionCacheTracker>();
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<TargetLibraryInfoWrapperPass>();
+    AU.addRequired<AAResultsWrapperPass>();
+
+    AU.addPreserved<DominatorTreeWrapperPass>();
+    AU.addPreserved<GlobalsAAWrapperPass>();
+  }
+
+private:
+  DominatorTree *DT;
+  const DataLayout *DL;
+  const TargetLibraryInfo *TLI;
+  AssumptionCache *AC;
+  MemorySSA *MSSA;
+  MemorySSAWalker *Walker;
+
+  std::vector<std::unique_ptr<CongruenceClass>> Classes;
+  /// The optimistic class every instruction starts in.
+  CongruenceClass *InitialClass;
+  DenseMap<Value *, CongruenceClass *> ValueToClass;
+  DenseMap<Expression, CongruenceClass *> ExpressionToClass;
+
+  /// The MemoryPhis known to be congruent to another memory access.
+  DenseMap<MemoryAccess *, MemoryAccess *> MemoryPhiEquiv;
+  /// The loads and calls numbered with a memory access as their clobber, and
+  /// the loads that got the value of a store.
+  DenseMap<MemoryAccess *, SmallPtrSet<Instruction *, 2>> MemoryDependents;
+  DenseMap<StoreInst *, SmallPtrSet<Instruction *, 2>> StoreDependents;
+
+  SmallPtrSet<BasicBlock *, 32> ReachableBlocks;
+  DenseSet<std::pair<BasicBlock *, BasicBlock *>> ReachableEdges;
+
+  /// The instructions and MemoryPhis in reverse post order.  A MemoryPhi
+  /// comes right before the instructions of its block.
+  std::vector<Value *> DFSToValue;
+  DenseMap<const Value *, unsigned> ValueToDFS;
+  BitVector Touched;
+
+  void initialize(Function &F);
+  void cleanup();
+
+  void touch(Value *V);
+  void touchUsers(Value *V);
+  void touchBlock(BasicBlock *BB);
+
+  CongruenceClass *createClass(Value *Leader);
+  CongruenceClass *getClass(Value *V);
+  Value *getLeader(Value *V);
+  MemoryAccess *getMemoryLeader(MemoryAccess *MA);
+
+  CongruenceClass *getSimplifiedClass(Value *V);
+  CongruenceClass *numberPHI(PHINode *PN, Expression &E);
+  CongruenceClass *numberLoad(LoadInst *LI, Expression &E);
+  CongruenceClass *numberCall(CallInst *CI, Expression &E);
+  CongruenceClass *numberInstruction(Instruction *I, Expression &E,
+                                     bool &IsUnique);
+
+  void processInstruction(Instruction *I);
+  void processMemoryPhi(MemoryPhi *MP);
+  void processOutgoingEdges(TerminatorInst *TI);
+  void moveToClass(Instruction *I, CongruenceClass *NewClass);
+
+  bool dominates(Instruction *A, Instruction *B) const;
+  bool eliminateInstructions();
+};
+} // end anonymous namespace
+
+char NewGVN::ID = 0;
+
+FunctionPass *llvm::createNewGVNPass() { return new NewGVN(); }
+
+INITIALIZE_PASS_BEGIN(NewGVN, "newgvn", "Global Value Numbering on MemorySSA",
+                      false, false)
+INITIALIZE_PASS_DEPENDENCY(AssumptionCacheTracker)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(TargetLibraryInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(AAResultsWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(GlobalsAAWrapperPass)
+INITIALIZE_PASS_END(NewGVN, "newgvn", "Global Value Numbering on MemorySSA",
+                    false, false)
+
+CongruenceClass *NewGVN::createClass(Value *Leader) {
+  Classes.emplace_back(new CongruenceClass(Leader));
+  return Classes.back().get();
+}
+
+void NewGVN::initialize(Function &F) {
+  InitialClass = createClass(nullptr);
+  for (Argument &A : F.args())
+    ValueToClass[&A] = createClass(&A);
+
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  for (BasicBlock *BB : RPOT) {
+    if (MemoryPhi *MP = MSSA->getMemoryAccess(BB)) {
+      ValueToDFS[MP] = DFSToValue.size();
+      DFSToValue.push_back(MP);
+    }
+    for (Instruction &I : *BB) {
+      ValueToDFS[&I] = DFSToValue.size();
+      DFSToValue.push_back(&I);
+      ValueToClass[&I] = InitialClass;
+      InitialClass->Members.insert(&I);
+    }
+  }
+  Touched.resize(DFSToValue.size());
+
+  BasicBlock *Entry = &F.getEntryBlock();
+  ReachableBlocks.insert(Entry);
+  touchBlock(Entry);
+}
+
+void NewGVN::cleanup() {
+  Classes.clear();
+  ValueToClass.clear();
+  ExpressionToClass.clear();
+  MemoryPhiEquiv.clear();
+  MemoryDependents.clear();
+  StoreDependents.clear();
+  ReachableBlocks.clear();
+  ReachableEdges.clear();
+  DFSToValue.clear();
+  ValueToDFS.clear();
+  Touched.clear();
+}
+
+void NewGVN::touch(Value *V) {
+  auto It = ValueToDFS.find(V);
+  if (It != ValueToDFS.end())
+    Touched.set(It->second);
+}
+
+void NewGVN::touchUsers(Value *V) {
+  for (User *U : V->users())
+    if (isa<Instruction>(U))
+      touch(U);
+}
+
+void NewGVN::touchBlock(BasicBlock *BB) {
+  if (MemoryPhi *MP = MSSA->getMemoryAccess(BB))
+    touch(MP);
+  for (Instruction &I : *BB)
+    touch(&I);
+}
+
+CongruenceClass *NewGVN::getClass(Value *V) {
+  auto It = ValueToClass.find(V);
+  if (It != ValueToClass.end())
+    return It->second;
+  // Constants, globals and the other values that aren't instructions lead a
+  // class of their own.
+  if (!isa<Instruction>(V)) {
+    CongruenceClass *CC = createClass(V);
+    ValueToClass[V] = CC;
+    return CC;
+  }
+  return nullptr;
+}
+
+/// Return the leader of the class of \p V, or null if it is still TOP.
+Value *NewGVN::getLeader(Value *V) {
+  return getClass(V)->Leader;
+}
+
+MemoryAccess *NewGVN::getMemoryLeader(MemoryAccess *MA) {
+  auto It = MemoryPhiEquiv.find(MA);
+  return It == MemoryPhiEquiv.end() ? MA : It->second;
+}
+
+/// Return the class of the value an instruction simplified to, or null if
+/// the value is not numbered.
+CongruenceClass *NewGVN::getSimplifiedClass(Value *V) {
+  CongruenceClass *CC = getClass(V);
+  return CC == InitialClass ? nullptr : CC;
+}
+
+CongruenceClass *NewGVN::numberPHI(PHINode *PN, Expression &E) {
+  BasicBlock *BB = PN->getParent();
+  CongruenceClass *PNClass = ValueToClass[PN];
+  CongruenceClass *Common = nullptr;
+  bool AllSame = true, SawOwnClass = false;
+  SmallVector<std::pair<BasicBlock *, Value *>, 4> Incoming;
+  for (unsigned I = 0, E = PN->getNumIncomingValues(); I != E; ++I) {
+    BasicBlock *Pred = PN->getIncomingBlock(I);
+    if (!ReachableEdges.count({Pred, BB}))
+      continue;
+    CongruenceClass *CC = getClass(PN->getIncomingValue(I));
+    // Values that are still TOP, and the values already assumed congruent to
+    // the PHI, are optimistically assumed to agree with the others.
+    if (CC == InitialClass)
+      continue;
+    if (CC == PNClass) {
+      SawOwnClass = true;
+      continue;
+    }
+    if (Common && Common != CC)
+      AllSame = false;
+    Common = CC;
+    Incoming.push_back({Pred, CC->Leader});
+  }
+  if (!Common)
+    return SawOwnClass ? PNClass : InitialClass;
+  if (AllSame)
+    return Common;
+
+  std::sort(Incoming.begin(), Incoming.end());
+  E.Opcode = Instruction::PHI;
+  E.Ty = PN->getType();
+  E.BB = BB;
+  for (auto &In : Incoming) {
+    E.Args.push_back(In.first);
+    E.Args.push_back(In.second);
+  }
+  return nullptr;
+}
+
+CongruenceClass *NewGVN::numberLoad(LoadInst *LI, Expression &E) {
+  Value *Ptr = getLeader(LI->getPointerOperand());
+  if (!Ptr)
+    return InitialClass;
+
+  MemoryAccess *Clobber = Walker->getClobberingMemoryAccess(LI);
+  MemoryDependents[Clobber].insert(LI);
+  MemoryAccess *State = getMemoryLeader(Clobber);
+
+  // Forward the value of a store to the same pointer.
+  if (auto *MD = dyn_cast<MemoryDef>(State))
+    if (auto *SI = dyn_cast_or_null<StoreInst>(MD->getMemoryInst()))
+      if (SI->isSimple() && getLeader(SI->getPointerOperand()) == Ptr &&
+          SI->getValueOperand()->getType() == LI->getType()) {
+        StoreDependents[SI].insert(LI);
+        return getClass(SI->getValueOperand());
+      }
+
+  E.Opcode = Instruction::Load;
+  E.Ty = LI->getType();
+  E.Memory = State;
+  E.Args.push_back(Ptr);
+  return nullptr;
+}
+
+CongruenceClass *NewGVN::numberCall(CallInst *CI, Expression &E) {
+  E.Opcode = Instruction::Call;
+  E.Ty = CI->getType();
+  for (Value *Op : CI->operands()) {
+    Value *Leader = getLeader(Op);
+    if (!Leader)
+      return InitialClass;
+    E.Args.push_back(Leader);
+  }
+  if (!CI->doesNotAccessMemory()) {
+    MemoryAccess *Clobber = Walker->getClobberingMemoryAccess(CI);
+    MemoryDependents[Clobber].insert(CI);
+    E.Memory = getMemoryLeader(Clobber);
+  }
+  return nullptr;
+}
+
+/// Number \p I: either return the class of the value it simplifies to, or
+/// fill in its expression \p E and return null.  Instructions that can't be
+/// numbered set \p IsUnique.
+CongruenceClass *NewGVN::numberInstruction(Instruction *I, Expression &E,
+                                           bool &IsUnique) {
+  if (auto *PN = dyn_cast<PHINode>(I))
+    return numberPHI(PN, E);
+  if (auto *LI = dyn_cast<LoadInst>(I)) {
+    if (!LI->isSimple()) {
+      IsUnique = true;
+      return nullptr;
+    }
+    return numberLoad(LI, E);
+  }
+  if (auto *CI = dyn_cast<CallInst>(I)) {
+    if (!CI->onlyReadsMemory() || CI->isConvergent() ||
+        CI->getType()->isVoidTy()) {
+      IsUnique = true;
+      return nullptr;
+    }
+    return numberCall(CI, E);
+  }
+  if (!isa<BinaryOperator>(I) && !isa<CastInst>(I) && !isa<CmpInst>(I) &&
+      !isa<SelectInst>(I) && !isa<GetElementPtrInst>(I) &&
+      !isa<ExtractElementInst>(I) && !isa<InsertElementInst>(I) &&
+      !isa<ShuffleVectorInst>(I)) {
+    IsUnique = true;
+    return nullptr;
+  }
+
+  SmallVector<Value *, 4> Ops;
+  SmallVector<Constant *, 4> ConstOps;
+  for (Value *Op : I->operands()) {
+    Value *Leader = getLeader(Op);
+    if (!Leader)
+      return InitialClass;
+    Ops.push_back(Leader);
+    if (auto *C = dyn_cast<Constant>(Leader))
+      ConstOps.push_back(C);
+  }
+
+  Value *Simplified = nullptr;
+  if (auto *BO = dyn_cast<BinaryOperator>(I))
+    Simplified = SimplifyBinOp(BO->getOpcode(), Ops[0], Ops[1], *DL, TLI, DT,
+                               AC, I);
+  else if (auto *Cmp = dyn_cast<CmpInst>(I))
+    Simplified = SimplifyCmpInst(Cmp->getPredicate(), Ops[0], Ops[1], *DL,
+                                 TLI, DT, AC, I);
+  else if (isa<SelectInst>(I))
+    Simplified = SimplifySelectInst(Ops[0], Ops[1], Ops[2], *DL, TLI, DT, AC,
+                                    I);
+  else if (auto *GEP = dyn_cast<GetElementPtrInst>(I))
+    Simplified = SimplifyGEPInst(GEP->getSourceElementType(), Ops, *DL, TLI,
+                                 DT, AC, I);
+  else if (ConstOps.size() == Ops.size())
+    Simplified = ConstantFoldInstOperands(I, ConstOps, *DL, TLI);
+  if (Simplified)
+    if (CongruenceClass *CC = getSimplifiedClass(Simplified))
+      return CC;
+
+  E.Opcode = I->getOpcode();
+  E.Ty = I->getType();
+  if (auto *Cmp = dyn_cast<CmpInst>(I)) {
+    CmpInst::Predicate Pred = Cmp->getPredicate();
+    if (Ops[0] > Ops[1]) {
+      std::swap(Ops[0], Ops[1]);
+      Pred = CmpInst::getSwappedPredicate(Pred);
+    }
+    E.Opcode = (E.Opcode << 8) | Pred;
+  } else if (auto *GEP = dyn_cast<GetElementPtrInst>(I)) {
+    E.Opcode = (E.Opcode << 8) | GEP->isInBounds();
+  } else if (I->isCommutative() && Ops[0] > Ops[1]) {
+    std::swap(Ops[0], Ops[1]);
+  }
+  E.Args.append(Ops.begin(), Ops.end());
+  return nullptr;
+}
+
+void NewGVN::moveToClass(Instruction *I, CongruenceClass *NewClass) {
+  CongruenceClass *OldClass = ValueToClass[I];
+  if (OldClass == NewClass)
+    return;
+  DEBUG(dbgs() << "NewGVN: moving " << *I << " to the class of "
+               << (NewClass->Leader ? NewClass->Leader->getName() : "itself")
+               << "\n");
+
+  OldClass->Members.erase(I);
+  if (OldClass->Leader == I) {
+    // The users of the old class were numbered with I as its leader.
+    Instruction *NewLeader = nullptr;
+    for (Instruction *M : OldClass->Members)
+      if (!NewLeader || ValueToDFS[M] < ValueToDFS[NewLeader])
+        NewLeader = M;
+    OldClass->Leader = NewLeader;
+    for (Instruction *M : OldClass->Members)
+      touchUsers(M);
+  }
+
+  NewClass->Members.insert(I);
+  if (!NewClass->Leader && NewClass != InitialClass)
+    NewClass->Leader = I;
+  ValueToClass[I] = NewClass;
+  touchUsers(I);
+}
+
+void NewGVN::processInstruction(Instruction *I) {
+  if (auto *TI = dyn_cast<TerminatorInst>(I)) {
+    processOutgoingEdges(TI);
+    if (I->getType()->isVoidTy())
+      return;
+  }
+  if (auto *SI = dyn_cast<StoreInst>(I)) {
+    auto It = StoreDependents.find(SI);
+    if (It != StoreDependents.end())
+      for (Instruction *Dep : It->second)
+        touch(Dep);
+    return;
+  }
+  if (I->getType()->isVoidTy())
+    return;
+
+  Expression E;
+  bool IsUnique = isa<TerminatorInst>(I);
+  CongruenceClass *CC = IsUnique ? nullptr : numberInstruction(I, E, IsUnique);
+  if (IsUnique) {
+    // The instruction is only congruent to itself.
+    if (ValueToClass[I] == InitialClass)
+      moveToClass(I, createClass(nullptr));
+    return;
+  }
+  if (!CC) {
+    CongruenceClass *&EClass = ExpressionToClass[E];
+    if (!EClass)
+      EClass = createClass(nullptr);
+    CC = EClass;
+  }
+  moveToClass(I, CC);
+}
+
+void NewGVN::processMemoryPhi(MemoryPhi *MP) {
+  BasicBlock *BB = MP->getBlock();
+  MemoryAccess *Common = nullptr;
+  bool AllSame = true;
+  for (unsigned I = 0, E = MP->getNumIncomingValues(); I != E; ++I) {
+    if (!ReachableEdges.count({MP->getIncomingBlock(I), BB}))
+      continue;
+    MemoryAccess *In = getMemoryLeader(MP->getIncomingValue(I));
+    if (In == MP)
+      continue;
+    if (Common && Common != In)
+      AllSame = false;
+    Common = In;
+  }
+
+  MemoryAccess *OldLeader = getMemoryLeader(MP);
+  MemoryAccess *NewLeader = Common && AllSame ? Common : MP;
+  if (OldLeader == NewLeader)
+    return;
+  if (NewLeader == MP)
+    MemoryPhiEquiv.erase(MP);
+  else
+    MemoryPhiEquiv[MP] = NewLeader;
+
+  auto It = MemoryDependents.find(MP);
+  if (It != MemoryDependents.end())
+    for (Instruction *Dep : It->second)
+      touch(Dep);
+  for (User *U : MP->users())
+    if (isa<MemoryPhi>(U))
+      touch(U);
+}
+
+void NewGVN::processOutgoingEdges(TerminatorInst *TI) {
+  BasicBlock *BB = TI->getParent();
+  SmallVector<BasicBlock *, 4> Succs;
+  if (auto *BI = dyn_cast<BranchInst>(TI)) {
+    auto *Cond = BI->isConditional()
+                     ? dyn_cast_or_null<ConstantInt>(getLeader(BI->getCondition()))
+                     : nullptr;
+    if (Cond)
+      Succs.push_back(BI->getSuccessor(Cond->isZero() ? 1 : 0));
+  } else if (auto *SI = dyn_cast<SwitchInst>(TI)) {
+    if (auto *Cond = dyn_cast_or_null<ConstantInt>(getLeader(SI->getCondition())))
+      Succs.push_back(SI->findCaseValue(Cond).getCaseSuccessor());
+  }
+  if (Succs.empty())
+    Succs.append(succ_begin(BB), succ_end(BB));
+
+  for (BasicBlock *Succ : Succs) {
+    if (!ReachableEdges.insert({BB, Succ}).second)
+      continue;
+    if (ReachableBlocks.insert(Succ).second) {
+      touchBlock(Succ);
+      continue;
+    }
+    // A new edge into a reachable block only changes its PHIs.
+    if (MemoryPhi *MP = MSSA->getMemoryAccess(Succ))
+      touch(MP);
+    for (Instruction &I : *Succ) {
+      if (!isa<PHINode>(I))
+        break;
+      touch(&I);
+    }
+  }
+}
+
+bool NewGVN::dominates(Instruction *A, Instruction *B) const {
+  BasicBlock *ABB = A->getParent(), *BBB = B->getParent();
+  if (ABB == BBB)
+    return ValueToDFS.lookup(A) < ValueToDFS.lookup(B);
+  DomTreeNode *AN = DT->getNode(ABB), *BN = DT->getNode(BBB);
+  return AN->getDFSNumIn() <= BN->getDFSNumIn() &&
+         BN->getDFSNumOut() <= AN->getDFSNumOut();
+}
+
+static void patchReplacementInstruction(Instruction *I, Value *Repl) {
+  // Simplification puts instructions with different opcodes in one class,
+  // e.g. (X + 1) - 1 and X, and their flags and metadata don't mix.
+  Instruction *ReplInst = dyn_cast<Instruction>(Repl);
+  if (!ReplInst || ReplInst->getOpcode() != I->getOpcode())
+    return;
+
+  // Patch the replacement so that it is not more restrictive than the value
+  // being replaced.
+  if (auto *ReplOp = dyn_cast<BinaryOperator>(ReplInst))
+    ReplOp->andIRFlags(I);
+
+  // The members of a class come from different control-flow regions, so
+  // the metadata is combined conservatively, as in GVN.
+  static const unsigned KnownIDs[] = {
+      LLVMContext::MD_tbaa,           LLVMContext::MD_alias_scope,
+      LLVMContext::MD_noalias,        LLVMContext::MD_range,
+      LLVMContext::MD_fpmath,         LLVMContext::MD_invariant_load,
+      LLVMContext::MD_invariant_group};
+  combineMetadata(ReplInst, I, KnownIDs);
+}
+
+bool NewGVN::eliminateInstructions() {
+  DT->updateDFSNumbers();
+  SmallVector<Instruction *, 32> Dead;
+  SmallVector<Instruction *, 8> Members;
+  SmallVector<Instruction *, 8> Stack;
+
+  auto Replace = [&](Instruction *I, Value *Repl) {
+    DEBUG(dbgs() << "NewGVN: replacing " << *I << " with " << *Repl << "\n");
+    patchReplacementInstruction(I, Repl);
+    I->replaceAllUsesWith(Repl);
+    Dead.push_back(I);
+    if (isa<Constant>(Repl))
+      ++NumNewGVNConstants;
+  };
+
+  for (auto &CC : Classes) {
+    if (CC.get() == InitialClass || !CC->Leader || CC->Members.empty())
+      continue;
+    // A constant or argument leader is available everywhere.
+    if (!isa<Instruction>(CC->Leader)) {
+      for (Instruction *I : CC->Members)
+        Replace(I, CC->Leader);
+      continue;
+    }
+    if (CC->Members.size() == 1)
+      continue;
+
+    // Walk the members in dominator tree order, keeping a stack of the
+    // members that dominate the current one.
+    Members.clear();
+    Members.append(CC->Members.begin(), CC->Members.end());
+    std::sort(Members.begin(), Members.end(),
+              [&](Instruction *A, Instruction *B) {
+                unsigned AIn = DT->getNode(A->getParent())->getDFSNumIn();
+                unsigned BIn = DT->getNode(B->getParent())->getDFSNumIn();
+                if (AIn != BIn)
+                  return AIn < BIn;
+                return ValueToDFS[A] < ValueToDFS[B];
+              });
+    Stack.clear();
+    for (Instruction *I : Members) {
+      while (!Stack.empty() && !dominates(Stack.back(), I))
+        Stack.pop_back();
+      if (Stack.empty())
+        Stack.push_back(I);
+      else
+        Replace(I, Stack.back());
+    }
+  }
+
+  for (Instruction *I : Dead) {
+    if (!isInstructionTriviallyDead(I, TLI))
+      continue;
+    if (MemoryAccess *MA = MSSA->getMemoryAccess(I))
+      MSSA->removeMemoryAccess(MA);
+    if (isa<LoadInst>(I))
+      ++NumNewGVNLoadsDeleted;
+    I->eraseFromParent();
+    ++NumNewGVNInstrDeleted;
+  }
+  return !Dead.empty();
+}
+
+bool NewGVN::runOnFunction(Function &F) {
+  if (skipOptnoneFunction(F))
+    return false;
+
+  DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  DL = &F.getParent()->getDataLayout();
+  TLI = &getAnalysis<TargetLibraryInfoWrapperPass>().getTLI();
+  AC = &getAnalysis<AssumptionCacheTracker>().getAssumptionCache(F);
+  AliasAnalysis *AA = &getAnalysis<AAResultsWrapperPass>().getAAResults();
+
+  std::unique_ptr<MemorySSA> MSSAPtr(new MemorySSA(F));
+  std::unique_ptr<MemorySSAWalker> WalkerPtr(MSSAPtr->buildMemorySSA(AA, DT));
+  MSSA = MSSAPtr.get();
+  Walker = WalkerPtr.get();
+
+  initialize(F);
+
+  unsigned Iterations = 0;
+  while (Touched.any()) {
+    if (++Iterations > MaxIterations) {
+      DEBUG(dbgs() << "NewGVN: giving up on " << F.getName() << "\n");
+      ++NumNewGVNMaxIterations;
+      cleanup();
+      return false;
+    }
+    for (int Num = Touched.find_first(); Num != -1;
+         Num = Touched.find_next(Num)) {
+      Touched.reset(Num);
+      Value *V = DFSToValue[Num];
+      if (auto *MP = dyn_cast<MemoryPhi>(V)) {
+        if (ReachableBlocks.count(MP->getBlock()))
+          processMemoryPhi(MP);
+        continue;
+      }
+      auto *I = cast<Instruction>(V);
+      if (ReachableBlocks.count(I->getParent()))
+        processInstruction(I);
+    }
+  }
+  DEBUG(dbgs() << "NewGVN: " << F.getName() << " converged after "
+               << Iterations << " iterations\n");
+  for (BasicBlock &BB : F)
+    if (!ReachableBlocks.count(&BB))
+      ++NumNewGVNUnreachable;
+
+  bool Changed = eliminateInstructions();
+  cleanup();
+  return Changed;
+}
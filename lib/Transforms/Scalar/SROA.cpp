@@ -75,6 +75,8 @@ STATISTIC(NumPromoted, "Number of allocas promoted to SSA values");
 STATISTIC(NumLoadsSpeculated, "Number of loads speculated to allow promotion");
 STATISTIC(NumDeleted, "Number of instructions deleted");
 STATISTIC(NumVectorized, "Number of vectorized aggregates");
+STATISTIC(NumAllocasPartiallySplit,
+          "Number of allocas with too many slices to split completely");
 
 /// Hidden option to enable randomly shuffling the slices to help uncover
 /// instability in their order.
@@ -86,6 +88,14 @@ static cl::opt<bool> SROARandomShuffleSlices("sroa-random-shuffle-slices",
 static cl::opt<bool> SROAStrictInbounds("sroa-strict-inbounds", cl::init(false),
                                         cl::Hidden);
 
+/// Allocas with more slices than this are only partially split: loads and
+/// stores are not pre-split, and only the partitions which can be rewritten
+/// without splitting any slice get their own alloca. This keeps huge
+/// aggregates and memcpy'd arrays from being split into thousands of pieces.
+static cl::opt<unsigned> SROAMaxAllocaSlices(
+    "sroa-max-alloca-slices", cl::init(1024), cl::Hidden,
+    cl::desc("Maximum number of slices of an alloca to split completely"));
+
 namespace {
 /// \brief A custom IRBuilder inserter which prefixes all names, but only in
 /// Assert builds.
@@ -3292,6 +3302,20 @@ static Type *getTypePartition(const DataLayout &DL, Type *Ty, uint64_t Offset,
   return SubTy;
 }
 
+/// \brief Remove the allocas in \p ToRemove from \p List.
+///
+/// \p List is only scanned when it holds one of the allocas, as a function
+/// with many allocas would otherwise scan all of them each time one alloca is
+/// deleted.
+static void
+removeAllocas(SetVector<AllocaInst *, SmallVector<AllocaInst *, 16>> &List,
+              SmallPtrSetImpl<AllocaInst *> &ToRemove) {
+  if (std::none_of(ToRemove.begin(), ToRemove.end(),
+                   [&](AllocaInst *AI) { return List.count(AI); }))
+    return;
+  List.remove_if([&](AllocaInst *AI) { return ToRemove.count(AI); });
+}
+
 /// \brief Pre-split loads and stores to simplify rewriting.
 ///
 /// We want to break up the splittable load+store pairs as much as
@@ -3776,11 +3800,7 @@ bool SROA::presplitLoadsAndStores(AllocaInst &AI, AllocaSlices &AS) {
 
   // Finally, don't try to promote any allocas that new require re-splitting.
   // They have already been added to the worklist above.
-  PromotableAllocas.erase(
-      std::remove_if(
-          PromotableAllocas.begin(), PromotableAllocas.end(),
-          [&](AllocaInst *AI) { return ResplitPromotableAllocas.count(AI); }),
-      PromotableAllocas.end());
+  removeAllocas(PromotableAllocas, ResplitPromotableAllocas);
 
   return true;
 }
@@ -3908,7 +3928,7 @@ AllocaInst *SROA::rewritePartition(AllocaInst &AI, AllocaSlices &AS,
   if (Promotable) {
     if (PHIUsers.empty() && SelectUsers.empty()) {
       // Promote the alloca.
-      PromotableAllocas.push_back(NewAI);
+      PromotableAllocas.insert(NewAI);
     } else {
       // If we have either PHIs or Selects to speculate, add them to those
       // worklists and re-queue the new alloca so that we promote in on the
@@ -3934,6 +3954,20 @@ AllocaInst *SROA::rewritePartition(AllocaInst &AI, AllocaSlices &AS,
   return NewAI;
 }
 
+/// \brief Test whether a partition can be rewritten on its own.
+///
+/// This is the case when no slice overlaps both the partition and the rest of
+/// the alloca, so that rewriting it splits no slice and leaves the uses of the
+/// other partitions untouched.
+static bool isIsolatedPartition(Partition &P) {
+  if (P.empty() || !P.splitSliceTails().empty())
+    return false;
+  for (Slice &S : P)
+    if (S.endOffset() > P.endOffset())
+      return false;
+  return true;
+}
+
 /// \brief Walks the slices of an alloca and form partitions based on them,
 /// rewriting each of their uses.
 bool SROA::splitAlloca(AllocaInst &AI, AllocaSlices &AS) {
@@ -3944,8 +3978,19 @@ bool SROA::splitAlloca(AllocaInst &AI, AllocaSlices &AS) {
   bool Changed = false;
   const DataLayout &DL = AI.getModule()->getDataLayout();
 
-  // First try to pre-split loads and stores.
-  Changed |= presplitLoadsAndStores(AI, AS);
+  // Splitting every slice of an alloca with a huge number of them can create
+  // more new instructions than the function had to begin with, so such allocas
+  // only get the partitions rewritten which need no splitting at all. The rest
+  // of the alloca stays in memory.
+  bool SplitPartially =
+      static_cast<uint64_t>(AS.end() - AS.begin()) > SROAMaxAllocaSlices;
+  if (SplitPartially) {
+    DEBUG(dbgs() << "  Too many slices, splitting partially\n");
+    ++NumAllocasPartiallySplit;
+  } else {
+    // First try to pre-split loads and stores.
+    Changed |= presplitLoadsAndStores(AI, AS);
+  }
 
   // Now that we have identified any pre-splitting opportunities, mark any
   // splittable (non-whole-alloca) loads and stores as unsplittable. If we fail
@@ -3984,6 +4029,10 @@ bool SROA::splitAlloca(AllocaInst &AI, AllocaSlices &AS) {
 
   // Rewrite each partition.
   for (auto &P : AS.partitions()) {
+    if (SplitPartially && !isIsolatedPartition(P)) {
+      ++NumPartitions;
+      continue;
+    }
     if (AllocaInst *NewAI = rewritePartition(AI, AS, P)) {
       Changed = true;
       if (NewAI != &AI) {
@@ -4002,7 +4051,10 @@ bool SROA::splitAlloca(AllocaInst &AI, AllocaSlices &AS) {
       std::max<unsigned>(NumPartitions, MaxPartitionsPerAlloca);
 
   // Migrate debug information from the old alloca to the new alloca(s)
-  // and the individual partitions.
+  // and the individual partitions. A partially split alloca keeps describing
+  // the whole variable, which pieces must not overlap.
+  if (SplitPartially)
+    return Changed;
   if (DbgDeclareInst *DbgDecl = FindAllocaDbgDeclare(&AI)) {
     auto *Var = DbgDecl->getVariable();
     auto *Expr = DbgDecl->getExpression();
@@ -4174,7 +4226,7 @@ bool SROA::promoteAllocas(Function &F) {
   NumPromoted += PromotableAllocas.size();
 
   DEBUG(dbgs() << "Promoting allocas with mem2reg...\n");
-  PromoteMemToReg(PromotableAllocas, *DT, nullptr, AC);
+  PromoteMemToReg(PromotableAllocas.getArrayRef(), *DT, nullptr, AC);
   PromotableAllocas.clear();
   return true;
 }
@@ -4206,13 +4258,9 @@ PreservedAnalyses SROA::runImpl(Function &F, DominatorTree &RunDT,
       // Remove the deleted allocas from various lists so that we don't try to
       // continue processing them.
       if (!DeletedAllocas.empty()) {
-        auto IsInSet = [&](AllocaInst *AI) { return DeletedAllocas.count(AI); };
-        Worklist.remove_if(IsInSet);
-        PostPromotionWorklist.remove_if(IsInSet);
-        PromotableAllocas.erase(std::remove_if(PromotableAllocas.begin(),
-                                               PromotableAllocas.end(),
-                                               IsInSet),
-                                PromotableAllocas.end());
+        removeAllocas(Worklist, DeletedAllocas);
+        removeAllocas(PostPromotionWorklist, DeletedAllocas);
+        removeAllocas(PromotableAllocas, DeletedAllocas);
         DeletedAllocas.clear();
       }
     }
@@ -47,6 +47,12 @@ using namespace llvm;
 STATISTIC(NumClobberCacheLookups, "Number of Memory SSA version cache lookups");
 STATISTIC(NumClobberCacheHits, "Number of Memory SSA version cache hits");
 STATISTIC(NumClobberCacheInserts, "Number of MemorySSA version cache inserts");
+
+static cl::opt<unsigned> MaxCheckLimit(
+    "memssa-check-limit", cl::Hidden, cl::init(100),
+    cl::desc("The maximum number of phi arguments to follow when looking for "
+             "the clobber of one access"));
+
 INITIALIZE_PASS_WITH_OPTIONS_BEGIN(MemorySSAPrinterPass, "print-memoryssa",
                                    "Memory SSA", true, true)
 INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
@@ -898,6 +904,14 @@ MemoryAccessPair CachingMemorySSAWalker::UpwardsDFSWalk(
       continue;
     }
 
+    // Each phi argument followed can lead all the way up to the entry, so
+    // give up once a query followed too many of them. The phi is always a
+    // correct, if conservative, clobber.
+    if (Q.Visited.size() >= MaxCheckLimit) {
+      ModifyingAccess = CurrAccess;
+      break;
+    }
+
 #ifndef NDEBUG
     // The loop below visits the phi's children for us. Because phis are the
     // only things with multiple edges, skipping the children should always lead
@@ -985,7 +999,6 @@ MemoryAccessPair CachingMemorySSAWalker::UpwardsDFSWalk(
     MemoryAccess *CacheAccess = DFI.getPath(N - 1);
     doCacheInsert(CacheAccess, ModifyingAccess, Q, Loc);
   }
-  assert(Q.Visited.size() < 1000 && "Visited too much");
 
   return {ModifyingAccess, Loc};
 }
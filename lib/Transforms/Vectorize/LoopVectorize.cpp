@@ -114,6 +114,7 @@ using namespace llvm::PatternMatch;
 
 STATISTIC(LoopsVectorized, "Number of loops vectorized");
 STATISTIC(LoopsAnalyzed, "Number of loops analyzed for vectorization");
+STATISTIC(EpiloguesVectorized, "Number of vectorized epilogue loops");
 
 static cl::opt<bool>
 EnableIfConversion("enable-if-conversion", cl::init(true), cl::Hidden,
@@ -147,10 +148,27 @@ static cl::opt<bool> EnableMemAccessVersioning(
     "enable-mem-access-versioning", cl::init(true), cl::Hidden,
     cl::desc("Enable symbolic stride memory access versioning"));
 
+static cl::opt<bool> EnableEpilogueVectorization(
+    "enable-epilogue-vectorization", cl::init(false), cl::Hidden,
+    cl::desc("Vectorize the remainder loop of a vectorized loop with a "
+             "smaller vectorization factor before the scalar remainder"));
+
+/// The epilogue is only worth vectorizing if the main vector loop leaves
+/// many iterations behind.
+static cl::opt<unsigned> EpilogueVectorizationMinStep(
+    "epilogue-vectorization-min-step", cl::init(16), cl::Hidden,
+    cl::desc("Only vectorize the epilogue of loops whose vector loop covers "
+             "at least this many iterations (VF * interleave count)"));
+
 static cl::opt<bool> EnableInterleavedMemAccesses(
     "enable-interleaved-mem-accesses", cl::init(false), cl::Hidden,
     cl::desc("Enable vectorization on interleaved memory accesses in a loop"));
 
+static cl::opt<bool> EnableMaskedInterleavedMemAccesses(
+    "enable-masked-interleaved-mem-accesses", cl::init(true), cl::Hidden,
+    cl::desc("Enable vectorization on interleaved memory accesses with gaps "
+             "or in predicated blocks using masked loads and stores"));
+
 /// Maximum factor for an interleaved memory access.
 static cl::opt<unsigned> MaxInterleaveGroupFactor(
     "max-interleave-group-factor", cl::Hidden,
@@ -717,12 +735,17 @@ void InnerLoopVectorizer::addMetadata(SmallVectorImpl<Value *> &To,
 ///          A[i+3] = d;                         // Member of index 3
 ///        }
 ///
-/// Note: the interleaved load group could have gaps (missing members), but
-/// the interleaved store group doesn't allow gaps.
+/// Note: the interleaved load group could have gaps (missing members). An
+/// interleaved store group, a load group missing its first or last member and
+/// a group in a predicated block are only kept when the target supports masked
+/// loads/stores; such groups are vectorized with a masked wide load/store that
+/// never touches the gaps.
 class InterleaveGroup {
 public:
-  InterleaveGroup(Instruction *Instr, int Stride, unsigned Align)
-      : Align(Align), SmallestKey(0), LargestKey(0), InsertPos(Instr) {
+  InterleaveGroup(Instruction *Instr, int Stride, unsigned Align,
+                  bool Predicated)
+      : Align(Align), SmallestKey(0), LargestKey(0), Predicated(Predicated),
+        InsertPos(Instr) {
     assert(Align && "The alignment should be non-zero");
 
     Factor = std::abs(Stride);
@@ -737,6 +760,23 @@ public:
   unsigned getAlignment() const { return Align; }
   unsigned getNumMembers() const { return Members.size(); }
 
+  /// \brief Return true if the members are conditionally executed.
+  bool isPredicated() const { return Predicated; }
+
+  /// \brief Return true if the group has members missing at some index.
+  bool hasGaps() const { return getNumMembers() != Factor; }
+
+  /// \brief Return true if the wide load/store of this group has to be masked,
+  /// either because the group is predicated or because an unmasked access
+  /// could write to a gap or read past the accessed object.
+  bool requiresMask() const {
+    if (Predicated)
+      return true;
+    if (InsertPos->mayWriteToMemory())
+      return hasGaps();
+    return !getMember(0) || !getMember(Factor - 1);
+  }
+
   /// \brief Try to insert a new member \p Instr with index \p Index and
   /// alignment \p NewAlign. The index is related to the leader and it could be
   /// negative if it is the new leader.
@@ -802,6 +842,7 @@ private:
   DenseMap<int, Instruction *> Members;
   int SmallestKey;
   int LargestKey;
+  bool Predicated;
 
   // To avoid breaking dependences, vectorized instructions of an interleave
   // group should be inserted at either the first load or the last store in
@@ -828,8 +869,8 @@ private:
 class InterleavedAccessInfo {
 public:
   InterleavedAccessInfo(PredicatedScalarEvolution &PSE, Loop *L,
-                        DominatorTree *DT)
-      : PSE(PSE), TheLoop(L), DT(DT) {}
+                        DominatorTree *DT, const TargetTransformInfo *TTI)
+      : PSE(PSE), TheLoop(L), DT(DT), TTI(TTI) {}
 
   ~InterleavedAccessInfo() {
     SmallSet<InterleaveGroup *, 4> DelSet;
@@ -841,8 +882,11 @@ public:
   }
 
   /// \brief Analyze the interleaved accesses and collect them in interleave
-  /// groups. Substitute symbolic strides using \p Strides.
-  void analyzeInterleaving(const ValueToValueMap &Strides);
+  /// groups. Substitute symbolic strides using \p Strides. Accesses in
+  /// predicated blocks are only grouped if they are in \p MaskedOps.
+  void
+  analyzeInterleaving(const ValueToValueMap &Strides,
+                      const SmallPtrSetImpl<const Instruction *> &MaskedOps);
 
   /// \brief Check if \p Instr belongs to any interleave group.
   bool isInterleaved(Instruction *Instr) const {
@@ -866,6 +910,7 @@ private:
   PredicatedScalarEvolution &PSE;
   Loop *TheLoop;
   DominatorTree *DT;
+  const TargetTransformInfo *TTI;
 
   /// Holds the relationships between the members and the interleave group.
   DenseMap<Instruction *, InterleaveGroup *> InterleaveGroupMap;
@@ -873,15 +918,18 @@ private:
   /// \brief The descriptor for a strided memory access.
   struct StrideDescriptor {
     StrideDescriptor(int Stride, const SCEV *Scev, unsigned Size,
-                     unsigned Align)
-        : Stride(Stride), Scev(Scev), Size(Size), Align(Align) {}
+                     unsigned Align, bool Predicated)
+        : Stride(Stride), Scev(Scev), Size(Size), Align(Align),
+          Predicated(Predicated) {}
 
-    StrideDescriptor() : Stride(0), Scev(nullptr), Size(0), Align(0) {}
+    StrideDescriptor()
+        : Stride(0), Scev(nullptr), Size(0), Align(0), Predicated(false) {}
 
     int Stride; // The access's stride. It is negative for a reverse access.
     const SCEV *Scev; // The scalar expression of this access
     unsigned Size;    // The size of the memory object.
     unsigned Align;   // The alignment of this access.
+    bool Predicated;  // The access is in a predicated block.
   };
 
   /// \brief Create a new interleave group with the given instruction \p Instr,
@@ -889,10 +937,11 @@ private:
   ///
   /// \returns the newly created interleave group.
   InterleaveGroup *createInterleaveGroup(Instruction *Instr, int Stride,
-                                         unsigned Align) {
+                                         unsigned Align, bool Predicated) {
     assert(!InterleaveGroupMap.count(Instr) &&
            "Already in an interleaved access group");
-    InterleaveGroupMap[Instr] = new InterleaveGroup(Instr, Stride, Align);
+    InterleaveGroupMap[Instr] =
+        new InterleaveGroup(Instr, Stride, Align, Predicated);
     return InterleaveGroupMap[Instr];
   }
 
@@ -905,10 +954,15 @@ private:
     delete Group;
   }
 
+  /// \brief Return true if \p Group can be vectorized with a masked wide
+  /// load/store on this target.
+  bool canMaskGroup(const InterleaveGroup *Group) const;
+
   /// \brief Collect all the accesses with a constant stride in program order.
   void collectConstStridedAccesses(
       MapVector<Instruction *, StrideDescriptor> &StrideAccesses,
-      const ValueToValueMap &Strides);
+      const ValueToValueMap &Strides,
+      const SmallPtrSetImpl<const Instruction *> &MaskedOps);
 };
 
 /// Utility class for getting and setting loop vectorizer hints in the form
@@ -990,6 +1044,15 @@ public:
     writeHintsToMetadata(Hints);
   }
 
+  /// Request the remainder loop L of a vectorized loop to be vectorized with
+  /// width \p VF and without interleaving.
+  void setEpilogueWidth(unsigned VF) {
+    Width.Value = VF;
+    Interleave.Value = 1;
+    Hint Hints[] = {Width, Interleave};
+    writeHintsToMetadata(Hints);
+  }
+
   bool allowVectorization(Function *F, Loop *L, bool AlwaysVectorize) const {
     if (getForce() == LoopVectorizeHints::FK_Disabled) {
       DEBUG(dbgs() << "LV: Not vectorizing: #pragma vectorize disable.\n");
@@ -1232,7 +1295,7 @@ public:
                             LoopVectorizationRequirements *R,
                             const LoopVectorizeHints *H)
       : NumPredStores(0), TheLoop(L), PSE(PSE), TLI(TLI), TheFunction(F),
-        TTI(TTI), DT(DT), LAA(LAA), LAI(nullptr), InterleaveInfo(PSE, L, DT),
+        TTI(TTI), DT(DT), LAA(LAA), LAI(nullptr), InterleaveInfo(PSE, L, DT, TTI),
         Induction(nullptr), WidestIndTy(nullptr), HasFunNoNaNAttr(false),
         Requirements(R), Hints(H) {}
 
@@ -1384,6 +1447,18 @@ private:
   /// and we know that we can read from them without segfault.
   bool blockCanBePredicated(BasicBlock *BB, SmallPtrSetImpl<Value *> &SafePtrs);
 
+  /// Return true if interleaved accesses are analyzed for this loop.
+  bool useInterleavedAccesses() const;
+
+  /// Return true if the predicated load or store \p I may become a member of
+  /// a masked interleave group. Whether it actually does is only known once
+  /// the groups are formed, see canVectorizeMaskedAccesses().
+  bool mayBeMaskedInterleaved(Instruction *I);
+
+  /// Return true if every access in MaskedOp can be vectorized as a masked
+  /// wide access, a masked interleave group or a gather/scatter.
+  bool canVectorizeMaskedAccesses();
+
   /// \brief Collect memory access with loop invariant strides.
   ///
   /// Looks for accesses like "a[i * StrideA]" where "StrideA" is loop
@@ -1515,6 +1590,13 @@ public:
   unsigned computeInterleaveCount(bool OptForSize, unsigned VF,
                                   unsigned LoopCost);
 
+  /// \return The vectorization factor for the epilogue of the loop once it is
+  /// vectorized with \p MainVF and interleaved \p IC times, or 1 if the
+  /// leftover iterations are better run by the scalar loop. \p TripCount is
+  /// the known or estimated trip count of the loop, or zero if unknown.
+  unsigned selectEpilogueVectorizationFactor(unsigned MainVF, unsigned IC,
+                                             unsigned TripCount);
+
   /// \brief A struct that represents some properties of the register usage
   /// of a loop.
   struct RegisterUsage {
@@ -1640,6 +1722,37 @@ private:
   Instruction *UnsafeAlgebraInst;
 };
 
+/// Estimate the trip count of \p L from the branch weights of its latch.
+/// \returns zero if the latch has no profile data.
+static unsigned getEstimatedTripCount(const Loop *L) {
+  BranchInst *LatchBr =
+      dyn_cast<BranchInst>(L->getLoopLatch()->getTerminator());
+  if (!LatchBr || !LatchBr->isConditional())
+    return 0;
+
+  MDNode *ProfileData = LatchBr->getMetadata(LLVMContext::MD_prof);
+  if (!ProfileData || ProfileData->getNumOperands() != 3)
+    return 0;
+  ConstantInt *TrueWeight =
+      mdconst::dyn_extract<ConstantInt>(ProfileData->getOperand(1));
+  ConstantInt *FalseWeight =
+      mdconst::dyn_extract<ConstantInt>(ProfileData->getOperand(2));
+  if (!TrueWeight || !FalseWeight)
+    return 0;
+
+  uint64_t BackedgeWeight = TrueWeight->getZExtValue();
+  uint64_t ExitWeight = FalseWeight->getZExtValue();
+  if (!L->contains(LatchBr->getSuccessor(0)))
+    std::swap(BackedgeWeight, ExitWeight);
+  if (!ExitWeight)
+    return 0;
+
+  // Each exit ends one execution of the loop, which took the backedge
+  // BackedgeWeight / ExitWeight times on average.
+  uint64_t TripCount = (BackedgeWeight + ExitWeight / 2) / ExitWeight + 1;
+  return TripCount > UINT_MAX ? 0 : TripCount;
+}
+
 static void addInnerLoop(Loop &L, SmallVectorImpl<Loop *> &V) {
   if (L.empty())
     return V.push_back(&L);
@@ -1756,7 +1869,9 @@ struct LoopVectorize : public FunctionPass {
     }
   }
 
-  bool processLoop(Loop *L) {
+  /// Vectorize or interleave \p L if legal and profitable. \p IsEpilogue is
+  /// set when \p L is the remainder loop of a loop vectorized just before.
+  bool processLoop(Loop *L, bool IsEpilogue = false) {
     assert(L->empty() && "Only process inner loops.");
 
 #ifndef NDEBUG
@@ -1795,9 +1910,10 @@ struct LoopVectorize : public FunctionPass {
     }
 
     // Check the loop for a trip count threshold:
-    // do not vectorize loops with a tiny trip count.
+    // do not vectorize loops with a tiny trip count. An epilogue only ever
+    // runs a few iterations, its width was chosen with that in mind.
     const unsigned TC = SE->getSmallConstantTripCount(L);
-    if (TC > 0u && TC < TinyTripCountVectorThreshold) {
+    if (TC > 0u && TC < TinyTripCountVectorThreshold && !IsEpilogue) {
       DEBUG(dbgs() << "LV: Found a loop with a very small trip count. "
                    << "This loop is not worth vectorizing.");
       if (Hints.getForce() == LoopVectorizeHints::FK_Enabled)
@@ -1879,6 +1995,11 @@ struct LoopVectorize : public FunctionPass {
     // Get user interleave count.
     unsigned UserIC = Hints.getInterleave();
 
+    // An epilogue only runs the iterations left by the vector loop, it is
+    // never interleaved.
+    if (IsEpilogue)
+      IC = UserIC = 1;
+
     // Identify the diagnostic messages that should be produced.
     std::string VecDiagMsg, IntDiagMsg;
     bool VectorizeLoop = true, InterleaveLoop = true;
@@ -1942,6 +2063,13 @@ struct LoopVectorize : public FunctionPass {
       DEBUG(dbgs() << "LV: Interleave Count is " << IC << '\n');
     }
 
+    // Pick a narrower vectorization factor for the remainder loop if the
+    // vector loop leaves enough iterations behind.
+    unsigned EpilogueVF = 1;
+    if (VectorizeLoop && EnableEpilogueVectorization && !IsEpilogue)
+      EpilogueVF = CM.selectEpilogueVectorizationFactor(
+          VF.Width, IC, TC ? TC : getEstimatedTripCount(L));
+
     if (!VectorizeLoop) {
       assert(IC > 1 && "interleave count should not be 1 or 0");
       // If we decided that it is not legal to vectorize the loop then
@@ -1971,8 +2099,22 @@ struct LoopVectorize : public FunctionPass {
                                  Twine(IC) + ")");
     }
 
-    // Mark the loop as already vectorized to avoid vectorizing again.
-    Hints.setAlreadyVectorized();
+    if (EpilogueVF > 1) {
+      // L is now the remainder loop. Vectorize it again with the epilogue
+      // width. Its accesses start where the vector loop stopped, so the
+      // cached access analysis is stale.
+      DEBUG(dbgs() << "LV: Vectorizing the epilogue with VF " << EpilogueVF
+                   << ".\n");
+      Hints.setEpilogueWidth(EpilogueVF);
+      LAA->forgetLoop(L);
+      if (processLoop(L, /*IsEpilogue=*/true))
+        ++EpiloguesVectorized;
+      else
+        Hints.setAlreadyVectorized();
+    } else {
+      // Mark the loop as already vectorized to avoid vectorizing again.
+      Hints.setAlreadyVectorized();
+    }
 
     DEBUG(verifyFunction(*L->getHeader()->getParent()));
     return true;
@@ -2213,6 +2355,20 @@ static Constant *getSequentialMask(IRBuilder<> &Builder, unsigned NumInt,
   return ConstantVector::get(Mask);
 }
 
+// Get a mask to replicate each of the \p VF lanes \p Factor times, optionally
+// in reverse lane order.
+// E.g. For a factor of 3, if VF is 4, the mask is:
+//      <0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3>
+static Constant *getReplicatedMask(IRBuilder<> &Builder, unsigned Factor,
+                                   unsigned VF, bool Reverse) {
+  SmallVector<Constant *, 16> Mask;
+  for (unsigned i = 0; i < VF; i++)
+    for (unsigned j = 0; j < Factor; j++)
+      Mask.push_back(Builder.getInt32(Reverse ? VF - 1 - i : i));
+
+  return ConstantVector::get(Mask);
+}
+
 // Concatenate two vectors with the same element type. The 2nd vector should
 // not have more elements than the 1st vector. If the 2nd vector has less
 // elements, extend it with UNDEFs.
@@ -2296,6 +2452,11 @@ static Value *ConcatenateVectors(IRBuilder<> &Builder,
 //   %interleaved.vec = shuffle %R_G.vec, %B_U.vec,
 //        <0, 4, 8, 1, 5, 9, 2, 6, 10, 3, 7, 11>    ; Interleave R,G,B elements
 //   store <12 x i32> %interleaved.vec              ; Write 4 tuples of R,G,B
+//
+// If the group has gaps that must not be accessed or if it is predicated, the
+// wide load/store is masked. The mask enables the lanes of the existing
+// members, and for a predicated group, only in the tuples whose iteration
+// executes the block.
 void InnerLoopVectorizer::vectorizeInterleaveGroup(Instruction *Instr) {
   const InterleaveGroup *Group = Legal->getInterleavedAccessGroup(Instr);
   assert(Group && "Fail to get an interleaved access group.");
@@ -2346,11 +2507,49 @@ void InnerLoopVectorizer::vectorizeInterleaveGroup(Instruction *Instr) {
   setDebugLocFromInst(Builder, Instr);
   Value *UndefVec = UndefValue::get(VecTy);
 
+  // Prepare the masks of a masked group.
+  SmallVector<Value *, 2> Masks;
+  if (Group->requiresMask()) {
+    Constant *GapMask = nullptr;
+    if (Group->hasGaps()) {
+      SmallVector<Constant *, 16> Lanes;
+      for (unsigned i = 0; i < VF; i++)
+        for (unsigned j = 0; j < InterleaveFactor; j++)
+          Lanes.push_back(Builder.getInt1(Group->getMember(j) != nullptr));
+      GapMask = ConstantVector::get(Lanes);
+    }
+
+    VectorParts BlockMask;
+    if (Group->isPredicated())
+      BlockMask = createBlockInMask(Instr->getParent());
+
+    for (unsigned Part = 0; Part < UF; Part++) {
+      Value *Mask = GapMask;
+      if (Group->isPredicated()) {
+        Value *BlockMaskPart = BlockMask[Part];
+        Mask = Builder.CreateShuffleVector(
+            BlockMaskPart, UndefValue::get(BlockMaskPart->getType()),
+            getReplicatedMask(Builder, InterleaveFactor, VF,
+                              Group->isReverse()),
+            "interleaved.mask");
+        if (GapMask)
+          Mask = Builder.CreateAnd(Mask, GapMask);
+      }
+      Masks.push_back(Mask);
+    }
+  }
+
   // Vectorize the interleaved load group.
   if (LI) {
     for (unsigned Part = 0; Part < UF; Part++) {
-      Instruction *NewLoadInstr = Builder.CreateAlignedLoad(
-          NewPtrs[Part], Group->getAlignment(), "wide.vec");
+      Instruction *NewLoadInstr;
+      if (!Masks.empty())
+        NewLoadInstr =
+            Builder.CreateMaskedLoad(NewPtrs[Part], Group->getAlignment(),
+                                     Masks[Part], UndefVec, "wide.masked.vec");
+      else
+        NewLoadInstr = Builder.CreateAlignedLoad(
+            NewPtrs[Part], Group->getAlignment(), "wide.vec");
 
       for (unsigned i = 0; i < InterleaveFactor; i++) {
         Instruction *Member = Group->getMember(i);
@@ -2387,9 +2586,14 @@ void InnerLoopVectorizer::vectorizeInterleaveGroup(Instruction *Instr) {
     // Collect the stored vector from each member.
     SmallVector<Value *, 4> StoredVecs;
     for (unsigned i = 0; i < InterleaveFactor; i++) {
-      // Interleaved store group doesn't allow a gap, so each index has a member
+      // A gap in an interleaved store group is masked off, so its lanes can
+      // hold anything.
       Instruction *Member = Group->getMember(i);
-      assert(Member && "Fail to get a member from an interleaved store group");
+      if (!Member) {
+        assert(!Masks.empty() && "Unmasked interleaved store group with gaps");
+        StoredVecs.push_back(UndefValue::get(SubVT));
+        continue;
+      }
 
       Value *StoredVec =
           getVectorValue(dyn_cast<StoreInst>(Member)->getValueOperand())[Part];
@@ -2411,8 +2615,13 @@ void InnerLoopVectorizer::vectorizeInterleaveGroup(Instruction *Instr) {
     Value *IVec = Builder.CreateShuffleVector(WideVec, UndefVec, IMask,
                                               "interleaved.vec");
 
-    Instruction *NewStoreInstr =
-        Builder.CreateAlignedStore(IVec, NewPtrs[Part], Group->getAlignment());
+    Instruction *NewStoreInstr;
+    if (!Masks.empty())
+      NewStoreInstr = Builder.CreateMaskedStore(
+          IVec, NewPtrs[Part], Group->getAlignment(), Masks[Part]);
+    else
+      NewStoreInstr = Builder.CreateAlignedStore(IVec, NewPtrs[Part],
+                                                 Group->getAlignment());
     addMetadata(NewStoreInstr, Instr);
   }
 }
@@ -3841,7 +4050,9 @@ void InnerLoopVectorizer::fixLCSSAPHIs() {
        LEE = LoopExitBlock->end(); LEI != LEE; ++LEI) {
     PHINode *LCSSAPhi = dyn_cast<PHINode>(LEI);
     if (!LCSSAPhi) break;
-    if (LCSSAPhi->getNumIncomingValues() == 1)
+    // The exit of a vectorized epilogue already has an entry for the middle
+    // block of the main vector loop, so look for ours.
+    if (LCSSAPhi->getBasicBlockIndex(LoopMiddleBlock) == -1)
       LCSSAPhi->addIncoming(UndefValue::get(LCSSAPhi->getType()),
                             LoopMiddleBlock);
   }
@@ -4268,9 +4479,13 @@ void InnerLoopVectorizer::updateAnalysis() {
   // Forget the original basic block.
   PSE.getSE()->forgetLoop(OrigLoop);
 
-  // Update the dominator tree information.
-  assert(DT->properlyDominates(LoopBypassBlocks.front(), LoopExitBlock) &&
-         "Entry does not dominate exit.");
+  // Update the dominator tree information.  The exit block is normally only
+  // reached through the loop, but the exit of a vectorized epilogue is also
+  // reached from the middle block of the main vector loop, which dominates
+  // it then.
+  BasicBlock *ExitIDom = DT->findNearestCommonDominator(
+      DT->getNode(LoopExitBlock)->getIDom()->getBlock(),
+      LoopBypassBlocks.front());
 
   // We don't predicate stores by this point, so the vector body should be a
   // single loop.
@@ -4280,7 +4495,7 @@ void InnerLoopVectorizer::updateAnalysis() {
   DT->addNewBlock(LoopMiddleBlock, LoopVectorBody.back());
   DT->addNewBlock(LoopScalarPreHeader, LoopBypassBlocks[0]);
   DT->changeImmediateDominator(LoopScalarBody, LoopScalarPreHeader);
-  DT->changeImmediateDominator(LoopExitBlock, LoopBypassBlocks[0]);
+  DT->changeImmediateDominator(LoopExitBlock, ExitIDom);
 
   DEBUG(DT->verifyDomTree());
 }
@@ -4443,15 +4658,16 @@ bool LoopVectorizationLegality::canVectorize() {
                        : "")
                << "!\n");
 
-  bool UseInterleaved = TTI->enableInterleavedAccessVectorization();
-
-  // If an override option has been passed in for interleaved accesses, use it.
-  if (EnableInterleavedMemAccesses.getNumOccurrences() > 0)
-    UseInterleaved = EnableInterleavedMemAccesses;
-
   // Analyze interleaved memory accesses.
-  if (UseInterleaved)
-    InterleaveInfo.analyzeInterleaving(Strides);
+  if (useInterleavedAccesses())
+    InterleaveInfo.analyzeInterleaving(Strides, MaskedOp);
+
+  if (!canVectorizeMaskedAccesses()) {
+    emitAnalysis(VectorizationReport()
+                 << "predicated strided access could not be interleaved");
+    DEBUG(dbgs() << "LV: Can't vectorize a predicated strided access.\n");
+    return false;
+  }
 
   unsigned SCEVThreshold = VectorizeSCEVCheckThreshold;
   if (Hints->getForce() == LoopVectorizeHints::FK_Enabled)
@@ -4797,6 +5013,63 @@ bool LoopVectorizationLegality::blockNeedsPredication(BasicBlock *BB)  {
   return LoopAccessInfo::blockNeedsPredication(BB, TheLoop, DT);
 }
 
+bool LoopVectorizationLegality::useInterleavedAccesses() const {
+  // If an override option has been passed in for interleaved accesses, use it.
+  if (EnableInterleavedMemAccesses.getNumOccurrences() > 0)
+    return EnableInterleavedMemAccesses;
+  return TTI->enableInterleavedAccessVectorization();
+}
+
+bool LoopVectorizationLegality::mayBeMaskedInterleaved(Instruction *I) {
+  if (!EnableMaskedInterleavedMemAccesses || !useInterleavedAccesses())
+    return false;
+
+  LoadInst *LI = dyn_cast<LoadInst>(I);
+  StoreInst *SI = dyn_cast<StoreInst>(I);
+  Value *Ptr = LI ? LI->getPointerOperand() : SI->getPointerOperand();
+  Type *DataType = LI ? LI->getType() : SI->getValueOperand()->getType();
+
+  // Only look at the stride here.  isStridedPtr would also have to prove that
+  // the pointer doesn't wrap, which may need the predicates that the memory
+  // dependence analysis has not added yet.  The grouping checks it later.
+  const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(PSE.getSCEV(Ptr));
+  if (!AR || AR->getLoop() != TheLoop)
+    return false;
+  const SCEVConstant *Step =
+      dyn_cast<SCEVConstant>(AR->getStepRecurrence(*PSE.getSE()));
+  if (!Step || Step->getAPInt().getMinSignedBits() > 64)
+    return false;
+  const DataLayout &DL = TheLoop->getHeader()->getModule()->getDataLayout();
+  int64_t Size = DL.getTypeAllocSize(DataType);
+  int64_t StepVal = Step->getAPInt().getSExtValue();
+  if (StepVal % Size)
+    return false;
+  uint64_t Factor = std::abs(StepVal / Size);
+  if (Factor < 2 || Factor > MaxInterleaveGroupFactor ||
+      !isPowerOf2_64(Factor))
+    return false;
+
+  if (LI)
+    return TTI->isLegalMaskedLoad(DataType);
+  return TTI->isLegalMaskedStore(DataType);
+}
+
+bool LoopVectorizationLegality::canVectorizeMaskedAccesses() {
+  for (const Instruction *MaskedI : MaskedOp) {
+    Instruction *I = const_cast<Instruction *>(MaskedI);
+    LoadInst *LI = dyn_cast<LoadInst>(I);
+    StoreInst *SI = dyn_cast<StoreInst>(I);
+    Type *DataType = LI ? LI->getType() : SI->getValueOperand()->getType();
+    Value *Ptr = LI ? LI->getPointerOperand() : SI->getPointerOperand();
+    if (isConsecutivePtr(Ptr) || InterleaveInfo.isInterleaved(I))
+      continue;
+    if (LI ? isLegalMaskedGather(DataType) : isLegalMaskedScatter(DataType))
+      continue;
+    return false;
+  }
+  return true;
+}
+
 bool LoopVectorizationLegality::blockCanBePredicated(BasicBlock *BB,
                                            SmallPtrSetImpl<Value *> &SafePtrs) {
 
@@ -4815,7 +5088,8 @@ bool LoopVectorizationLegality::blockCanBePredicated(BasicBlock *BB,
         return false;
       if (!SafePtrs.count(LI->getPointerOperand())) {
         if (isLegalMaskedLoad(LI->getType(), LI->getPointerOperand()) ||
-            isLegalMaskedGather(LI->getType())) {
+            isLegalMaskedGather(LI->getType()) ||
+            mayBeMaskedInterleaved(LI)) {
           MaskedOp.insert(LI);
           continue;
         }
@@ -4841,7 +5115,8 @@ bool LoopVectorizationLegality::blockCanBePredicated(BasicBlock *BB,
         bool isLegalMaskedOp =
           isLegalMaskedStore(SI->getValueOperand()->getType(),
                              SI->getPointerOperand()) ||
-          isLegalMaskedScatter(SI->getValueOperand()->getType());
+          isLegalMaskedScatter(SI->getValueOperand()->getType()) ||
+          mayBeMaskedInterleaved(SI);
         if (isLegalMaskedOp) {
           --NumPredStores;
           MaskedOp.insert(SI);
@@ -4869,9 +5144,11 @@ bool LoopVectorizationLegality::blockCanBePredicated(BasicBlock *BB,
 
 void InterleavedAccessInfo::collectConstStridedAccesses(
     MapVector<Instruction *, StrideDescriptor> &StrideAccesses,
-    const ValueToValueMap &Strides) {
+    const ValueToValueMap &Strides,
+    const SmallPtrSetImpl<const Instruction *> &MaskedOps) {
   // Holds load/store instructions in program order.
   SmallVector<Instruction *, 16> AccessList;
+  SmallPtrSet<Instruction *, 8> PredicatedAccesses;
 
   for (auto *BB : TheLoop->getBlocks()) {
     bool IsPred = LoopAccessInfo::blockNeedsPredication(BB, TheLoop, DT);
@@ -4879,9 +5156,14 @@ void InterleavedAccessInfo::collectConstStridedAccesses(
     for (auto &I : *BB) {
       if (!isa<LoadInst>(&I) && !isa<StoreInst>(&I))
         continue;
-      // FIXME: Currently we can't handle mixed accesses and predicated accesses
-      if (IsPred)
-        return;
+      if (IsPred) {
+        // A predicated access can only join a group if it is going to be
+        // masked anyway. FIXME: Currently we can't handle mixed accesses and
+        // other predicated accesses.
+        if (!EnableMaskedInterleavedMemAccesses || !MaskedOps.count(&I))
+          return;
+        PredicatedAccesses.insert(&I);
+      }
 
       AccessList.push_back(&I);
     }
@@ -4896,7 +5178,10 @@ void InterleavedAccessInfo::collectConstStridedAccesses(
     StoreInst *SI = dyn_cast<StoreInst>(I);
 
     Value *Ptr = LI ? LI->getPointerOperand() : SI->getPointerOperand();
-    int Stride = isStridedPtr(PSE, Ptr, TheLoop, Strides);
+    // A predicated access can only be vectorized as part of a group, so rather
+    // assume at runtime that its pointer doesn't wrap than scalarize it.
+    int Stride = isStridedPtr(PSE, Ptr, TheLoop, Strides,
+                              /*Assume=*/PredicatedAccesses.count(I));
 
     // The factor of the corresponding interleave group.
     unsigned Factor = std::abs(Stride);
@@ -4914,10 +5199,32 @@ void InterleavedAccessInfo::collectConstStridedAccesses(
     if (!Align)
       Align = DL.getABITypeAlignment(PtrTy->getElementType());
 
-    StrideAccesses[I] = StrideDescriptor(Stride, Scev, Size, Align);
+    StrideAccesses[I] = StrideDescriptor(Stride, Scev, Size, Align,
+                                         PredicatedAccesses.count(I));
   }
 }
 
+bool InterleavedAccessInfo::canMaskGroup(const InterleaveGroup *Group) const {
+  if (!EnableMaskedInterleavedMemAccesses)
+    return false;
+
+  // A group with a single member is better served by a gather/scatter or by
+  // scalarization.
+  if (Group->getNumMembers() < 2)
+    return false;
+
+  // The wide vector has to be a power of two to be legalized as a single
+  // masked operation.
+  if (!isPowerOf2_32(Group->getFactor()))
+    return false;
+
+  Instruction *Leader = Group->getInsertPos();
+  if (LoadInst *LI = dyn_cast<LoadInst>(Leader))
+    return TTI->isLegalMaskedLoad(LI->getType());
+  return TTI->isLegalMaskedStore(
+      cast<StoreInst>(Leader)->getValueOperand()->getType());
+}
+
 // Analyze interleaved accesses and collect them into interleave groups.
 //
 // Notice that the vectorization on interleaved groups will change instruction
@@ -4939,12 +5246,13 @@ void InterleavedAccessInfo::collectConstStridedAccesses(
 // The store group of (2) is always inserted at or below (2), and the load group
 // of (1) is always inserted at or above (1). The dependence is safe.
 void InterleavedAccessInfo::analyzeInterleaving(
-    const ValueToValueMap &Strides) {
+    const ValueToValueMap &Strides,
+    const SmallPtrSetImpl<const Instruction *> &MaskedOps) {
   DEBUG(dbgs() << "LV: Analyzing interleaved accesses...\n");
 
   // Holds all the stride accesses.
   MapVector<Instruction *, StrideDescriptor> StrideAccesses;
-  collectConstStridedAccesses(StrideAccesses, Strides);
+  collectConstStridedAccesses(StrideAccesses, Strides, MaskedOps);
 
   if (StrideAccesses.empty())
     return;
@@ -4975,7 +5283,8 @@ void InterleavedAccessInfo::analyzeInterleaving(
     InterleaveGroup *Group = getInterleaveGroup(A);
     if (!Group) {
       DEBUG(dbgs() << "LV: Creating an interleave group with:" << *A << '\n');
-      Group = createInterleaveGroup(A, DesA.Stride, DesA.Align);
+      Group = createInterleaveGroup(A, DesA.Stride, DesA.Align,
+                                    DesA.Predicated);
     }
 
     if (A->mayWriteToMemory())
@@ -4995,6 +5304,11 @@ void InterleavedAccessInfo::analyzeInterleaving(
       if (DesB.Stride != DesA.Stride || DesB.Size != DesA.Size)
         continue;
 
+      // Members of a predicated group share the mask of a single block.
+      if ((DesA.Predicated || DesB.Predicated) &&
+          A->getParent() != B->getParent())
+        continue;
+
       // Calculate the distance and prepare for the rule 3.
       const SCEVConstant *DistToA = dyn_cast<SCEVConstant>(
           PSE.getSE()->getMinusSCEV(DesB.Scev, DesA.Scev));
@@ -5025,15 +5339,17 @@ void InterleavedAccessInfo::analyzeInterleaving(
     } // Iteration on instruction B
   }   // Iteration on instruction A
 
-  // Remove interleaved store groups with gaps.
+  // Remove interleaved store groups with gaps, unless the stores can be
+  // masked so that the gaps are left untouched.
   for (InterleaveGroup *Group : StoreGroups)
-    if (Group->getNumMembers() != Group->getFactor())
+    if (Group->requiresMask() && !canMaskGroup(Group))
       releaseGroup(Group);
 
-  // Remove interleaved load groups that don't have the first and last member.
-  // This guarantees that we won't do speculative out of bounds loads.
+  // Remove interleaved load groups that don't have the first and last member,
+  // unless the loads can be masked. This guarantees that we won't do
+  // speculative out of bounds loads.
   for (InterleaveGroup *Group : LoadGroups)
-    if (!Group->getMember(0) || !Group->getMember(Group->getFactor() - 1))
+    if (Group->requiresMask() && !canMaskGroup(Group))
       releaseGroup(Group);
 }
 
@@ -5386,6 +5702,36 @@ unsigned LoopVectorizationCostModel::selectInterleaveCount(bool OptForSize,
   return 1;
 }
 
+unsigned LoopVectorizationCostModel::selectEpilogueVectorizationFactor(
+    unsigned MainVF, unsigned IC, unsigned TripCount) {
+  unsigned MainStep = MainVF * IC;
+  if (MainStep < EpilogueVectorizationMinStep)
+    return 1;
+
+  // The number of iterations the main vector loop leaves to its remainder.
+  // Without a trip count, anything below the step of the vector loop is
+  // possible.
+  unsigned Leftover = TripCount ? TripCount % MainStep : MainStep - 1;
+
+  // The epilogue is itself a loop, so with interleaving it can run at the
+  // main VF; otherwise it has to be narrower to be of any use.
+  unsigned ScalarCost = expectedCost(1);
+  for (unsigned VF = IC > 1 ? MainVF : MainVF / 2; VF >= 2; VF /= 2) {
+    if (VF > Leftover)
+      continue;
+    float VectorCost = expectedCost(VF) / (float)VF;
+    DEBUG(dbgs() << "LV: Epilogue loop of width " << VF << " costs: "
+                 << (int)VectorCost << ".\n");
+    if (VectorCost < ScalarCost) {
+      DEBUG(dbgs() << "LV: Selecting epilogue VF: " << VF << ".\n");
+      return VF;
+    }
+  }
+
+  DEBUG(dbgs() << "LV: Not vectorizing the epilogue.\n");
+  return 1;
+}
+
 SmallVector<LoopVectorizationCostModel::RegisterUsage, 8>
 LoopVectorizationCostModel::calculateRegisterUsage(
     const SmallVector<unsigned, 8> &VFs) {
@@ -5796,7 +6142,8 @@ LoopVectorizationCostModel::getInstructionCost(Instruction *I, unsigned VF) {
                           VectorTy->getVectorNumElements() * InterleaveFactor);
 
       // Holds the indices of existing members in an interleaved load group.
-      // An interleaved store group doesn't need this as it dones't allow gaps.
+      // An interleaved store group doesn't need this as its gaps, if any, are
+      // masked off and still cost a full shuffle.
       SmallVector<unsigned, 4> Indices;
       if (LI) {
         for (unsigned i = 0; i < InterleaveFactor; i++)
@@ -5814,6 +6161,18 @@ LoopVectorizationCostModel::getInstructionCost(Instruction *I, unsigned VF) {
             Group->getNumMembers() *
             TTI.getShuffleCost(TargetTransformInfo::SK_Reverse, VectorTy, 0);
 
+      // A masked group pays for the masked wide access instead of the plain
+      // one.
+      if (Group->requiresMask()) {
+        int MaskedCost =
+            TTI.getMaskedMemoryOpCost(I->getOpcode(), WideVecTy,
+                                      Group->getAlignment(), AS);
+        int PlainCost = TTI.getMemoryOpCost(I->getOpcode(), WideVecTy,
+                                            Group->getAlignment(), AS);
+        if (MaskedCost > PlainCost)
+          Cost += MaskedCost - PlainCost;
+      }
+
       // FIXME: The interleaved load group with a huge gap could be even more
       // expensive than scalar operations. Then we could ignore such group and
       // use scalar operations instead.
@@ -28,6 +28,7 @@
 #include "llvm/Analysis/LoopAccessAnalysis.h"
 #include "llvm/Analysis/LoopAccessAnalysis.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/OrderedBasicBlock.h"
 #include "llvm/Analysis/ScalarEvolution.h"
 #include "llvm/Analysis/ScalarEvolutionExpressions.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
@@ -40,6 +41,7 @@
 #include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/NoFolder.h"
+#include "llvm/IR/PatternMatch.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Value.h"
 #include "llvm/IR/Verifier.h"
@@ -89,10 +91,12 @@ static cl::opt<int> MinVectorRegSizeOption(
     "slp-min-reg-size", cl::init(128), cl::Hidden,
     cl::desc("Attempt to vectorize for this register size in bits"));
 
-namespace {
+/// Limits the depth of the trees built from the seeds.
+static cl::opt<unsigned> RecursionMaxDepth(
+    "slp-recursion-max-depth", cl::init(12), cl::Hidden,
+    cl::desc("Limit the recursion depth when building a vectorizable tree"));
 
-// FIXME: Set this via cl::opt to allow overriding.
-static const unsigned RecursionMaxDepth = 12;
+namespace {
 
 // Limit the number of alias checks. The limit is chosen so that
 // it has no negative effect on the llvm benchmarks.
@@ -758,6 +762,10 @@ private:
         ScheduleRegionSizeLimit = MinScheduleRegionSize;
       ScheduleRegionSize = 0;
 
+      // Vectorizing the previous tree may have moved instructions around, so
+      // the instruction order has to be computed again.
+      OrderedBB.reset();
+
       // Make a new scheduling region, i.e. all existing ScheduleData is not
       // in the new region yet.
       ++SchedulingRegionID;
@@ -895,6 +903,10 @@ private:
     /// The maximum size allowed for the scheduling region.
     int ScheduleRegionSizeLimit;
 
+    /// Lazily computed instruction order of the block, used to find out in
+    /// which direction the scheduling region has to be extended.
+    std::unique_ptr<OrderedBasicBlock> OrderedBB;
+
     /// The ID of the scheduling region. For a new vectorization iteration this
     /// is incremented which "removes" all ScheduleData from the region.
     int SchedulingRegionID;
@@ -1705,7 +1717,11 @@ bool BoUpSLP::isFullyVectorizableTinyTree() {
   DEBUG(dbgs() << "SLP: Check whether the tree with height " <<
         VectorizableTree.size() << " is fully vectorizable .\n");
 
-  // We only handle trees of height 2.
+  // We only handle trees of heights 1 and 2.  A tree of height 1 is a
+  // single bundle, e.g. the loads feeding a horizontal reduction.
+  if (VectorizableTree.size() == 1 && !VectorizableTree[0].NeedToGather)
+    return true;
+
   if (VectorizableTree.size() != 2)
     return false;
 
@@ -2859,41 +2875,40 @@ bool BoUpSLP::BlockScheduling::extendSchedulingRegion(Value *V) {
     DEBUG(dbgs() << "SLP:  initialize schedule region to " << *I << "\n");
     return true;
   }
-  // Search up and down at the same time, because we don't know if the new
-  // instruction is above or below the existing scheduling region.
-  BasicBlock::reverse_iterator UpIter(ScheduleStart->getIterator());
-  BasicBlock::reverse_iterator UpperEnd = BB->rend();
-  BasicBlock::iterator DownIter(ScheduleEnd);
-  BasicBlock::iterator LowerEnd = BB->end();
-  for (;;) {
-    if (++ScheduleRegionSize > ScheduleRegionSizeLimit) {
+  // Find out on which side of the existing scheduling region the new
+  // instruction is, instead of searching up and down at the same time. Only
+  // the instructions which are actually added to the region count against the
+  // region size limit, so large blocks don't exhaust it with searching.
+  if (!OrderedBB)
+    OrderedBB = llvm::make_unique<OrderedBasicBlock>(BB);
+  if (OrderedBB->dominates(I, ScheduleStart)) {
+    int NewSize = ScheduleRegionSize;
+    for (Instruction *J = I; J != ScheduleStart; J = J->getNextNode())
+      if (++NewSize > ScheduleRegionSizeLimit) {
+        DEBUG(dbgs() << "SLP:  exceeded schedule region size limit\n");
+        return false;
+      }
+    ScheduleRegionSize = NewSize;
+    initScheduleData(I, ScheduleStart, nullptr, FirstLoadStoreInRegion);
+    ScheduleStart = I;
+    DEBUG(dbgs() << "SLP:  extend schedule region start to " << *I << "\n");
+    return true;
+  }
+  int NewSize = ScheduleRegionSize;
+  for (Instruction *J = ScheduleEnd; J != I->getNextNode();
+       J = J->getNextNode()) {
+    assert(J && "instruction not found in block");
+    if (++NewSize > ScheduleRegionSizeLimit) {
       DEBUG(dbgs() << "SLP:  exceeded schedule region size limit\n");
       return false;
     }
-
-    if (UpIter != UpperEnd) {
-      if (&*UpIter == I) {
-        initScheduleData(I, ScheduleStart, nullptr, FirstLoadStoreInRegion);
-        ScheduleStart = I;
-        DEBUG(dbgs() << "SLP:  extend schedule region start to " << *I << "\n");
-        return true;
-      }
-      UpIter++;
-    }
-    if (DownIter != LowerEnd) {
-      if (&*DownIter == I) {
-        initScheduleData(ScheduleEnd, I->getNextNode(), LastLoadStoreInRegion,
-                         nullptr);
-        ScheduleEnd = I->getNextNode();
-        assert(ScheduleEnd && "tried to vectorize a TerminatorInst?");
-        DEBUG(dbgs() << "SLP:  extend schedule region end to " << *I << "\n");
-        return true;
-      }
-      DownIter++;
-    }
-    assert((UpIter != UpperEnd || DownIter != LowerEnd) &&
-           "instruction not found in block");
   }
+  ScheduleRegionSize = NewSize;
+  initScheduleData(ScheduleEnd, I->getNextNode(), LastLoadStoreInRegion,
+                   nullptr);
+  ScheduleEnd = I->getNextNode();
+  assert(ScheduleEnd && "tried to vectorize a TerminatorInst?");
+  DEBUG(dbgs() << "SLP:  extend schedule region end to " << *I << "\n");
   return true;
 }
 
@@ -3875,9 +3890,9 @@ static Value *createRdxShuffleMask(unsigned VecLen, unsigned NumEltsToRdx,
 
 /// Model horizontal reductions.
 ///
-/// A horizontal reduction is a tree of reduction operations (currently add and
-/// fadd) that has operations that can be put into a vector as its leaf.
-/// For example, this tree:
+/// A horizontal reduction is a tree of reduction operations (currently add,
+/// fadd and min/max) that has operations that can be put into a vector as its
+/// leaf. For example, this tree:
 ///
 /// mul mul mul mul
 ///  \  /    \  /
@@ -3900,15 +3915,31 @@ static Value *createRdxShuffleMask(unsigned VecLen, unsigned NumEltsToRdx,
 ///     |
 ///   *p =
 ///
+/// A min/max reduction operation is a select of a compare of the same two
+/// operands, e.g. "select (icmp sgt a, b), a, b", and is matched as a whole.
+///
 class HorizontalReduction {
   SmallVector<Value *, 16> ReductionOps;
   SmallVector<Value *, 32> ReducedVals;
 
-  BinaryOperator *ReductionRoot;
+  Instruction *ReductionRoot;
   PHINode *ReductionPHI;
 
+  /// The kinds of min/max reductions.
+  enum MinMaxKind {
+    MMK_None,
+    MMK_SMin,
+    MMK_SMax,
+    MMK_UMin,
+    MMK_UMax,
+    MMK_FMin,
+    MMK_FMax
+  };
+
   /// The opcode of the reduction.
   unsigned ReductionOpcode;
+  /// The kind of min/max computed by the reduction if its opcode is a select.
+  MinMaxKind ReductionMinMaxKind;
   /// The opcode of the values we perform a reduction on.
   unsigned ReducedValueOpcode;
   /// Should we model this reduction as a pairwise reduction tree or a tree that
@@ -3925,72 +3956,83 @@ public:
 
   HorizontalReduction(unsigned MinVecRegSize)
       : ReductionRoot(nullptr), ReductionPHI(nullptr), ReductionOpcode(0),
-        ReducedValueOpcode(0), IsPairwiseReduction(false), ReduxWidth(0),
+        ReductionMinMaxKind(MMK_None), ReducedValueOpcode(0),
+        IsPairwiseReduction(false), ReduxWidth(0),
         MinVecRegSize(MinVecRegSize) {}
 
   /// \brief Try to find a reduction tree.
-  bool matchAssociativeReduction(PHINode *Phi, BinaryOperator *B) {
+  bool matchAssociativeReduction(PHINode *Phi, Instruction *Root) {
     assert((!Phi ||
-            std::find(Phi->op_begin(), Phi->op_end(), B) != Phi->op_end()) &&
-           "Thi phi needs to use the binary operator");
+            std::find(Phi->op_begin(), Phi->op_end(), Root) != Phi->op_end()) &&
+           "Thi phi needs to use the reduction operation");
+
+    // The operands of a min/max are the true and false values of the select.
+    unsigned FirstOperand = isa<SelectInst>(Root) ? 1 : 0;
 
     // We could have a initial reductions that is not an add.
     //  r *= v1 + v2 + v3 + v4
     // In such a case start looking for a tree rooted in the first '+'.
     if (Phi) {
-      if (B->getOperand(0) == Phi) {
+      if (Root->getOperand(FirstOperand) == Phi) {
         Phi = nullptr;
-        B = dyn_cast<BinaryOperator>(B->getOperand(1));
-      } else if (B->getOperand(1) == Phi) {
+        Root = dyn_cast<Instruction>(Root->getOperand(FirstOperand + 1));
+      } else if (Root->getOperand(FirstOperand + 1) == Phi) {
         Phi = nullptr;
-        B = dyn_cast<BinaryOperator>(B->getOperand(0));
+        Root = dyn_cast<Instruction>(Root->getOperand(FirstOperand));
       }
     }
 
-    if (!B)
+    if (!Root || !(isa<BinaryOperator>(Root) || isa<SelectInst>(Root)))
       return false;
 
-    Type *Ty = B->getType();
+    Type *Ty = Root->getType();
     if (!isValidElementType(Ty))
       return false;
 
-    const DataLayout &DL = B->getModule()->getDataLayout();
-    ReductionOpcode = B->getOpcode();
+    const DataLayout &DL = Root->getModule()->getDataLayout();
+    ReductionOpcode = Root->getOpcode();
+    ReductionMinMaxKind = getMinMaxKind(Root);
     ReducedValueOpcode = 0;
     // FIXME: Register size should be a parameter to this function, so we can
     // try different vectorization factors.
     ReduxWidth = MinVecRegSize / DL.getTypeSizeInBits(Ty);
-    ReductionRoot = B;
+    ReductionRoot = Root;
     ReductionPHI = Phi;
 
     if (ReduxWidth < 4)
       return false;
 
-    // We currently only support adds.
+    // We currently only support adds and min/max.
     if (ReductionOpcode != Instruction::Add &&
-        ReductionOpcode != Instruction::FAdd)
+        ReductionOpcode != Instruction::FAdd &&
+        ReductionMinMaxKind == MMK_None)
       return false;
 
-    // Post order traverse the reduction tree starting at B. We only handle true
-    // trees containing only binary operators or selects.
+    // The operands of a min/max node are used by both the compare and the
+    // select of their parent.
+    FirstOperand = ReductionMinMaxKind == MMK_None ? 0 : 1;
+    unsigned NumUses = ReductionMinMaxKind == MMK_None ? 1 : 2;
+
+    // Post order traverse the reduction tree starting at Root. We only handle
+    // true trees containing only binary operators or selects.
     SmallVector<std::pair<Instruction *, unsigned>, 32> Stack;
-    Stack.push_back(std::make_pair(B, 0));
+    Stack.push_back(std::make_pair(Root, FirstOperand));
     while (!Stack.empty()) {
       Instruction *TreeN = Stack.back().first;
       unsigned EdgeToVist = Stack.back().second++;
-      bool IsReducedValue = TreeN->getOpcode() != ReductionOpcode;
+      bool IsReducedValue = !isReductionOp(TreeN);
 
       // Only handle trees in the current basic block.
-      if (TreeN->getParent() != B->getParent())
+      if (TreeN->getParent() != Root->getParent())
         return false;
 
       // Each tree node needs to have one user except for the ultimate
       // reduction.
-      if (!TreeN->hasOneUse() && TreeN != B)
+      if (!TreeN->hasNUses(NumUses) && TreeN != Root)
         return false;
 
       // Postorder vist.
-      if (EdgeToVist == 2 || IsReducedValue) {
+      if (EdgeToVist == FirstOperand + 2 || IsReducedValue) {
         if (IsReducedValue) {
           // Make sure that the opcodes of the operations that we are going to
           // reduce match.
@@ -3999,6 +4041,14 @@ public:
           else if (ReducedValueOpcode != TreeN->getOpcode())
             return false;
           ReducedVals.push_back(TreeN);
+        } else if (ReductionMinMaxKind != MMK_None) {
+          // The compare goes away with the select, so it must not have any
+          // other users.
+          auto *Cmp = cast<Instruction>(cast<SelectInst>(TreeN)->getCondition());
+          if (!Cmp->hasOneUse() || Cmp->getParent() != Root->getParent())
+            return false;
+          ReductionOps.push_back(Cmp);
+          ReductionOps.push_back(TreeN);
         } else {
           // We need to be able to reassociate the adds.
           if (!TreeN->isAssociative())
@@ -4013,9 +4063,10 @@ public:
       // Visit left or right.
       Value *NextV = TreeN->getOperand(EdgeToVist);
       // We currently only allow BinaryOperator's and SelectInst's as reduction
-      // values in our tree.
-      if (isa<BinaryOperator>(NextV) || isa<SelectInst>(NextV))
-        Stack.push_back(std::make_pair(cast<Instruction>(NextV), 0));
+      // values in our tree. Min/max reductions may also reduce loads.
+      if (isa<BinaryOperator>(NextV) || isa<SelectInst>(NextV) ||
+          (ReductionMinMaxKind != MMK_None && isa<LoadInst>(NextV)))
+        Stack.push_back(std::make_pair(cast<Instruction>(NextV), FirstOperand));
       else if (NextV != Phi)
         return false;
     }
@@ -4039,7 +4090,14 @@ public:
     Builder.setFastMathFlags(Unsafe);
     unsigned i = 0;
 
-    for (; i < NumReducedVals - ReduxWidth + 1; i += ReduxWidth) {
+    while (i < NumReducedVals) {
+      // Reduce the values that are left over from the full width with a
+      // narrower vector, as long as it still has at least four lanes.
+      while (ReduxWidth > NumReducedVals - i)
+        ReduxWidth /= 2;
+      if (ReduxWidth < 4)
+        break;
+
       V.buildTree(makeArrayRef(&ReducedVals[i], ReduxWidth), ReductionOps);
       V.computeMinimumValueSizes();
 
@@ -4059,10 +4117,11 @@ public:
       Value *ReducedSubTree = emitReduction(VectorizedRoot, Builder);
       if (VectorizedTree) {
         Builder.SetCurrentDebugLocation(Loc);
-        VectorizedTree = createBinOp(Builder, ReductionOpcode, VectorizedTree,
-                                     ReducedSubTree, "bin.rdx");
+        VectorizedTree =
+            createOp(Builder, VectorizedTree, ReducedSubTree, "bin.rdx");
       } else
         VectorizedTree = ReducedSubTree;
+      i += ReduxWidth;
     }
 
     if (VectorizedTree) {
@@ -4070,14 +4129,19 @@ public:
       for (; i < NumReducedVals; ++i) {
         Builder.SetCurrentDebugLocation(
           cast<Instruction>(ReducedVals[i])->getDebugLoc());
-        VectorizedTree = createBinOp(Builder, ReductionOpcode, VectorizedTree,
-                                     ReducedVals[i]);
+        VectorizedTree = createOp(Builder, VectorizedTree, ReducedVals[i]);
       }
       // Update users.
-      if (ReductionPHI) {
+      if (ReductionPHI && ReductionMinMaxKind == MMK_None) {
         assert(ReductionRoot && "Need a reduction operation");
         ReductionRoot->setOperand(0, VectorizedTree);
         ReductionRoot->setOperand(1, ReductionPHI);
+      } else if (ReductionPHI) {
+        // The compare of the root has to be replaced as well, so build a new
+        // root instead.
+        Builder.SetCurrentDebugLocation(ReductionRoot->getDebugLoc());
+        ReductionRoot->replaceAllUsesWith(
+            createOp(Builder, VectorizedTree, ReductionPHI, "op.rdx"));
       } else
         ReductionRoot->replaceAllUsesWith(VectorizedTree);
     }
@@ -4089,20 +4153,94 @@ public:
   }
 
 private:
+  /// \returns the kind of min/max computed by \p I if it is a select of a
+  /// compare of its two value operands. Floating point min/max can only be
+  /// reassociated if NaNs don't have to be honored.
+  static MinMaxKind getMinMaxKind(Instruction *I) {
+    using namespace PatternMatch;
+    auto *Select = dyn_cast<SelectInst>(I);
+    if (!Select || !isa<CmpInst>(Select->getCondition()) ||
+        Select->getType()->isPointerTy())
+      return MMK_None;
+
+    Value *L, *R;
+    if (match(Select, m_SMin(m_Value(L), m_Value(R))))
+      return MMK_SMin;
+    if (match(Select, m_SMax(m_Value(L), m_Value(R))))
+      return MMK_SMax;
+    if (match(Select, m_UMin(m_Value(L), m_Value(R))))
+      return MMK_UMin;
+    if (match(Select, m_UMax(m_Value(L), m_Value(R))))
+      return MMK_UMax;
+
+    auto *Cmp = dyn_cast<FCmpInst>(Select->getCondition());
+    if (!Cmp)
+      return MMK_None;
+    const Function *F = I->getParent()->getParent();
+    if (!Cmp->hasNoNaNs() &&
+        F->getFnAttribute("no-nans-fp-math").getValueAsString() != "true")
+      return MMK_None;
+    if (match(Select, m_OrdFMin(m_Value(L), m_Value(R))) ||
+        match(Select, m_UnordFMin(m_Value(L), m_Value(R))))
+      return MMK_FMin;
+    if (match(Select, m_OrdFMax(m_Value(L), m_Value(R))) ||
+        match(Select, m_UnordFMax(m_Value(L), m_Value(R))))
+      return MMK_FMax;
+    return MMK_None;
+  }
+
+  /// \returns true if \p I is an operation of this reduction.
+  bool isReductionOp(Instruction *I) const {
+    if (ReductionMinMaxKind != MMK_None)
+      return getMinMaxKind(I) == ReductionMinMaxKind;
+    return I->getOpcode() == ReductionOpcode;
+  }
+
+  /// \returns the cost of a compare and select pair computing a min/max of
+  /// type \p Ty.
+  static int getMinMaxCost(TargetTransformInfo *TTI, Type *Ty) {
+    Type *CondTy = Type::getInt1Ty(Ty->getContext());
+    if (Ty->isVectorTy())
+      CondTy = VectorType::get(CondTy, Ty->getVectorNumElements());
+    unsigned CmpOpcode = Ty->getScalarType()->isFloatingPointTy()
+                             ? Instruction::FCmp
+                             : Instruction::ICmp;
+    return TTI->getCmpSelInstrCost(CmpOpcode, Ty, CondTy) +
+           TTI->getCmpSelInstrCost(Instruction::Select, Ty, CondTy);
+  }
+
   /// \brief Calculate the cost of a reduction.
   int getReductionCost(TargetTransformInfo *TTI, Value *FirstReducedVal) {
     Type *ScalarTy = FirstReducedVal->getType();
     Type *VecTy = VectorType::get(ScalarTy, ReduxWidth);
 
-    int PairwiseRdxCost = TTI->getReductionCost(ReductionOpcode, VecTy, true);
-    int SplittingRdxCost = TTI->getReductionCost(ReductionOpcode, VecTy, false);
+    int PairwiseRdxCost, SplittingRdxCost, ScalarReduxCost;
+    if (ReductionMinMaxKind == MMK_None) {
+      PairwiseRdxCost = TTI->getReductionCost(ReductionOpcode, VecTy, true);
+      SplittingRdxCost = TTI->getReductionCost(ReductionOpcode, VecTy, false);
+      ScalarReduxCost =
+          ReduxWidth * TTI->getArithmeticInstrCost(ReductionOpcode, VecTy);
+    } else {
+      // There is no target hook for min/max reductions, so model them like
+      // the generic reduction cost: a shuffle (two for the pairwise form) and
+      // a vector min/max per level, plus the final extract.
+      int NumReduxLevels = Log2_32(ReduxWidth);
+      int ShuffleCost = TTI->getShuffleCost(
+          TargetTransformInfo::SK_ExtractSubvector, VecTy, ReduxWidth / 2,
+          VecTy);
+      int VecMinMaxCost = getMinMaxCost(TTI, VecTy);
+      int ExtractCost =
+          TTI->getVectorInstrCost(Instruction::ExtractElement, VecTy, 0);
+      PairwiseRdxCost =
+          NumReduxLevels * (2 * ShuffleCost + VecMinMaxCost) + ExtractCost;
+      SplittingRdxCost =
+          NumReduxLevels * (ShuffleCost + VecMinMaxCost) + ExtractCost;
+      ScalarReduxCost = (ReduxWidth - 1) * getMinMaxCost(TTI, ScalarTy);
+    }
 
     IsPairwiseReduction = PairwiseRdxCost < SplittingRdxCost;
     int VecReduxCost = IsPairwiseReduction ? PairwiseRdxCost : SplittingRdxCost;
 
-    int ScalarReduxCost =
-        ReduxWidth * TTI->getArithmeticInstrCost(ReductionOpcode, VecTy);
-
     DEBUG(dbgs() << "SLP: Adding cost " << VecReduxCost - ScalarReduxCost
                  << " for reduction that starts with " << *FirstReducedVal
                  << " (It is a "
@@ -4119,6 +4257,36 @@ private:
     return Builder.CreateBinOp((Instruction::BinaryOps)Opcode, L, R, Name);
   }
 
+  /// \brief Emit a reduction operation of \p L and \p R. Min/max are emitted
+  /// as a compare and a select.
+  Value *createOp(IRBuilder<> &Builder, Value *L, Value *R,
+                  const Twine &Name = "") {
+    Value *Cmp = nullptr;
+    switch (ReductionMinMaxKind) {
+    case MMK_None:
+      return createBinOp(Builder, ReductionOpcode, L, R, Name);
+    case MMK_SMin:
+      Cmp = Builder.CreateICmpSLT(L, R);
+      break;
+    case MMK_SMax:
+      Cmp = Builder.CreateICmpSGT(L, R);
+      break;
+    case MMK_UMin:
+      Cmp = Builder.CreateICmpULT(L, R);
+      break;
+    case MMK_UMax:
+      Cmp = Builder.CreateICmpUGT(L, R);
+      break;
+    case MMK_FMin:
+      Cmp = Builder.CreateFCmpOLT(L, R);
+      break;
+    case MMK_FMax:
+      Cmp = Builder.CreateFCmpOGT(L, R);
+      break;
+    }
+    return Builder.CreateSelect(Cmp, L, R, Name);
+  }
+
   /// \brief Emit a horizontal reduction of the vectorized value.
   Value *emitReduction(Value *VectorizedValue, IRBuilder<> &Builder) {
     assert(VectorizedValue && "Need to have a vectorized tree node");
@@ -4138,14 +4306,13 @@ private:
         Value *RightShuf = Builder.CreateShuffleVector(
           TmpVec, UndefValue::get(TmpVec->getType()), (RightMask),
           "rdx.shuf.r");
-        TmpVec = createBinOp(Builder, ReductionOpcode, LeftShuf, RightShuf,
-                             "bin.rdx");
+        TmpVec = createOp(Builder, LeftShuf, RightShuf, "bin.rdx");
       } else {
         Value *UpperHalf =
           createRdxShuffleMask(ReduxWidth, i, false, false, Builder);
         Value *Shuf = Builder.CreateShuffleVector(
           TmpVec, UndefValue::get(TmpVec->getType()), UpperHalf, "rdx.shuf");
-        TmpVec = createBinOp(Builder, ReductionOpcode, TmpVec, Shuf, "bin.rdx");
+        TmpVec = createOp(Builder, TmpVec, Shuf, "bin.rdx");
       }
     }
 
@@ -4249,18 +4416,18 @@ static Value *getReductionValue(const DominatorTree *DT, PHINode *P,
 
 /// \brief Attempt to reduce a horizontal reduction.
 /// If it is legal to match a horizontal reduction feeding
-/// the phi node P with reduction operators BI, then check if it
+/// the phi node P with reduction operation Root, then check if it
 /// can be done.
 /// \returns true if a horizontal reduction was matched and reduced.
 /// \returns false if a horizontal reduction was not matched.
-static bool canMatchHorizontalReduction(PHINode *P, BinaryOperator *BI,
+static bool canMatchHorizontalReduction(PHINode *P, Instruction *Root,
                                         BoUpSLP &R, TargetTransformInfo *TTI,
                                         unsigned MinRegSize) {
   if (!ShouldVectorizeHor)
     return false;
 
   HorizontalReduction HorRdx(MinRegSize);
-  if (!HorRdx.matchAssociativeReduction(P, BI))
+  if (!HorRdx.matchAssociativeReduction(P, Root))
     return false;
 
   // If there is a sufficient number of reduction values, reduce
@@ -4341,19 +4508,23 @@ bool SLPVectorizer::vectorizeChainsInBlock(BasicBlock *BB, BoUpSLP &R) {
 
       Value *Rdx = getReductionValue(DT, P, BB, LI);
 
-      // Check if this is a Binary Operator.
-      BinaryOperator *BI = dyn_cast_or_null<BinaryOperator>(Rdx);
-      if (!BI)
+      // Check if this is a Binary Operator or a select that may be a min/max.
+      if (!Rdx || !(isa<BinaryOperator>(Rdx) || isa<SelectInst>(Rdx)))
         continue;
 
       // Try to match and vectorize a horizontal reduction.
-      if (canMatchHorizontalReduction(P, BI, R, TTI, MinVecRegSize)) {
+      if (canMatchHorizontalReduction(P, cast<Instruction>(Rdx), R, TTI,
+                                      MinVecRegSize)) {
         Changed = true;
         it = BB->begin();
         e = BB->end();
         continue;
       }
 
+      BinaryOperator *BI = dyn_cast<BinaryOperator>(Rdx);
+      if (!BI)
+        continue;
+
      Value *Inst = BI->getOperand(0);
       if (Inst == P)
         Inst = BI->getOperand(1);
@@ -4372,11 +4543,12 @@ bool SLPVectorizer::vectorizeChainsInBlock(BasicBlock *BB, BoUpSLP &R) {
 
     if (ShouldStartVectorizeHorAtStore)
       if (StoreInst *SI = dyn_cast<StoreInst>(it))
-        if (BinaryOperator *BinOp =
-                dyn_cast<BinaryOperator>(SI->getValueOperand())) {
-          if (canMatchHorizontalReduction(nullptr, BinOp, R, TTI,
+        if (isa<BinaryOperator>(SI->getValueOperand()) ||
+            isa<SelectInst>(SI->getValueOperand())) {
+          Instruction *Val = cast<Instruction>(SI->getValueOperand());
+          if (canMatchHorizontalReduction(nullptr, Val, R, TTI,
                                           MinVecRegSize) ||
-              tryToVectorize(BinOp, R)) {
+              tryToVectorize(dyn_cast<BinaryOperator>(Val), R)) {
             Changed = true;
             it = BB->begin();
             e = BB->end();
@@ -4399,6 +4571,18 @@ bool SLPVectorizer::vectorizeChainsInBlock(BasicBlock *BB, BoUpSLP &R) {
           }
         }
 
+    // Try to vectorize min/max reductions feeding into a return.
+    if (ReturnInst *RI = dyn_cast<ReturnInst>(it))
+      if (RI->getNumOperands() != 0)
+        if (SelectInst *Sel = dyn_cast<SelectInst>(RI->getOperand(0)))
+          if (canMatchHorizontalReduction(nullptr, Sel, R, TTI,
+                                          MinVecRegSize)) {
+            Changed = true;
+            it = BB->begin();
+            e = BB->end();
+            continue;
+          }
+
     // Try to vectorize trees that start at compare instructions.
     if (CmpInst *CI = dyn_cast<CmpInst>(it)) {
       if (tryToVectorizePair(CI->getOperand(0), CI->getOperand(1), R)) {
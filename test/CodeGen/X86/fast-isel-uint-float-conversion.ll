@@ -0,0 +1,68 @@
+; RUN: llc -mtriple=x86_64-unknown-unknown -mcpu=generic -mattr=+sse2 -fast-isel --fast-isel-abort=1 < %s | FileCheck %s --check-prefix=ALL --check-prefix=SSE2
+; RUN: llc -mtriple=x86_64-unknown-unknown -mcpu=generic -mattr=+avx -fast-isel --fast-isel-abort=1 < %s | FileCheck %s --check-prefix=ALL --check-prefix=AVX
+
+; Unsigned conversions of up to 32 bits go through the signed 64-bit ones.
+
+define double @uint_to_double(i32 %a) {
+; ALL-LABEL: uint_to_double:
+; ALL: movl %edi, %e[[REG:[a-z0-9]+]]
+; SSE2: cvtsi2sdq %r[[REG]], %xmm0
+; AVX: vcvtsi2sdq %r[[REG]], %xmm{{[0-9]+}}, %xmm0
+; ALL: ret
+entry:
+  %0 = uitofp i32 %a to double
+  ret double %0
+}
+
+define float @uint_to_float(i32 %a) {
+; ALL-LABEL: uint_to_float:
+; ALL: movl %edi, %e[[REG:[a-z0-9]+]]
+; SSE2: cvtsi2ssq %r[[REG]], %xmm0
+; AVX: vcvtsi2ssq %r[[REG]], %xmm{{[0-9]+}}, %xmm0
+; ALL: ret
+entry:
+  %0 = uitofp i32 %a to float
+  ret float %0
+}
+
+define double @ushort_to_double(i16 %a) {
+; ALL-LABEL: ushort_to_double:
+; ALL: movzwl %di, %e[[REG:[a-z0-9]+]]
+; SSE2: cvtsi2sdq %r[[REG]], %xmm0
+; AVX: vcvtsi2sdq %r[[REG]], %xmm{{[0-9]+}}, %xmm0
+; ALL: ret
+entry:
+  %0 = uitofp i16 %a to double
+  ret double %0
+}
+
+define float @uchar_to_float(i8 %a) {
+; ALL-LABEL: uchar_to_float:
+; ALL: movzbl %dil, %e[[REG:[a-z0-9]+]]
+; SSE2: cvtsi2ssq %r[[REG]], %xmm0
+; AVX: vcvtsi2ssq %r[[REG]], %xmm{{[0-9]+}}, %xmm0
+; ALL: ret
+entry:
+  %0 = uitofp i8 %a to float
+  ret float %0
+}
+
+define i32 @double_to_uint(double %a) {
+; ALL-LABEL: double_to_uint:
+; SSE2: cvttsd2si{{q?}} %xmm0, %r{{[a-z0-9]+}}
+; AVX: vcvttsd2si{{q?}} %xmm0, %r{{[a-z0-9]+}}
+; ALL: ret
+entry:
+  %0 = fptoui double %a to i32
+  ret i32 %0
+}
+
+define i16 @float_to_ushort(float %a) {
+; ALL-LABEL: float_to_ushort:
+; SSE2: cvttss2si{{q?}} %xmm0, %r{{[a-z0-9]+}}
+; AVX: vcvttss2si{{q?}} %xmm0, %r{{[a-z0-9]+}}
+; ALL: ret
+entry:
+  %0 = fptoui float %a to i16
+  ret i16 %0
+}
@@ -0,0 +1,44 @@
+; REQUIRES: asserts
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -mcpu=haswell -enable-misched -debug-only=misched -o /dev/null 2>&1 | FileCheck %s --check-prefix=HSW
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -mcpu=skylake-avx512 -enable-misched -debug-only=misched -o /dev/null 2>&1 | FileCheck %s --check-prefix=SKX
+; RUN: llc < %s -mtriple=x86_64-unknown-unknown -mcpu=znver1 -enable-misched -debug-only=misched -o /dev/null 2>&1 | FileCheck %s --check-prefix=ZNVER1
+;
+; Check that skylake-avx512 and znver1 use their own machine models rather
+; than Haswell's: the latencies of the same 256-bit operations differ, and
+; only Skylake Server has the 512-bit ones.
+
+define <4 x double> @ymm_ops(<4 x double> %a, <4 x double> %b, <4 x double> %c) {
+; HSW-LABEL: ymm_ops:
+; HSW: SU({{[0-9]+}}): {{.*}}VDIVPDYrr
+; HSW: Latency : 27
+; HSW: SU({{[0-9]+}}): {{.*}}VMULPDYrr
+; HSW: Latency : 5
+;
+; SKX-LABEL: ymm_ops:
+; SKX: SU({{[0-9]+}}): {{.*}}VDIVPDZ256rr
+; SKX: Latency : 14
+; SKX: SU({{[0-9]+}}): {{.*}}VMULPDZ256rr
+; SKX: Latency : 4
+;
+; ZNVER1-LABEL: ymm_ops:
+; ZNVER1: SU({{[0-9]+}}): {{.*}}VDIVPDYrr
+; ZNVER1: Latency : 15
+; ZNVER1: SU({{[0-9]+}}): {{.*}}VMULPDYrr
+; ZNVER1: Latency : 3
+entry:
+  %d = fdiv <4 x double> %a, %b
+  %m = fmul <4 x double> %d, %c
+  ret <4 x double> %m
+}
+
+define <8 x double> @zmm_ops(<8 x double> %a, <8 x double> %b, <8 x double> %c) {
+; SKX-LABEL: zmm_ops:
+; SKX: SU({{[0-9]+}}): {{.*}}VDIVPDZrr
+; SKX: Latency : 23
+; SKX: SU({{[0-9]+}}): {{.*}}VMULPDZrr
+; SKX: Latency : 4
+entry:
+  %d = fdiv <8 x double> %a, %b
+  %m = fmul <8 x double> %d, %c
+  ret <8 x double> %m
+}
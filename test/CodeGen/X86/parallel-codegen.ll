@@ -0,0 +1,43 @@
+; RUN: rm -rf %t && mkdir %t
+; RUN: llc -mtriple=x86_64-unknown-linux-gnu -threads=2 %s -o %t
+; RUN: cat %t/0.s %t/1.s | FileCheck %s
+; RUN: cat %t/0.s %t/1.s | FileCheck %s --check-prefix=LOCAL
+; RUN: llc -mtriple=x86_64-unknown-linux-gnu -threads=2 -filetype=obj %s -o %t
+; RUN: ls %t/0.o %t/1.o
+
+; The partitions get the target of the whole module when it has no triple.
+; RUN: llc -march=x86-64 -threads=2 %s -o %t
+
+; The partitions can't be merged into one output file, so -o has to name a
+; directory.
+; RUN: not llc -mtriple=x86_64-unknown-linux-gnu -threads=2 %s -o %t/out.s 2>&1 | FileCheck %s --check-prefix=ERR
+; RUN: not llc -mtriple=x86_64-unknown-linux-gnu -threads=2 %s -o - 2>&1 | FileCheck %s --check-prefix=ERR
+
+; ERR: -threads writes one file per partition, so -o must name an existing directory.
+
+; Each function is generated in one of the two partitions, and the internal
+; helper stays local to the partition of its caller.
+
+; CHECK-DAG: .globl f1
+; CHECK-DAG: f1:
+; CHECK-DAG: .globl f2
+; CHECK-DAG: f2:
+; CHECK-DAG: helper:
+; CHECK-DAG: callq helper
+
+; LOCAL-NOT: .globl helper
+
+define internal i32 @helper(i32 %x) noinline {
+  %r = mul i32 %x, 3
+  ret i32 %r
+}
+
+define i32 @f1(i32 %x) {
+  %r = call i32 @helper(i32 %x)
+  ret i32 %r
+}
+
+define i32 @f2(i32 %x) {
+  %r = add i32 %x, 7
+  ret i32 %r
+}
@@ -0,0 +1,83 @@
+; RUN: opt < %s -instrprof -do-counter-promotion -S | FileCheck %s
+; RUN: opt < %s -instrprof -S | FileCheck %s --check-prefix=NOPROMO
+
+target triple = "x86_64-unknown-linux-gnu"
+
+@__profn_foo = hidden constant [3 x i8] c"foo"
+@__profn_bar = hidden constant [3 x i8] c"bar"
+
+; The loop body counter is counted in a register and added to the counter in
+; the exit block. The entry counter is outside of any loop and is not changed.
+
+define void @foo(i32 %n) {
+; CHECK-LABEL: define void @foo(
+; CHECK: entry:
+; CHECK: %pgocount = load i64, i64* getelementptr inbounds ([2 x i64], [2 x i64]* @__profc_foo, i64 0, i64 0)
+; CHECK: for.cond:
+; CHECK: %pgocount.promoted = phi i64 [ 0, %entry ], [ %pgocount.next, %for.body ]
+; CHECK: for.body:
+; CHECK-NOT: @__profc_foo
+; CHECK: %pgocount.next = add i64 %pgocount.promoted, 1
+; CHECK: for.end:
+; CHECK: %[[COUNT:.*]] = load i64, i64* getelementptr inbounds ([2 x i64], [2 x i64]* @__profc_foo, i64 0, i64 1)
+; CHECK: %[[SUM:.*]] = add i64 %[[COUNT]], %pgocount.promoted
+; CHECK: store i64 %[[SUM]], i64* getelementptr inbounds ([2 x i64], [2 x i64]* @__profc_foo, i64 0, i64 1)
+
+; NOPROMO-LABEL: define void @foo(
+; NOPROMO: for.body:
+; NOPROMO: load i64, i64* getelementptr inbounds ([2 x i64], [2 x i64]* @__profc_foo, i64 0, i64 1)
+entry:
+  call void @llvm.instrprof.increment(i8* getelementptr inbounds ([3 x i8], [3 x i8]* @__profn_foo, i32 0, i32 0), i64 0, i32 2, i32 0)
+  br label %for.cond
+
+for.cond:
+  %i = phi i32 [ 0, %entry ], [ %inc, %for.body ]
+  %cmp = icmp slt i32 %i, %n
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  call void @llvm.instrprof.increment(i8* getelementptr inbounds ([3 x i8], [3 x i8]* @__profn_foo, i32 0, i32 0), i64 0, i32 2, i32 1)
+  %inc = add nsw i32 %i, 1
+  br label %for.cond
+
+for.end:
+  ret void
+}
+
+; A counter in an inner loop is promoted out of the outermost loop.
+
+define void @bar(i32 %n) {
+; CHECK-LABEL: define void @bar(
+; CHECK: outer:
+; CHECK: %[[OUTER:pgocount.promoted[0-9]*]] = phi i64
+; CHECK: inner:
+; CHECK: %[[INNER:pgocount.promoted[0-9]*]] = phi i64 [ %[[OUTER]], %outer ]
+; CHECK-NOT: @__profc_bar
+; CHECK: %pgocount.next = add i64 %[[INNER]], 1
+; CHECK: exit:
+; CHECK: %[[COUNT:.*]] = load i64, i64* getelementptr inbounds ([1 x i64], [1 x i64]* @__profc_bar, i64 0, i64 0)
+; CHECK: add i64 %[[COUNT]], %pgocount.next
+entry:
+  br label %outer
+
+outer:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i32 [ 0, %outer ], [ %j.next, %inner ]
+  call void @llvm.instrprof.increment(i8* getelementptr inbounds ([3 x i8], [3 x i8]* @__profn_bar, i32 0, i32 0), i64 0, i32 1, i32 0)
+  %j.next = add nsw i32 %j, 1
+  %inner.cmp = icmp slt i32 %j.next, %n
+  br i1 %inner.cmp, label %inner, label %outer.latch
+
+outer.latch:
+  %i.next = add nsw i32 %i, 1
+  %outer.cmp = icmp slt i32 %i.next, %n
+  br i1 %outer.cmp, label %outer, label %exit
+
+exit:
+  ret void
+}
+
+declare void @llvm.instrprof.increment(i8*, i64, i32, i32)
@@ -0,0 +1,61 @@
+; RUN: opt < %s -instrprof -instrprof-counter-shards=3 -S | FileCheck %s
+; RUN: opt < %s -instrprof -S | FileCheck %s --check-prefix=NOSHARDS
+
+target triple = "x86_64-unknown-linux-gnu"
+
+@__profn_foo = hidden constant [3 x i8] c"foo"
+
+; The shard count is rounded up to a power of two and each shard is padded to
+; a cache line.
+
+; CHECK: @__profc_foo = hidden global [2 x i64] zeroinitializer, section "__llvm_prf_cnts", align 8
+; CHECK: @__profs_foo = hidden global [4 x [8 x i64]] zeroinitializer, align 64
+; CHECK: @__llvm_profile_shard_key = linkonce_odr hidden thread_local(initialexec) global i8 0, comdat
+; CHECK: @llvm.global_ctors = {{.*}} @__llvm_profile_init
+
+; NOSHARDS-NOT: @__profs_foo
+; NOSHARDS-NOT: @__llvm_profile_shard_key
+
+define void @foo(i1 %c) {
+; CHECK-LABEL: define void @foo(
+; CHECK: %pgoshardkey = ptrtoint i8* @__llvm_profile_shard_key to i64
+; CHECK: %pgoshard = lshr i64 %{{.*}}, 62
+; CHECK: %[[ADDR0:.*]] = getelementptr inbounds [4 x [8 x i64]], [4 x [8 x i64]]* @__profs_foo, i64 0, i64 %pgoshard, i64 0
+; CHECK: %pgocount = load i64, i64* %[[ADDR0]]
+; CHECK: store i64 %{{.*}}, i64* %[[ADDR0]]
+; CHECK: then:
+; CHECK: %[[ADDR1:.*]] = getelementptr inbounds [4 x [8 x i64]], [4 x [8 x i64]]* @__profs_foo, i64 0, i64 %pgoshard, i64 1
+; CHECK: %pgocount1 = load i64, i64* %[[ADDR1]]
+; CHECK: store i64 %{{.*}}, i64* %[[ADDR1]]
+
+; NOSHARDS-LABEL: define void @foo(
+; NOSHARDS: %pgocount = load i64, i64* getelementptr inbounds ([2 x i64], [2 x i64]* @__profc_foo, i64 0, i64 0)
+entry:
+  call void @llvm.instrprof.increment(i8* getelementptr inbounds ([3 x i8], [3 x i8]* @__profn_foo, i32 0, i32 0), i64 0, i32 2, i32 0)
+  br i1 %c, label %then, label %exit
+
+then:
+  call void @llvm.instrprof.increment(i8* getelementptr inbounds ([3 x i8], [3 x i8]* @__profn_foo, i32 0, i32 0), i64 0, i32 2, i32 1)
+  br label %exit
+
+exit:
+  ret void
+}
+
+declare void @llvm.instrprof.increment(i8*, i64, i32, i32)
+
+; The merge function adds all shards into the counters and clears them. It
+; runs at exit, after the profile writer is registered so that it runs first.
+
+; CHECK-LABEL: define internal void @__llvm_profile_merge_shards()
+; CHECK: merge:
+; CHECK: %idx = phi i64
+; CHECK: %pgocount = load i64, i64* %{{.*}}
+; CHECK: getelementptr inbounds [4 x [8 x i64]], [4 x [8 x i64]]* @__profs_foo, i64 0, i64 3, i64 %idx
+; CHECK: store i64 0
+; CHECK: %idx.next = add i64 %idx, 1
+; CHECK: icmp eq i64 %idx.next, 2
+
+; CHECK-LABEL: define internal void @__llvm_profile_init()
+; CHECK: call i32 @__llvm_profile_register_write_file_atexit()
+; CHECK: call i32 @atexit(void ()* @__llvm_profile_merge_shards)
@@ -0,0 +1,89 @@
+; Allocas that are live across a suspend but never live at the same time
+; share a field of the coroutine frame.
+; REQUIRES: asserts
+; RUN: opt < %s -O2 -S 2>/dev/null | FileCheck %s
+; RUN: opt < %s -O2 -coro-share-frame-fields=false -S 2>/dev/null \
+; RUN:   | FileCheck %s --check-prefix=NOSHARE
+; RUN: opt < %s -O2 -stats -disable-output 2>&1 | FileCheck %s --check-prefix=STATS
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+
+; CHECK: %f.frame = type { void (%f.frame*)*, void (%f.frame*)*, i32, [16 x i32] }
+; NOSHARE: %f.frame = type { void (%f.frame*)*, void (%f.frame*)*, i32, [16 x i32], [16 x i32] }
+; STATS: 1 coro-split4 - Number of allocas sharing a coroutine frame field with another
+
+declare i8* @malloc(i32)
+declare void @free(i8*)
+declare void @use(i32*)
+declare void @llvm.lifetime.start(i64, i8* nocapture)
+declare void @llvm.lifetime.end(i64, i8* nocapture)
+declare i8* @llvm.experimental.coro.elide()
+declare i32 @llvm.experimental.coro.size.i32()
+declare i8* @llvm.experimental.coro.init(i8*, i32, i8*, i8*)
+declare i1 @llvm.experimental.coro.fork()
+declare i1 @llvm.experimental.coro.suspend(token, i1)
+declare i8* @llvm.experimental.coro.delete(i8*)
+declare void @llvm.experimental.coro.resume.end()
+
+define i8* @f(i1 %cond) {
+entry:
+  %a = alloca [16 x i32], align 16
+  %b = alloca [16 x i32], align 16
+  %elide = call i8* @llvm.experimental.coro.elide()
+  %need.alloc = icmp eq i8* %elide, null
+  br i1 %need.alloc, label %coro.alloc, label %coro.init
+coro.alloc:
+  %size = call i32 @llvm.experimental.coro.size.i32()
+  %alloc = call i8* @malloc(i32 %size)
+  br label %coro.init
+coro.init:
+  %mem = phi i8* [ %elide, %entry ], [ %alloc, %coro.alloc ]
+  %frame = call i8* @llvm.experimental.coro.init(i8* %mem, i32 0, i8* null, i8* null)
+  %first.return = call i1 @llvm.experimental.coro.fork()
+  br i1 %first.return, label %coro.return, label %coro.start
+coro.start:
+  br i1 %cond, label %use.a, label %use.b
+use.a:
+  %a.raw = bitcast [16 x i32]* %a to i8*
+  call void @llvm.lifetime.start(i64 64, i8* %a.raw)
+  %a.0 = getelementptr inbounds [16 x i32], [16 x i32]* %a, i64 0, i64 0
+  call void @use(i32* %a.0)
+  %suspend.a = call i1 @llvm.experimental.coro.suspend(token none, i1 false)
+  br i1 %suspend.a, label %resume.a, label %cleanup.a
+resume.a:
+  call void @use(i32* %a.0)
+  call void @llvm.lifetime.end(i64 64, i8* %a.raw)
+  br label %done
+cleanup.a:
+  call void @llvm.lifetime.end(i64 64, i8* %a.raw)
+  br label %cleanup
+use.b:
+  %b.raw = bitcast [16 x i32]* %b to i8*
+  call void @llvm.lifetime.start(i64 64, i8* %b.raw)
+  %b.0 = getelementptr inbounds [16 x i32], [16 x i32]* %b, i64 0, i64 0
+  call void @use(i32* %b.0)
+  %suspend.b = call i1 @llvm.experimental.coro.suspend(token none, i1 false)
+  br i1 %suspend.b, label %resume.b, label %cleanup.b
+resume.b:
+  call void @use(i32* %b.0)
+  call void @llvm.lifetime.end(i64 64, i8* %b.raw)
+  br label %done
+cleanup.b:
+  call void @llvm.lifetime.end(i64 64, i8* %b.raw)
+  br label %cleanup
+done:
+  %final = call i1 @llvm.experimental.coro.suspend(token none, i1 true)
+  br label %cleanup
+cleanup:
+  %mem.free = call i8* @llvm.experimental.coro.delete(i8* %frame)
+  %need.free = icmp ne i8* %mem.free, null
+  br i1 %need.free, label %coro.free, label %coro.end
+coro.free:
+  call void @free(i8* %mem.free)
+  br label %coro.end
+coro.end:
+  call void @llvm.experimental.coro.resume.end()
+  br label %coro.return
+coro.return:
+  ret i8* %frame
+}
@@ -0,0 +1,125 @@
+; A coroutine that awaits on another one, whose frame was elided into the
+; frame of the awaiting coroutine, is elided in turn into its caller. The
+; stores of the resume and destroy functions of the nested frame must not be
+; taken for the ones of the outer frame.
+; REQUIRES: asserts
+; RUN: opt < %s -O2 -coro-elide-max-depth=1 -S 2>/dev/null | FileCheck %s
+; RUN: opt < %s -O2 -S 2>/dev/null | FileCheck %s
+; RUN: opt < %s -O2 -coro-elide-max-depth=1 -stats -disable-output 2>&1 \
+; RUN:   | FileCheck %s --check-prefix=STATS
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+
+; Both resume functions are inlined into @main and no frame is left.
+; CHECK-LABEL: define i32 @main(i32 %n)
+; CHECK-NOT: call
+; CHECK: mul i32 %n, 5
+; CHECK-NOT: call
+; CHECK: ret i32
+
+; STATS: 2 coro-elide - Number of heap elision performed
+
+@sink = global i32 0, align 4
+
+declare i8* @malloc(i32)
+declare void @free(i8*)
+declare i8* @llvm.experimental.coro.elide()
+declare i32 @llvm.experimental.coro.size.i32()
+declare i8* @llvm.experimental.coro.init(i8*, i32, i8*, i8*)
+declare i1 @llvm.experimental.coro.fork()
+declare i1 @llvm.experimental.coro.suspend(token, i1)
+declare i8* @llvm.experimental.coro.delete(i8*)
+declare void @llvm.experimental.coro.resume.end()
+declare void @llvm.experimental.coro.resume(i8*)
+declare void @llvm.experimental.coro.destroy(i8*)
+
+define i8* @inner(i32 %n) {
+entry:
+  %elide = call i8* @llvm.experimental.coro.elide()
+  %need.alloc = icmp eq i8* %elide, null
+  br i1 %need.alloc, label %coro.alloc, label %coro.init
+coro.alloc:
+  %size = call i32 @llvm.experimental.coro.size.i32()
+  %alloc = call i8* @malloc(i32 %size)
+  br label %coro.init
+coro.init:
+  %mem = phi i8* [ %elide, %entry ], [ %alloc, %coro.alloc ]
+  %frame = call i8* @llvm.experimental.coro.init(i8* %mem, i32 0, i8* null, i8* null)
+  %first.return = call i1 @llvm.experimental.coro.fork()
+  br i1 %first.return, label %coro.return, label %coro.start
+coro.start:
+  %suspend = call i1 @llvm.experimental.coro.suspend(token none, i1 false)
+  br i1 %suspend, label %resume, label %cleanup
+resume:
+  %twice = shl i32 %n, 1
+  %old = load i32, i32* @sink, align 4
+  %new = add i32 %old, %twice
+  store i32 %new, i32* @sink, align 4
+  %final = call i1 @llvm.experimental.coro.suspend(token none, i1 true)
+  br label %cleanup
+cleanup:
+  %mem.free = call i8* @llvm.experimental.coro.delete(i8* %frame)
+  %need.free = icmp ne i8* %mem.free, null
+  br i1 %need.free, label %coro.free, label %coro.end
+coro.free:
+  call void @free(i8* %mem.free)
+  br label %coro.end
+coro.end:
+  call void @llvm.experimental.coro.resume.end()
+  br label %coro.return
+coro.return:
+  ret i8* %frame
+}
+
+define i8* @outer(i32 %n) {
+entry:
+  %elide = call i8* @llvm.experimental.coro.elide()
+  %need.alloc = icmp eq i8* %elide, null
+  br i1 %need.alloc, label %coro.alloc, label %coro.init
+coro.alloc:
+  %size = call i32 @llvm.experimental.coro.size.i32()
+  %alloc = call i8* @malloc(i32 %size)
+  br label %coro.init
+coro.init:
+  %mem = phi i8* [ %elide, %entry ], [ %alloc, %coro.alloc ]
+  %frame = call i8* @llvm.experimental.coro.init(i8* %mem, i32 0, i8* null, i8* null)
+  %first.return = call i1 @llvm.experimental.coro.fork()
+  br i1 %first.return, label %coro.return, label %coro.start
+coro.start:
+  %child = call i8* @inner(i32 %n)
+  %suspend = call i1 @llvm.experimental.coro.suspend(token none, i1 false)
+  br i1 %suspend, label %resume, label %cleanup.child
+resume:
+  call void @llvm.experimental.coro.resume(i8* %child)
+  call void @llvm.experimental.coro.destroy(i8* %child)
+  %thrice = mul i32 %n, 3
+  %old = load i32, i32* @sink, align 4
+  %new = add i32 %old, %thrice
+  store i32 %new, i32* @sink, align 4
+  %final = call i1 @llvm.experimental.coro.suspend(token none, i1 true)
+  br label %cleanup
+cleanup.child:
+  call void @llvm.experimental.coro.destroy(i8* %child)
+  br label %cleanup
+cleanup:
+  %mem.free = call i8* @llvm.experimental.coro.delete(i8* %frame)
+  %need.free = icmp ne i8* %mem.free, null
+  br i1 %need.free, label %coro.free, label %coro.end
+coro.free:
+  call void @free(i8* %mem.free)
+  br label %coro.end
+coro.end:
+  call void @llvm.experimental.coro.resume.end()
+  br label %coro.return
+coro.return:
+  ret i8* %frame
+}
+
+define i32 @main(i32 %n) {
+entry:
+  %task = call i8* @outer(i32 %n)
+  call void @llvm.experimental.coro.resume(i8* %task)
+  call void @llvm.experimental.coro.destroy(i8* %task)
+  %res = load i32, i32* @sink, align 4
+  ret i32 %res
+}
@@ -1,4 +1,5 @@
 ; RUN: opt -correlated-propagation -S < %s | FileCheck %s
+; RUN: opt -correlated-propagation -lvi-cache-max-entries=1 -S < %s | FileCheck %s
 
 declare i32 @foo()
 
@@ -0,0 +1,160 @@
+; RUN: opt < %s -basicaa -dse -enable-dse-memoryssa -S | FileCheck %s
+; RUN: opt < %s -basicaa -dse -S | FileCheck %s --check-prefix=NOMSSA
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+
+declare void @llvm.memset.p0i8.i64(i8* nocapture, i8, i64, i32, i1) nounwind
+declare void @use(i32*)
+
+; The store in the entry block is overwritten in the join block, which
+; post-dominates it.
+define void @diamond(i32* noalias %p, i32* noalias %q, i1 %c) {
+; CHECK-LABEL: @diamond(
+; CHECK-NEXT: entry:
+; CHECK-NEXT: br i1 %c
+; CHECK: store i32 1, i32* %q
+; CHECK: store i32 2, i32* %q
+; CHECK: join:
+; CHECK-NEXT: store i32 3, i32* %p
+; NOMSSA-LABEL: @diamond(
+; NOMSSA: store i32 0, i32* %p
+entry:
+  store i32 0, i32* %p
+  br i1 %c, label %then, label %else
+
+then:
+  store i32 1, i32* %q
+  br label %join
+
+else:
+  store i32 2, i32* %q
+  br label %join
+
+join:
+  store i32 3, i32* %p
+  ret void
+}
+
+; A read on one of the paths keeps the store alive.
+define i32 @read_on_path(i32* noalias %p, i1 %c) {
+; CHECK-LABEL: @read_on_path(
+; CHECK: store i32 0, i32* %p
+; CHECK: store i32 3, i32* %p
+entry:
+  store i32 0, i32* %p
+  br i1 %c, label %then, label %join
+
+then:
+  %v = load i32, i32* %p
+  br label %join
+
+join:
+  %r = phi i32 [ %v, %then ], [ 0, %entry ]
+  store i32 3, i32* %p
+  ret i32 %r
+}
+
+; The overwrite is only on one of the paths out of the function.
+define void @partial_kill(i32* noalias %p, i1 %c) {
+; CHECK-LABEL: @partial_kill(
+; CHECK: store i32 0, i32* %p
+entry:
+  store i32 0, i32* %p
+  br i1 %c, label %then, label %exit
+
+then:
+  store i32 1, i32* %p
+  br label %exit
+
+exit:
+  ret void
+}
+
+; A memset of the whole object is overwritten by a larger memset.
+define void @memset_kill(i8* noalias %p, i1 %c, i32* noalias %q) {
+; CHECK-LABEL: @memset_kill(
+; CHECK-NOT: i64 8,
+; CHECK: call void @llvm.memset.p0i8.i64(i8* %p, i8 0, i64 16, i32 1, i1 false)
+entry:
+  call void @llvm.memset.p0i8.i64(i8* %p, i8 1, i64 8, i32 1, i1 false)
+  br i1 %c, label %then, label %join
+
+then:
+  store i32 1, i32* %q
+  br label %join
+
+join:
+  call void @llvm.memset.p0i8.i64(i8* %p, i8 0, i64 16, i32 1, i1 false)
+  ret void
+}
+
+; The alloca is never read again after the store, on either path.
+define void @dead_alloca(i1 %c, i32* noalias %q) {
+; CHECK-LABEL: @dead_alloca(
+; CHECK-NOT: store i32 0, i32* %a
+; CHECK: ret void
+entry:
+  %a = alloca i32
+  call void @use(i32* %a)
+  store i32 0, i32* %a
+  br i1 %c, label %then, label %exit
+
+then:
+  store i32 1, i32* %q
+  br label %exit
+
+exit:
+  ret void
+}
+
+; The store to the alloca is read in the next iteration of the loop.
+define i32 @loop_read(i32 %n) {
+; CHECK-LABEL: @loop_read(
+; CHECK: store i32 %i, i32* %a
+entry:
+  %a = alloca i32
+  store i32 0, i32* %a
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %v = load i32, i32* %a
+  %c = icmp eq i32 %v, 7
+  br i1 %c, label %latch, label %body
+
+body:
+  store i32 %i, i32* %a
+  br label %latch
+
+latch:
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %v
+}
+
+; The pointer changes in every iteration, so the store in the next iteration
+; does not overwrite the one in this iteration.
+define void @loop_variant(i32* noalias %p, i32 %n) {
+; CHECK-LABEL: @loop_variant(
+; CHECK: store i32 0, i32* %gep
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %gep = getelementptr inbounds i32, i32* %p, i32 %i
+  store i32 0, i32* %gep
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret void
+}
+
+; Stores with walks longer than the scan limit are left alone.
+; RUN: opt < %s -basicaa -dse -enable-dse-memoryssa -dse-memoryssa-scanlimit=1 -S | FileCheck %s --check-prefix=LIMIT
+; LIMIT-LABEL: @diamond(
+; LIMIT: store i32 0, i32* %p
@@ -0,0 +1,113 @@
+; RUN: opt -hotcoldsplit -S < %s | FileCheck %s
+; RUN: opt -hotcoldsplit -hotcoldsplit-threshold=100 -S < %s | FileCheck %s --check-prefix=THRESHOLD
+
+declare void @abort() noreturn
+declare void @report(i32)
+declare void @log_error(i32) cold
+
+; The error path ends in unreachable, so it is outlined.
+; CHECK-LABEL: define i32 @unreachable_path(
+; CHECK: call void @unreachable_path_fail(
+; CHECK-NOT: @abort
+; CHECK: ret i32
+; THRESHOLD-LABEL: define i32 @unreachable_path(
+; THRESHOLD-NOT: call void @unreachable_path_fail(
+; THRESHOLD: call void @abort()
+define i32 @unreachable_path(i32 %a, i32* %p) {
+entry:
+  %c = icmp eq i32 %a, 0
+  br i1 %c, label %fail, label %ok
+
+fail:
+  %x = load i32, i32* %p
+  %y = mul i32 %x, 3
+  %z = add i32 %y, 7
+  %w = xor i32 %z, %x
+  call void @report(i32 %w)
+  %v = shl i32 %w, 2
+  call void @report(i32 %v)
+  br label %fail.exit
+
+fail.exit:
+  call void @abort()
+  unreachable
+
+ok:
+  %r = add i32 %a, 1
+  ret i32 %r
+}
+
+; A block that calls a cold function is outlined, and rejoins the hot path.
+; CHECK-LABEL: define void @cold_call(
+; CHECK: call void @cold_call_err(
+; CHECK: ret void
+define void @cold_call(i32 %a, i32* %p) {
+entry:
+  %c = icmp slt i32 %a, 0
+  br i1 %c, label %err, label %done
+
+err:
+  %x = load i32, i32* %p
+  %y = sub i32 0, %x
+  %z = mul i32 %y, %a
+  %w = add i32 %z, 1
+  call void @log_error(i32 %w)
+  %v = or i32 %w, 8
+  store i32 %v, i32* %p
+  br label %done
+
+done:
+  ret void
+}
+
+; Small cold regions are left in place.
+; CHECK-LABEL: define void @small(
+; CHECK: call void @abort()
+; CHECK-NOT: call void @small_
+define void @small(i1 %c) {
+entry:
+  br i1 %c, label %fail, label %ok
+
+fail:
+  call void @abort()
+  unreachable
+
+ok:
+  ret void
+}
+
+; With a profile, the blocks that never executed are outlined.
+; CHECK-LABEL: define i32 @profiled(
+; CHECK: call void @profiled_never(
+; CHECK: ret i32
+define i32 @profiled(i32 %a, i32* %p) !prof !0 {
+entry:
+  %c = icmp eq i32 %a, 42
+  br i1 %c, label %never, label %done, !prof !1
+
+never:
+  %x = load i32, i32* %p
+  %y = mul i32 %x, %a
+  %z = add i32 %y, 5
+  %w = xor i32 %z, 12
+  call void @report(i32 %w)
+  %v = lshr i32 %w, 1
+  store i32 %v, i32* %p
+  call void @report(i32 %v)
+  br label %done
+
+done:
+  %r = add i32 %a, 2
+  ret i32 %r
+}
+
+; The outlined functions are cold and stay out of line.
+; CHECK: define internal void @unreachable_path_fail({{.*}}) #[[ATTR:[0-9]+]]
+; CHECK: call void @abort()
+; CHECK: define internal void @cold_call_err({{.*}}) #[[ATTR]]
+; CHECK: call void @log_error(
+; CHECK: define internal void @profiled_never({{.*}}) #[[ATTR]]
+; CHECK: attributes #[[ATTR]] = { cold minsize noinline }
+
+!0 = !{!"function_entry_count", i64 100}
+!1 = !{!"branch_weights", i32 0, i32 100}
@@ -0,0 +1,104 @@
+; RUN: opt < %s -inline -S | FileCheck %s
+; RUN: opt < %s -inline -inline-cost-cache-size=0 -S | FileCheck %s
+; RUN: opt < %s -inline -stats -disable-output 2>&1 | FileCheck %s --check-prefix=STATS
+; REQUIRES: asserts
+
+; Call sites which present a callee with the same inputs share one analysis of
+; the callee body. Arguments the callee never uses do not take part in the
+; comparison, while a constant argument which folds away most of the body does.
+
+; STATS: 1 inline-cost{{ +}}- Number of call sites whose cost was reused from a callee summary
+
+define i32 @callee(i32 %x, i32 %unused) {
+entry:
+  %cmp = icmp eq i32 %x, 0
+  br i1 %cmp, label %small, label %large
+
+small:
+  ret i32 0
+
+large:
+  %v0 = add i32 %x, %x
+  %v1 = mul i32 %v0, %x
+  %v2 = xor i32 %v1, %x
+  %v3 = add i32 %v2, %x
+  %v4 = mul i32 %v3, %x
+  %v5 = xor i32 %v4, %x
+  %v6 = add i32 %v5, %x
+  %v7 = mul i32 %v6, %x
+  %v8 = xor i32 %v7, %x
+  %v9 = add i32 %v8, %x
+  %v10 = mul i32 %v9, %x
+  %v11 = xor i32 %v10, %x
+  %v12 = add i32 %v11, %x
+  %v13 = mul i32 %v12, %x
+  %v14 = xor i32 %v13, %x
+  %v15 = add i32 %v14, %x
+  %v16 = mul i32 %v15, %x
+  %v17 = xor i32 %v16, %x
+  %v18 = add i32 %v17, %x
+  %v19 = mul i32 %v18, %x
+  %v20 = xor i32 %v19, %x
+  %v21 = add i32 %v20, %x
+  %v22 = mul i32 %v21, %x
+  %v23 = xor i32 %v22, %x
+  %v24 = add i32 %v23, %x
+  %v25 = mul i32 %v24, %x
+  %v26 = xor i32 %v25, %x
+  %v27 = add i32 %v26, %x
+  %v28 = mul i32 %v27, %x
+  %v29 = xor i32 %v28, %x
+  %v30 = add i32 %v29, %x
+  %v31 = mul i32 %v30, %x
+  %v32 = xor i32 %v31, %x
+  %v33 = add i32 %v32, %x
+  %v34 = mul i32 %v33, %x
+  %v35 = xor i32 %v34, %x
+  %v36 = add i32 %v35, %x
+  %v37 = mul i32 %v36, %x
+  %v38 = xor i32 %v37, %x
+  %v39 = add i32 %v38, %x
+  %v40 = mul i32 %v39, %x
+  %v41 = xor i32 %v40, %x
+  %v42 = add i32 %v41, %x
+  %v43 = mul i32 %v42, %x
+  %v44 = xor i32 %v43, %x
+  %v45 = add i32 %v44, %x
+  %v46 = mul i32 %v45, %x
+  %v47 = xor i32 %v46, %x
+  %v48 = add i32 %v47, %x
+  %v49 = mul i32 %v48, %x
+  %v50 = xor i32 %v49, %x
+  %v51 = add i32 %v50, %x
+  %v52 = mul i32 %v51, %x
+  %v53 = xor i32 %v52, %x
+  %v54 = add i32 %v53, %x
+  %v55 = mul i32 %v54, %x
+  %v56 = xor i32 %v55, %x
+  %v57 = add i32 %v56, %x
+  %v58 = mul i32 %v57, %x
+  %v59 = xor i32 %v58, %x
+  ret i32 %v59
+}
+
+define i32 @caller1(i32 %p) {
+; CHECK-LABEL: @caller1(
+; CHECK: call i32 @callee(i32 %p, i32 1)
+  %r = call i32 @callee(i32 %p, i32 1)
+  ret i32 %r
+}
+
+define i32 @caller2(i32 %q) {
+; CHECK-LABEL: @caller2(
+; CHECK: call i32 @callee(i32 %q, i32 2)
+  %r = call i32 @callee(i32 %q, i32 2)
+  ret i32 %r
+}
+
+define i32 @caller3() {
+; CHECK-LABEL: @caller3(
+; CHECK-NOT: call
+; CHECK: ret i32 0
+  %r = call i32 @callee(i32 0, i32 3)
+  ret i32 %r
+}
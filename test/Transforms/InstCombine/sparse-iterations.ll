@@ -0,0 +1,52 @@
+; RUN: opt < %s -instcombine -S | FileCheck %s
+; RUN: opt < %s -instcombine -instcombine-sparse-iterations -S | FileCheck %s
+; RUN: opt < %s -instcombine -instcombine-sparse-iterations -stats -disable-output 2>&1 | FileCheck %s --check-prefix=STATS
+; REQUIRES: asserts, shell
+
+; The sparse mode only revisits the instructions changed by the previous
+; iteration, and must reach the same result as the full iterations. Check
+; that on every test of InstCombine that it can run on its own, too.
+; RUN: for f in %S/*.ll; do \
+; RUN:   opt -instcombine -S $f -o %t.full 2>/dev/null || continue; \
+; RUN:   opt -instcombine -instcombine-sparse-iterations -S $f -o %t.sparse; \
+; RUN:   cmp -s %t.full %t.sparse || echo $f; \
+; RUN: done > %t.differ
+; RUN: count 0 < %t.differ
+
+; STATS: instcombine{{ +}}- Number of insts seeded into the worklist
+; STATS: instcombine{{ +}}- Number of insts visited by the combiner
+
+define i32 @test1(i32 %x, i32 %y) {
+; CHECK-LABEL: @test1(
+; CHECK-NEXT: ret i32 %y
+  %a = add i32 %x, %y
+  %b = sub i32 %a, %x
+  %c = xor i32 %b, 0
+  %d = shl i32 %c, 3
+  %e = lshr i32 %d, 3
+  %f = and i32 %c, %e
+  ret i32 %c
+}
+
+define i1 @test2(i32 %x) {
+; CHECK-LABEL: @test2(
+; CHECK-NEXT: [[MASK:%.*]] = and i32 %x, 2147483647
+; CHECK-NEXT: [[CMP:%.*]] = icmp eq i32 [[MASK]], 4
+; CHECK-NEXT: ret i1 [[CMP]]
+  %a = add i32 %x, 1
+  %b = add i32 %a, 1
+  %c = mul i32 %b, 2
+  %cmp = icmp eq i32 %c, 12
+  ret i1 %cmp
+}
+
+; The compare folds to a constant expression, which only folds further once
+; it is an operand of the return.
+define i1 @test3(i8* %p) {
+; CHECK-LABEL: @test3(
+; CHECK-NEXT: ret i1 true
+  %a = getelementptr inbounds i8, i8* %p, i64 1
+  %b = getelementptr inbounds i8, i8* %p, i64 10
+  %cmp = icmp slt i8* %a, %b
+  ret i1 %cmp
+}
@@ -0,0 +1,130 @@
+; RUN: opt -mtriple=x86_64-unknown-linux-gnu -loop-data-prefetch -S < %s | FileCheck %s
+; RUN: opt -mtriple=x86_64-unknown-linux-gnu -loop-data-prefetch -loop-prefetch-indirect=false -loop-prefetch-pointer-chase=false -S < %s | FileCheck %s --check-prefix=DISABLED
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+
+%struct.node = type { %struct.node*, [15 x i64], i64 }
+
+; The strided load of the index is left to the hardware prefetcher, but the
+; indirect access is prefetched using an index loaded ahead of time.
+;
+;   int gather(int *A, int *B, long n) {
+;     int sum = 0;
+;     for (long i = 0; i < n; i++)
+;       sum += A[B[i]];
+;     return sum;
+;   }
+
+; CHECK-LABEL: @gather(
+; CHECK: %idx = load i32, i32* %b.addr
+; CHECK: %prefidx = load i32, i32*
+; CHECK: call void @llvm.prefetch(i8* %{{.*}}, i32 0, i32 3, i32 1)
+; CHECK-NEXT: %v = load i32, i32* %a.addr
+; CHECK-NOT: @llvm.prefetch
+; CHECK: ret i32
+
+; DISABLED-LABEL: @gather(
+; DISABLED-NOT: @llvm.prefetch
+; DISABLED: ret i32
+
+define i32 @gather(i32* noalias %A, i32* noalias %B, i64 %n) {
+entry:
+  %cmp = icmp sgt i64 %n, 0
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %sum = phi i32 [ 0, %entry ], [ %add, %for.body ]
+  %b.addr = getelementptr inbounds i32, i32* %B, i64 %i
+  %idx = load i32, i32* %b.addr, align 4
+  %idx.ext = sext i32 %idx to i64
+  %a.addr = getelementptr inbounds i32, i32* %A, i64 %idx.ext
+  %v = load i32, i32* %a.addr, align 4
+  %add = add nsw i32 %v, %sum
+  %i.next = add nuw nsw i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  %res = phi i32 [ 0, %entry ], [ %add, %for.body ]
+  ret i32 %res
+}
+
+; The lines of the next node of a linked list that the loop accesses are
+; prefetched as soon as the pointer to it has been loaded.
+;
+;   long list_sum(struct node *p) {
+;     long sum = 0;
+;     for (; p; p = p->next)
+;       sum += p->val;
+;     return sum;
+;   }
+
+; CHECK-LABEL: @list_sum(
+; CHECK: %next = load %struct.node*, %struct.node** %next.addr
+; CHECK-NEXT: %[[NODE:.*]] = bitcast %struct.node* %next to i8*
+; CHECK-NEXT: %[[VAL:.*]] = getelementptr i8, i8* %[[NODE]], i64 128
+; CHECK-NEXT: call void @llvm.prefetch(i8* %[[VAL]], i32 0, i32 3, i32 1)
+; CHECK-NEXT: %[[NEXT:.*]] = getelementptr i8, i8* %[[NODE]], i64 0
+; CHECK-NEXT: call void @llvm.prefetch(i8* %[[NEXT]], i32 0, i32 3, i32 1)
+
+; DISABLED-LABEL: @list_sum(
+; DISABLED-NOT: @llvm.prefetch
+; DISABLED: ret i64
+
+define i64 @list_sum(%struct.node* %head) {
+entry:
+  %cmp = icmp eq %struct.node* %head, null
+  br i1 %cmp, label %exit, label %for.body
+
+for.body:
+  %p = phi %struct.node* [ %head, %entry ], [ %next, %for.body ]
+  %sum = phi i64 [ 0, %entry ], [ %add, %for.body ]
+  %val.addr = getelementptr inbounds %struct.node, %struct.node* %p, i64 0, i32 2
+  %val = load i64, i64* %val.addr, align 8
+  %add = add nsw i64 %val, %sum
+  %next.addr = getelementptr inbounds %struct.node, %struct.node* %p, i64 0, i32 0
+  %next = load %struct.node*, %struct.node** %next.addr, align 8
+  %done = icmp eq %struct.node* %next, null
+  br i1 %done, label %exit, label %for.body
+
+exit:
+  %res = phi i64 [ 0, %entry ], [ %add, %for.body ]
+  ret i64 %res
+}
+
+; The profile says that the loop only runs five iterations on average, which
+; ends it before any data prefetched ahead would be used.
+
+; CHECK-LABEL: @gather_short(
+; CHECK-NOT: @llvm.prefetch
+; CHECK: ret i32
+
+define i32 @gather_short(i32* noalias %A, i32* noalias %B, i64 %n) !prof !0 {
+entry:
+  %cmp = icmp sgt i64 %n, 0
+  br i1 %cmp, label %for.body.preheader, label %for.end
+
+for.body.preheader:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %for.body.preheader ], [ %i.next, %for.body ]
+  %sum = phi i32 [ 0, %for.body.preheader ], [ %add, %for.body ]
+  %b.addr = getelementptr inbounds i32, i32* %B, i64 %i
+  %idx = load i32, i32* %b.addr, align 4
+  %idx.ext = sext i32 %idx to i64
+  %a.addr = getelementptr inbounds i32, i32* %A, i64 %idx.ext
+  %v = load i32, i32* %a.addr, align 4
+  %add = add nsw i32 %v, %sum
+  %i.next = add nuw nsw i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body, !prof !1
+
+for.end:
+  %res = phi i32 [ 0, %entry ], [ %add, %for.body ]
+  ret i32 %res
+}
+
+!0 = !{!"function_entry_count", i64 100}
+!1 = !{!"branch_weights", i32 1, i32 4}
@@ -0,0 +1,199 @@
+; RUN: opt -basicaa -loop-fusion -verify-loop-info -verify-dom-info -S \
+; RUN:   < %s | FileCheck %s
+
+; Fuse the two loops of:
+;   for (i = 0; i < 100000; i++)
+;     b[i] = a[i] + 1;
+;   for (i = 0; i < 100000; i++)
+;     c[i] = a[i] * b[i];
+; so that the second body reads a[i] and b[i] while they are in the cache.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define void @fuse(float* noalias %a, float* noalias %b, float* noalias %c) {
+; CHECK-LABEL: @fuse(
+; CHECK: l1:
+; CHECK-NEXT: %i = phi i64 [ 0, %entry ], [ %i.next, %l1 ]
+; CHECK-NEXT: %j = phi i64 [ 0, %entry ], [ %j.next, %l1 ]
+; CHECK: store float %vb, float* %b.i
+; CHECK-NOT: br
+; CHECK: store float %vc, float* %c.j
+; CHECK-NOT: %c1 =
+; CHECK: br i1 %c2, label %exit, label %l1
+; CHECK-NOT: l2:
+entry:
+  br label %l1
+
+l1:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %l1 ]
+  %a.i = getelementptr inbounds float, float* %a, i64 %i
+  %b.i = getelementptr inbounds float, float* %b, i64 %i
+  %va = load float, float* %a.i, align 4
+  %vb = fadd float %va, 1.000000e+00
+  store float %vb, float* %b.i, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %c1 = icmp eq i64 %i.next, 100000
+  br i1 %c1, label %between, label %l1
+
+between:
+  br label %l2
+
+l2:
+  %j = phi i64 [ 0, %between ], [ %j.next, %l2 ]
+  %a.j = getelementptr inbounds float, float* %a, i64 %j
+  %b.j = getelementptr inbounds float, float* %b, i64 %j
+  %c.j = getelementptr inbounds float, float* %c, i64 %j
+  %la = load float, float* %a.j, align 4
+  %lb = load float, float* %b.j, align 4
+  %vc = fmul float %la, %lb
+  store float %vc, float* %c.j, align 4
+  %j.next = add nuw nsw i64 %j, 1
+  %c2 = icmp eq i64 %j.next, 100000
+  br i1 %c2, label %exit, label %l2
+
+exit:
+  ret void
+}
+
+; The second loop reads b[i + 1], which the first loop only writes in the
+; next iteration.
+define void @backward_dep(float* noalias %a, float* noalias %b,
+                          float* noalias %c) {
+; CHECK-LABEL: @backward_dep(
+; CHECK: l1:
+; CHECK: br i1 %c1, label %between, label %l1
+; CHECK: l2:
+entry:
+  br label %l1
+
+l1:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %l1 ]
+  %a.i = getelementptr inbounds float, float* %a, i64 %i
+  %b.i = getelementptr inbounds float, float* %b, i64 %i
+  %va = load float, float* %a.i, align 4
+  store float %va, float* %b.i, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %c1 = icmp eq i64 %i.next, 100000
+  br i1 %c1, label %between, label %l1
+
+between:
+  br label %l2
+
+l2:
+  %j = phi i64 [ 0, %between ], [ %j.next, %l2 ]
+  %j.1 = add nuw nsw i64 %j, 1
+  %b.j = getelementptr inbounds float, float* %b, i64 %j.1
+  %c.j = getelementptr inbounds float, float* %c, i64 %j
+  %lb = load float, float* %b.j, align 4
+  store float %lb, float* %c.j, align 4
+  %j.next = add nuw nsw i64 %j, 1
+  %c2 = icmp eq i64 %j.next, 100000
+  br i1 %c2, label %exit, label %l2
+
+exit:
+  ret void
+}
+
+; The loops run a different number of iterations.
+define void @trip_count(float* noalias %a, float* noalias %b) {
+; CHECK-LABEL: @trip_count(
+; CHECK: br i1 %c1, label %between, label %l1
+; CHECK: l2:
+entry:
+  br label %l1
+
+l1:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %l1 ]
+  %a.i = getelementptr inbounds float, float* %a, i64 %i
+  store float 0.000000e+00, float* %a.i, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %c1 = icmp eq i64 %i.next, 100000
+  br i1 %c1, label %between, label %l1
+
+between:
+  br label %l2
+
+l2:
+  %j = phi i64 [ 0, %between ], [ %j.next, %l2 ]
+  %a.j = getelementptr inbounds float, float* %a, i64 %j
+  %b.j = getelementptr inbounds float, float* %b, i64 %j
+  %la = load float, float* %a.j, align 4
+  store float %la, float* %b.j, align 4
+  %j.next = add nuw nsw i64 %j, 1
+  %c2 = icmp eq i64 %j.next, 99999
+  br i1 %c2, label %exit, label %l2
+
+exit:
+  ret void
+}
+
+; The loops share no data, so fusing them saves no memory traffic.
+define void @no_reuse(float* noalias %a, float* noalias %b,
+                      float* noalias %c, float* noalias %d) {
+; CHECK-LABEL: @no_reuse(
+; CHECK: br i1 %c1, label %between, label %l1
+; CHECK: l2:
+entry:
+  br label %l1
+
+l1:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %l1 ]
+  %a.i = getelementptr inbounds float, float* %a, i64 %i
+  %b.i = getelementptr inbounds float, float* %b, i64 %i
+  %va = load float, float* %a.i, align 4
+  store float %va, float* %b.i, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %c1 = icmp eq i64 %i.next, 100000
+  br i1 %c1, label %between, label %l1
+
+between:
+  br label %l2
+
+l2:
+  %j = phi i64 [ 0, %between ], [ %j.next, %l2 ]
+  %c.j = getelementptr inbounds float, float* %c, i64 %j
+  %d.j = getelementptr inbounds float, float* %d, i64 %j
+  %lc = load float, float* %c.j, align 4
+  store float %lc, float* %d.j, align 4
+  %j.next = add nuw nsw i64 %j, 1
+  %c2 = icmp eq i64 %j.next, 100000
+  br i1 %c2, label %exit, label %l2
+
+exit:
+  ret void
+}
+
+; The first loop only touches 1KB, which is still in the cache when the second
+; loop runs.
+define void @small(float* noalias %a, float* noalias %b) {
+; CHECK-LABEL: @small(
+; CHECK: br i1 %c1, label %between, label %l1
+; CHECK: l2:
+entry:
+  br label %l1
+
+l1:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %l1 ]
+  %a.i = getelementptr inbounds float, float* %a, i64 %i
+  store float 0.000000e+00, float* %a.i, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %c1 = icmp eq i64 %i.next, 256
+  br i1 %c1, label %between, label %l1
+
+between:
+  br label %l2
+
+l2:
+  %j = phi i64 [ 0, %between ], [ %j.next, %l2 ]
+  %a.j = getelementptr inbounds float, float* %a, i64 %j
+  %b.j = getelementptr inbounds float, float* %b, i64 %j
+  %la = load float, float* %a.j, align 4
+  store float %la, float* %b.j, align 4
+  %j.next = add nuw nsw i64 %j, 1
+  %c2 = icmp eq i64 %j.next, 256
+  br i1 %c2, label %exit, label %l2
+
+exit:
+  ret void
+}
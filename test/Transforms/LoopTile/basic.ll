@@ -0,0 +1,217 @@
+; RUN: opt -basicaa -loop-tile -verify-loop-info -verify-dom-info -S \
+; RUN:   < %s | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; Tile the transposition
+;   for (i = 0; i < 1024; i++)
+;     for (j = 0; j < 1024; j++)
+;       B[j][i] = A[i][j];
+; with 32 x 32 tiles, so that two tiles of 8KB fit in the 32KB L1 cache.
+
+define void @transpose([1024 x double]* noalias %A,
+                       [1024 x double]* noalias %B) {
+; CHECK-LABEL: @transpose(
+; CHECK: entry:
+; CHECK-NEXT: br label %outer.tile
+; CHECK: outer.tile:
+; CHECK-NEXT: %i.tile = phi i64 [ 0, %entry ], [ %i.tile.next, %outer.tile.latch ]
+; CHECK-NEXT: %i.tile.rem = sub i64 1024, %i.tile
+; CHECK-NEXT: %i.tile.full = icmp ugt i64 %i.tile.rem, 32
+; CHECK-NEXT: %i.tile.len = select i1 %i.tile.full, i64 32, i64 %i.tile.rem
+; CHECK-NEXT: %i.tile.end = add i64 %i.tile, %i.tile.len
+; CHECK-NEXT: br label %inner.tile
+; CHECK: inner.tile:
+; CHECK-NEXT: %j.tile = phi i64 [ 0, %outer.tile ], [ %j.tile.next, %inner.tile.latch ]
+; CHECK-NEXT: %j.tile.rem = sub i64 1024, %j.tile
+; CHECK-NEXT: %j.tile.full = icmp ugt i64 %j.tile.rem, 32
+; CHECK-NEXT: %j.tile.len = select i1 %j.tile.full, i64 32, i64 %j.tile.rem
+; CHECK-NEXT: %j.tile.end = add i64 %j.tile, %j.tile.len
+; CHECK-NEXT: br label %outer
+; CHECK: outer:
+; CHECK-NEXT: %i = phi i64 [ %i.tile, %inner.tile ], [ %i.next, %outer.latch ]
+; CHECK: inner:
+; CHECK-NEXT: %j = phi i64 [ %j.tile, %outer ], [ %j.next, %inner ]
+; CHECK: %cj = icmp eq i64 %j.next, %j.tile.end
+; CHECK-NEXT: br i1 %cj, label %outer.latch, label %inner, !llvm.loop ![[DISABLE:[0-9]+]]
+; CHECK: outer.latch:
+; CHECK: %ci = icmp eq i64 %i.next, %i.tile.end
+; CHECK-NEXT: br i1 %ci, label %inner.tile.latch, label %outer, !llvm.loop ![[DISABLE2:[0-9]+]]
+; CHECK: inner.tile.latch:
+; CHECK-NEXT: %j.tile.next = add i64 %j.tile, 32
+; CHECK-NEXT: br i1 %j.tile.full, label %inner.tile, label %outer.tile.latch
+; CHECK: outer.tile.latch:
+; CHECK-NEXT: %i.tile.next = add i64 %i.tile, 32
+; CHECK-NEXT: br i1 %i.tile.full, label %outer.tile, label %exit
+; CHECK: exit:
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %a = getelementptr inbounds [1024 x double], [1024 x double]* %A, i64 %i, i64 %j
+  %v = load double, double* %a, align 8
+  %b = getelementptr inbounds [1024 x double], [1024 x double]* %B, i64 %j, i64 %i
+  store double %v, double* %b, align 8
+  %j.next = add nuw nsw i64 %j, 1
+  %cj = icmp eq i64 %j.next, 1024
+  br i1 %cj, label %outer.latch, label %inner
+
+outer.latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %ci = icmp eq i64 %i.next, 1024
+  br i1 %ci, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+; The tile size of the inner loop comes from its metadata.
+
+define void @metadata([1024 x double]* noalias %A,
+                      [1024 x double]* noalias %B) {
+; CHECK-LABEL: @metadata(
+; CHECK: %i.tile.full = icmp ugt i64 %i.tile.rem, 32
+; CHECK: %j.tile.full = icmp ugt i64 %j.tile.rem, 128
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %a = getelementptr inbounds [1024 x double], [1024 x double]* %A, i64 %i, i64 %j
+  %v = load double, double* %a, align 8
+  %b = getelementptr inbounds [1024 x double], [1024 x double]* %B, i64 %j, i64 %i
+  store double %v, double* %b, align 8
+  %j.next = add nuw nsw i64 %j, 1
+  %cj = icmp slt i64 %j.next, 1024
+  br i1 %cj, label %inner, label %outer.latch, !llvm.loop !0
+
+outer.latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %ci = icmp eq i64 %i.next, 1024
+  br i1 %ci, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+; A[i][j] depends on A[i - 1][j + 1], so running the tile of j + 1 after the
+; one of j would read A[i - 1][j + 1] before it is written.
+
+define void @illegal([1024 x double]* noalias %A) {
+; CHECK-LABEL: @illegal(
+; CHECK-NOT: .tile
+; CHECK: ret void
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 1, %entry ], [ %i.next, %outer.latch ]
+  %i.prev = add nsw i64 %i, -1
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %j.next = add nuw nsw i64 %j, 1
+  %src = getelementptr inbounds [1024 x double], [1024 x double]* %A, i64 %i.prev, i64 %j.next
+  %v = load double, double* %src, align 8
+  %dst = getelementptr inbounds [1024 x double], [1024 x double]* %A, i64 %i, i64 %j
+  store double %v, double* %dst, align 8
+  %cj = icmp eq i64 %j.next, 1023
+  br i1 %cj, label %outer.latch, label %inner
+
+outer.latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %ci = icmp eq i64 %i.next, 1024
+  br i1 %ci, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+; The column sums
+;   for (i = 0; i < 1024; i++)
+;     for (j = 0; j < 1024; j++)
+;       S[i] += A[j][i];
+; depend on each other in either order of j, but only within one i, so they
+; may still be tiled.
+
+define void @column_sums([1024 x double]* noalias %A, double* noalias %S) {
+; CHECK-LABEL: @column_sums(
+; CHECK: outer.tile:
+; CHECK: inner.tile:
+; CHECK: ret void
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  %s = getelementptr inbounds double, double* %S, i64 %i
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %a = getelementptr inbounds [1024 x double], [1024 x double]* %A, i64 %j, i64 %i
+  %v = load double, double* %a, align 8
+  %sum = load double, double* %s, align 8
+  %add = fadd double %sum, %v
+  store double %add, double* %s, align 8
+  %j.next = add nuw nsw i64 %j, 1
+  %cj = icmp eq i64 %j.next, 1024
+  br i1 %cj, label %outer.latch, label %inner
+
+outer.latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %ci = icmp eq i64 %i.next, 1024
+  br i1 %ci, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+; Both 16 x 16 arrays fit in the cache, tiling would not save any misses.
+
+define void @small([16 x double]* noalias %A, [16 x double]* noalias %B) {
+; CHECK-LABEL: @small(
+; CHECK-NOT: .tile
+; CHECK: ret void
+entry:
+  br label %outer
+
+outer:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %outer.latch ]
+  br label %inner
+
+inner:
+  %j = phi i64 [ 0, %outer ], [ %j.next, %inner ]
+  %a = getelementptr inbounds [16 x double], [16 x double]* %A, i64 %i, i64 %j
+  %v = load double, double* %a, align 8
+  %b = getelementptr inbounds [16 x double], [16 x double]* %B, i64 %j, i64 %i
+  store double %v, double* %b, align 8
+  %j.next = add nuw nsw i64 %j, 1
+  %cj = icmp eq i64 %j.next, 16
+  br i1 %cj, label %outer.latch, label %inner
+
+outer.latch:
+  %i.next = add nuw nsw i64 %i, 1
+  %ci = icmp eq i64 %i.next, 16
+  br i1 %ci, label %exit, label %outer
+
+exit:
+  ret void
+}
+
+; CHECK: ![[DISABLE]] = distinct !{![[DISABLE]], ![[DISABLEMD:[0-9]+]]}
+; CHECK: ![[DISABLEMD]] = !{!"llvm.loop.tile.disable", i32 1}
+
+!0 = distinct !{!0, !1}
+!1 = !{!"llvm.loop.tile.size", i32 128}
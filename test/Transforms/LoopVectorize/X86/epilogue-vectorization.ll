@@ -0,0 +1,139 @@
+; RUN: opt -S -loop-vectorize -enable-epilogue-vectorization -force-vector-width=16 -force-vector-interleave=1 -mcpu=skx < %s | FileCheck %s
+; RUN: opt -S -loop-vectorize -force-vector-width=16 -force-vector-interleave=1 -mcpu=skx < %s | FileCheck %s --check-prefix=DISABLED
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; With an unknown trip count, up to 15 iterations are left by the vector loop,
+; so the remainder is vectorized with a VF of 8 before the scalar loop.
+;
+;   void add(int *A, int *B, int n) {
+;     for (int i = 0; i < n; i++)
+;       A[i] = B[i] + 42;
+;   }
+
+; CHECK-LABEL: @add(
+; CHECK: vector.body:
+; CHECK: add nsw <16 x i32>
+; CHECK: vector.body{{[0-9]+}}:
+; CHECK: add nsw <8 x i32>
+; CHECK: for.body:
+; CHECK: add nsw i32
+
+; DISABLED-LABEL: @add(
+; DISABLED: add nsw <16 x i32>
+; DISABLED-NOT: <8 x i32>
+; DISABLED: ret void
+
+define void @add(i32* noalias %A, i32* noalias %B, i64 %n) {
+entry:
+  %cmp = icmp sgt i64 %n, 0
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %src = getelementptr inbounds i32, i32* %B, i64 %i
+  %b = load i32, i32* %src, align 4
+  %add = add nsw i32 %b, 42
+  %dst = getelementptr inbounds i32, i32* %A, i64 %i
+  store i32 %add, i32* %dst, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
+
+; The profile says the loop runs 20 iterations, which leaves 4 of them to the
+; remainder: the epilogue is vectorized with a VF of 4.
+
+; CHECK-LABEL: @add_profiled(
+; CHECK: add nsw <16 x i32>
+; CHECK-NOT: <8 x i32>
+; CHECK: add nsw <4 x i32>
+; CHECK: ret void
+
+define void @add_profiled(i32* noalias %A, i32* noalias %B, i64 %n) {
+entry:
+  %cmp = icmp sgt i64 %n, 0
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %src = getelementptr inbounds i32, i32* %B, i64 %i
+  %b = load i32, i32* %src, align 4
+  %add = add nsw i32 %b, 42
+  %dst = getelementptr inbounds i32, i32* %A, i64 %i
+  store i32 %add, i32* %dst, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body, !prof !0
+
+for.end:
+  ret void
+}
+
+; A constant trip count that is a multiple of the step leaves nothing to an
+; epilogue.
+
+; CHECK-LABEL: @add_exact(
+; CHECK: add nsw <16 x i32>
+; CHECK-NOT: <8 x i32>
+; CHECK-NOT: <4 x i32>
+; CHECK: ret void
+
+define void @add_exact(i32* noalias %A, i32* noalias %B) {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %src = getelementptr inbounds i32, i32* %B, i64 %i
+  %b = load i32, i32* %src, align 4
+  %add = add nsw i32 %b, 42
+  %dst = getelementptr inbounds i32, i32* %A, i64 %i
+  store i32 %add, i32* %dst, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, 64
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
+
+; The exit block gets an entry from the middle block of both vector loops:
+; the reduction takes its final value from each of them, and other LCSSA
+; phis get undef.
+
+; CHECK-LABEL: @sum(
+; CHECK: middle.block:
+; CHECK: [[RDX:%.*]] = extractelement <16 x i32>
+; CHECK: middle.block{{[0-9]+}}:
+; CHECK: [[RDX_EPIL:%.*]] = extractelement <8 x i32>
+; CHECK: for.end:
+; CHECK-NEXT: %s.lcssa = phi i32 [ %s.next, %for.body ], [ [[RDX]], %middle.block ], [ [[RDX_EPIL]], %middle.block{{[0-9]+}} ]
+; CHECK-NEXT: %k.lcssa = phi i32 [ %k, %for.body ], [ undef, %middle.block ], [ undef, %middle.block{{[0-9]+}} ]
+
+define i32 @sum(i32* noalias %A, i64 %n, i32 %k) {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %for.body ]
+  %src = getelementptr inbounds i32, i32* %A, i64 %i
+  %a = load i32, i32* %src, align 4
+  %s.next = add nsw i32 %s, %a
+  %i.next = add nuw nsw i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  %s.lcssa = phi i32 [ %s.next, %for.body ]
+  %k.lcssa = phi i32 [ %k, %for.body ]
+  %r = add i32 %s.lcssa, %k.lcssa
+  ret i32 %r
+}
+
+!0 = !{!"branch_weights", i32 1, i32 19}
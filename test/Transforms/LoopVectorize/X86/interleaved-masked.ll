@@ -0,0 +1,152 @@
+; RUN: opt -S -loop-vectorize -instcombine -force-vector-width=4 -force-vector-interleave=1 -enable-interleaved-mem-accesses -mcpu=core-avx2 < %s | FileCheck %s
+; RUN: opt -S -loop-vectorize -instcombine -force-vector-width=4 -force-vector-interleave=1 -enable-interleaved-mem-accesses -mcpu=core-avx2 -enable-masked-interleaved-mem-accesses=false < %s | FileCheck %s --check-prefix=DISABLED
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; Check that an interleaved store group with a gap is vectorized with a masked
+; store that leaves the gap untouched.
+;
+;   void fill_rgb(int *RGBA, int *R, int *G, int *B) {
+;     for (int i = 0; i < 1024; i++) {
+;       RGBA[4*i]   = R[i];
+;       RGBA[4*i+1] = G[i];
+;       RGBA[4*i+2] = B[i];
+;     }
+;   }
+
+; CHECK-LABEL: @fill_rgb(
+; CHECK: %interleaved.vec = shufflevector <8 x i32> %{{.*}}, <8 x i32> %{{.*}}, <16 x i32>
+; CHECK: call void @llvm.masked.store.v16i32(<16 x i32> %interleaved.vec, <16 x i32>* %{{.*}}, i32 4, <16 x i1> <i1 true, i1 true, i1 true, i1 false, i1 true, i1 true, i1 true, i1 false, i1 true, i1 true, i1 true, i1 false, i1 true, i1 true, i1 true, i1 false>)
+
+; DISABLED-LABEL: @fill_rgb(
+; DISABLED-NOT: @llvm.masked.store
+; DISABLED: ret void
+
+define void @fill_rgb(i32* noalias %RGBA, i32* noalias %R, i32* noalias %G, i32* noalias %B) {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %r.addr = getelementptr inbounds i32, i32* %R, i64 %i
+  %r = load i32, i32* %r.addr, align 4
+  %g.addr = getelementptr inbounds i32, i32* %G, i64 %i
+  %g = load i32, i32* %g.addr, align 4
+  %b.addr = getelementptr inbounds i32, i32* %B, i64 %i
+  %b = load i32, i32* %b.addr, align 4
+  %idx0 = shl nsw i64 %i, 2
+  %idx1 = or i64 %idx0, 1
+  %idx2 = or i64 %idx0, 2
+  %dst0 = getelementptr inbounds i32, i32* %RGBA, i64 %idx0
+  store i32 %r, i32* %dst0, align 4
+  %dst1 = getelementptr inbounds i32, i32* %RGBA, i64 %idx1
+  store i32 %g, i32* %dst1, align 4
+  %dst2 = getelementptr inbounds i32, i32* %RGBA, i64 %idx2
+  store i32 %b, i32* %dst2, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, 1024
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
+
+; Check that an interleaved load group missing its last member is vectorized
+; with a masked load, so that the wide load can't read past the last tuple.
+;
+;   void luma(int *RGBA, int *Y) {
+;     for (int i = 0; i < 1024; i++)
+;       Y[i] = RGBA[4*i] + RGBA[4*i+1] + RGBA[4*i+2];
+;   }
+
+; CHECK-LABEL: @luma(
+; CHECK: %wide.masked.vec = call <16 x i32> @llvm.masked.load.v16i32(<16 x i32>* %{{.*}}, i32 4, <16 x i1> <i1 true, i1 true, i1 true, i1 false, i1 true, i1 true, i1 true, i1 false, i1 true, i1 true, i1 true, i1 false, i1 true, i1 true, i1 true, i1 false>, <16 x i32> undef)
+; CHECK: shufflevector <16 x i32> %wide.masked.vec, <16 x i32> undef, <4 x i32> <i32 0, i32 4, i32 8, i32 12>
+; CHECK: shufflevector <16 x i32> %wide.masked.vec, <16 x i32> undef, <4 x i32> <i32 1, i32 5, i32 9, i32 13>
+; CHECK: shufflevector <16 x i32> %wide.masked.vec, <16 x i32> undef, <4 x i32> <i32 2, i32 6, i32 10, i32 14>
+
+; DISABLED-LABEL: @luma(
+; DISABLED-NOT: @llvm.masked.load
+; DISABLED: ret void
+
+define void @luma(i32* noalias %RGBA, i32* noalias %Y) {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %idx0 = shl nsw i64 %i, 2
+  %idx1 = or i64 %idx0, 1
+  %idx2 = or i64 %idx0, 2
+  %src0 = getelementptr inbounds i32, i32* %RGBA, i64 %idx0
+  %r = load i32, i32* %src0, align 4
+  %src1 = getelementptr inbounds i32, i32* %RGBA, i64 %idx1
+  %g = load i32, i32* %src1, align 4
+  %src2 = getelementptr inbounds i32, i32* %RGBA, i64 %idx2
+  %b = load i32, i32* %src2, align 4
+  %rg = add nsw i32 %r, %g
+  %rgb = add nsw i32 %rg, %b
+  %dst = getelementptr inbounds i32, i32* %Y, i64 %i
+  store i32 %rgb, i32* %dst, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, 1024
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
+
+; Check that interleaved accesses in a predicated block are grouped and use
+; the block mask replicated for each member.
+;
+;   void cond_scale(int *C, int *Trigger) {
+;     for (int i = 0; i < 1024; i++)
+;       if (Trigger[i] > 0) {
+;         C[2*i]   *= 3;
+;         C[2*i+1] *= 3;
+;       }
+;   }
+
+; CHECK-LABEL: @cond_scale(
+; CHECK: %[[CMP:.*]] = icmp sgt <4 x i32> %{{.*}}, zeroinitializer
+; CHECK: %[[MASK:.*]] = shufflevector <4 x i1> %[[CMP]], <4 x i1> undef, <8 x i32> <i32 0, i32 0, i32 1, i32 1, i32 2, i32 2, i32 3, i32 3>
+; CHECK: %wide.masked.vec = call <8 x i32> @llvm.masked.load.v8i32(<8 x i32>* %{{.*}}, i32 4, <8 x i1> %[[MASK]], <8 x i32> undef)
+; CHECK: call void @llvm.masked.store.v8i32(<8 x i32> %{{.*}}, <8 x i32>* %{{.*}}, i32 4, <8 x i1> %{{.*}})
+
+; DISABLED-LABEL: @cond_scale(
+; DISABLED-NOT: <8 x i32> @llvm.masked.load
+; DISABLED: ret void
+
+define void @cond_scale(i32* noalias %C, i32* noalias %Trigger) {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.inc ]
+  %t.addr = getelementptr inbounds i32, i32* %Trigger, i64 %i
+  %t = load i32, i32* %t.addr, align 4
+  %cmp = icmp sgt i32 %t, 0
+  br i1 %cmp, label %if.then, label %for.inc
+
+if.then:
+  %idx0 = shl nsw i64 %i, 1
+  %idx1 = or i64 %idx0, 1
+  %p0 = getelementptr inbounds i32, i32* %C, i64 %idx0
+  %v0 = load i32, i32* %p0, align 4
+  %p1 = getelementptr inbounds i32, i32* %C, i64 %idx1
+  %v1 = load i32, i32* %p1, align 4
+  %m0 = mul nsw i32 %v0, 3
+  %m1 = mul nsw i32 %v1, 3
+  store i32 %m0, i32* %p0, align 4
+  store i32 %m1, i32* %p1, align 4
+  br label %for.inc
+
+for.inc:
+  %i.next = add nuw nsw i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, 1024
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
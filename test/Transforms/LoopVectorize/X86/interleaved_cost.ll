@@ -0,0 +1,75 @@
+; RUN: opt -S -debug-only=loop-vectorize -loop-vectorize -enable-interleaved-mem-accesses -force-vector-width=8 -force-vector-interleave=1 -mcpu=core-avx2 < %s 2>&1 | FileCheck %s
+; REQUIRES: asserts
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+%rgba32 = type { i32, i32, i32, i32 }
+%rgba8 = type { i8, i8, i8, i8 }
+
+; The members of a group of 32-bit elements each take one cross-lane permute
+; per register of the wide load, plus the blends: 4 loads, 4 x 4 permutes and
+; 4 x 3 blends.
+
+; CHECK-LABEL: LV: Checking a loop in "sum_rgba32"
+; CHECK: LV: Found an estimated cost of 32 for VF 8 For instruction:   %r = load i32, i32* %pr, align 4
+
+define void @sum_rgba32(%rgba32* noalias %p, i32* noalias %y, i64 %n) {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %pr = getelementptr inbounds %rgba32, %rgba32* %p, i64 %i, i32 0
+  %r = load i32, i32* %pr, align 4
+  %pg = getelementptr inbounds %rgba32, %rgba32* %p, i64 %i, i32 1
+  %g = load i32, i32* %pg, align 4
+  %pb = getelementptr inbounds %rgba32, %rgba32* %p, i64 %i, i32 2
+  %b = load i32, i32* %pb, align 4
+  %pa = getelementptr inbounds %rgba32, %rgba32* %p, i64 %i, i32 3
+  %a = load i32, i32* %pa, align 4
+  %s1 = add i32 %r, %g
+  %s2 = add i32 %s1, %b
+  %s3 = add i32 %s2, %a
+  %py = getelementptr inbounds i32, i32* %y, i64 %i
+  store i32 %s3, i32* %py, align 4
+  %i.next = add nuw nsw i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
+
+; There are no cross-lane permutes of bytes, so a group of 8-bit elements
+; keeps the cost of extracting and inserting every element.
+
+; CHECK-LABEL: LV: Checking a loop in "sum_rgba8"
+; CHECK: LV: Found an estimated cost of 65 for VF 8 For instruction:   %r = load i8, i8* %pr, align 1
+
+define void @sum_rgba8(%rgba8* noalias %p, i8* noalias %y, i64 %n) {
+entry:
+  br label %for.body
+
+for.body:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %for.body ]
+  %pr = getelementptr inbounds %rgba8, %rgba8* %p, i64 %i, i32 0
+  %r = load i8, i8* %pr, align 1
+  %pg = getelementptr inbounds %rgba8, %rgba8* %p, i64 %i, i32 1
+  %g = load i8, i8* %pg, align 1
+  %pb = getelementptr inbounds %rgba8, %rgba8* %p, i64 %i, i32 2
+  %b = load i8, i8* %pb, align 1
+  %pa = getelementptr inbounds %rgba8, %rgba8* %p, i64 %i, i32 3
+  %a = load i8, i8* %pa, align 1
+  %s1 = add i8 %r, %g
+  %s2 = add i8 %s1, %b
+  %s3 = add i8 %s2, %a
+  %py = getelementptr inbounds i8, i8* %y, i64 %i
+  store i8 %s3, i8* %py, align 1
+  %i.next = add nuw nsw i64 %i, 1
+  %exitcond = icmp eq i64 %i.next, %n
+  br i1 %exitcond, label %for.end, label %for.body
+
+for.end:
+  ret void
+}
@@ -0,0 +1,110 @@
+; RUN: opt -newgvn -S < %s | FileCheck %s
+
+declare void @use(i32, i32)
+declare i1 @cond()
+
+; Commuted operands are congruent.
+
+; CHECK-LABEL: @commute(
+; CHECK: %x = add i32 %a, %b
+; CHECK-NEXT: call void @use(i32 %x, i32 %x)
+define void @commute(i32 %a, i32 %b) {
+entry:
+  %x = add i32 %a, %b
+  %y = add i32 %b, %a
+  call void @use(i32 %x, i32 %y)
+  ret void
+}
+
+; The two induction variables are only found congruent by assuming that
+; their PHIs are before proving it.
+
+; CHECK-LABEL: @ivs(
+; CHECK-NOT: %j
+; CHECK: ret i32 0
+define i32 @ivs(i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %j = phi i32 [ 0, %entry ], [ %j.next, %loop ]
+  %i.next = add i32 %i, 1
+  %j.next = add i32 %j, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %d = sub i32 %i.next, %j.next
+  ret i32 %d
+}
+
+; The block %never is never reached, as %p is always 1, so %q is 1 too.
+
+; CHECK-LABEL: @unreachable(
+; CHECK: exit:
+; CHECK-NEXT: ret i32 1
+define i32 @unreachable() {
+entry:
+  br label %loop
+
+loop:
+  %p = phi i32 [ 1, %entry ], [ %q, %latch ]
+  %c = icmp eq i32 %p, 1
+  br i1 %c, label %latch, label %never
+
+never:
+  br label %latch
+
+latch:
+  %q = phi i32 [ %p, %loop ], [ 2, %never ]
+  %cont = call i1 @cond()
+  br i1 %cont, label %loop, label %exit
+
+exit:
+  ret i32 %q
+}
+
+; Only dominating members of a class replace the others.
+
+; CHECK-LABEL: @diamond(
+; CHECK: then:
+; CHECK-NEXT: %x = mul i32 %a, %b
+; CHECK: else:
+; CHECK-NEXT: %y = mul i32 %a, %b
+; CHECK: join:
+; CHECK-NEXT: %z = mul i32 %a, %b
+define i32 @diamond(i32 %a, i32 %b, i1 %c) {
+entry:
+  br i1 %c, label %then, label %else
+
+then:
+  %x = mul i32 %a, %b
+  call void @use(i32 %x, i32 %x)
+  br label %join
+
+else:
+  %y = mul i32 %a, %b
+  call void @use(i32 %y, i32 %y)
+  br label %join
+
+join:
+  %z = mul i32 %a, %b
+  ret i32 %z
+}
+
+; (%r + 1) - 1 simplifies to the srem, whose class it then joins.  The
+; flags and metadata of the two are not combined.
+
+; CHECK-LABEL: @simplified_opcode(
+; CHECK: %r = srem i32 %n, 47
+; CHECK-NEXT: %a = add i32 %r, 1
+; CHECK-NEXT: call void @use(i32 %r, i32 %r)
+define void @simplified_opcode(i32 %n) {
+entry:
+  %r = srem i32 %n, 47
+  %a = add i32 %r, 1
+  %s = sub nsw i32 %a, 1
+  call void @use(i32 %r, i32 %s)
+  ret void
+}
@@ -0,0 +1,87 @@
+; RUN: opt -basicaa -newgvn -S < %s | FileCheck %s
+
+declare i32 @pure(i32) nounwind readnone
+declare i32 @reader(i32*) nounwind readonly
+
+; A store to memory that doesn't alias the loads doesn't separate them.
+
+; CHECK-LABEL: @load_cse(
+; CHECK: %x = load i32, i32* %p
+; CHECK-NOT: load
+; CHECK: add i32 %x, %x
+define i32 @load_cse(i32* noalias %p, i32* noalias %q) {
+entry:
+  %x = load i32, i32* %p
+  store i32 1, i32* %q
+  %y = load i32, i32* %p
+  %s = add i32 %x, %y
+  ret i32 %s
+}
+
+; The value of a store reaches the load from the same pointer.
+
+; CHECK-LABEL: @store_forward(
+; CHECK-NOT: load
+; CHECK: ret i32 %v
+define i32 @store_forward(i32* %p, i32 %v) {
+entry:
+  store i32 %v, i32* %p
+  %x = load i32, i32* %p
+  ret i32 %x
+}
+
+; The store in %clobber is never executed, so the MemoryPhis of the loop are
+; congruent to the store in the entry block.
+
+; CHECK-LABEL: @memory_phi(
+; CHECK: loop:
+; CHECK-NOT: load
+; CHECK: exit:
+; CHECK-NEXT: ret i32 42
+define i32 @memory_phi(i32* %p, i32 %n) {
+entry:
+  store i32 42, i32* %p
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %f = phi i32 [ 0, %entry ], [ %f, %latch ]
+  %v = load i32, i32* %p
+  %c = icmp ne i32 %f, 0
+  br i1 %c, label %clobber, label %latch
+
+clobber:
+  store i32 0, i32* %p
+  br label %latch
+
+latch:
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret i32 %v
+}
+
+; Calls that don't write memory are numbered like other instructions, with
+; the state of memory they read when they read memory.
+
+; CHECK-LABEL: @calls(
+; CHECK: %a = call i32 @pure(i32 %x)
+; CHECK-NEXT: %b = call i32 @reader(i32* %p)
+; CHECK-NEXT: store i32 %x, i32* %p
+; CHECK-NEXT: %d = call i32 @reader(i32* %p)
+; CHECK-NEXT: %s1 = add i32 %a, %a
+; CHECK-NEXT: %s2 = add i32 %b, %d
+define i32 @calls(i32* %p, i32 %x) {
+entry:
+  %a = call i32 @pure(i32 %x)
+  %b = call i32 @reader(i32* %p)
+  %c = call i32 @pure(i32 %x)
+  store i32 %x, i32* %p
+  %d = call i32 @reader(i32* %p)
+  %s1 = add i32 %a, %c
+  %s2 = add i32 %b, %d
+  %s = add i32 %s1, %s2
+  ret i32 %s
+}
@@ -0,0 +1,98 @@
+; RUN: opt < %s -pgo-instr-gen -pgo-instr-sampling -pgo-instr-sampling-period=101 -S | FileCheck %s --check-prefix=GEN
+; RUN: opt < %s -pgo-instr-gen -S | FileCheck %s --check-prefix=NOSAMPLE
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+; GEN: $__llvm_pgo_sample_countdown = comdat any
+; GEN: @__llvm_pgo_sample_countdown = linkonce_odr hidden thread_local(initialexec) global i32 0, comdat
+; NOSAMPLE-NOT: __llvm_pgo_sample_countdown
+
+; The new entry block decides whether the invocation runs the instrumented
+; body, and keeps the static allocas shared by both bodies.
+
+define i32 @test_br_1(i32 %i) {
+; GEN-LABEL: @test_br_1(
+; GEN: pgo.sample:
+; GEN-NEXT: %p = alloca i32
+; GEN-NEXT: %pgo.countdown = load i32, i32* @__llvm_pgo_sample_countdown
+; GEN-NEXT: [[NEXT:%.*]] = sub i32 %pgo.countdown, 1
+; GEN-NEXT: %pgo.sampled = icmp sle i32 [[NEXT]], 0
+; GEN-NEXT: [[RESET:%.*]] = select i1 %pgo.sampled, i32 101, i32 [[NEXT]]
+; GEN-NEXT: store i32 [[RESET]], i32* @__llvm_pgo_sample_countdown
+; GEN-NEXT: br i1 %pgo.sampled, label %entry, label %entry.nosample, !prof ![[BW:[0-9]+]]
+; GEN: entry:
+; GEN-NOT: alloca
+; GEN: store i32 %i, i32* %p
+; GEN: if.then:
+; GEN: call void @llvm.instrprof.increment(i8* getelementptr inbounds ([9 x i8], [9 x i8]* @__profn_test_br_1, i32 0, i32 0), i64 25571299074, i32 2, i32 1)
+; GEN: if.end:
+; GEN: call void @llvm.instrprof.increment(i8* getelementptr inbounds ([9 x i8], [9 x i8]* @__profn_test_br_1, i32 0, i32 0), i64 25571299074, i32 2, i32 0)
+; GEN: entry.nosample:
+; GEN-NOT: llvm.instrprof.increment
+; GEN: store i32 %i, i32* %p
+; GEN: br i1 %cmp.nosample, label %if.then.nosample, label %if.end.nosample
+; GEN-NOT: llvm.instrprof.increment
+; GEN: if.end.nosample:
+; GEN-NEXT: %retv.nosample = phi i32 [ %add.nosample, %if.then.nosample ], [ %i, %entry.nosample ]
+; GEN-NOT: llvm.instrprof.increment
+; GEN: ret i32 %retv.nosample
+entry:
+  %p = alloca i32
+  store i32 %i, i32* %p
+  %cmp = icmp sgt i32 %i, 0
+  br i1 %cmp, label %if.then, label %if.end
+
+if.then:
+  %add = add nsw i32 %i, 2
+  br label %if.end
+
+if.end:
+  %retv = phi i32 [ %add, %if.then ], [ %i, %entry ]
+  ret i32 %retv
+}
+
+; A function whose blocks have their address taken is only instrumented.
+
+@dest = global i8* blockaddress(@indirect, %target)
+
+define i32 @indirect(i8* %addr) {
+; GEN-LABEL: @indirect(
+; GEN-NOT: pgo.sample
+; GEN-NOT: nosample
+; GEN: ret i32 1
+entry:
+  indirectbr i8* %addr, [label %target]
+
+target:
+  ret i32 1
+}
+
+; So is a function that escapes its locals, which it may only do once and
+; in the entry block.
+
+define i32 @escape(i32 %i) {
+; GEN-LABEL: @escape(
+; GEN-NOT: pgo.sample
+; GEN: entry:
+; GEN-NEXT: %a = alloca i32
+; GEN-NEXT: call void (...) @llvm.localescape(i32* %a)
+; GEN-NOT: nosample
+; GEN: ret i32
+entry:
+  %a = alloca i32
+  call void (...) @llvm.localescape(i32* %a)
+  store i32 %i, i32* %a
+  %cmp = icmp sgt i32 %i, 0
+  br i1 %cmp, label %if.then, label %if.end
+
+if.then:
+  br label %if.end
+
+if.end:
+  %retv = phi i32 [ 1, %if.then ], [ 0, %entry ]
+  ret i32 %retv
+}
+
+declare void @llvm.localescape(...)
+
+; GEN: ![[BW]] = !{!"branch_weights", i32 1, i32 100}
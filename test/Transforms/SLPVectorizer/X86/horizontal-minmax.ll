@@ -0,0 +1,163 @@
+; RUN: opt -slp-vectorizer -S < %s -mtriple=x86_64-unknown-linux-gnu -mcpu=core-avx2 | FileCheck %s
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+
+@arr = global [16 x i32] zeroinitializer, align 16
+@arr_f = global [16 x float] zeroinitializer, align 16
+
+; Check that a chain of signed max operations over consecutive loads is
+; vectorized as a min/max horizontal reduction.
+;
+;   int smax8() {
+;     int m = arr[0];
+;     for (int i = 1; i < 8; i++)
+;       m = m > arr[i] ? m : arr[i];
+;     return m;
+;   }
+
+; CHECK-LABEL: @smax8(
+; CHECK: load <8 x i32>
+; CHECK: icmp sgt <8 x i32>
+; CHECK: select <8 x i1>
+; CHECK: extractelement <8 x i32>
+; CHECK: ret i32
+
+define i32 @smax8() {
+  %a0 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 0), align 4
+  %a1 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 1), align 4
+  %a2 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 2), align 4
+  %a3 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 3), align 4
+  %a4 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 4), align 4
+  %a5 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 5), align 4
+  %a6 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 6), align 4
+  %a7 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 7), align 4
+  %c1 = icmp sgt i32 %a0, %a1
+  %m1 = select i1 %c1, i32 %a0, i32 %a1
+  %c2 = icmp sgt i32 %m1, %a2
+  %m2 = select i1 %c2, i32 %m1, i32 %a2
+  %c3 = icmp sgt i32 %m2, %a3
+  %m3 = select i1 %c3, i32 %m2, i32 %a3
+  %c4 = icmp sgt i32 %m3, %a4
+  %m4 = select i1 %c4, i32 %m3, i32 %a4
+  %c5 = icmp sgt i32 %m4, %a5
+  %m5 = select i1 %c5, i32 %m4, i32 %a5
+  %c6 = icmp sgt i32 %m5, %a6
+  %m6 = select i1 %c6, i32 %m5, i32 %a6
+  %c7 = icmp sgt i32 %m6, %a7
+  %m7 = select i1 %c7, i32 %m6, i32 %a7
+  ret i32 %m7
+}
+
+; The reduction of twelve values is done with a full width of eight lanes
+; followed by a partial reduction of the four values left over.
+
+; CHECK-LABEL: @umin12(
+; CHECK: load <8 x i32>
+; CHECK: load <4 x i32>
+; CHECK: icmp ult <8 x i32>
+; CHECK: icmp ult <4 x i32>
+; CHECK: ret i32
+
+define i32 @umin12() {
+  %a0 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 0), align 4
+  %a1 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 1), align 4
+  %a2 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 2), align 4
+  %a3 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 3), align 4
+  %a4 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 4), align 4
+  %a5 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 5), align 4
+  %a6 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 6), align 4
+  %a7 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 7), align 4
+  %a8 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 8), align 4
+  %a9 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 9), align 4
+  %a10 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 10), align 4
+  %a11 = load i32, i32* getelementptr inbounds ([16 x i32], [16 x i32]* @arr, i64 0, i64 11), align 4
+  %c1 = icmp ult i32 %a0, %a1
+  %m1 = select i1 %c1, i32 %a0, i32 %a1
+  %c2 = icmp ult i32 %m1, %a2
+  %m2 = select i1 %c2, i32 %m1, i32 %a2
+  %c3 = icmp ult i32 %m2, %a3
+  %m3 = select i1 %c3, i32 %m2, i32 %a3
+  %c4 = icmp ult i32 %m3, %a4
+  %m4 = select i1 %c4, i32 %m3, i32 %a4
+  %c5 = icmp ult i32 %m4, %a5
+  %m5 = select i1 %c5, i32 %m4, i32 %a5
+  %c6 = icmp ult i32 %m5, %a6
+  %m6 = select i1 %c6, i32 %m5, i32 %a6
+  %c7 = icmp ult i32 %m6, %a7
+  %m7 = select i1 %c7, i32 %m6, i32 %a7
+  %c8 = icmp ult i32 %m7, %a8
+  %m8 = select i1 %c8, i32 %m7, i32 %a8
+  %c9 = icmp ult i32 %m8, %a9
+  %m9 = select i1 %c9, i32 %m8, i32 %a9
+  %c10 = icmp ult i32 %m9, %a10
+  %m10 = select i1 %c10, i32 %m9, i32 %a10
+  %c11 = icmp ult i32 %m10, %a11
+  %m11 = select i1 %c11, i32 %m10, i32 %a11
+  ret i32 %m11
+}
+
+; Floating point max operations can be reassociated if NaNs can be ignored.
+
+; CHECK-LABEL: @fmax8(
+; CHECK: load <8 x float>
+; CHECK: fcmp fast ogt <8 x float>
+; CHECK: select <8 x i1>
+; CHECK: ret float
+
+define float @fmax8() {
+  %a0 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 0), align 4
+  %a1 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 1), align 4
+  %a2 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 2), align 4
+  %a3 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 3), align 4
+  %a4 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 4), align 4
+  %a5 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 5), align 4
+  %a6 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 6), align 4
+  %a7 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 7), align 4
+  %c1 = fcmp fast ogt float %a0, %a1
+  %m1 = select i1 %c1, float %a0, float %a1
+  %c2 = fcmp fast ogt float %m1, %a2
+  %m2 = select i1 %c2, float %m1, float %a2
+  %c3 = fcmp fast ogt float %m2, %a3
+  %m3 = select i1 %c3, float %m2, float %a3
+  %c4 = fcmp fast ogt float %m3, %a4
+  %m4 = select i1 %c4, float %m3, float %a4
+  %c5 = fcmp fast ogt float %m4, %a5
+  %m5 = select i1 %c5, float %m4, float %a5
+  %c6 = fcmp fast ogt float %m5, %a6
+  %m6 = select i1 %c6, float %m5, float %a6
+  %c7 = fcmp fast ogt float %m6, %a7
+  %m7 = select i1 %c7, float %m6, float %a7
+  ret float %m7
+}
+
+; But not if they have to be honored.
+
+; CHECK-LABEL: @fmax8_nans(
+; CHECK-NOT: <8 x float>
+; CHECK: ret float
+
+define float @fmax8_nans() {
+  %a0 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 0), align 4
+  %a1 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 1), align 4
+  %a2 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 2), align 4
+  %a3 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 3), align 4
+  %a4 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 4), align 4
+  %a5 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 5), align 4
+  %a6 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 6), align 4
+  %a7 = load float, float* getelementptr inbounds ([16 x float], [16 x float]* @arr_f, i64 0, i64 7), align 4
+  %c1 = fcmp ogt float %a0, %a1
+  %m1 = select i1 %c1, float %a0, float %a1
+  %c2 = fcmp ogt float %m1, %a2
+  %m2 = select i1 %c2, float %m1, float %a2
+  %c3 = fcmp ogt float %m2, %a3
+  %m3 = select i1 %c3, float %m2, float %a3
+  %c4 = fcmp ogt float %m3, %a4
+  %m4 = select i1 %c4, float %m3, float %a4
+  %c5 = fcmp ogt float %m4, %a5
+  %m5 = select i1 %c5, float %m4, float %a5
+  %c6 = fcmp ogt float %m5, %a6
+  %m6 = select i1 %c6, float %m5, float %a6
+  %c7 = fcmp ogt float %m6, %a7
+  %m7 = select i1 %c7, float %m6, float %a7
+  ret float %m7
+}
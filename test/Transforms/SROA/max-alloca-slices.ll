@@ -0,0 +1,64 @@
+; RUN: opt < %s -sroa -S | FileCheck %s
+; RUN: opt < %s -sroa -sroa-max-alloca-slices=4 -S | FileCheck %s --check-prefix=PARTIAL
+target datalayout = "e-p:64:64:64-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+declare void @llvm.memcpy.p0i8.p0i8.i32(i8* nocapture, i8* nocapture, i32, i32, i1) nounwind
+
+define i32 @partial(i8* %src) {
+; The first half of the alloca is copied from %src, and the second half is
+; only accessed by scalar loads and stores. With more slices than the limit,
+; the first half stays in memory while the second half is still promoted.
+;
+; CHECK-LABEL: @partial(
+; CHECK-NOT: alloca
+; CHECK-NOT: memcpy
+; CHECK: ret i32
+;
+; PARTIAL-LABEL: @partial(
+; PARTIAL: %a = alloca [8 x i32]
+; PARTIAL: call void @llvm.memcpy.p0i8.p0i8.i32(i8* %a8, i8* %src, i32 16, i32 4, i1 false)
+; PARTIAL-NOT: store
+; PARTIAL: %l0 = load i32, i32* %p0
+; PARTIAL: %l1 = load i32, i32* %p1
+; PARTIAL: %s1 = add i32 %l0, %l1
+; PARTIAL-NEXT: %s2 = add i32 %s1, 1
+; PARTIAL-NEXT: %s3 = add i32 %s2, 4
+; PARTIAL-NEXT: ret i32 %s3
+entry:
+  %a = alloca [8 x i32]
+  %a8 = bitcast [8 x i32]* %a to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i32(i8* %a8, i8* %src, i32 16, i32 4, i1 false)
+  %p0 = getelementptr [8 x i32], [8 x i32]* %a, i64 0, i64 0
+  %p1 = getelementptr [8 x i32], [8 x i32]* %a, i64 0, i64 1
+  %p4 = getelementptr [8 x i32], [8 x i32]* %a, i64 0, i64 4
+  %p5 = getelementptr [8 x i32], [8 x i32]* %a, i64 0, i64 5
+  %p6 = getelementptr [8 x i32], [8 x i32]* %a, i64 0, i64 6
+  %p7 = getelementptr [8 x i32], [8 x i32]* %a, i64 0, i64 7
+  store i32 1, i32* %p4
+  store i32 2, i32* %p5
+  store i32 3, i32* %p6
+  store i32 4, i32* %p7
+  %l0 = load i32, i32* %p0
+  %l1 = load i32, i32* %p1
+  %l4 = load i32, i32* %p4
+  %l7 = load i32, i32* %p7
+  %s1 = add i32 %l0, %l1
+  %s2 = add i32 %s1, %l4
+  %s3 = add i32 %s2, %l7
+  ret i32 %s3
+}
+
+define i32 @under_limit(i8* %src) {
+; Allocas with at most as many slices as the limit are split completely.
+;
+; PARTIAL-LABEL: @under_limit(
+; PARTIAL-NOT: alloca
+; PARTIAL: ret i32
+entry:
+  %a = alloca [2 x i32]
+  %a8 = bitcast [2 x i32]* %a to i8*
+  call void @llvm.memcpy.p0i8.p0i8.i32(i8* %a8, i8* %src, i32 8, i32 4, i1 false)
+  %p1 = getelementptr [2 x i32], [2 x i32]* %a, i64 0, i64 1
+  %l1 = load i32, i32* %p1
+  ret i32 %l1
+}
@@ -0,0 +1,37 @@
+; RUN: opt -basicaa -print-memoryssa -verify-memoryssa -analyze < %s 2>&1 | FileCheck %s
+; RUN: opt -basicaa -print-memoryssa -verify-memoryssa -analyze -memssa-check-limit=1 < %s 2>&1 | FileCheck %s --check-prefix=LIMIT
+
+; Once a query followed -memssa-check-limit phi arguments, the walker stops at
+; the next phi instead of finding the store to %local above both diamonds.
+; CHECK-LABEL: define void @check
+; LIMIT-LABEL: define void @check
+define void @check(i8* %ptr, i1 %bool) {
+entry:
+  %local = alloca i8, align 1
+; CHECK: 1 = MemoryDef(liveOnEntry)
+; CHECK-NEXT: store i8 0, i8* %local, align 1
+  store i8 0, i8* %local, align 1
+  br i1 %bool, label %if.then, label %if.end
+
+if.then:
+  store i8 0, i8* %ptr, align 1
+  br label %if.end
+
+if.end:
+  br i1 %bool, label %if.then2, label %if.end2
+
+if.then2:
+  %p2 = getelementptr inbounds i8, i8* %ptr, i32 1
+  store i8 0, i8* %p2, align 1
+  br label %if.end2
+
+if.end2:
+; CHECK: 4 = MemoryPhi({if.end,5},{if.then2,3})
+; CHECK: MemoryUse(1)
+; CHECK-NEXT: load i8, i8* %local, align 1
+; LIMIT: 4 = MemoryPhi({if.end,5},{if.then2,3})
+; LIMIT: MemoryUse(5)
+; LIMIT-NEXT: load i8, i8* %local, align 1
+  load i8, i8* %local, align 1
+  ret void
+}
@@ -15,12 +15,15 @@
 
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/CodeGen/CommandFlags.h"
 #include "llvm/CodeGen/LinkAllAsmWriterComponents.h"
 #include "llvm/CodeGen/LinkAllCodegenComponents.h"
 #include "llvm/CodeGen/MIRParser/MIRParser.h"
+#include "llvm/CodeGen/ParallelCG.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/IRPrintingPasses.h"
 #include "llvm/IR/LLVMContext.h"
@@ -36,6 +39,7 @@
 #include "llvm/Support/FormattedStream.h"
 #include "llvm/Support/Host.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/PluginLoader.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
@@ -103,12 +107,22 @@ static cl::opt<bool>
                           "manager and verify the result is the same."),
                  cl::init(false));
 
+static cl::opt<unsigned>
+Threads("threads", cl::init(1u), cl::value_desc("N"),
+        cl::desc("Split the module into N partitions and generate code for "
+                 "them in parallel, writing partition I to <output dir>/I.s "
+                 "or <output dir>/I.o"));
+
 static cl::opt<bool> DiscardValueNames(
     "discard-value-names",
     cl::desc("Discard names from Value (other than GlobalValue)."),
     cl::init(false), cl::Hidden);
 
 static int compileModule(char **, LLVMContext &);
+static int compileModuleInParallel(char **, std::unique_ptr<Module>,
+                                   const Target *, const Triple &, StringRef,
+                                   StringRef, const TargetOptions &,
+                                   CodeGenOpt::Level, bool);
 
 static std::unique_ptr<tool_output_file>
 GetOutputStream(const char *TargetName, Triple::OSType OS,
@@ -309,6 +323,23 @@ static int compileModule(char **argv, LLVMContext &Context) {
   if (FloatABIForCalls != FloatABI::Default)
     Options.FloatABIType = FloatABIForCalls;
 
+  // Add the target data from the target machine, if it exists, or the module.
+  M->setDataLayout(Target->createDataLayout());
+
+  // Override function attributes based on CPUStr, FeaturesStr, and command line
+  // flags.
+  setFunctionAttributes(CPUStr, FeaturesStr, *M);
+
+  if (RelaxAll.getNumOccurrences() > 0 &&
+      FileType != TargetMachine::CGFT_ObjectFile)
+    errs() << argv[0]
+             << ": warning: ignoring -mc-relax-all because filetype != obj";
+
+  if (Threads > 1)
+    return compileModuleInParallel(argv, std::move(M), TheTarget, TheTriple,
+                                   CPUStr, FeaturesStr, Options, OLvl,
+                                   MIR != nullptr);
+
   // Figure out where we are going to send the output.
   std::unique_ptr<tool_output_file> Out =
       GetOutputStream(TheTarget->getName(), TheTriple.getOS(), argv[0]);
@@ -325,18 +356,6 @@ static int compileModule(char **argv, LLVMContext &Context) {
     TLII.disableAllFunctions();
   PM.add(new TargetLibraryInfoWrapperPass(TLII));
 
-  // Add the target data from the target machine, if it exists, or the module.
-  M->setDataLayout(Target->createDataLayout());
-
-  // Override function attributes based on CPUStr, FeaturesStr, and command line
-  // flags.
-  setFunctionAttributes(CPUStr, FeaturesStr, *M);
-
-  if (RelaxAll.getNumOccurrences() > 0 &&
-      FileType != TargetMachine::CGFT_ObjectFile)
-    errs() << argv[0]
-             << ": warning: ignoring -mc-relax-all because filetype != obj";
-
   {
     raw_pwrite_stream *OS = &Out->os();
 
@@ -437,3 +456,75 @@ static int compileModule(char **argv, LLVMContext &Context) {
 
   return 0;
 }
+
+/// Split M into -threads partitions and generate code for them in parallel,
+/// writing partition I to I.s or I.o in the output directory. Linking the
+/// partitions together gives the same program as the single output file of
+/// compileModule would.
+static int compileModuleInParallel(char **argv, std::unique_ptr<Module> M,
+                                   const Target *TheTarget,
+                                   const Triple &TheTriple, StringRef CPUStr,
+                                   StringRef FeaturesStr,
+                                   const TargetOptions &Options,
+                                   CodeGenOpt::Level OLvl, bool IsMIR) {
+  if (IsMIR || !RunPass.empty() || !StartAfter.empty() || !StopAfter.empty() ||
+      CompileTwice) {
+    errs() << argv[0] << ": -threads only supports generating code for a "
+                         "whole IR module.\n";
+    return 1;
+  }
+  // The partitions are separate objects, which only a linker can combine.
+  // Rather than leave the user with files named after an object that is
+  // never written, -o has to name the directory to put them in.
+  if (OutputFilename.empty() || !sys::fs::is_directory(OutputFilename)) {
+    errs() << argv[0] << ": -threads writes one file per partition, so -o "
+                         "must name an existing directory.\n";
+    return 1;
+  }
+
+  StringRef Ext;
+  sys::fs::OpenFlags OpenFlags = sys::fs::F_None;
+  switch (FileType) {
+  case TargetMachine::CGFT_AssemblyFile:
+    Ext = ".s";
+    OpenFlags |= sys::fs::F_Text;
+    break;
+  case TargetMachine::CGFT_ObjectFile:
+    Ext = TheTriple.getOS() == Triple::Win32 ? ".obj" : ".o";
+    break;
+  case TargetMachine::CGFT_Null:
+    Ext = ".null";
+    break;
+  }
+
+  std::vector<std::unique_ptr<tool_output_file>> Outs;
+  std::vector<raw_pwrite_stream *> OSs;
+  for (unsigned I = 0; I != Threads; ++I) {
+    SmallString<128> Path(OutputFilename);
+    sys::path::append(Path, utostr(I) + Ext);
+    std::error_code EC;
+    Outs.push_back(llvm::make_unique<tool_output_file>(Path, EC, OpenFlags));
+    if (EC) {
+      errs() << EC.message() << '\n';
+      return 1;
+    }
+    OSs.push_back(&Outs.back()->os());
+  }
+
+  // Before executing passes, print the final values of the LLVM options.
+  cl::PrintOptionValues();
+
+  // splitCodeGen looks the target up again from the module, which may have
+  // been left to the default triple.
+  M->setTargetTriple(TheTriple.getTriple());
+
+  // Locals are kept local, so that the partitions export no more symbols than
+  // the whole module would.
+  splitCodeGen(std::move(M), OSs, CPUStr, FeaturesStr, Options, RelocModel,
+               CMModel, OLvl, FileType, /*PreserveLocals=*/true);
+
+  // Declare success.
+  for (auto &Out : Outs)
+    Out->keep();
+  return 0;
+}
@@ -52,6 +52,10 @@ class MatcherTableEmitter {
   DenseMap<Record*, unsigned> NodeXFormMap;
   std::vector<Record*> NodeXForms;
 
+  /// The opcode of each case of an OPC_SwitchOpcode at the start of the table,
+  /// and the index of the case's matcher.
+  std::vector<std::pair<std::string, unsigned>> OpcodeDispatch;
+
 public:
   MatcherTableEmitter(const CodeGenDAGPatterns &cgp)
     : CGP(cgp) {}
@@ -62,6 +66,8 @@ public:
   void EmitPredicateFunctions(formatted_raw_ostream &OS);
 
   void EmitHistogram(const Matcher *N, formatted_raw_ostream &OS);
+
+  void EmitOpcodeDispatch(formatted_raw_ostream &OS);
 private:
   unsigned EmitMatcher(const Matcher *N, unsigned Indent, unsigned CurrentIdx,
                        formatted_raw_ostream &OS);
@@ -357,6 +363,13 @@ EmitMatcher(const Matcher *N, unsigned Indent, unsigned CurrentIdx,
 
       CurrentIdx += IdxSize;
 
+      // Remember where the cases of a top-level opcode switch start, so that
+      // SelectCode can jump straight to them.
+      if (StartIdx == 0)
+        if (const SwitchOpcodeMatcher *SOM = dyn_cast<SwitchOpcodeMatcher>(N))
+          OpcodeDispatch.push_back(
+              std::make_pair(SOM->getCaseOpcode(i).getEnumName(), CurrentIdx));
+
       if (!OmitComments)
         OS << "// ->" << CurrentIdx+ChildSize;
       OS << '\n';
@@ -816,6 +829,22 @@ void MatcherTableEmitter::EmitHistogram(const Matcher *M,
   OS << '\n';
 }
 
+/// EmitOpcodeDispatch - Emit a switch on the opcode of the node to select that
+/// computes the index of its case in the top-level OPC_SwitchOpcode, which the
+/// C++ compiler can turn into a jump table.  This saves SelectCodeCommon from
+/// scanning the cases one by one.
+void MatcherTableEmitter::EmitOpcodeDispatch(formatted_raw_ostream &OS) {
+  OS << "  unsigned MatcherIndex = 0;\n";
+  if (OpcodeDispatch.empty())
+    return;
+
+  OS << "  switch (N->getOpcode()) {\n";
+  OS << "  default: break;\n";
+  for (const auto &Case : OpcodeDispatch)
+    OS << "  case " << Case.first << ": MatcherIndex = " << Case.second
+       << "; break;\n";
+  OS << "  }\n";
+}
 
 void llvm::EmitMatcherTable(const Matcher *TheMatcher,
                             const CodeGenDAGPatterns &CGP,
@@ -837,7 +866,9 @@ void llvm::EmitMatcherTable(const Matcher *TheMatcher,
   MatcherEmitter.EmitHistogram(TheMatcher, OS);
 
   OS << "  #undef TARGET_VAL\n";
-  OS << "  return SelectCodeCommon(N, MatcherTable,sizeof(MatcherTable));\n}\n";
+  MatcherEmitter.EmitOpcodeDispatch(OS);
+  OS << "  return SelectCodeCommon(N, MatcherTable, sizeof(MatcherTable),\n";
+  OS << "                          MatcherIndex);\n}\n";
   OS << '\n';
 
   // Next up, emit the function for node and pattern predicates:
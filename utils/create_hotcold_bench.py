@@ -0,0 +1,96 @@
+#!/usr/bin/env python
+"""A hot/cold code splitting benchmark creation program.
+
+This is a python program that creates LLVM IR for a program whose hot loop
+calls many small functions, each of which checks its arguments and has a
+large error handling path that never runs, like the assertion and error
+reporting code of real programs.  The error paths end in a call to abort()
+and are interleaved with the hot code, so that without splitting most of the
+instruction cache lines and pages the hot loop touches are half full of cold
+code.
+
+One good use of this program is to measure the instruction cache and TLB
+behavior of the hot loop with and without outlining the cold paths, e.g.:
+
+  create_hotcold_bench.py 2000 > hc.ll
+  opt -O2 hc.ll -o base.bc
+  opt -O2 -hot-cold-split hc.ll -o split.bc
+  llc -O2 -filetype=obj -group-functions-by-hotness split.bc -o split.o
+  llc -O2 -filetype=obj base.bc -o base.o
+  clang base.o -o base && clang split.o -o split
+  perf stat -e instructions,L1-icache-load-misses,iTLB-load-misses ./base
+  perf stat -e instructions,L1-icache-load-misses,iTLB-load-misses ./split
+
+where -stats on the opt run with -hot-cold-split reports the number of
+outlined regions under "hotcoldsplit".
+"""
+
+from __future__ import print_function
+import argparse
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+                       formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('functions', type=int,
+                      help="Number of functions the hot loop calls")
+  parser.add_argument('--cold-size', type=int, default=40,
+                      help="Number of instructions on each error path")
+  parser.add_argument('--iterations', type=int, default=100000,
+                      help="Number of iterations of the hot loop")
+  args = parser.parse_args()
+  if args.functions < 1 or args.cold_size < 1 or args.iterations < 1:
+    print("The function, size and iteration counts must be positive")
+    return
+
+  print("declare void @abort() noreturn")
+  print("declare i32 @printf(i8*, ...)")
+  print("")
+  print("@msg = private constant [13 x i8] c\"error %d %d\\0A\\00\"")
+  print("")
+
+  for f in range(args.functions):
+    print("define i32 @f%d(i32 %%a, i32 %%b) noinline {" % f)
+    print("entry:")
+    print("  %%bad = icmp ugt i32 %%a, %d" % (1 << 30))
+    print("  br i1 %bad, label %fail, label %ok")
+    print("fail:")
+    prev = "%a"
+    for s in range(args.cold_size):
+      print("  %%c%d = %s i32 %s, %d" %
+            (s, ["mul", "xor", "add", "sub"][s % 4], prev, s * 31 + f))
+      prev = "%%c%d" % s
+    print("  %fmt = getelementptr inbounds [13 x i8], [13 x i8]* @msg, "
+          "i64 0, i64 0")
+    print("  %%pr = call i32 (i8*, ...) @printf(i8* %%fmt, i32 %d, i32 %s)" %
+          (f, prev))
+    print("  call void @abort()")
+    print("  unreachable")
+    print("ok:")
+    print("  %%x = mul i32 %%a, %d" % (f * 2 + 1))
+    print("  %r = add i32 %x, %b")
+    print("  ret i32 %r")
+    print("}")
+    print("")
+
+  print("define i32 @main() {")
+  print("entry:")
+  print("  br label %loop")
+  print("loop:")
+  print("  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]")
+  print("  %%acc = phi i32 [ 0, %%entry ], [ %%acc.f%d, %%loop ]" %
+        (args.functions - 1))
+  print("  %a = and i32 %i, 65535")
+  prev = "%acc"
+  for f in range(args.functions):
+    print("  %%acc.f%d = call i32 @f%d(i32 %%a, i32 %s)" % (f, f, prev))
+    prev = "%%acc.f%d" % f
+  print("  %i.next = add nuw nsw i32 %i, 1")
+  print("  %%done = icmp eq i32 %%i.next, %d" % args.iterations)
+  print("  br i1 %done, label %exit, label %loop")
+  print("exit:")
+  print("  %%res = and i32 %s, 1" % prev)
+  print("  ret i32 %res")
+  print("}")
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,79 @@
+#!/usr/bin/env python
+"""A register allocation benchmark creation program.
+
+This is a python program that creates LLVM IR for a function with a large
+control flow graph and many long live ranges, which is what makes the greedy
+register allocator and its live range splitting expensive.  The function
+loads more values than there are registers up front, runs a long sequence of
+loops that each use a few of them, and sums all of them at the end, so every
+value is live through most of the blocks and has to be split or spilled
+around the loops that don't use it.
+
+One good use of this program is to measure the register allocation time and
+the quality of the spill code, e.g.:
+
+  create_regalloc_bench.py 2000 > ra.ll
+  llc -O2 -time-passes -stats ra.ll -o /dev/null
+
+which reports the "Greedy Register Allocator" time, and the number of split
+live ranges, spills and reloads under the "regalloc" statistics.  Running it
+again with a different -grow-region-complexity-budget shows what bounding the
+region splitting costs in spill code.  The peak memory use of llc, which the
+live intervals dominate on such functions, can be read off the "Maximum
+resident set size" of /usr/bin/time -v.
+"""
+
+from __future__ import print_function
+import argparse
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+                       formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('loops', type=int,
+                      help="Number of loops in the function")
+  parser.add_argument('--values', type=int, default=64,
+                      help="Number of values live across the whole function")
+  args = parser.parse_args()
+  if args.loops < 1 or args.values < 1:
+    print("The loop and value counts must be positive")
+    return
+
+  nv = args.values
+  print("define i64 @f(i64* %p, i64 %n) {")
+  print("entry:")
+  for v in range(nv):
+    print("  %%g%d = getelementptr inbounds i64, i64* %%p, i64 %d" % (v, v))
+    print("  %%v%d = load volatile i64, i64* %%g%d, align 8" % (v, v))
+  print("  br label %l0")
+
+  acc = "0"
+  for k in range(args.loops):
+    pred = "l%d.exit" % (k - 1) if k else "entry"
+    a, b = "%%v%d" % (k % nv), "%%v%d" % ((k * 7 + 3) % nv)
+    print("l%d:" % k)
+    print("  %%i%d = phi i64 [ 0, %%%s ], [ %%i%d.next, %%l%d ]" %
+          (k, pred, k, k))
+    print("  %%acc%d = phi i64 [ %s, %%%s ], [ %%acc%d.next, %%l%d ]" %
+          (k, acc, pred, k, k))
+    print("  %%q%d = getelementptr inbounds i64, i64* %%p, i64 %%i%d" % (k, k))
+    print("  %%x%d = load i64, i64* %%q%d, align 8" % (k, k))
+    print("  %%m%d = mul i64 %%x%d, %s" % (k, k, a))
+    print("  %%s%d = xor i64 %%m%d, %s" % (k, k, b))
+    print("  %%acc%d.next = add i64 %%acc%d, %%s%d" % (k, k, k))
+    print("  %%i%d.next = add nuw nsw i64 %%i%d, 1" % (k, k))
+    print("  %%done%d = icmp eq i64 %%i%d.next, %%n" % (k, k))
+    print("  br i1 %%done%d, label %%l%d.exit, label %%l%d" % (k, k, k))
+    print("l%d.exit:" % k)
+    acc = "%%acc%d.next" % k
+    if k + 1 < args.loops:
+      print("  br label %%l%d" % (k + 1))
+
+  prev = acc
+  for v in range(nv):
+    print("  %%sum%d = add i64 %s, %%v%d" % (v, prev, v))
+    prev = "%%sum%d" % v
+  print("  ret i64 %s" % prev)
+  print("}")
+
+if __name__ == '__main__':
+  main()
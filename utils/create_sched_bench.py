@@ -0,0 +1,62 @@
+#!/usr/bin/env python
+"""A machine scheduler DAG construction benchmark creation program.
+
+This is a python program that creates LLVM IR for a function with one huge
+basic block of loads and stores, like the straight-line code of a fully
+unrolled or machine generated kernel.  Most accesses go to many different
+global arrays, whose memory dependencies the scheduler's DAG builder tracks
+separately; a configurable share of them go to one shared array, which makes
+its dependence lists long.
+
+One good use of this program is to time the DAG construction of the machine
+scheduler and to look at the quality of the schedule on large blocks, e.g.:
+
+  create_sched_bench.py 20000 > sched.ll
+  llc -O2 -enable-misched -time-passes sched.ll -o sched.s
+
+comparing the "Machine Instruction Scheduler" time, and the interleaving of
+the loads and stores in sched.s, for different -dag-maps-huge-region values.
+"""
+
+from __future__ import print_function
+import argparse
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+                       formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('statements', type=int,
+                      help="Number of load/compute/store statements")
+  parser.add_argument('--arrays', type=int, default=256,
+                      help="Number of distinct global arrays")
+  parser.add_argument('--shared-percent', type=int, default=10,
+                      help="Percentage of statements using the shared array")
+  args = parser.parse_args()
+  if args.statements < 1 or args.arrays < 1:
+    print("The statement and array counts must be positive")
+    return
+
+  for a in range(args.arrays):
+    print("@a%d = global [64 x i32] zeroinitializer, align 16" % a)
+  print("@shared = global [4096 x i32] zeroinitializer, align 16")
+  print("")
+  print("define void @f(i32 %k) {")
+  print("entry:")
+  for s in range(args.statements):
+    if s * args.shared_percent // 100 != (s + 1) * args.shared_percent // 100:
+      arr, n, idx = "@shared", 4096, (s * 17) % 4096
+    else:
+      arr, n, idx = "@a%d" % (s % args.arrays), 64, (s // args.arrays) % 64
+    dst = (idx + 1) % n
+    print("  %%p%d = getelementptr inbounds [%d x i32], [%d x i32]* %s, "
+          "i64 0, i64 %d" % (s, n, n, arr, idx))
+    print("  %%q%d = getelementptr inbounds [%d x i32], [%d x i32]* %s, "
+          "i64 0, i64 %d" % (s, n, n, arr, dst))
+    print("  %%v%d = load i32, i32* %%p%d, align 4" % (s, s))
+    print("  %%m%d = mul i32 %%v%d, %%k" % (s, s))
+    print("  %%r%d = add i32 %%m%d, %d" % (s, s, s % 97))
+    print("  store i32 %%r%d, i32* %%q%d, align 4" % (s, s))
+  print("  ret void")
+  print("}")
+
+if __name__ == '__main__':
+  main()
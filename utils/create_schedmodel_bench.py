@@ -0,0 +1,100 @@
+#!/usr/bin/env python
+"""A scheduling model benchmark creation program.
+
+This is a python program that creates LLVM IR for a vector floating point
+kernel whose speed depends on how well its instructions are scheduled: a loop
+over arrays of doubles with several independent chains of multiplies, adds and
+divides in its body, which the machine scheduler has to interleave to hide
+their latencies.  The program calls the kernel many times and returns the
+rounded sum of its results, so the output can also be compared between runs.
+
+One good use of this program is to compare the code scheduled with the
+machine model of a CPU against the one scheduled with the Haswell model on
+that CPU, e.g. on a Skylake Server machine:
+
+  create_schedmodel_bench.py 8 > model.ll
+  llc -O3 -mcpu=haswell model.ll -o hsw.s
+  llc -O3 -mcpu=skylake-avx512 model.ll -o skx.s
+  clang hsw.s -o hsw && clang skx.s -o skx
+  perf stat ./hsw; perf stat ./skx
+
+and with -mcpu=znver1 instead on a Zen machine.  --width 8 makes the kernel
+use 512-bit vectors, which only Skylake Server of the three supports.
+"""
+
+from __future__ import print_function
+import argparse
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+                       formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('chains', type=int,
+                      help="Number of independent dependence chains")
+  parser.add_argument('--width', type=int, default=4, choices=[2, 4, 8],
+                      help="Number of doubles in a vector")
+  parser.add_argument('--depth', type=int, default=6,
+                      help="Number of operations in each chain")
+  parser.add_argument('--elements', type=int, default=1024,
+                      help="Number of vectors in each array")
+  parser.add_argument('--iterations', type=int, default=100000,
+                      help="Number of times the kernel is called")
+  args = parser.parse_args()
+  if args.chains < 1 or args.depth < 1 or args.elements < 1:
+    print("The chain, depth and element counts must be positive")
+    return
+
+  vt = "<%d x double>" % args.width
+  n = args.elements
+  splat = lambda v: "<" + ", ".join(["double %s" % v] * args.width) + ">"
+  for c in range(args.chains):
+    print("@a%d = global [%d x %s] zeroinitializer, align 64" % (c, n, vt))
+  print("")
+  print("define %s @kernel(%s %%x) noinline {" % (vt, vt))
+  print("entry:")
+  print("  br label %loop")
+  print("loop:")
+  print("  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]")
+  for c in range(args.chains):
+    print("  %%acc%d = phi %s [ %s, %%entry ], [ %%acc%d.next, %%loop ]" %
+          (c, vt, splat("1.0"), c))
+  for c in range(args.chains):
+    print("  %%p%d = getelementptr inbounds [%d x %s], [%d x %s]* @a%d, "
+          "i64 0, i64 %%i" % (c, n, vt, n, vt, c))
+    print("  %%v%d = load %s, %s* %%p%d, align 64" % (c, vt, vt, c))
+    prev = "%%v%d" % c
+    for d in range(args.depth):
+      op = ["fmul", "fadd", "fdiv"][d % 3]
+      print("  %%t%d.%d = %s %s %s, %%x" % (c, d, op, vt, prev))
+      prev = "%%t%d.%d" % (c, d)
+    print("  %%acc%d.next = fadd %s %%acc%d, %s" % (c, vt, c, prev))
+  print("  %i.next = add nuw nsw i64 %i, 1")
+  print("  %%done = icmp eq i64 %%i.next, %d" % n)
+  print("  br i1 %done, label %exit, label %loop")
+  print("exit:")
+  prev = "%acc0.next"
+  for c in range(1, args.chains):
+    print("  %%sum%d = fadd %s %s, %%acc%d.next" % (c, vt, prev, c))
+    prev = "%%sum%d" % c
+  print("  ret %s %s" % (vt, prev))
+  print("}")
+  print("")
+  print("define i32 @main() {")
+  print("entry:")
+  print("  br label %loop")
+  print("loop:")
+  print("  %k = phi i32 [ 0, %entry ], [ %k.next, %loop ]")
+  print("  %%s = phi %s [ zeroinitializer, %%entry ], [ %%s.next, %%loop ]" %
+        vt)
+  print("  %%r = call %s @kernel(%s %s)" % (vt, vt, splat("1.000001")))
+  print("  %%s.next = fadd %s %%s, %%r" % vt)
+  print("  %k.next = add nuw nsw i32 %k, 1")
+  print("  %%done = icmp eq i32 %%k.next, %d" % args.iterations)
+  print("  br i1 %done, label %exit, label %loop")
+  print("exit:")
+  print("  %%e = extractelement %s %%s.next, i32 0" % vt)
+  print("  %res = fptoui double %e to i32")
+  print("  ret i32 %res")
+  print("}")
+
+if __name__ == '__main__':
+  main()